@@ -0,0 +1,188 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "autolock_timer.h"
+#include "benchmark/benchmark.h"
+#include "concurrent_cache.h"
+#include "linked_unordered_map.h"
+
+namespace devtools_goma {
+
+namespace {
+
+constexpr int kNumKeys = 100000;
+constexpr int kTraceLength = 1 << 20;
+constexpr size_t kCapacity = 4096;
+
+// FifoCache is the LinkedUnorderedMap + global lock cache that ListDirCache
+// and modulemap::Cache used before ConcurrentCache. Kept here as the baseline.
+class FifoCache {
+ public:
+  explicit FifoCache(size_t capacity) : capacity_(capacity) {}
+
+  bool Lookup(const std::string& key, int* value) {
+    AUTOLOCK(lock, &mu_);
+    auto it = map_.find(key);
+    if (it == map_.end()) {
+      return false;
+    }
+    *value = it->second;
+    return true;
+  }
+
+  void Insert(const std::string& key, int value) {
+    AUTOLOCK(lock, &mu_);
+    map_.emplace_back(key, value);
+    while (map_.size() > capacity_) {
+      map_.pop_front();
+    }
+  }
+
+ private:
+  const size_t capacity_;
+  Lock mu_;
+  LinkedUnorderedMap<std::string, int> map_ ABSL_GUARDED_BY(mu_);
+};
+
+class ConcurrentCacheAdapter {
+ public:
+  explicit ConcurrentCacheAdapter(size_t capacity) : cache_(capacity) {}
+
+  bool Lookup(const std::string& key, int* value) {
+    return cache_.Lookup(key, value);
+  }
+
+  void Insert(const std::string& key, int value) {
+    cache_.Insert(key, value, 1);
+  }
+
+ private:
+  ConcurrentCache<std::string, int> cache_;
+};
+
+// Returns a key trace read from the file named by $GOMA_CACHE_TRACE (one
+// key per line, e.g. directories given to ListDirCache), or nullptr.
+const std::vector<std::string>* RecordedTrace() {
+  static const std::vector<std::string>* trace =
+      []() -> std::vector<std::string>* {
+    const char* path = getenv("GOMA_CACHE_TRACE");
+    if (path == nullptr) {
+      return nullptr;
+    }
+    std::ifstream ifs(path);
+    auto* trace = new std::vector<std::string>;
+    std::string line;
+    while (std::getline(ifs, line)) {
+      trace->push_back(line);
+    }
+    return trace;
+  }();
+  return trace;
+}
+
+// Zipf distributed accesses, like headers in a build: a few are used by
+// every compile, most only by a few.
+std::vector<std::string> ZipfTrace() {
+  std::vector<double> cdf(kNumKeys);
+  double sum = 0;
+  for (int i = 0; i < kNumKeys; ++i) {
+    sum += 1.0 / std::pow(i + 1, 0.9);
+    cdf[i] = sum;
+  }
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> dist(0, sum);
+  std::vector<std::string> trace;
+  trace.reserve(kTraceLength);
+  for (int i = 0; i < kTraceLength; ++i) {
+    const int k = std::lower_bound(cdf.begin(), cdf.end(), dist(rng)) -
+                  cdf.begin();
+    trace.push_back(absl::StrCat("/src/dir", k));
+  }
+  return trace;
+}
+
+// ZipfTrace with a one-off scan over unique keys every 64K accesses, like a
+// compile of a large generated target.
+std::vector<std::string> ScanTrace() {
+  std::vector<std::string> trace = ZipfTrace();
+  for (int i = 0; i < kTraceLength; i += 1 << 16) {
+    for (int j = 0; j < 8192 && i + j < kTraceLength; ++j) {
+      trace[i + j] = absl::StrCat("/out/gen/scan", i, "/", j);
+    }
+  }
+  return trace;
+}
+
+const std::vector<std::string>& Trace(int kind) {
+  static const std::vector<std::string>* zipf =
+      new std::vector<std::string>(ZipfTrace());
+  static const std::vector<std::string>* scan =
+      new std::vector<std::string>(ScanTrace());
+  switch (kind) {
+    case 0:
+      return *zipf;
+    case 1:
+      return *scan;
+    default:
+      if (RecordedTrace() != nullptr && !RecordedTrace()->empty()) {
+        return *RecordedTrace();
+      }
+      return *zipf;
+  }
+}
+
+}  // namespace
+
+// Replays a trace from multiple threads, inserting on miss. Arg is trace kind:
+// 0 zipf, 1 zipf with scans, 2 $GOMA_CACHE_TRACE (falls back to zipf).
+template <class Cache>
+void BM_Replay(benchmark::State& state) {
+  static Cache* cache;
+  if (state.thread_index() == 0) {
+    cache = new Cache(kCapacity);
+  }
+  const std::vector<std::string>& trace = Trace(state.range(0));
+  int64_t hits = 0;
+  int64_t lookups = 0;
+  size_t i = state.thread_index() * (trace.size() / state.threads());
+  for (auto _ : state) {
+    const std::string& key = trace[i];
+    if (++i == trace.size()) {
+      i = 0;
+    }
+    int value;
+    if (cache->Lookup(key, &value)) {
+      ++hits;
+    } else {
+      cache->Insert(key, 0);
+    }
+    ++lookups;
+  }
+  state.counters["hit_rate"] = benchmark::Counter(
+      lookups > 0 ? static_cast<double>(hits) / lookups : 0,
+      benchmark::Counter::kAvgThreads);
+  if (state.thread_index() == 0) {
+    delete cache;
+  }
+}
+BENCHMARK_TEMPLATE(BM_Replay, FifoCache)
+    ->ArgsProduct({{0, 1, 2}})
+    ->ThreadRange(1, 32);
+BENCHMARK_TEMPLATE(BM_Replay, ConcurrentCacheAdapter)
+    ->ArgsProduct({{0, 1, 2}})
+    ->ThreadRange(1, 32);
+
+}  // namespace devtools_goma
+
+BENCHMARK_MAIN();
@@ -5,6 +5,7 @@
 #include <string>
 
 #include "benchmark/benchmark.h"
+#include "cxx/include_processor/cpp_directive_parser.h"
 #include "cxx/include_processor/cpp_parser.h"
 #include "glog/logging.h"
 
@@ -60,6 +61,41 @@ void BM_ReadFunctionMacro(benchmark::State& state) {
 
 BENCHMARK(BM_ReadFunctionMacro)->RangeMultiplier(2)->Range(1, 32);
 
+// Processes directives parsed once, as directives of a header are cached
+// in IncludeCache and processed for every compile.
+void BM_ProcessPreparsedDirectives(benchmark::State& state) {
+  std::string directives;
+  for (int i = 0; i < state.range(0); ++i) {
+    const std::string n = std::to_string(i);
+    directives += "#ifndef LONG_LONG_GUARD_" + n + "\n" +
+                  "#define LONG_LONG_GUARD_" + n + "\n" +
+                  "#define LONG_LONG_FEATURE_" + n + " 1\n" +
+                  "#endif\n" +
+                  "#if defined(LONG_LONG_FEATURE_" + n + ") && " +
+                  "LONG_LONG_FEATURE_" + n + "\n" +
+                  "#define LONG_LONG_USE_" + n + " LONG_LONG_FEATURE_" + n +
+                  "\n" +
+                  "#endif\n" +
+                  "#ifdef LONG_LONG_USE_" + n + "\n" +
+                  "#undef LONG_LONG_USE_" + n + "\n" +
+                  "#endif\n";
+  }
+  SharedCppDirectives parsed =
+      CppDirectiveParser::ParseFromString(directives, "a.h");
+  CHECK(parsed);
+
+  for (auto _ : state) {
+    (void)_;
+    CppParser cpp_parser;
+    cpp_parser.AddPreparsedDirectivesInput(parsed);
+    CHECK(cpp_parser.ProcessDirectives());
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_ProcessPreparsedDirectives)->RangeMultiplier(4)->Range(1, 256);
+
 }  // namespace devtools_goma
 
 BENCHMARK_MAIN();
@@ -0,0 +1,244 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "benchmark/benchmark.h"
+#include "cxx/include_processor/include_cache.h"
+#include "deps_cache.h"
+#include "file_stat_cache.h"
+#include "glog/logging.h"
+#include "goma_hash.h"
+#include "path.h"
+#include "unittest_util.h"
+#include "worker_thread_manager.h"
+
+namespace devtools_goma {
+
+namespace {
+
+// A build of kNumEntries compiles over kNumSources sources, each of which
+// includes kNumDepsPerEntry of kNumHeaders headers.
+constexpr int kNumEntries = 100000;
+constexpr int kNumSources = 10000;
+constexpr int kNumHeaders = 2000;
+constexpr int kNumDepsPerEntry = 50;
+
+DepsCache::Identifier MakeIdentifier(int i) {
+  SHA256HashValue hash_value;
+  ComputeDataHashKeyForSHA256HashValue(absl::StrCat("identifier", i),
+                                       &hash_value);
+  return hash_value;
+}
+
+// Sources and headers on disk, and a DepsCache filled with kNumEntries
+// entries. Created once, since filling the cache takes seconds.
+class DepsCacheEnv {
+ public:
+  static const DepsCacheEnv& Get() {
+    static const DepsCacheEnv env;
+    return env;
+  }
+
+  const std::string& cwd() const { return cwd_; }
+  const DepsCache::Identifier& identifier(int i) const {
+    return identifiers_[i];
+  }
+  const std::string& input_file(int i) const {
+    return sources_[i % sources_.size()];
+  }
+  const std::set<std::string>& dependencies(int i) const {
+    return dependencies_[i % dependencies_.size()];
+  }
+
+ private:
+  DepsCacheEnv()
+      : tmpdir_("deps_cache_benchmark"), cwd_(tmpdir_.realcwd()) {
+    GlobalFileStatCache::Init(0, absl::InfiniteDuration());
+    IncludeCache::Init(kNumHeaders + kNumSources, true);
+    DepsCache::Init(file::JoinPath(tmpdir_.tmpdir(), ".goma_deps"),
+                    absl::nullopt, kNumEntries * 2, 1024);
+    DepsCache::LoadIfEnabled();
+    CHECK(DepsCache::IsEnabled());
+
+    std::vector<std::string> headers;
+    for (int i = 0; i < kNumHeaders; ++i) {
+      std::string name = absl::StrCat("include/header", i, ".h");
+      tmpdir_.CreateTmpFile(name, absl::StrCat("#pragma once\n"
+                                               "#include <header",
+                                               (i + 1) % kNumHeaders,
+                                               ".h>\n"
+                                               "int f",
+                                               i, "();\n"));
+      headers.push_back(tmpdir_.FullPath(name));
+    }
+    for (int i = 0; i < kNumSources; ++i) {
+      std::string name = absl::StrCat("src/source", i, ".cc");
+      tmpdir_.CreateTmpFile(name, absl::StrCat("#include <header", i, ".h>\n"
+                                               "int main() {}\n"));
+      sources_.push_back(tmpdir_.FullPath(name));
+    }
+
+    // Headers included by a source are skewed to low numbers, like base/
+    // headers that are included everywhere.
+    std::mt19937 rng(0);
+    std::exponential_distribution<double> dist(8.0 / kNumHeaders);
+    dependencies_.resize(kNumSources);
+    for (auto& deps : dependencies_) {
+      while (deps.size() < kNumDepsPerEntry) {
+        deps.insert(headers[static_cast<size_t>(dist(rng)) % headers.size()]);
+      }
+    }
+
+    FileStatCache file_stat_cache;
+    for (int i = 0; i < kNumEntries; ++i) {
+      identifiers_.push_back(MakeIdentifier(i));
+      CHECK(DepsCache::instance()->SetDependencies(
+          identifier(i), cwd(), input_file(i), dependencies(i),
+          &file_stat_cache));
+    }
+  }
+
+  TmpdirUtil tmpdir_;
+  const std::string cwd_;
+  std::vector<DepsCache::Identifier> identifiers_;
+  std::vector<std::string> sources_;
+  std::vector<std::set<std::string>> dependencies_;
+};
+
+}  // namespace
+
+// Gets dependencies of random entries. Arg 0 uses a new FileStatCache for
+// each call as CompileTask does, and 1 a warm FileStatCache per thread to
+// measure DepsCache alone.
+void BM_DepsCacheGetDependencies(benchmark::State& state) {
+  const DepsCacheEnv& env = DepsCacheEnv::Get();
+  std::mt19937 rng(state.thread_index());
+  std::uniform_int_distribution<int> dist(0, kNumEntries - 1);
+  std::unique_ptr<FileStatCache> warm_file_stat_cache;
+  if (state.range(0) == 1) {
+    warm_file_stat_cache = absl::make_unique<FileStatCache>();
+  }
+  int64_t hits = 0;
+  for (auto _ : state) {
+    (void)_;
+    const int i = dist(rng);
+    std::unique_ptr<FileStatCache> task_file_stat_cache;
+    FileStatCache* file_stat_cache = warm_file_stat_cache.get();
+    if (file_stat_cache == nullptr) {
+      task_file_stat_cache = absl::make_unique<FileStatCache>();
+      file_stat_cache = task_file_stat_cache.get();
+    }
+    std::set<std::string> dependencies;
+    if (DepsCache::instance()->GetDependencies(
+            env.identifier(i), env.cwd(), env.input_file(i), &dependencies,
+            file_stat_cache)) {
+      ++hits;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["hit_rate"] = benchmark::Counter(
+      state.iterations() > 0
+          ? static_cast<double>(hits) / state.iterations()
+          : 0,
+      benchmark::Counter::kAvgThreads);
+}
+BENCHMARK(BM_DepsCacheGetDependencies)->Arg(0)->Arg(1)->ThreadRange(1, 16);
+
+// Overwrites dependencies of random entries, as a compile of a modified
+// source does. A warm FileStatCache is used per thread.
+// Arg 0 uses SetDependencies, and 1 SetDependenciesAsync with the writer
+// thread as CompileTask does. p50_us and p99_us are the latency of a call,
+// which is on the compile critical path.
+void BM_DepsCacheSetDependencies(benchmark::State& state) {
+  const DepsCacheEnv& env = DepsCacheEnv::Get();
+  const bool async = state.range(0) == 1;
+  static WorkerThreadManager* wm;
+  if (async && state.thread_index() == 0) {
+    wm = new WorkerThreadManager;
+    wm->Start(1);
+    DepsCache::instance()->StartWriter(wm);
+  }
+  std::mt19937 rng(state.thread_index());
+  std::uniform_int_distribution<int> dist(0, kNumEntries - 1);
+  FileStatCache file_stat_cache;
+  std::vector<absl::Duration> latencies;
+  for (auto _ : state) {
+    (void)_;
+    const int i = dist(rng);
+    const absl::Time start = absl::Now();
+    if (async) {
+      DepsCache::instance()->SetDependenciesAsync(
+          env.identifier(i), env.cwd(), env.input_file(i),
+          env.dependencies(i), &file_stat_cache);
+    } else {
+      DepsCache::instance()->SetDependencies(env.identifier(i), env.cwd(),
+                                             env.input_file(i),
+                                             env.dependencies(i),
+                                             &file_stat_cache);
+    }
+    latencies.push_back(absl::Now() - start);
+  }
+  if (async && state.thread_index() == 0) {
+    DepsCache::instance()->StopWriter();
+    wm->Finish();
+    delete wm;
+    wm = nullptr;
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (!latencies.empty()) {
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+      return absl::ToDoubleMicroseconds(
+          latencies[static_cast<size_t>((latencies.size() - 1) * p)]);
+    };
+    state.counters["p50_us"] =
+        benchmark::Counter(percentile(0.50), benchmark::Counter::kAvgThreads);
+    state.counters["p99_us"] =
+        benchmark::Counter(percentile(0.99), benchmark::Counter::kAvgThreads);
+  }
+}
+BENCHMARK(BM_DepsCacheSetDependencies)
+    ->Arg(0)
+    ->Arg(1)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+// Mixes GetDependencies and SetDependencies, 1 set per Arg gets.
+void BM_DepsCacheMixed(benchmark::State& state) {
+  const DepsCacheEnv& env = DepsCacheEnv::Get();
+  std::mt19937 rng(state.thread_index());
+  std::uniform_int_distribution<int> dist(0, kNumEntries - 1);
+  FileStatCache file_stat_cache;
+  int64_t n = 0;
+  for (auto _ : state) {
+    (void)_;
+    const int i = dist(rng);
+    if (++n % (state.range(0) + 1) == 0) {
+      DepsCache::instance()->SetDependencies(env.identifier(i), env.cwd(),
+                                             env.input_file(i),
+                                             env.dependencies(i),
+                                             &file_stat_cache);
+      continue;
+    }
+    std::set<std::string> dependencies;
+    DepsCache::instance()->GetDependencies(env.identifier(i), env.cwd(),
+                                           env.input_file(i), &dependencies,
+                                           &file_stat_cache);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DepsCacheMixed)->Arg(10)->ThreadRange(1, 16);
+
+}  // namespace devtools_goma
+
+BENCHMARK_MAIN();
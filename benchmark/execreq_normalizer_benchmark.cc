@@ -0,0 +1,132 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "glog/logging.h"
+#include "lib/compiler_flag_type_specific.h"
+#include "lib/execreq_normalizer.h"
+#include "lib/goma_data.pb.h"
+
+namespace devtools_goma {
+
+namespace {
+
+constexpr char kCwd[] = "/home/bob/src/out/Release";
+
+// Returns a clang ExecReq of a large chromium-like compile.
+const ExecReq& LargeClangExecReq() {
+  static const ExecReq* req = [] {
+    auto* req = new ExecReq;
+    CommandSpec* spec = req->mutable_command_spec();
+    spec->set_name("clang++");
+    spec->set_version("4.2.1[clang version 15.0.0]");
+    spec->set_target("x86_64-unknown-linux-gnu");
+    spec->set_local_compiler_path(
+        "/home/bob/src/third_party/llvm-build/Release+Asserts/bin/clang++");
+    for (int i = 0; i < 8; ++i) {
+      spec->add_system_include_path(
+          absl::StrCat("/home/bob/src/build/linux/sysroot/usr/include/", i));
+      spec->add_cxx_system_include_path(
+          absl::StrCat("/home/bob/src/buildtools/third_party/libc++/", i));
+    }
+
+    req->add_arg("../../third_party/llvm-build/Release+Asserts/bin/clang++");
+    req->add_arg("-MMD");
+    req->add_arg("-MF");
+    req->add_arg("obj/foo/foo.o.d");
+    req->add_arg("-fdebug-compilation-dir=.");
+    req->add_arg("-fdebug-prefix-map=/home/bob/src=../..");
+    for (int i = 0; i < 100; ++i) {
+      req->add_arg(absl::StrCat("-DFEATURE_", i, "=1"));
+    }
+    for (int i = 0; i < 100; ++i) {
+      req->add_arg(absl::StrCat("-I../../third_party/lib", i, "/include"));
+    }
+    req->add_arg("-isystem/home/bob/src/third_party/system/include");
+    req->add_arg("--sysroot=/home/bob/src/build/linux/sysroot");
+    req->add_arg("-g2");
+    req->add_arg("-c");
+    req->add_arg("../../foo/foo.cc");
+    req->add_arg("-o");
+    req->add_arg("obj/foo/foo.o");
+
+    req->set_cwd(kCwd);
+    for (int i = 0; i < 50; ++i) {
+      req->add_env(absl::StrCat("VAR", i, "=value", i));
+    }
+    req->add_env(absl::StrCat("PWD=", kCwd));
+    req->add_env("DEVELOPER_DIR=/Applications/Xcode.app/Contents/Developer");
+
+    // Inputs are sorted by filename, and half of them are under cwd.
+    for (int i = 0; i < 3000; ++i) {
+      ExecReq_Input* input = req->add_input();
+      if (i % 2 == 0) {
+        input->set_filename(
+            absl::StrCat("/home/bob/src/base/header", i, ".h"));
+      } else {
+        input->set_filename(absl::StrCat(kCwd, "/gen/header", i, ".h"));
+      }
+      input->set_hash_key(std::string(64, 'a' + i % 16));
+    }
+    for (int i = 0; i < 4; ++i) {
+      req->add_subprogram()->set_path(
+          absl::StrCat("/home/bob/src/plugin", i, ".so"));
+    }
+    req->add_expected_output_files("obj/foo/foo.o.d");
+    req->add_expected_output_files("obj/foo/foo.o");
+    req->mutable_requester_info()->set_compiler_proxy_id("bob@host:8088/1");
+    return req;
+  }();
+  return *req;
+}
+
+void BM_CopyExecReq(benchmark::State& state) {
+  const ExecReq& prototype = LargeClangExecReq();
+  for (auto _ : state) {
+    (void)_;
+    ExecReq req(prototype);
+    benchmark::DoNotOptimize(req);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CopyExecReq);
+
+// Includes the cost of BM_CopyExecReq.
+void BM_NormalizeForCacheKey(benchmark::State& state) {
+  const ExecReq& prototype = LargeClangExecReq();
+  std::unique_ptr<const ExecReqNormalizer> normalizer =
+      CompilerFlagTypeSpecific::FromArg(prototype.command_spec().name())
+          .NewExecReqNormalizer();
+  std::map<std::string, std::string> debug_prefix_map;
+  if (state.range(0)) {
+    debug_prefix_map["/home/bob/src"] = "../..";
+  }
+  for (auto _ : state) {
+    (void)_;
+    ExecReq req(prototype);
+    normalizer->NormalizeForCacheKey(0, true, false, {}, debug_prefix_map,
+                                     &req);
+    benchmark::DoNotOptimize(req);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_NormalizeForCacheKey)->ArgName("debug_prefix_map")->Arg(0)->Arg(1);
+
+}  // namespace
+
+}  // namespace devtools_goma
+
+int main(int argc, char** argv) {
+  // NormalizeForCacheKey logs every request at INFO.
+  FLAGS_minloglevel = google::GLOG_WARNING;
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
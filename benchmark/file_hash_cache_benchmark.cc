@@ -0,0 +1,133 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "benchmark/benchmark.h"
+#include "file_hash_cache.h"
+#include "file_stat.h"
+#include "glog/logging.h"
+
+namespace devtools_goma {
+
+namespace {
+
+constexpr int kNumFiles = 100000;
+
+// Paths, FileStats and hash keys of kNumFiles synthetic files, and a
+// FileHashCache that knows all of them.
+// FileStats are made up, since FileHashCache only compares them.
+class FileHashCacheEnv {
+ public:
+  static FileHashCacheEnv* Get() {
+    static FileHashCacheEnv env;
+    return &env;
+  }
+
+  FileHashCache* cache() { return &cache_; }
+  const std::string& path(int i) const { return paths_[i]; }
+  const FileStat& file_stat(int i) const { return file_stats_[i]; }
+  const std::string& hash_key(int i) const { return hash_keys_[i]; }
+  absl::Time uploaded_time() const { return uploaded_time_; }
+
+ private:
+  FileHashCacheEnv() : uploaded_time_(absl::Now()) {
+    const absl::Time mtime = uploaded_time_ - absl::Hours(1);
+    for (int i = 0; i < kNumFiles; ++i) {
+      paths_.push_back(absl::StrCat("/src/third_party/dir", i % 1000,
+                                    "/header", i, ".h"));
+      FileStat file_stat;
+      file_stat.mtime = mtime;
+      file_stat.size = 1000 + i;
+      file_stats_.push_back(file_stat);
+      std::string hash_key = absl::StrCat(i);
+      hash_key.resize(64, '0');
+      hash_keys_.push_back(std::move(hash_key));
+      cache_.StoreFileCacheKey(paths_[i], hash_keys_[i], uploaded_time_,
+                               file_stats_[i]);
+    }
+  }
+
+  FileHashCache cache_;
+  const absl::Time uploaded_time_;
+  std::vector<std::string> paths_;
+  std::vector<FileStat> file_stats_;
+  std::vector<std::string> hash_keys_;
+};
+
+}  // namespace
+
+// Gets cache keys of random known files, as CompileTask does for each
+// input. With Arg 1, a missed timestamp is passed as for retries after
+// missing inputs.
+void BM_FileHashCacheGetFileCacheKey(benchmark::State& state) {
+  FileHashCacheEnv* env = FileHashCacheEnv::Get();
+  absl::optional<absl::Time> missed_timestamp;
+  if (state.range(0) == 1) {
+    missed_timestamp = env->uploaded_time();
+  }
+  std::mt19937 rng(state.thread_index());
+  std::uniform_int_distribution<int> dist(0, kNumFiles - 1);
+  for (auto _ : state) {
+    (void)_;
+    const int i = dist(rng);
+    std::string cache_key;
+    if (!env->cache()->GetFileCacheKey(env->path(i), missed_timestamp,
+                                       env->file_stat(i), &cache_key)) {
+      state.SkipWithError("cache miss");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FileHashCacheGetFileCacheKey)->Arg(0)->Arg(1)->ThreadRange(1, 16);
+
+// Checks random known hash keys, as done for outputs and uploaded files.
+void BM_FileHashCacheIsKnownCacheKey(benchmark::State& state) {
+  FileHashCacheEnv* env = FileHashCacheEnv::Get();
+  std::mt19937 rng(state.thread_index());
+  std::uniform_int_distribution<int> dist(0, kNumFiles - 1);
+  for (auto _ : state) {
+    (void)_;
+    if (!env->cache()->IsKnownCacheKey(env->hash_key(dist(rng)))) {
+      state.SkipWithError("unknown cache key");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FileHashCacheIsKnownCacheKey)->ThreadRange(1, 16);
+
+// Stores cache keys of random known files again, as done after uploads.
+// One of Arg calls stores, and the others get.
+void BM_FileHashCacheMixed(benchmark::State& state) {
+  FileHashCacheEnv* env = FileHashCacheEnv::Get();
+  std::mt19937 rng(state.thread_index());
+  std::uniform_int_distribution<int> dist(0, kNumFiles - 1);
+  int64_t n = 0;
+  for (auto _ : state) {
+    (void)_;
+    const int i = dist(rng);
+    if (++n % state.range(0) == 0) {
+      env->cache()->StoreFileCacheKey(env->path(i), env->hash_key(i),
+                                      env->uploaded_time(),
+                                      env->file_stat(i));
+      continue;
+    }
+    std::string cache_key;
+    env->cache()->GetFileCacheKey(env->path(i), absl::nullopt,
+                                  env->file_stat(i), &cache_key);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FileHashCacheMixed)->Arg(10)->Arg(100)->ThreadRange(1, 16);
+
+}  // namespace devtools_goma
+
+BENCHMARK_MAIN();
@@ -0,0 +1,132 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "cxx/include_processor/include_cache.h"
+#include "file_stat.h"
+#include "glog/logging.h"
+#include "unittest_util.h"
+
+namespace devtools_goma {
+
+namespace {
+
+constexpr int kNumHeaders = 4096;
+constexpr int kMaxCacheEntries = 1024;
+
+// Returns a header with include guard, includes, macros and conditionals,
+// about the size of a typical header.
+std::string MakeHeader(int i) {
+  std::string content =
+      absl::StrCat("#ifndef HEADER", i, "_H_\n#define HEADER", i, "_H_\n\n");
+  for (int j = 1; j <= 8; ++j) {
+    absl::StrAppend(&content, "#include \"header", (i + j) % kNumHeaders,
+                    ".h\"\n");
+  }
+  for (int j = 0; j < 8; ++j) {
+    absl::StrAppend(&content, "#if defined(OS_", j, ")\n",
+                    "#define HEADER", i, "_MACRO", j, "(x) ((x) + ", j,
+                    ")\n#else\n#define HEADER", i, "_MACRO", j, "(x) (x)\n",
+                    "#endif\n");
+  }
+  for (int j = 0; j < 32; ++j) {
+    absl::StrAppend(&content, "int header", i, "_function", j,
+                    "(int a, int b);  // not a directive\n");
+  }
+  absl::StrAppend(&content, "\n#endif  // HEADER", i, "_H_\n");
+  return content;
+}
+
+// Headers on disk and their FileStats.
+class IncludeCacheEnv {
+ public:
+  static const IncludeCacheEnv& Get() {
+    static const IncludeCacheEnv env;
+    return env;
+  }
+
+  const std::string& path(int i) const { return paths_[i]; }
+  const FileStat& file_stat(int i) const { return file_stats_[i]; }
+
+ private:
+  IncludeCacheEnv() : tmpdir_("include_cache_benchmark") {
+    for (int i = 0; i < kNumHeaders; ++i) {
+      const std::string name = absl::StrCat("header", i, ".h");
+      tmpdir_.CreateTmpFile(name, MakeHeader(i));
+      paths_.push_back(tmpdir_.FullPath(name));
+      file_stats_.emplace_back(paths_.back());
+      CHECK(file_stats_.back().IsValid()) << paths_.back();
+    }
+  }
+
+  TmpdirUtil tmpdir_;
+  std::vector<std::string> paths_;
+  std::vector<FileStat> file_stats_;
+};
+
+}  // namespace
+
+// Gets IncludeItems of random headers out of Arg headers, from a cache of
+// kMaxCacheEntries. With Arg <= kMaxCacheEntries, this measures the hit path.
+// Otherwise most calls read and parse the header, insert it and evict the
+// oldest entry.
+void BM_IncludeCacheGetIncludeItem(benchmark::State& state) {
+  const IncludeCacheEnv& env = IncludeCacheEnv::Get();
+  if (state.thread_index() == 0) {
+    IncludeCache::Init(kMaxCacheEntries, false);
+  }
+  std::mt19937 rng(state.thread_index());
+  std::uniform_int_distribution<int> dist(0, state.range(0) - 1);
+  for (auto _ : state) {
+    (void)_;
+    const int i = dist(rng);
+    IncludeItem item =
+        IncludeCache::instance()->GetIncludeItem(env.path(i), env.file_stat(i));
+    benchmark::DoNotOptimize(item);
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0) {
+    IncludeCache::Quit();
+  }
+}
+BENCHMARK(BM_IncludeCacheGetIncludeItem)
+    ->Arg(kMaxCacheEntries / 2)
+    ->Arg(kNumHeaders)
+    ->ThreadRange(1, 16);
+
+// Same as BM_IncludeCacheGetIncludeItem for directive hashes, which
+// DepsCache uses.
+void BM_IncludeCacheGetDirectiveHash(benchmark::State& state) {
+  const IncludeCacheEnv& env = IncludeCacheEnv::Get();
+  if (state.thread_index() == 0) {
+    IncludeCache::Init(kMaxCacheEntries, true);
+  }
+  std::mt19937 rng(state.thread_index());
+  std::uniform_int_distribution<int> dist(0, state.range(0) - 1);
+  for (auto _ : state) {
+    (void)_;
+    const int i = dist(rng);
+    absl::optional<SHA256HashValue> hash =
+        IncludeCache::instance()->GetDirectiveHash(env.path(i),
+                                                   env.file_stat(i));
+    benchmark::DoNotOptimize(hash);
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0) {
+    IncludeCache::Quit();
+  }
+}
+BENCHMARK(BM_IncludeCacheGetDirectiveHash)
+    ->Arg(kMaxCacheEntries / 2)
+    ->Arg(kNumHeaders)
+    ->ThreadRange(1, 16);
+
+}  // namespace devtools_goma
+
+BENCHMARK_MAIN();
@@ -0,0 +1,174 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "compiler_specific.h"
+#include "file_helper.h"
+#include "filesystem.h"
+#include "glog/logging.h"
+#include "local_output_cache.h"
+#include "options.h"
+#include "path.h"
+
+MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
+#include "lib/goma_data.pb.h"
+MSVC_POP_WARNING()
+
+namespace devtools_goma {
+
+namespace {
+
+// Entries looked up by BM_LocalOutputCacheLookup for each output size.
+constexpr int kNumEntries = 256;
+// Keys saved by each thread of BM_LocalOutputCacheSaveOutput.
+constexpr int kNumSaveKeysPerThread = 64;
+constexpr int kMaxThreads = 16;
+
+constexpr int kOutputSizes[] = {64 << 10, 1 << 20};
+
+// A LocalOutputCache in a directory on tmpfs (/dev/shm) if available, so
+// that numbers are not dominated by the disk, with kNumEntries entries for
+// each of kOutputSizes.
+class LocalOutputCacheEnv {
+ public:
+  static const LocalOutputCacheEnv& Get() {
+    static const LocalOutputCacheEnv env;
+    return env;
+  }
+
+  const std::string& key(int output_size, int i) const {
+    return keys_.at(output_size)[i];
+  }
+  const ExecReq& req(int output_size) const { return reqs_.at(output_size); }
+  const ExecResp& resp(int output_size) const {
+    return resps_.at(output_size);
+  }
+
+ private:
+  LocalOutputCacheEnv() {
+    struct stat st;
+    std::string tmpl = absl::StrCat(
+        stat("/dev/shm", &st) == 0 && S_ISDIR(st.st_mode) ? "/dev/shm"
+                                                           : "/tmp",
+        "/local_output_cache_benchmark_XXXXXX");
+    PCHECK(mkdtemp(&tmpl[0]) != nullptr) << tmpl;
+    dir_ = tmpl;
+    const std::string build_dir = file::JoinPath(dir_, "build");
+    PCHECK(mkdir(build_dir.c_str(), 0755) == 0) << build_dir;
+
+    LocalOutputCache::Init(file::JoinPath(dir_, "cache"), nullptr, 1 << 20,
+                           1 << 20, 1 << 20, 1 << 20);
+    CHECK(LocalOutputCache::IsEnabled());
+
+    const int num_keys = kNumEntries + kNumSaveKeysPerThread * kMaxThreads;
+    for (int output_size : kOutputSizes) {
+      const std::string output = absl::StrCat("out", output_size, ".o");
+      CHECK(WriteStringToFile(std::string(output_size, 'o'),
+                              file::JoinPath(build_dir, output)));
+
+      ExecReq& req = reqs_[output_size];
+      req.mutable_command_spec()->set_name("clang");
+      req.mutable_command_spec()->set_version("4.2.1");
+      req.mutable_command_spec()->set_target("x86_64-unknown-linux-gnu");
+      for (const char* arg : {"clang", "-c", "src.cc", "-o"}) {
+        req.add_arg(arg);
+      }
+      req.add_arg(output);
+      req.set_cwd(build_dir);
+      ExecResp& resp = resps_[output_size];
+      resp.mutable_result()->set_exit_status(0);
+      resp.mutable_result()->set_stderr_buffer("warning: benchmark\n");
+      resp.mutable_result()->add_output()->set_filename(output);
+
+      std::vector<std::string>& keys = keys_[output_size];
+      for (int i = 0; i < num_keys; ++i) {
+        ExecReq key_req = req;
+        key_req.add_arg(absl::StrCat("-DBENCHMARK_KEY=", i));
+        keys.push_back(LocalOutputCache::MakeCacheKey(key_req));
+      }
+      for (int i = 0; i < kNumEntries; ++i) {
+        CHECK(LocalOutputCache::instance()->SaveOutput(keys[i], &req, &resp,
+                                                       "benchmark"));
+      }
+    }
+  }
+
+  ~LocalOutputCacheEnv() {
+    LocalOutputCache::Quit();
+    (void)file::RecursivelyDelete(dir_, file::Defaults());
+  }
+
+  std::string dir_;
+  std::map<int, ExecReq> reqs_;
+  std::map<int, ExecResp> resps_;
+  std::map<int, std::vector<std::string>> keys_;
+};
+
+}  // namespace
+
+// Looks up random entries whose output is Arg bytes.
+void BM_LocalOutputCacheLookup(benchmark::State& state) {
+  const LocalOutputCacheEnv& env = LocalOutputCacheEnv::Get();
+  const int output_size = state.range(0);
+  std::mt19937 rng(state.thread_index());
+  std::uniform_int_distribution<int> dist(0, kNumEntries - 1);
+  for (auto _ : state) {
+    (void)_;
+    ExecResp resp;
+    if (!LocalOutputCache::instance()->Lookup(env.key(output_size, dist(rng)),
+                                              &resp, "benchmark")) {
+      state.SkipWithError("lookup failed");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * output_size);
+}
+BENCHMARK(BM_LocalOutputCacheLookup)
+    ->Arg(kOutputSizes[0])
+    ->Arg(kOutputSizes[1])
+    ->ThreadRange(1, kMaxThreads);
+
+// Saves an output of Arg bytes. Each thread overwrites its own keys, since
+// saving the same key concurrently is not expected.
+void BM_LocalOutputCacheSaveOutput(benchmark::State& state) {
+  const LocalOutputCacheEnv& env = LocalOutputCacheEnv::Get();
+  const int output_size = state.range(0);
+  const ExecReq& req = env.req(output_size);
+  const ExecResp& resp = env.resp(output_size);
+  const int first_key =
+      kNumEntries + state.thread_index() * kNumSaveKeysPerThread;
+  int i = 0;
+  for (auto _ : state) {
+    (void)_;
+    const std::string& key = env.key(output_size, first_key + i);
+    if (++i == kNumSaveKeysPerThread) {
+      i = 0;
+    }
+    if (!LocalOutputCache::instance()->SaveOutput(key, &req, &resp,
+                                                  "benchmark")) {
+      state.SkipWithError("save failed");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * output_size);
+}
+BENCHMARK(BM_LocalOutputCacheSaveOutput)
+    ->Arg(kOutputSizes[0])
+    ->Arg(kOutputSizes[1])
+    ->ThreadRange(1, kMaxThreads);
+
+}  // namespace devtools_goma
+
+BENCHMARK_MAIN();
@@ -0,0 +1,145 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "autolock_timer.h"
+#include "benchmark/benchmark.h"
+#include "value_id_table.h"
+
+namespace devtools_goma {
+
+namespace {
+
+constexpr int kNumValues = 10000;
+
+// RwLockedValueIDTable is the ReadWriteLock based table that ValueIDTable
+// replaced. Kept here as the baseline for contention.
+class RwLockedValueIDTable {
+ public:
+  using Id = int;
+
+  Id GetId(const std::string& value) {
+    {
+      AUTO_SHARED_LOCK(lock, &mu_);
+      auto v = map_to_id_.find(value);
+      if (v != map_to_id_.end()) {
+        return v->second;
+      }
+    }
+
+    AUTO_EXCLUSIVE_LOCK(lock, &mu_);
+    auto v = map_to_id_.try_emplace(value, values_.size());
+    if (v.second) {
+      values_.push_back(value);
+    }
+    return v.first->second;
+  }
+
+  std::string GetValue(Id id) const {
+    AUTO_SHARED_LOCK(lock, &mu_);
+    return values_[id];
+  }
+
+ private:
+  mutable ReadWriteLock mu_;
+  std::vector<std::string> values_ ABSL_GUARDED_BY(mu_);
+  absl::flat_hash_map<std::string, Id> map_to_id_ ABSL_GUARDED_BY(mu_);
+};
+
+const std::vector<std::string>& Values() {
+  static const std::vector<std::string>* values = [] {
+    auto* values = new std::vector<std::string>;
+    for (int i = 0; i < kNumValues; ++i) {
+      values->push_back(absl::StrCat("/usr/include/c++/v1/header", i, ".h"));
+    }
+    return values;
+  }();
+  return *values;
+}
+
+template <class Table>
+Table* PopulatedTable() {
+  static Table* table = [] {
+    auto* table = new Table;
+    for (const auto& value : Values()) {
+      table->GetId(value);
+    }
+    return table;
+  }();
+  return table;
+}
+
+}  // namespace
+
+// Looks up IDs for existing values from multiple threads.
+template <class Table>
+void BM_GetIdHit(benchmark::State& state) {
+  Table* table = PopulatedTable<Table>();
+  const auto& values = Values();
+  size_t i = state.thread_index();
+  for (auto _ : state) {
+    (void)_;
+    benchmark::DoNotOptimize(table->GetId(values[i % values.size()]));
+    i += 7;
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_GetIdHit, RwLockedValueIDTable)->ThreadRange(1, 32);
+BENCHMARK_TEMPLATE(BM_GetIdHit, ValueIDTable<std::string>)->ThreadRange(1, 32);
+
+// Converts IDs to values from multiple threads.
+template <class Table>
+void BM_GetValue(benchmark::State& state) {
+  Table* table = PopulatedTable<Table>();
+  int id = state.thread_index();
+  for (auto _ : state) {
+    (void)_;
+    benchmark::DoNotOptimize(table->GetValue(id % kNumValues));
+    id += 7;
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_GetValue, RwLockedValueIDTable)->ThreadRange(1, 32);
+BENCHMARK_TEMPLATE(BM_GetValue, ValueIDTable<std::string>)->ThreadRange(1, 32);
+
+// Inserts new values while other threads look up existing ones.
+template <class Table>
+void BM_GetIdMixed(benchmark::State& state) {
+  const auto& values = Values();
+  static Table* table = nullptr;
+  if (state.thread_index() == 0) {
+    table = new Table;
+    for (size_t i = 0; i < values.size() / 2; ++i) {
+      table->GetId(values[i]);
+    }
+  }
+  size_t i = state.thread_index();
+  for (auto _ : state) {
+    (void)_;
+    benchmark::DoNotOptimize(table->GetId(values[i % values.size()]));
+    i += 7;
+  }
+  if (state.thread_index() == 0) {
+    delete table;
+    table = nullptr;
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_GetIdMixed, RwLockedValueIDTable)->ThreadRange(1, 32);
+BENCHMARK_TEMPLATE(BM_GetIdMixed, ValueIDTable<std::string>)
+    ->ThreadRange(1, 32);
+
+}  // namespace devtools_goma
+
+BENCHMARK_MAIN();
@@ -8,9 +8,30 @@
 #include <algorithm>
 #include <iomanip>
 
+#include "absl/time/clock.h"
+
 namespace devtools_goma {
 
 AutoLockStats* g_auto_lock_stats;
+LockWaitGraph* g_lock_wait_graph;
+
+namespace {
+
+const char* const kWaitBucketNames[LockWaitGraph::kNumWaitBuckets] = {
+    "<10us", "<100us", "<1ms", "<10ms", "<100ms", "<1s", ">=1s",
+};
+
+size_t WaitBucket(absl::Duration wait_time) {
+  size_t bucket = 0;
+  for (absl::Duration bound = absl::Microseconds(10);
+       bucket < LockWaitGraph::kNumWaitBuckets - 1 && wait_time >= bound;
+       bound *= 10) {
+    ++bucket;
+  }
+  return bucket;
+}
+
+}  // namespace
 
 AutoLockStat* AutoLockStats::NewStat(const char* name) {
   AutoLock lock(&mu_);
@@ -144,4 +165,109 @@ void AutoLockStats::Report(std::ostringstream* ss,
         << "</table></body></html>";
 }
 
+LockWaitGraph::LockWaitGraph(int sample_rate)
+    : sample_rate_(std::max(sample_rate, 1)) {}
+
+bool LockWaitGraph::ShouldSample() const {
+  if (sample_rate_ == 1) {
+    return true;
+  }
+  // xorshift64*, seeded per thread. A counter would alias with periodic
+  // lock patterns, e.g. always sample the same call site in a loop.
+  static thread_local uint64_t state = 0;
+  if (state == 0) {
+    state = (reinterpret_cast<uintptr_t>(&state) ^
+             static_cast<uint64_t>(absl::GetCurrentTimeNanos())) |
+            1;
+  }
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  const uint64_t random = (state * 0x2545f4914f6cdd1dULL) >> 32;
+  return random % static_cast<uint64_t>(sample_rate_) == 0;
+}
+
+LockWaitGraph::HolderSlot* LockWaitGraph::GetSlot(const void* lock) const {
+  // Locks are at least pointer aligned.
+  const uintptr_t key = reinterpret_cast<uintptr_t>(lock) / sizeof(void*);
+  return &holders_[key % kNumHolderSlots];
+}
+
+const AutoLockStat* LockWaitGraph::GetHolder(const void* lock) const {
+  const HolderSlot* slot = GetSlot(lock);
+  const AutoLockStat* holder = slot->holder.load(std::memory_order_relaxed);
+  if (slot->lock.load(std::memory_order_relaxed) != lock) {
+    return nullptr;
+  }
+  return holder;
+}
+
+void LockWaitGraph::SetHolder(const void* lock, const AutoLockStat* holder) {
+  HolderSlot* slot = GetSlot(lock);
+  slot->lock.store(lock, std::memory_order_relaxed);
+  slot->holder.store(holder, std::memory_order_relaxed);
+}
+
+void LockWaitGraph::ClearHolder(const void* lock, const AutoLockStat* holder) {
+  HolderSlot* slot = GetSlot(lock);
+  if (slot->lock.load(std::memory_order_relaxed) != lock) {
+    return;
+  }
+  slot->holder.compare_exchange_strong(holder, nullptr,
+                                       std::memory_order_relaxed);
+}
+
+void LockWaitGraph::AddWait(const AutoLockStat* waiter,
+                            const AutoLockStat* holder,
+                            absl::Duration wait_time) {
+  AutoLock lock(&mu_);
+  WaitStat& stat = wait_stats_[Edge(waiter, holder)];
+  ++stat.count;
+  stat.total_wait_time += wait_time;
+  stat.max_wait_time = std::max(stat.max_wait_time, wait_time);
+  ++stat.buckets[WaitBucket(wait_time)];
+}
+
+std::vector<std::pair<LockWaitGraph::Edge, LockWaitGraph::WaitStat>>
+LockWaitGraph::GetWaitStats() const {
+  std::vector<std::pair<Edge, WaitStat>> stats;
+  {
+    AutoLock lock(&mu_);
+    stats.assign(wait_stats_.begin(), wait_stats_.end());
+  }
+  std::sort(stats.begin(), stats.end(),
+            [](const std::pair<Edge, WaitStat>& l,
+               const std::pair<Edge, WaitStat>& r) {
+              return l.second.total_wait_time > r.second.total_wait_time;
+            });
+  return stats;
+}
+
+void LockWaitGraph::TextReport(std::ostringstream* ss) const {
+  (*ss) << "sampled 1 in " << sample_rate_ << " lock acquisitions\n";
+  for (const auto& it : GetWaitStats()) {
+    const WaitStat& s = it.second;
+    (*ss) << it.first.first->name << " <- " << it.first.second->name
+          << " count: " << s.count
+          << " total-wait: " << s.total_wait_time
+          << " max-wait: " << s.max_wait_time
+          << " ave-wait: " << s.total_wait_time / std::max<int64_t>(s.count, 1);
+    for (size_t i = 0; i < kNumWaitBuckets; ++i) {
+      (*ss) << " " << kWaitBucketNames[i] << ": " << s.buckets[i];
+    }
+    (*ss) << "\n";
+  }
+}
+
+void LockWaitGraph::DotReport(std::ostringstream* ss) const {
+  (*ss) << "digraph lockwait {\n";
+  for (const auto& it : GetWaitStats()) {
+    const WaitStat& s = it.second;
+    (*ss) << "  \"" << it.first.first->name << "\" -> \""
+          << it.first.second->name << "\" [label=\"" << s.count << " / "
+          << s.total_wait_time << "\"];\n";
+  }
+  (*ss) << "}\n";
+}
+
 }  // namespace devtools_goma
@@ -6,12 +6,19 @@
 #ifndef DEVTOOLS_GOMA_CLIENT_AUTOLOCK_TIMER_H_
 #define DEVTOOLS_GOMA_CLIENT_AUTOLOCK_TIMER_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
@@ -90,6 +97,76 @@ class AutoLockStats {
 
 extern AutoLockStats* g_auto_lock_stats;
 
+// LockWaitGraph records which call sites wait for which call sites holding
+// the same lock, and the wait time distribution per the pair.
+// Every acquisition registers itself as the holder while it holds the lock,
+// which is a few relaxed atomic operations. For 1 in |sample_rate| randomly
+// chosen acquisitions, AutoLockTimerBase looks up the holder before
+// acquiring the lock, and records the wait, so waits are sampled at
+// 1 in |sample_rate|.
+// Holders are kept in a fixed size table indexed by lock address, so a
+// holder may be missed or misattributed on collision.
+// A lock has only one holder slot, so when a lock is held shared by several
+// call sites, the last one that acquired it is taken as the holder.
+class LockWaitGraph {
+ public:
+  // Wait time buckets are <10us, <100us, <1ms, <10ms, <100ms, <1s and >=1s.
+  static const size_t kNumWaitBuckets = 7;
+
+  explicit LockWaitGraph(int sample_rate);
+
+  // Returns true if the current acquisition should look up the holder and
+  // record its wait. Returns true randomly with probability 1/sample_rate.
+  bool ShouldSample() const;
+
+  const AutoLockStat* GetHolder(const void* lock) const;
+  void SetHolder(const void* lock, const AutoLockStat* holder);
+  // Clears the holder of |lock| if it is still |holder|.
+  void ClearHolder(const void* lock, const AutoLockStat* holder);
+
+  // Records that |waiter| waited |wait_time| for |lock| held by |holder|.
+  void AddWait(const AutoLockStat* waiter,
+               const AutoLockStat* holder,
+               absl::Duration wait_time);
+
+  // Reports waiter and holder pairs, sorted by total wait time.
+  void TextReport(std::ostringstream* ss) const;
+  // Reports waiter and holder pairs as a graphviz digraph, whose edges are
+  // from waiters to holders.
+  void DotReport(std::ostringstream* ss) const;
+
+ private:
+  struct HolderSlot {
+    std::atomic<const void*> lock{nullptr};
+    std::atomic<const AutoLockStat*> holder{nullptr};
+  };
+
+  struct WaitStat {
+    int64_t count = 0;
+    absl::Duration total_wait_time;
+    absl::Duration max_wait_time;
+    std::array<int64_t, kNumWaitBuckets> buckets{};
+  };
+
+  using Edge = std::pair<const AutoLockStat*, const AutoLockStat*>;
+
+  static const size_t kNumHolderSlots = 4096;
+
+  HolderSlot* GetSlot(const void* lock) const;
+  std::vector<std::pair<Edge, WaitStat>> GetWaitStats() const;
+
+  const int sample_rate_;
+  mutable std::array<HolderSlot, kNumHolderSlots> holders_;
+
+  mutable Lock mu_;
+  absl::flat_hash_map<Edge, WaitStat> wait_stats_ ABSL_GUARDED_BY(mu_);
+
+  DISALLOW_COPY_AND_ASSIGN(LockWaitGraph);
+};
+
+// nullptr unless lock wait graph is enabled. Used only with AutoLockStat.
+extern LockWaitGraph* g_lock_wait_graph;
+
 class MutexAcquireStrategy {
  public:
   static void Acquire(Lock* lock) ABSL_EXCLUSIVE_LOCK_FUNCTION(lock) {
@@ -173,15 +250,33 @@ class AutoLockTimerBase {
   // |name| must be string literal. It must not be deleted.
   // If |statp| is NULL, it doesn't collect stats (i.e. it works as
   // almost same as AutoLock).
-  // If |statp| is not NULL, it holds stats for lock wait/hold time.
+  // If |statp| is not NULL, it holds stats for lock wait/hold time, and
+  // lock wait graph if g_lock_wait_graph is set. The wait is recorded in
+  // lock wait graph only if this acquisition is sampled.
   AutoLockTimerBase(LockType* lock, AutoLockStat* statp)
-      : lock_(lock), stat_(nullptr), timer_(SimpleTimer::NO_START) {
-    if (statp)
+      : lock_(lock),
+        stat_(nullptr),
+        lock_wait_graph_(nullptr),
+        timer_(SimpleTimer::NO_START) {
+    const AutoLockStat* holder = nullptr;
+    if (statp) {
       timer_.Start();
+      lock_wait_graph_ = g_lock_wait_graph;
+      if (lock_wait_graph_ && lock_wait_graph_->ShouldSample()) {
+        holder = lock_wait_graph_->GetHolder(lock_);
+      }
+    }
     LockAcquireStrategy::Acquire(lock_);
     if (statp) {
       stat_ = statp;
-      stat_->UpdateWaitTime(timer_.GetDuration());
+      const absl::Duration wait_time = timer_.GetDuration();
+      stat_->UpdateWaitTime(wait_time);
+      if (lock_wait_graph_) {
+        if (holder) {
+          lock_wait_graph_->AddWait(stat_, holder, wait_time);
+        }
+        lock_wait_graph_->SetHolder(lock_, stat_);
+      }
       timer_.Start();
     }
   }
@@ -190,12 +285,16 @@ class AutoLockTimerBase {
     if (stat_) {
       stat_->UpdateHoldTime(timer_.GetDuration());
     }
+    if (lock_wait_graph_) {
+      lock_wait_graph_->ClearHolder(lock_, stat_);
+    }
     LockAcquireStrategy::Release(lock_);
   }
 
  private:
   LockType* lock_;
   AutoLockStat* stat_;
+  LockWaitGraph* lock_wait_graph_;
   SimpleTimer timer_;
   DISALLOW_COPY_AND_ASSIGN(AutoLockTimerBase);
 };
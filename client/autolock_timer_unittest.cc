@@ -0,0 +1,124 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "autolock_timer.h"
+
+#include <sstream>
+#include <string>
+
+#include "absl/strings/match.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+
+namespace devtools_goma {
+
+TEST(LockWaitGraphTest, Holder) {
+  LockWaitGraph graph(1);
+  AutoLockStat holder("holder");
+  AutoLockStat other("other");
+  Lock mu;
+
+  EXPECT_EQ(nullptr, graph.GetHolder(&mu));
+  graph.SetHolder(&mu, &holder);
+  EXPECT_EQ(&holder, graph.GetHolder(&mu));
+  // Not cleared by another holder.
+  graph.ClearHolder(&mu, &other);
+  EXPECT_EQ(&holder, graph.GetHolder(&mu));
+  graph.ClearHolder(&mu, &holder);
+  EXPECT_EQ(nullptr, graph.GetHolder(&mu));
+}
+
+TEST(LockWaitGraphTest, ShouldSample) {
+  LockWaitGraph graph(4);
+  int num_sampled = 0;
+  for (int i = 0; i < 10000; ++i) {
+    if (graph.ShouldSample()) {
+      ++num_sampled;
+    }
+  }
+  // Random, but not far from 1 in 4.
+  EXPECT_GT(num_sampled, 2000);
+  EXPECT_LT(num_sampled, 3000);
+}
+
+TEST(LockWaitGraphTest, ShouldSampleNotPeriodic) {
+  // A counter based sampler would sample every 4th acquisition only.
+  LockWaitGraph graph(4);
+  int num_sampled[4] = {};
+  for (int i = 0; i < 10000; ++i) {
+    if (graph.ShouldSample()) {
+      ++num_sampled[i % 4];
+    }
+  }
+  for (int n : num_sampled) {
+    EXPECT_GT(n, 300);
+  }
+}
+
+TEST(LockWaitGraphTest, Report) {
+  LockWaitGraph graph(1);
+  AutoLockStat waiter("waiter");
+  AutoLockStat holder("holder");
+  graph.AddWait(&waiter, &holder, absl::Microseconds(5));
+  graph.AddWait(&waiter, &holder, absl::Milliseconds(2));
+  graph.AddWait(&holder, &waiter, absl::Seconds(3));
+
+  std::ostringstream text;
+  graph.TextReport(&text);
+  // Sorted by total wait time.
+  EXPECT_TRUE(absl::StartsWith(text.str(),
+                               "sampled 1 in 1 lock acquisitions\n"
+                               "holder <- waiter count: 1"))
+      << text.str();
+  EXPECT_TRUE(absl::StrContains(
+      text.str(), "waiter <- holder count: 2 total-wait: 2.005ms"))
+      << text.str();
+  EXPECT_TRUE(absl::StrContains(text.str(),
+                                "<10us: 1 <100us: 0 <1ms: 0 <10ms: 1 "
+                                "<100ms: 0 <1s: 0 >=1s: 0\n"))
+      << text.str();
+  EXPECT_TRUE(absl::StrContains(text.str(), ">=1s: 1\n")) << text.str();
+
+  std::ostringstream dot;
+  graph.DotReport(&dot);
+  EXPECT_TRUE(absl::StrContains(dot.str(),
+                                "\"waiter\" -> \"holder\" [label=\"2 / "
+                                "2.005ms\"];\n"))
+      << dot.str();
+}
+
+TEST(LockWaitGraphTest, AutoLock) {
+  LockWaitGraph graph(1);
+  AutoLockStat stat("stat");
+  Lock mu;
+
+  LockWaitGraph* saved_graph = g_lock_wait_graph;
+  g_lock_wait_graph = &graph;
+  {
+    AUTOLOCK_WITH_STAT(lock, &mu, &stat);
+    EXPECT_EQ(&stat, graph.GetHolder(&mu));
+  }
+  EXPECT_EQ(nullptr, graph.GetHolder(&mu));
+  g_lock_wait_graph = saved_graph;
+}
+
+TEST(LockWaitGraphTest, AutoLockNotSampled) {
+  // Few enough acquisitions in this test to be never sampled.
+  LockWaitGraph graph(1 << 30);
+  AutoLockStat stat("stat");
+  Lock mu;
+
+  LockWaitGraph* saved_graph = g_lock_wait_graph;
+  g_lock_wait_graph = &graph;
+  {
+    // Holder is registered even if not sampled, so that a sampled waiter
+    // can find it.
+    AUTOLOCK_WITH_STAT(lock, &mu, &stat);
+    EXPECT_EQ(&stat, graph.GetHolder(&mu));
+  }
+  EXPECT_EQ(nullptr, graph.GetHolder(&mu));
+  g_lock_wait_graph = saved_graph;
+}
+
+}  // namespace devtools_goma
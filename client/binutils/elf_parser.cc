@@ -26,6 +26,41 @@
 
 namespace devtools_goma {
 
+namespace {
+
+// Finds NT_GNU_BUILD_ID in |notes|, which is the content of PT_NOTE segment
+// or SHT_NOTE section. Each note is aligned to |align|.
+// Elf32_Nhdr and Elf64_Nhdr have the same layout.
+bool FindGnuBuildId(const std::string& notes,
+                    size_t align,
+                    std::string* build_id) {
+  static constexpr char kGnu[] = ELF_NOTE_GNU;  // "GNU"
+  auto aligned = [align](size_t n) { return (n + align - 1) & ~(align - 1); };
+  size_t pos = 0;
+  while (pos + sizeof(Elf32_Nhdr) <= notes.size()) {
+    Elf32_Nhdr nhdr;
+    memcpy(&nhdr, notes.data() + pos, sizeof(nhdr));
+    const size_t name_pos = pos + sizeof(nhdr);
+    const size_t desc_pos = name_pos + aligned(nhdr.n_namesz);
+    const size_t next_pos = desc_pos + aligned(nhdr.n_descsz);
+    if (desc_pos > notes.size() || desc_pos + nhdr.n_descsz > notes.size()) {
+      LOG(WARNING) << "broken note: pos=" << pos
+                   << " namesz=" << nhdr.n_namesz
+                   << " descsz=" << nhdr.n_descsz;
+      return false;
+    }
+    if (nhdr.n_type == NT_GNU_BUILD_ID && nhdr.n_namesz == sizeof(kGnu) &&
+        memcmp(notes.data() + name_pos, kGnu, sizeof(kGnu)) == 0) {
+      build_id->assign(notes.data() + desc_pos, nhdr.n_descsz);
+      return true;
+    }
+    pos = next_pos;
+  }
+  return false;
+}
+
+}  // namespace
+
 template <typename Ehdr, typename Phdr, typename Shdr, typename Dyn>
 class ElfParserImpl : public ElfParser {
  public:
@@ -125,11 +160,62 @@ class ElfParserImpl : public ElfParser {
 
   bool HasDynamic() const override { return !no_dynamic_; }
 
+  bool ReadBuildId(std::string* build_id) override {
+    VLOG(1) << "ReadBuildId:" << filename_;
+    if (!valid_) {
+      LOG(ERROR) << "not valid:" << filename_;
+      return false;
+    }
+    if (!ReadEhdr()) {
+      return false;
+    }
+    std::string notes;
+    if (use_program_header_) {
+      if (!ReadPhdrs()) {
+        return false;
+      }
+      for (const auto& phdr : phdrs_) {
+        if (phdr->p_type != PT_NOTE) {
+          continue;
+        }
+        if (!ReadSegmentData(*phdr, &notes)) {
+          return false;
+        }
+        if (FindGnuBuildId(notes, phdr->p_align == 8 ? 8 : 4, build_id)) {
+          return true;
+        }
+      }
+      return false;
+    }
+    if (!ReadShdrs()) {
+      return false;
+    }
+    for (const auto& shdr : shdrs_) {
+      if (shdr->sh_type != SHT_NOTE) {
+        continue;
+      }
+      if (!ReadSectionData(*shdr, &notes)) {
+        return false;
+      }
+      if (FindGnuBuildId(notes, shdr->sh_addralign == 8 ? 8 : 4, build_id)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
  private:
   void CheckIdent();
   bool ReadEhdr() {
     if (!valid_)
       return false;
+    if (ehdr_read_)
+      return true;
+    if (lseek(fd_.fd(), EI_NIDENT, SEEK_SET) == static_cast<off_t>(-1)) {
+      PLOG(ERROR) << "seek ehdr:" << filename_;
+      valid_ = false;
+      return false;
+    }
     if (read(fd_.fd(), reinterpret_cast<char*>(&ehdr_) + EI_NIDENT,
              sizeof(Ehdr) - EI_NIDENT) != (sizeof(Ehdr) - EI_NIDENT)) {
       PLOG(ERROR) << "read ehdr:" << filename_;
@@ -137,11 +223,14 @@ class ElfParserImpl : public ElfParser {
       return false;
     }
     VLOG(1) << DumpEhdr(ehdr_);
+    ehdr_read_ = true;
     return true;
   }
   bool ReadPhdrs() {
     if (!valid_)
       return false;
+    if (!phdrs_.empty())
+      return true;
     if (lseek(fd_.fd(), ehdr_.e_phoff, SEEK_SET) == static_cast<off_t>(-1)) {
       PLOG(ERROR) << "seek phoff:" << ehdr_.e_phoff << " " << filename_;
       valid_ = false;
@@ -187,6 +276,8 @@ class ElfParserImpl : public ElfParser {
   bool ReadShdrs() {
     if (!valid_)
       return false;
+    if (!shdrs_.empty())
+      return true;
     if (lseek(fd_.fd(), ehdr_.e_shoff, SEEK_SET) == static_cast<off_t>(-1)) {
       PLOG(ERROR) << "seek shoff:" << ehdr_.e_shoff << " " << filename_;
       valid_ = false;
@@ -380,6 +471,7 @@ class ElfParserImpl : public ElfParser {
   bool valid_;
   bool use_program_header_;
   bool no_dynamic_ = false;
+  bool ehdr_read_ = false;
   Ehdr ehdr_;
   std::vector<std::unique_ptr<Phdr>> phdrs_;
   Phdr* dynamic_phdr_;
@@ -27,6 +27,10 @@ class ElfParser {
   // check if the elf has dynamic after ReadDynamicNeeded.
   virtual bool HasDynamic() const = 0;
 
+  // Reads the descriptor of NT_GNU_BUILD_ID note (raw bytes, not hex).
+  // Returns false if the elf doesn't have a build-id note.
+  virtual bool ReadBuildId(std::string* build_id) = 0;
+
   static bool IsElf(const std::string& filename);
 
  protected:
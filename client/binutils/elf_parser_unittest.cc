@@ -15,6 +15,7 @@
 #include <glog/stl_logging.h>
 #include <gtest/gtest.h>
 
+#include "absl/strings/escaping.h"
 #include "elf_parser.h"
 #include "file_dir.h"
 #include "mypath.h"
@@ -89,6 +90,25 @@ TEST_F(ElfParserTest, IsElf) {
   EXPECT_FALSE(ElfParser::IsElf(file::JoinPath(data_dir_, "libc.so")));
 }
 
+TEST_F(ElfParserTest, ReadBuildId) {
+  for (bool use_program_header : {true, false}) {
+    std::unique_ptr<ElfParser> parser(
+        ElfParser::NewElfParser(file::JoinPath(data_dir_, "libdl.so")));
+    ASSERT_TRUE(parser != nullptr);
+    parser->UseProgramHeader(use_program_header);
+    std::string build_id;
+    EXPECT_TRUE(parser->ReadBuildId(&build_id)) << use_program_header;
+    EXPECT_EQ("89905a355a901ba71187630c6c317009c0a0455a",
+              absl::BytesToHexString(build_id))
+        << use_program_header;
+
+    // ReadDynamicNeeded still works after ReadBuildId.
+    std::vector<std::string> needed;
+    EXPECT_TRUE(parser->ReadDynamicNeeded(&needed)) << use_program_header;
+    EXPECT_EQ(2U, needed.size()) << use_program_header;
+  }
+}
+
 TEST_F(ElfParserTest, UsrLib) {
   std::vector<DirEntry> entries;
   ASSERT_TRUE(ListDirectory("/usr/lib", &entries));
@@ -0,0 +1,237 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cgroup.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+#include <utility>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+#include "glog/logging.h"
+#include "path.h"
+#include "scoped_fd.h"
+
+namespace devtools_goma {
+
+namespace {
+
+// Number of rmdir attempts of a task cgroup before giving up. A cgroup
+// stays busy while e.g. a daemonized descendant is alive in it.
+constexpr int kMaxRmdirAttempts = 16;
+
+// Reads a cgroup interface file. Unlike ReadFileToString, this doesn't
+// rely on the file size, since cgroup files report size 0.
+bool ReadCgroupFile(const std::string& filename, std::string* content) {
+  content->clear();
+  ScopedFd fd(ScopedFd::OpenForRead(filename));
+  if (!fd.valid()) {
+    return false;
+  }
+  char buf[4096];
+  for (;;) {
+    ssize_t r = fd.Read(buf, sizeof(buf));
+    if (r < 0) {
+      PLOG(WARNING) << "read " << filename;
+      return false;
+    }
+    if (r == 0) {
+      return true;
+    }
+    content->append(buf, r);
+  }
+}
+
+bool WriteCgroupFile(const std::string& filename, absl::string_view data) {
+  ScopedFd fd(ScopedFd::Create(filename, 0644));
+  if (!fd.valid()) {
+    PLOG(WARNING) << "open " << filename;
+    return false;
+  }
+  if (fd.Write(data.data(), data.size()) !=
+      static_cast<ssize_t>(data.size())) {
+    PLOG(WARNING) << "write " << filename << " data=" << data;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+std::string CgroupLimits::DebugString() const {
+  std::ostringstream ss;
+  ss << "memory_high=" << memory_high << " cpu_weight=" << cpu_weight
+     << " io_weight=" << io_weight;
+  return ss.str();
+}
+
+std::string CgroupTree::Options::DebugString() const {
+  std::ostringstream ss;
+  ss << "root=" << root;
+  for (int i = 0; i < kNumClasses; ++i) {
+    ss << " " << ClassName(static_cast<Class>(i)) << "={"
+       << limits[i].DebugString() << "}";
+  }
+  return ss.str();
+}
+
+CgroupTree::CgroupTree(std::string root) : root_(std::move(root)) {}
+
+/* static */
+std::unique_ptr<CgroupTree> CgroupTree::Create(const Options& options) {
+  if (options.root.empty()) {
+    return nullptr;
+  }
+  if (!file::IsAbsolutePath(options.root)) {
+    LOG(WARNING) << "cgroup root must be an absolute path: " << options.root;
+    return nullptr;
+  }
+  const std::string controllers =
+      file::JoinPath(options.root, "cgroup.controllers");
+  if (access(controllers.c_str(), R_OK) != 0) {
+    PLOG(WARNING) << "not a cgroup v2 directory: " << options.root;
+    return nullptr;
+  }
+
+  // Enable controllers one by one. A write to cgroup.subtree_control fails
+  // as a whole if any of its controllers is not available.
+  const std::string root_subtree_control =
+      file::JoinPath(options.root, "cgroup.subtree_control");
+  for (const char* controller : {"+memory", "+cpu", "+io"}) {
+    if (!WriteCgroupFile(root_subtree_control, controller)) {
+      LOG(WARNING) << "failed to enable " << controller << " in "
+                   << options.root
+                   << ". The directory must not have processes.";
+    }
+  }
+
+  for (int i = 0; i < kNumClasses; ++i) {
+    const std::string dir =
+        file::JoinPath(options.root, ClassName(static_cast<Class>(i)));
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+      PLOG(WARNING) << "mkdir " << dir;
+      return nullptr;
+    }
+    const CgroupLimits& limits = options.limits[i];
+    WriteCgroupFile(file::JoinPath(dir, "memory.high"),
+                    limits.memory_high > 0 ? absl::StrCat(limits.memory_high)
+                                           : "max");
+    if (limits.cpu_weight > 0) {
+      WriteCgroupFile(file::JoinPath(dir, "cpu.weight"),
+                      absl::StrCat(limits.cpu_weight));
+    }
+    if (limits.io_weight > 0) {
+      WriteCgroupFile(file::JoinPath(dir, "io.weight"),
+                      absl::StrCat("default ", limits.io_weight));
+    }
+    // Task cgroups need the memory controller for memory.peak.
+    WriteCgroupFile(file::JoinPath(dir, "cgroup.subtree_control"), "+memory");
+  }
+  LOG(INFO) << "cgroup enabled: " << options.DebugString();
+  return std::unique_ptr<CgroupTree>(new CgroupTree(options.root));
+}
+
+std::string CgroupTree::CreateTaskCgroup(Class cls, int id) {
+  RetryPendingRemovals();
+  const std::string dir = file::JoinPath(root_, ClassName(cls),
+                                         absl::StrCat("task.", id));
+  if (mkdir(dir.c_str(), 0755) == 0) {
+    return dir;
+  }
+  // Left by a previous compiler_proxy. Reuse it after it becomes empty.
+  if (errno == EEXIST && rmdir(dir.c_str()) == 0 &&
+      mkdir(dir.c_str(), 0755) == 0) {
+    return dir;
+  }
+  PLOG(WARNING) << "failed to create cgroup " << dir;
+  return "";
+}
+
+void CgroupTree::RemoveTaskCgroup(const std::string& dir) {
+  RetryPendingRemovals();
+  if (rmdir(dir.c_str()) == 0 || errno == ENOENT) {
+    return;
+  }
+  VLOG(1) << "cgroup " << dir << " is not removable yet: "
+          << strerror(errno);
+  pending_removals_.push_back(PendingRemoval{dir, 1});
+}
+
+void CgroupTree::RetryPendingRemovals() {
+  auto it = std::remove_if(
+      pending_removals_.begin(), pending_removals_.end(),
+      [](PendingRemoval& removal) {
+        if (rmdir(removal.dir.c_str()) == 0 || errno == ENOENT) {
+          return true;
+        }
+        if (++removal.attempts >= kMaxRmdirAttempts) {
+          PLOG(WARNING) << "failed to remove cgroup " << removal.dir;
+          return true;
+        }
+        return false;
+      });
+  pending_removals_.erase(it, pending_removals_.end());
+}
+
+/* static */
+void CgroupTree::ReadStats(const std::string& dir, CgroupStats* stats) {
+  std::string content;
+  int64_t memory_peak = 0;
+  if (ReadCgroupFile(file::JoinPath(dir, "memory.peak"), &content) &&
+      absl::SimpleAtoi(absl::StripAsciiWhitespace(content), &memory_peak)) {
+    stats->memory_peak_kb = memory_peak / 1024;
+  }
+  if (stats->memory_peak_kb >= 0 &&
+      ReadCgroupFile(file::JoinPath(dir, "memory.stat"), &content)) {
+    const int64_t file = ParseStatValue(content, "file");
+    if (file >= 0) {
+      stats->memory_anon_peak_kb =
+          std::max<int64_t>(memory_peak - file, 0) / 1024;
+    }
+  }
+  if (ReadCgroupFile(file::JoinPath(dir, "cpu.stat"), &content)) {
+    stats->cpu_usage_us = ParseStatValue(content, "usage_usec");
+  }
+}
+
+/* static */
+int64_t CgroupTree::ParseStatValue(absl::string_view stat,
+                                   absl::string_view key) {
+  for (absl::string_view line : absl::StrSplit(stat, '\n')) {
+    if (!absl::ConsumePrefix(&line, key) || !absl::ConsumePrefix(&line, " ")) {
+      continue;
+    }
+    int64_t value = 0;
+    if (absl::SimpleAtoi(line, &value)) {
+      return value;
+    }
+  }
+  return -1;
+}
+
+/* static */
+const char* CgroupTree::ClassName(Class cls) {
+  switch (cls) {
+    case kNormal:
+      return "normal";
+    case kLowPriority:
+      return "low_priority";
+    case kVerify:
+      return "verify";
+    case kNumClasses:
+      break;
+  }
+  return "unknown";
+}
+
+}  // namespace devtools_goma
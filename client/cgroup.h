@@ -0,0 +1,121 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DEVTOOLS_GOMA_CLIENT_CGROUP_H_
+#define DEVTOOLS_GOMA_CLIENT_CGROUP_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "basictypes.h"
+
+namespace devtools_goma {
+
+// Resource limits of a cgroup v2 directory.
+struct CgroupLimits {
+  // memory.high in bytes. 0 means no limit ("max").
+  int64_t memory_high = 0;
+  // cpu.weight in [1, 10000]. 0 keeps the kernel default (100).
+  int cpu_weight = 0;
+  // io.weight in [1, 10000]. 0 keeps the kernel default (100).
+  int io_weight = 0;
+
+  std::string DebugString() const;
+};
+
+// Resource usage of a cgroup v2 directory.
+struct CgroupStats {
+  // memory.peak in KiB. It includes page cache charged to the cgroup.
+  // -1 if unavailable (e.g. Linux < 5.19).
+  int64_t memory_peak_kb = -1;
+  // memory.peak minus page cache still charged after processes exited
+  // ("file" of memory.stat) in KiB, i.e. estimated peak of anonymous memory.
+  // "anon" of memory.stat itself is ~0 by then. -1 if unavailable.
+  int64_t memory_anon_peak_kb = -1;
+  // usage_usec of cpu.stat. -1 if unavailable.
+  int64_t cpu_usage_us = -1;
+};
+
+// CgroupTree manages cgroup v2 directories for local subprocesses.
+//
+// Under the delegated |root|, it makes one directory per Class with the
+// Class's limits, and one directory per subprocess in it for accounting:
+//
+//   <root>/normal/task.<id>
+//   <root>/low_priority/task.<id>
+//   <root>/verify/task.<id>
+//
+// |root| must be writable by compiler_proxy, and must not have processes
+// in it (cgroup v2 "no internal process" rule), e.g. a systemd delegated
+// slice that doesn't contain compiler_proxy itself.
+//
+// This class is thread-unsafe. It is used in SubProcessControllerServer.
+class CgroupTree {
+ public:
+  enum Class {
+    kNormal,
+    kLowPriority,
+    kVerify,
+    kNumClasses,
+  };
+
+  struct Options {
+    // Absolute path of delegated cgroup v2 directory. Empty disables cgroup.
+    std::string root;
+    CgroupLimits limits[kNumClasses];
+
+    std::string DebugString() const;
+  };
+
+  // Creates directories for classes under |options.root|, and applies
+  // limits to them.
+  // Returns nullptr if |options.root| is empty or not a cgroup v2 directory.
+  static std::unique_ptr<CgroupTree> Create(const Options& options);
+
+  // Creates a cgroup for subprocess |id| in |cls|.
+  // Returns the cgroup directory, or empty string on error.
+  std::string CreateTaskCgroup(Class cls, int id);
+
+  // Removes the task cgroup |dir| made by CreateTaskCgroup.
+  // It doesn't block. If |dir| can't be removed yet (e.g. the kernel has not
+  // finished removing exited processes from it), it is retried in later
+  // CreateTaskCgroup or RemoveTaskCgroup calls.
+  void RemoveTaskCgroup(const std::string& dir);
+
+  // Reads stats of the task cgroup |dir|.
+  // All processes in |dir| should have exited.
+  static void ReadStats(const std::string& dir, CgroupStats* stats);
+
+  // Returns the value of |key| in flat keyed file |stat| (e.g. cpu.stat,
+  // memory.stat), or -1 if not found.
+  static int64_t ParseStatValue(absl::string_view stat, absl::string_view key);
+
+  static const char* ClassName(Class cls);
+
+  size_t NumPendingRemovalsForTest() const { return pending_removals_.size(); }
+
+ private:
+  struct PendingRemoval {
+    std::string dir;
+    int attempts;
+  };
+
+  explicit CgroupTree(std::string root);
+
+  // Tries to remove task cgroups that could not be removed before.
+  void RetryPendingRemovals();
+
+  const std::string root_;
+  std::vector<PendingRemoval> pending_removals_;
+
+  DISALLOW_COPY_AND_ASSIGN(CgroupTree);
+};
+
+}  // namespace devtools_goma
+
+#endif  // DEVTOOLS_GOMA_CLIENT_CGROUP_H_
@@ -0,0 +1,158 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cgroup.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "file_helper.h"
+#include "gtest/gtest.h"
+#include "path.h"
+#include "scoped_tmp_file.h"
+
+namespace devtools_goma {
+
+namespace {
+
+bool IsDirectory(const std::string& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+std::string ReadFile(const std::string& path) {
+  std::string content;
+  EXPECT_TRUE(ReadFileToString(path, &content)) << path;
+  return content;
+}
+
+}  // namespace
+
+TEST(CgroupTreeTest, ParseStatValue) {
+  EXPECT_EQ(12345, CgroupTree::ParseStatValue("usage_usec 12345\n"
+                                              "user_usec 10000\n"
+                                              "system_usec 2345\n",
+                                              "usage_usec"));
+  EXPECT_EQ(7, CgroupTree::ParseStatValue("nr_periods 0\n"
+                                          "usage_usec 7\n",
+                                          "usage_usec"));
+  EXPECT_EQ(-1, CgroupTree::ParseStatValue("", "usage_usec"));
+  EXPECT_EQ(-1, CgroupTree::ParseStatValue("user_usec 10000\n",
+                                           "usage_usec"));
+  // Only the whole key matches.
+  EXPECT_EQ(4096, CgroupTree::ParseStatValue("file_mapped 8192\n"
+                                             "file 4096\n",
+                                             "file"));
+}
+
+TEST(CgroupTreeTest, CreateNotCgroup) {
+  CgroupTree::Options options;
+  EXPECT_EQ(nullptr, CgroupTree::Create(options));
+
+  ScopedTmpDir root("cgroup_unittest");
+  ASSERT_TRUE(root.valid());
+  options.root = root.dirname();
+  // No cgroup.controllers.
+  EXPECT_EQ(nullptr, CgroupTree::Create(options));
+
+  ASSERT_TRUE(WriteStringToFile(
+      "cpu memory io", file::JoinPath(root.dirname(), "cgroup.controllers")));
+  options.root = "relative/path";
+  EXPECT_EQ(nullptr, CgroupTree::Create(options));
+}
+
+TEST(CgroupTreeTest, Create) {
+  // Emulates cgroupfs with a normal directory.
+  ScopedTmpDir root("cgroup_unittest");
+  ASSERT_TRUE(root.valid());
+  ASSERT_TRUE(WriteStringToFile(
+      "cpu memory io", file::JoinPath(root.dirname(), "cgroup.controllers")));
+
+  CgroupTree::Options options;
+  options.root = root.dirname();
+  options.limits[CgroupTree::kNormal].memory_high = 0;
+  options.limits[CgroupTree::kLowPriority].memory_high = 1024 * 1024 * 1024;
+  options.limits[CgroupTree::kLowPriority].cpu_weight = 20;
+  options.limits[CgroupTree::kLowPriority].io_weight = 30;
+  std::unique_ptr<CgroupTree> tree = CgroupTree::Create(options);
+  ASSERT_NE(nullptr, tree);
+
+  const std::string normal = file::JoinPath(root.dirname(), "normal");
+  const std::string low = file::JoinPath(root.dirname(), "low_priority");
+  const std::string verify = file::JoinPath(root.dirname(), "verify");
+  EXPECT_TRUE(IsDirectory(normal));
+  EXPECT_TRUE(IsDirectory(low));
+  EXPECT_TRUE(IsDirectory(verify));
+
+  EXPECT_EQ("max", ReadFile(file::JoinPath(normal, "memory.high")));
+  EXPECT_NE(0, access(file::JoinPath(normal, "cpu.weight").c_str(), F_OK));
+  EXPECT_EQ("+memory",
+            ReadFile(file::JoinPath(normal, "cgroup.subtree_control")));
+  EXPECT_EQ("1073741824", ReadFile(file::JoinPath(low, "memory.high")));
+  EXPECT_EQ("20", ReadFile(file::JoinPath(low, "cpu.weight")));
+  EXPECT_EQ("default 30", ReadFile(file::JoinPath(low, "io.weight")));
+
+  // Create again with existing directories.
+  EXPECT_NE(nullptr, CgroupTree::Create(options));
+}
+
+TEST(CgroupTreeTest, TaskCgroup) {
+  ScopedTmpDir root("cgroup_unittest");
+  ASSERT_TRUE(root.valid());
+  ASSERT_TRUE(WriteStringToFile(
+      "cpu memory io", file::JoinPath(root.dirname(), "cgroup.controllers")));
+  CgroupTree::Options options;
+  options.root = root.dirname();
+  std::unique_ptr<CgroupTree> tree = CgroupTree::Create(options);
+  ASSERT_NE(nullptr, tree);
+
+  const std::string dir = tree->CreateTaskCgroup(CgroupTree::kVerify, 3);
+  EXPECT_EQ(file::JoinPath(root.dirname(), "verify", "task.3"), dir);
+  EXPECT_TRUE(IsDirectory(dir));
+  // Left by a previous run.
+  EXPECT_EQ(dir, tree->CreateTaskCgroup(CgroupTree::kVerify, 3));
+
+  CgroupStats stats;
+  CgroupTree::ReadStats(dir, &stats);
+  EXPECT_EQ(-1, stats.memory_peak_kb);
+  EXPECT_EQ(-1, stats.memory_anon_peak_kb);
+  EXPECT_EQ(-1, stats.cpu_usage_us);
+  tree->RemoveTaskCgroup(dir);
+  EXPECT_FALSE(IsDirectory(dir));
+  EXPECT_EQ(0U, tree->NumPendingRemovalsForTest());
+
+  const std::string dir2 = tree->CreateTaskCgroup(CgroupTree::kNormal, 4);
+  ASSERT_FALSE(dir2.empty());
+  const std::string memory_peak = file::JoinPath(dir2, "memory.peak");
+  const std::string memory_stat = file::JoinPath(dir2, "memory.stat");
+  const std::string cpu_stat = file::JoinPath(dir2, "cpu.stat");
+  ASSERT_TRUE(WriteStringToFile("2097152\n", memory_peak));
+  ASSERT_TRUE(WriteStringToFile("anon 0\nfile 524288\n", memory_stat));
+  ASSERT_TRUE(WriteStringToFile("usage_usec 1500\nuser_usec 1000\n",
+                                cpu_stat));
+  CgroupTree::ReadStats(dir2, &stats);
+  EXPECT_EQ(2048, stats.memory_peak_kb);
+  EXPECT_EQ(1536, stats.memory_anon_peak_kb);
+  EXPECT_EQ(1500, stats.cpu_usage_us);
+
+  // A normal directory with files can't be removed by rmdir, like a busy
+  // cgroup. It is retried later without blocking.
+  tree->RemoveTaskCgroup(dir2);
+  EXPECT_TRUE(IsDirectory(dir2));
+  EXPECT_EQ(1U, tree->NumPendingRemovalsForTest());
+
+  ASSERT_EQ(0, unlink(memory_peak.c_str()));
+  ASSERT_EQ(0, unlink(memory_stat.c_str()));
+  ASSERT_EQ(0, unlink(cpu_stat.c_str()));
+  const std::string dir3 = tree->CreateTaskCgroup(CgroupTree::kNormal, 5);
+  EXPECT_FALSE(dir3.empty());
+  EXPECT_FALSE(IsDirectory(dir2));
+  EXPECT_EQ(0U, tree->NumPendingRemovalsForTest());
+  tree->RemoveTaskCgroup(dir3);
+  EXPECT_FALSE(IsDirectory(dir3));
+}
+
+}  // namespace devtools_goma
@@ -0,0 +1,164 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "circuit_breaker.h"
+
+#include <algorithm>
+
+#include "autolock_timer.h"
+#include "compiler_specific.h"
+#include "glog/logging.h"
+
+MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
+#include "lib/goma_stats.pb.h"
+MSVC_POP_WARNING()
+
+namespace devtools_goma {
+
+CircuitBreaker::CircuitBreaker(const Options& options)
+    : options_(options), open_duration_(options.open_duration) {}
+
+bool CircuitBreaker::Allow(absl::Time now) {
+  AUTOLOCK(lock, &mu_);
+  switch (state_) {
+    case kClosed:
+      return true;
+
+    case kOpen:
+      if (now < open_until_) {
+        ++num_rejected_;
+        return false;
+      }
+      LOG(INFO) << "circuit breaker half-open."
+                << " probes=" << options_.half_open_probes;
+      state_ = kHalfOpen;
+      half_open_since_ = now;
+      num_probes_started_ = 0;
+      num_probes_succeeded_ = 0;
+      break;
+
+    case kHalfOpen:
+      // Probes might be lost, e.g. tasks were canceled before sending a
+      // request. Start probes again not to stay half-open forever.
+      if (now - half_open_since_ >= open_duration_) {
+        half_open_since_ = now;
+        num_probes_started_ = 0;
+        num_probes_succeeded_ = 0;
+      }
+      break;
+  }
+
+  DCHECK_EQ(kHalfOpen, state_);
+  if (num_probes_started_ >= options_.half_open_probes) {
+    ++num_rejected_;
+    return false;
+  }
+  ++num_probes_started_;
+  ++num_probes_;
+  return true;
+}
+
+void CircuitBreaker::Record(bool ok, absl::Duration latency, absl::Time now) {
+  bool failed = !ok;
+  if (options_.slow_response_threshold > absl::ZeroDuration() &&
+      latency >= options_.slow_response_threshold) {
+    failed = true;
+  }
+
+  AUTOLOCK(lock, &mu_);
+  switch (state_) {
+    case kClosed:
+      results_.emplace_back(now, failed);
+      if (failed) {
+        ++num_failures_in_window_;
+      }
+      ExpireResultsUnlocked(now);
+      if (static_cast<int>(results_.size()) >= options_.min_requests &&
+          num_failures_in_window_ * 100 >=
+              static_cast<int>(results_.size()) *
+                  options_.failure_threshold_percent) {
+        LOG(WARNING) << "circuit breaker open."
+                     << " failures=" << num_failures_in_window_
+                     << " requests=" << results_.size()
+                     << " in " << options_.window;
+        OpenUnlocked(now);
+      }
+      return;
+
+    case kOpen:
+      // A request started before the circuit opened.
+      return;
+
+    case kHalfOpen:
+      if (failed) {
+        open_duration_ = std::min(
+            open_duration_ * 2,
+            std::max(options_.open_duration, options_.max_open_duration));
+        LOG(WARNING) << "circuit breaker probe failed. open again for "
+                     << open_duration_;
+        OpenUnlocked(now);
+        return;
+      }
+      if (++num_probes_succeeded_ >= options_.half_open_probes) {
+        LOG(INFO) << "circuit breaker closed.";
+        CloseUnlocked();
+      }
+      return;
+  }
+}
+
+CircuitBreaker::State CircuitBreaker::state() const {
+  AUTOLOCK(lock, &mu_);
+  return state_;
+}
+
+void CircuitBreaker::DumpStatsToProto(CircuitBreakerStats* stats) const {
+  AUTOLOCK(lock, &mu_);
+  stats->set_state(std::string(StateName(state_)));
+  stats->set_opened(num_opened_);
+  stats->set_closed(num_closed_);
+  stats->set_rejected(num_rejected_);
+  stats->set_probes(num_probes_);
+  stats->set_window_requests(results_.size());
+  stats->set_window_failures(num_failures_in_window_);
+}
+
+/* static */
+absl::string_view CircuitBreaker::StateName(State state) {
+  switch (state) {
+    case kClosed:
+      return "closed";
+    case kOpen:
+      return "open";
+    case kHalfOpen:
+      return "half-open";
+  }
+  return "unknown";
+}
+
+void CircuitBreaker::OpenUnlocked(absl::Time now) {
+  state_ = kOpen;
+  open_until_ = now + open_duration_;
+  results_.clear();
+  num_failures_in_window_ = 0;
+  ++num_opened_;
+}
+
+void CircuitBreaker::CloseUnlocked() {
+  state_ = kClosed;
+  open_duration_ = options_.open_duration;
+  ++num_closed_;
+}
+
+void CircuitBreaker::ExpireResultsUnlocked(absl::Time now) {
+  const absl::Time expired = now - options_.window;
+  while (!results_.empty() && results_.front().first <= expired) {
+    if (results_.front().second) {
+      --num_failures_in_window_;
+    }
+    results_.pop_front();
+  }
+}
+
+}  // namespace devtools_goma
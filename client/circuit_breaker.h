@@ -0,0 +1,106 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DEVTOOLS_GOMA_CLIENT_CIRCUIT_BREAKER_H_
+#define DEVTOOLS_GOMA_CLIENT_CIRCUIT_BREAKER_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "basictypes.h"
+#include "lockhelper.h"
+
+namespace devtools_goma {
+
+class CircuitBreakerStats;
+
+// CircuitBreaker decides whether remote work should be started, from
+// results of recent requests to the backend.
+//
+// While closed, all requests are allowed. It opens when failed or slow
+// requests in the last |window| reach |failure_threshold_percent|.
+// While open, no requests are allowed, so callers can skip preparation
+// for remote work and run locally. After |open_duration|, it becomes
+// half-open and allows |half_open_probes| requests. It closes when they
+// all succeed, or opens again with doubled open duration if one fails.
+//
+// This class is thread-safe.
+class CircuitBreaker {
+ public:
+  enum State {
+    kClosed,
+    kOpen,
+    kHalfOpen,
+  };
+
+  struct Options {
+    // Results in this duration are used to compute the failure rate.
+    absl::Duration window = absl::Seconds(10);
+    // The circuit doesn't open with fewer results than this in |window|.
+    int min_requests = 20;
+    // Opens if failed or slow results are this percent or more.
+    int failure_threshold_percent = 50;
+    // A result slower than this is counted as failure.
+    // Zero means latency is not considered.
+    absl::Duration slow_response_threshold;
+    // Duration to stay open before probing.
+    absl::Duration open_duration = absl::Seconds(5);
+    // Max duration to stay open after probes failed repeatedly.
+    absl::Duration max_open_duration = absl::Minutes(1);
+    // Number of probes in half-open state.
+    int half_open_probes = 3;
+  };
+
+  explicit CircuitBreaker(const Options& options);
+
+  // Returns true if a request can be started at |now|.
+  bool Allow(absl::Time now) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Records a result of a request finished at |now|.
+  void Record(bool ok, absl::Duration latency, absl::Time now)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  State state() const ABSL_LOCKS_EXCLUDED(mu_);
+
+  void DumpStatsToProto(CircuitBreakerStats* stats) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  static absl::string_view StateName(State state);
+
+ private:
+  void OpenUnlocked(absl::Time now) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void CloseUnlocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void ExpireResultsUnlocked(absl::Time now)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const Options options_;
+
+  mutable Lock mu_;
+  State state_ ABSL_GUARDED_BY(mu_) = kClosed;
+  // Finished time and whether it failed, in |window| while closed.
+  std::deque<std::pair<absl::Time, bool>> results_ ABSL_GUARDED_BY(mu_);
+  int num_failures_in_window_ ABSL_GUARDED_BY(mu_) = 0;
+
+  absl::Duration open_duration_ ABSL_GUARDED_BY(mu_);
+  absl::Time open_until_ ABSL_GUARDED_BY(mu_);
+  absl::Time half_open_since_ ABSL_GUARDED_BY(mu_);
+  int num_probes_started_ ABSL_GUARDED_BY(mu_) = 0;
+  int num_probes_succeeded_ ABSL_GUARDED_BY(mu_) = 0;
+
+  int64_t num_opened_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t num_closed_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t num_rejected_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t num_probes_ ABSL_GUARDED_BY(mu_) = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(CircuitBreaker);
+};
+
+}  // namespace devtools_goma
+
+#endif  // DEVTOOLS_GOMA_CLIENT_CIRCUIT_BREAKER_H_
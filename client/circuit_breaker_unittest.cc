@@ -0,0 +1,174 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "circuit_breaker.h"
+
+#include "absl/time/time.h"
+#include "compiler_specific.h"
+#include "gtest/gtest.h"
+
+MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
+#include "lib/goma_stats.pb.h"
+MSVC_POP_WARNING()
+
+namespace devtools_goma {
+
+namespace {
+
+CircuitBreaker::Options TestOptions() {
+  CircuitBreaker::Options options;
+  options.window = absl::Seconds(10);
+  options.min_requests = 4;
+  options.failure_threshold_percent = 50;
+  options.slow_response_threshold = absl::Seconds(30);
+  options.open_duration = absl::Seconds(5);
+  options.max_open_duration = absl::Seconds(20);
+  options.half_open_probes = 2;
+  return options;
+}
+
+}  // namespace
+
+TEST(CircuitBreakerTest, OpenByFailureRate) {
+  CircuitBreaker breaker(TestOptions());
+  const absl::Time now = absl::FromUnixSeconds(1000);
+
+  breaker.Record(false, absl::Milliseconds(10), now);
+  breaker.Record(false, absl::Milliseconds(10), now);
+  breaker.Record(false, absl::Milliseconds(10), now);
+  // Fewer results than min_requests.
+  EXPECT_EQ(CircuitBreaker::kClosed, breaker.state());
+  EXPECT_TRUE(breaker.Allow(now));
+
+  breaker.Record(true, absl::Milliseconds(10), now);
+  EXPECT_EQ(CircuitBreaker::kOpen, breaker.state());
+  EXPECT_FALSE(breaker.Allow(now));
+  EXPECT_FALSE(breaker.Allow(now + absl::Seconds(4)));
+
+  CircuitBreakerStats stats;
+  breaker.DumpStatsToProto(&stats);
+  EXPECT_EQ("open", stats.state());
+  EXPECT_EQ(1, stats.opened());
+  EXPECT_EQ(2, stats.rejected());
+}
+
+TEST(CircuitBreakerTest, StayClosedBelowThreshold) {
+  CircuitBreaker breaker(TestOptions());
+  const absl::Time now = absl::FromUnixSeconds(1000);
+
+  for (int i = 0; i < 10; ++i) {
+    breaker.Record(i % 4 != 0, absl::Milliseconds(10), now);
+  }
+  EXPECT_EQ(CircuitBreaker::kClosed, breaker.state());
+
+  // Old failures are out of the window.
+  CircuitBreaker windowed(TestOptions());
+  windowed.Record(false, absl::Milliseconds(10), now);
+  windowed.Record(false, absl::Milliseconds(10), now);
+  windowed.Record(false, absl::Milliseconds(10), now);
+  const absl::Time later = now + absl::Seconds(11);
+  windowed.Record(false, absl::Milliseconds(10), later);
+  windowed.Record(true, absl::Milliseconds(10), later);
+  windowed.Record(true, absl::Milliseconds(10), later);
+  windowed.Record(true, absl::Milliseconds(10), later);
+  EXPECT_EQ(CircuitBreaker::kClosed, windowed.state());
+
+  CircuitBreakerStats stats;
+  windowed.DumpStatsToProto(&stats);
+  EXPECT_EQ(4, stats.window_requests());
+  EXPECT_EQ(1, stats.window_failures());
+}
+
+TEST(CircuitBreakerTest, OpenBySlowResponse) {
+  CircuitBreaker breaker(TestOptions());
+  const absl::Time now = absl::FromUnixSeconds(1000);
+
+  breaker.Record(true, absl::Seconds(31), now);
+  breaker.Record(true, absl::Seconds(40), now);
+  breaker.Record(true, absl::Seconds(1), now);
+  breaker.Record(true, absl::Seconds(1), now);
+  EXPECT_EQ(CircuitBreaker::kOpen, breaker.state());
+}
+
+TEST(CircuitBreakerTest, HalfOpenProbe) {
+  CircuitBreaker breaker(TestOptions());
+  absl::Time now = absl::FromUnixSeconds(1000);
+  for (int i = 0; i < 4; ++i) {
+    breaker.Record(false, absl::Milliseconds(10), now);
+  }
+  ASSERT_EQ(CircuitBreaker::kOpen, breaker.state());
+
+  // Only half_open_probes requests are allowed after open_duration.
+  now += absl::Seconds(5);
+  EXPECT_TRUE(breaker.Allow(now));
+  EXPECT_EQ(CircuitBreaker::kHalfOpen, breaker.state());
+  EXPECT_TRUE(breaker.Allow(now));
+  EXPECT_FALSE(breaker.Allow(now));
+
+  // A probe failed. Open again with doubled duration.
+  breaker.Record(false, absl::Milliseconds(10), now);
+  EXPECT_EQ(CircuitBreaker::kOpen, breaker.state());
+  EXPECT_FALSE(breaker.Allow(now + absl::Seconds(9)));
+  now += absl::Seconds(10);
+  EXPECT_TRUE(breaker.Allow(now));
+  EXPECT_TRUE(breaker.Allow(now));
+
+  // Probes succeeded. Closed.
+  breaker.Record(true, absl::Milliseconds(10), now);
+  EXPECT_EQ(CircuitBreaker::kHalfOpen, breaker.state());
+  breaker.Record(true, absl::Milliseconds(10), now);
+  EXPECT_EQ(CircuitBreaker::kClosed, breaker.state());
+  EXPECT_TRUE(breaker.Allow(now));
+
+  CircuitBreakerStats stats;
+  breaker.DumpStatsToProto(&stats);
+  EXPECT_EQ("closed", stats.state());
+  EXPECT_EQ(2, stats.opened());
+  EXPECT_EQ(1, stats.closed());
+  EXPECT_EQ(4, stats.probes());
+  EXPECT_EQ(2, stats.rejected());
+
+  // Open duration is reset after closed.
+  for (int i = 0; i < 4; ++i) {
+    breaker.Record(false, absl::Milliseconds(10), now);
+  }
+  ASSERT_EQ(CircuitBreaker::kOpen, breaker.state());
+  EXPECT_TRUE(breaker.Allow(now + absl::Seconds(5)));
+}
+
+TEST(CircuitBreakerTest, MaxOpenDuration) {
+  CircuitBreaker breaker(TestOptions());
+  absl::Time now = absl::FromUnixSeconds(1000);
+  for (int i = 0; i < 4; ++i) {
+    breaker.Record(false, absl::Milliseconds(10), now);
+  }
+  // 5s -> 10s -> 20s -> 20s.
+  for (absl::Duration open_duration :
+       {absl::Seconds(5), absl::Seconds(10), absl::Seconds(20),
+        absl::Seconds(20)}) {
+    ASSERT_EQ(CircuitBreaker::kOpen, breaker.state());
+    EXPECT_FALSE(breaker.Allow(now + open_duration - absl::Seconds(1)));
+    now += open_duration;
+    EXPECT_TRUE(breaker.Allow(now));
+    breaker.Record(false, absl::Milliseconds(10), now);
+  }
+}
+
+TEST(CircuitBreakerTest, LostProbes) {
+  CircuitBreaker breaker(TestOptions());
+  absl::Time now = absl::FromUnixSeconds(1000);
+  for (int i = 0; i < 4; ++i) {
+    breaker.Record(false, absl::Milliseconds(10), now);
+  }
+  now += absl::Seconds(5);
+  EXPECT_TRUE(breaker.Allow(now));
+  EXPECT_TRUE(breaker.Allow(now));
+  EXPECT_FALSE(breaker.Allow(now + absl::Seconds(4)));
+
+  // Probes didn't report results in open duration. Probe again.
+  EXPECT_TRUE(breaker.Allow(now + absl::Seconds(5)));
+  EXPECT_EQ(CircuitBreaker::kHalfOpen, breaker.state());
+}
+
+}  // namespace devtools_goma
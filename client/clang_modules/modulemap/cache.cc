@@ -4,7 +4,6 @@
 
 #include "cache.h"
 
-#include "autolock_timer.h"
 #include "base/path.h"
 #include "glog/logging.h"
 
@@ -29,7 +28,6 @@ void Cache::Quit() {
 }
 
 size_t Cache::size() const {
-  AUTO_SHARED_LOCK(lock, &mu_);
   return cache_.size();
 }
 
@@ -43,19 +41,8 @@ bool Cache::AddModuleMapFileAndDependents(const std::string& module_map_file,
       file::JoinPathRespectAbsolute(cwd, module_map_file);
   CacheKey key(cwd, std::move(abs_module_map_path));
 
-  bool cache_hit = false;
   std::vector<CollectedModuleMapFile> cached_item;
-  {
-    AUTO_SHARED_LOCK(lock, &mu_);
-    auto it = cache_.find(key);
-    if (it != cache_.end()) {
-      // Need to copy in order to access outside of lock.s
-      cache_hit = true;
-      cached_item = it->second;
-    }
-  }
-
-  if (cache_hit) {
+  if (cache_.Lookup(key, &cached_item)) {
     bool ok = true;
     // If cache_hit, check FileStat.
     for (const auto& cf : cached_item) {
@@ -97,19 +84,8 @@ bool Cache::AddModuleMapFileAndDependents(const std::string& module_map_file,
     }
   }
 
-  {
-    AUTO_EXCLUSIVE_LOCK(lock, &mu_);
-    cache_.emplace_back(
-        std::move(key),
-        std::move(*processor.mutable_collected_module_map_files()));
-
-    // Remove oldest entries.
-    while (cache_.size() > max_cache_entries_) {
-      cache_.pop_front();
-      cache_evicted_.Add(1);
-    }
-  }
-
+  cache_.Insert(std::move(key),
+                std::move(*processor.mutable_collected_module_map_files()), 1);
   return true;
 }
 
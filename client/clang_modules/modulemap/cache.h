@@ -11,9 +11,8 @@
 #include <vector>
 
 #include "client/atomic_stats_counter.h"
+#include "client/concurrent_cache.h"
 #include "client/file_stat.h"
-#include "client/linked_unordered_map.h"
-#include "lockhelper.h"
 #include "processor.h"
 
 namespace devtools_goma {
@@ -46,7 +45,7 @@ class Cache {
   // Stat. Returns cache miss count.
   std::int64_t cache_miss() const { return cache_miss_.value(); }
   // Stat. Returns cache evicted count.
-  std::int64_t cache_evicted() const { return cache_evicted_.value(); }
+  std::int64_t cache_evicted() const { return cache_.evicted(); }
 
  private:
   // Cache Key. Since a relative path is collected, we have to keep
@@ -74,23 +73,20 @@ class Cache {
     std::string abs_module_map_file;
   };
 
-  explicit Cache(size_t max_cache_entries)
-      : max_cache_entries_(max_cache_entries) {}
+  // Each entry costs 1, so |max_cache_entries| is the number of entries.
+  explicit Cache(size_t max_cache_entries) : cache_(max_cache_entries) {}
 
   Cache(const Cache&) = delete;
   void operator=(const Cache&) = delete;
 
   static Cache* instance_;
 
-  const size_t max_cache_entries_;
-
-  mutable ReadWriteLock mu_;
-  LinkedUnorderedMap<CacheKey, std::vector<CollectedModuleMapFile>> cache_
-      ABSL_GUARDED_BY(mu_);
+  ConcurrentCache<CacheKey, std::vector<CollectedModuleMapFile>> cache_;
 
+  // Hit and miss are counted after checking the cached files are not
+  // updated, so they differ from |cache_|'s stats.
   StatsCounter cache_hit_;
   StatsCounter cache_miss_;
-  StatsCounter cache_evicted_;
 
   friend class ModuleMapCacheTest;
 };
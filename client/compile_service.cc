@@ -30,11 +30,15 @@
 #include "compile_task.h"
 #include "compiler_flags.h"
 #include "compiler_proxy_histogram.h"
+#include "compiler_proxy_metrics.h"
 #include "compiler_proxy_info.h"
 #include "cxx/include_processor/cpp_include_processor.h"
 #include "cxx/include_processor/include_cache.h"
 #include "deps_cache.h"
+#include "exec_req_recorder.h"
+#include "file_content_pool.h"
 #include "file_hash_cache.h"
+#include "file_stat_cache.h"
 #include "file_helper.h"
 #include "file_path_util.h"
 #include "file_stat.h"
@@ -45,16 +49,20 @@
 #include "google/protobuf/util/json_util.h"
 #include "http.h"
 #include "http_rpc.h"
+#include "input_manifest.h"
 #include "ioutil.h"
+#include "json_writer.h"
 #include "local_output_cache.h"
 #include "lockhelper.h"
 #include "log_service_client.h"
 #include "machine_info.h"
+#include "missing_input_predictor.h"
 #include "multi_http_rpc.h"
 #include "mypath.h"
 #include "path.h"
 #include "path_resolver.h"
 #include "rpc_controller.h"
+#include "upload_scheduler.h"
 #include "util.h"
 #include "watchdog.h"
 #include "worker_thread.h"
@@ -148,6 +156,7 @@ CompileService::CompileService(WorkerThreadManager* wm, int compiler_info_pool)
       file_hash_cache_(new FileHashCache),
       include_processor_pool_(WorkerThreadManager::kFreePool),
       histogram_(new CompilerProxyHistogram),
+      metrics_(absl::make_unique<CompilerProxyMetrics>()),
       new_file_threshold_duration_(absl::Minutes(1)),
       enable_gch_hack_(true),
       num_forced_fallback_in_setup_{} {
@@ -220,6 +229,11 @@ void CompileService::SetMultiFileStore(
   multi_file_store_ = std::move(multi_file_store);
 }
 
+void CompileService::SetUploadScheduler(
+    std::unique_ptr<UploadScheduler> upload_scheduler) {
+  upload_scheduler_ = std::move(upload_scheduler);
+}
+
 void CompileService::SetFileServiceHttpClient(
     std::unique_ptr<FileServiceHttpClient> file_service) {
   blob_client_ = absl::make_unique<FileBlobClient>(std::move(file_service));
@@ -229,13 +243,37 @@ BlobClient* CompileService::blob_client() const {
   return blob_client_.get();
 }
 
-void CompileService::StartIncludeProcessorWorkers(int num_threads) {
+void CompileService::SetInputManifestCache(
+    std::unique_ptr<InputManifestCache> input_manifest_cache) {
+  input_manifest_cache_ = std::move(input_manifest_cache);
+}
+
+void CompileService::SetMissingInputPredictor(
+    std::unique_ptr<MissingInputPredictor> missing_input_predictor) {
+  missing_input_predictor_ = std::move(missing_input_predictor);
+}
+
+void CompileService::SetExecReqRecorder(
+    std::unique_ptr<ExecReqRecorder> exec_req_recorder) {
+  exec_req_recorder_ = std::move(exec_req_recorder);
+}
+
+void CompileService::StartIncludeProcessorWorkers(
+    int num_threads,
+    int min_threads,
+    absl::Duration tune_period) {
   if (num_threads <= 0) {
     return;
   }
-  include_processor_pool_ = wm_->StartPool(num_threads, "include_processor");
+  if (min_threads > 0 && min_threads < num_threads) {
+    include_processor_pool_ = wm_->StartAdaptivePool(
+        min_threads, num_threads, tune_period, "include_processor");
+  } else {
+    include_processor_pool_ = wm_->StartPool(num_threads, "include_processor");
+  }
   LOG(INFO) << "include_processor_pool=" << include_processor_pool_
-            << " num_thread=" << num_threads;
+            << " num_thread=" << num_threads
+            << " min_thread=" << min_threads;
 }
 
 void CompileService::SetLogServiceClient(
@@ -306,6 +344,9 @@ void CompileService::Exec(
         absl::StrCat(compiler_proxy_id_prefix(), task_id));
 
     task->Init(rpc, std::move(task_req), resp, callback);
+    if (exec_req_recorder_ != nullptr) {
+      task->StartExecReqRecord(exec_req_recorder_->Elapsed(), req);
+    }
 
     AUTOLOCK(lock, &mu_);
     if (static_cast<int>(active_tasks_.size()) >= max_active_tasks_) {
@@ -339,9 +380,16 @@ void CompileService::ExecDone(WorkerThread::ThreadId thread_id,
 void CompileService::CompileTaskDone(CompileTask* task) {
   task->SetFrozenTimestamp(absl::Now());
   histogram_->UpdateCompileStat(task->stats());
+  metrics_->UpdateCompileStat(task->stats());
   rbe_stats_mgr_.Accumulate(task);
   if (log_service_client_.get())
     log_service_client_->SaveExecLog(task->stats().exec_log);
+  if (exec_req_recorder_ != nullptr) {
+    std::unique_ptr<ExecReqRecord> record = task->ReleaseExecReqRecord();
+    record->set_handler_time_usec(
+        absl::ToInt64Microseconds(task->stats().handler_time));
+    exec_req_recorder_->Write(*record);
+  }
 
   std::vector<CompileTask*> start_tasks;
   std::vector<CompileTask*> deref_tasks;
@@ -377,6 +425,13 @@ void CompileService::CompileTaskDone(CompileTask* task) {
         task->stats().include_processor_wait_time;
     include_processor_total_run_time_ +=
         task->stats().include_processor_run_time;
+    include_processor_total_cpu_time_ +=
+        task->stats().include_processor_cpu_time;
+    input_file_total_cpu_time_ += task->stats().input_file_cpu_time;
+    rpc_req_build_total_cpu_time_ += task->stats().total_rpc_req_build_cpu_time;
+    rpc_resp_parse_total_cpu_time_ +=
+        task->stats().total_rpc_resp_parse_cpu_time;
+    output_file_total_cpu_time_ += task->stats().output_file_cpu_time;
 
     switch (task->state()) {
       case CompileTask::FINISHED:
@@ -513,6 +568,8 @@ void CompileService::Wait() {
     }
   }
   CHECK(active_tasks_.empty());
+  // Completes the record file.
+  exec_req_recorder_.reset();
   if (log_service_client_.get())
     log_service_client_->Wait();
   log_service_client_.reset();
@@ -558,116 +615,192 @@ bool CompileService::DumpTaskRequest(int task_id, std::string* message) {
   return true;
 }
 
-void CompileService::DumpToJson(Json::Value* json, absl::Time after) {
-  AUTOLOCK(lock, &mu_);
-
-  absl::Time last_update_time = after;
+namespace {
 
-  {
-    Json::Value active(Json::arrayValue);
-    for (const auto* task : active_tasks_) {
-      Json::Value json_task;
-      task->DumpToJson(false, &json_task);
-      active.append(std::move(json_task));
+// Selects tasks of |tasks|, newest first, frozen after |after|, at most
+// |limit| oldest of them if |limit| is positive.
+// Returns the latest frozen timestamp of selected tasks, and sets
+// |*truncated| if tasks are dropped by |limit|.
+absl::optional<absl::Time> SelectTasksFrozenAfter(
+    const std::deque<CompileTask*>& tasks,
+    absl::Time after,
+    int limit,
+    std::vector<CompileTask*>* selected,
+    bool* truncated) {
+  absl::optional<absl::Time> last_update_time;
+  for (auto it = tasks.rbegin(); it != tasks.rend(); ++it) {
+    const absl::optional<absl::Time> frozen_timestamp =
+        (*it)->GetFrozenTimestamp();
+    if (frozen_timestamp.has_value() && *frozen_timestamp <= after) {
+      continue;
+    }
+    if (limit > 0 && static_cast<int>(selected->size()) >= limit) {
+      *truncated = true;
+      break;
     }
-    (*json)["active"] = std::move(active);
+    if (frozen_timestamp.has_value()) {
+      last_update_time = std::max(last_update_time.value_or(after),
+                                  *frozen_timestamp);
+    }
+    selected->push_back(*it);
   }
+  std::reverse(selected->begin(), selected->end());
+  return last_update_time;
+}
 
-  {
-    Json::Value finished(Json::arrayValue);
-    for (const auto* task : finished_tasks_) {
-      Json::Value json_task;
-      task->DumpToJson(false, &json_task);
-      finished.append(std::move(json_task));
-    }
-    (*json)["finished"] = std::move(finished);
+void WriteTasksJson(absl::string_view key,
+                    const std::vector<CompileTask*>& tasks,
+                    JsonWriter* writer) {
+  writer->Key(key);
+  writer->BeginArray();
+  for (const auto* task : tasks) {
+    task->WriteSummaryJson(writer);
   }
+  writer->EndArray();
+}
 
+}  // namespace
+
+void CompileService::DumpTasksJson(absl::Time after,
+                                   int limit,
+                                   std::string* out) {
+  // Takes references to tasks and writes bounded counters under mu_, and
+  // writes tasks after releasing mu_, so that compiles are not blocked while
+  // serializing many tasks.
+  std::vector<CompileTask*> active;
+  std::vector<CompileTask*> finished;
+  std::vector<CompileTask*> failed;
+  std::vector<CompileTask*> long_tasks;
+  bool truncated = false;
+  absl::Time last_update_time = after;
+  JsonWriter writer(out);
+  writer.BeginObject();
   {
-    Json::Value failed(Json::arrayValue);
-    for (const auto* task : failed_tasks_) {
-      const absl::optional<absl::Time> frozen_timestamp =
-          task->GetFrozenTimestamp();
-      if (!frozen_timestamp.has_value() || *frozen_timestamp <= after)
+    AUTOLOCK(lock, &mu_);
+    active.assign(active_tasks_.begin(), active_tasks_.end());
+
+    bool finished_truncated = false;
+    const absl::optional<absl::Time> finished_update_time =
+        SelectTasksFrozenAfter(finished_tasks_, after, limit, &finished,
+                               &finished_truncated);
+    bool failed_truncated = false;
+    const absl::optional<absl::Time> failed_update_time =
+        SelectTasksFrozenAfter(failed_tasks_, after, limit, &failed,
+                               &failed_truncated);
+    truncated = finished_truncated || failed_truncated;
+    // If a list is truncated, next request should start from its last
+    // selected task not to miss the rest. Tasks of the other list may be
+    // sent again in that case.
+    absl::optional<absl::Time> truncated_update_time;
+    for (const auto& it : {std::make_pair(finished_truncated,
+                                          finished_update_time),
+                           std::make_pair(failed_truncated,
+                                          failed_update_time)}) {
+      if (!it.second.has_value()) {
         continue;
-      last_update_time = std::max(last_update_time, *frozen_timestamp);
-      Json::Value json_task;
-      task->DumpToJson(false, &json_task);
-      failed.append(std::move(json_task));
+      }
+      last_update_time = std::max(last_update_time, *it.second);
+      if (it.first) {
+        truncated_update_time =
+            std::min(truncated_update_time.value_or(*it.second), *it.second);
+      }
+    }
+    if (truncated_update_time.has_value()) {
+      last_update_time = *truncated_update_time;
     }
-    (*json)["failed"] = std::move(failed);
-  }
 
-  {
-    Json::Value long_json(Json::arrayValue);
-    std::vector<CompileTask*> long_tasks(long_tasks_);
-    sort(long_tasks.begin(), long_tasks.end(), CompareTaskHandlerTime());
-    for (const auto* task : long_tasks) {
-      Json::Value json_task;
-      task->DumpToJson(false, &json_task);
-      long_json.append(std::move(json_task));
+    long_tasks = long_tasks_;
+    std::sort(long_tasks.begin(), long_tasks.end(), CompareTaskHandlerTime());
+
+    for (auto* tasks : {&active, &finished, &failed, &long_tasks}) {
+      for (auto* task : *tasks) {
+        task->Ref();
+      }
     }
-    (*json)["long"] = std::move(long_json);
-  }
 
-  {
-    Json::Value num_exec(Json::objectValue);
-
-    num_exec["max_active_tasks"] = max_active_tasks_;
-    num_exec["pending"] = Json::Int64(pending_tasks_.size());
-    num_exec["request"] = num_exec_request_;
-    num_exec["success"] = num_exec_success_;
-    num_exec["failure"] = num_exec_failure_;
-    num_exec["compiler_proxy_fail"] = num_exec_compiler_proxy_failure_;
-    num_exec["compiler_info_stores"] =
-        CompilerInfoCache::instance()->NumStores();
-    num_exec["compiler_info_store_dups"] =
-        CompilerInfoCache::instance()->NumStoreDups();
-    num_exec["compiler_info_fail"] = CompilerInfoCache::instance()->NumFail();
-    num_exec["compiler_info_miss"] = CompilerInfoCache::instance()->NumMiss();
-    num_exec["compiler_info_used"] = CompilerInfoCache::instance()->NumUsed();
-    num_exec["compiler_info_count"] = CompilerInfoCache::instance()->Count();
-    num_exec["goma_finished"] = num_exec_goma_finished_;
-    num_exec["goma_cache_hit"] = num_exec_goma_cache_hit_;
-    num_exec["goma_local_cache_hit"] = num_exec_goma_local_cache_hit_;
-    num_exec["goma_aborted"] = num_exec_goma_aborted_;
-    num_exec["goma_retry"] = num_exec_goma_retry_;
-    num_exec["local_run"] = num_exec_local_run_;
-    num_exec["local_killed"] = num_exec_local_killed_;
-    num_exec["local_finished"] = num_exec_local_finished_;
-    num_exec["fail_fallback"] = num_exec_fail_fallback_;
-
-    Json::Value version_mismatch(Json::objectValue);
+    const std::pair<const char*, int64_t> num_exec[] = {
+        {"max_active_tasks", max_active_tasks_},
+        {"pending", static_cast<int64_t>(pending_tasks_.size())},
+        {"request", num_exec_request_},
+        {"success", num_exec_success_},
+        {"failure", num_exec_failure_},
+        {"compiler_proxy_fail", num_exec_compiler_proxy_failure_},
+        {"compiler_info_stores", CompilerInfoCache::instance()->NumStores()},
+        {"compiler_info_store_dups",
+         CompilerInfoCache::instance()->NumStoreDups()},
+        {"compiler_info_fail", CompilerInfoCache::instance()->NumFail()},
+        {"compiler_info_miss", CompilerInfoCache::instance()->NumMiss()},
+        {"compiler_info_used", CompilerInfoCache::instance()->NumUsed()},
+        {"compiler_info_count", CompilerInfoCache::instance()->Count()},
+        {"goma_finished", num_exec_goma_finished_},
+        {"goma_cache_hit", num_exec_goma_cache_hit_},
+        {"goma_local_cache_hit", num_exec_goma_local_cache_hit_},
+        {"goma_aborted", num_exec_goma_aborted_},
+        {"goma_retry", num_exec_goma_retry_},
+        {"local_run", num_exec_local_run_},
+        {"local_killed", num_exec_local_killed_},
+        {"local_finished", num_exec_local_finished_},
+        {"fail_fallback", num_exec_fail_fallback_},
+    };
+    writer.Key("num_exec");
+    writer.BeginObject();
+    for (const auto& it : num_exec) {
+      writer.Key(it.first);
+      writer.Int(it.second);
+    }
+    writer.Key("version_mismatch");
+    writer.BeginObject();
     for (const auto& iter : command_version_mismatch_) {
-      version_mismatch[iter.first] = iter.second;
+      writer.Key(iter.first);
+      writer.Int(iter.second);
     }
-    num_exec["version_mismatch"] = std::move(version_mismatch);
-
-    Json::Value binary_hash_mismatch(Json::objectValue);
+    writer.EndObject();
+    writer.Key("binary_hash_mismatch");
+    writer.BeginObject();
     for (const auto& iter : command_binary_hash_mismatch_) {
-      binary_hash_mismatch[iter.first] = iter.second;
+      writer.Key(iter.first);
+      writer.Int(iter.second);
     }
-    num_exec["binary_hash_mismatch"] = std::move(binary_hash_mismatch);
-
-    (*json)["num_exec"] = std::move(num_exec);
+    writer.EndObject();
+    writer.EndObject();
+
+    const std::pair<const char*, int64_t> num_file[] = {
+        {"requested", num_file_requested_},
+        {"uploaded", num_file_uploaded_},
+        {"missed", num_file_missed_},
+        {"dropped", num_file_dropped_},
+    };
+    writer.Key("num_file");
+    writer.BeginObject();
+    for (const auto& it : num_file) {
+      writer.Key(it.first);
+      writer.Int(it.second);
+    }
+    writer.EndObject();
   }
 
-  {
-    Json::Value num_file;
-    num_file["requested"] = num_file_requested_;
-    num_file["uploaded"] = num_file_uploaded_;
-    num_file["missed"] = num_file_missed_;
-    num_file["dropped"] = num_file_dropped_;
-    (*json)["num_file"] = std::move(num_file);
-  }
+  WriteTasksJson("active", active, &writer);
+  WriteTasksJson("finished", finished, &writer);
+  WriteTasksJson("failed", failed, &writer);
+  WriteTasksJson("long", long_tasks, &writer);
 
-  {
-    Json::Value http_rpc;
-    http_rpc_->DumpToJson(&http_rpc);
-    (*json)["http_rpc"] = std::move(http_rpc);
-  }
+  Json::Value http_rpc;
+  http_rpc_->DumpToJson(&http_rpc);
+  writer.Key("http_rpc");
+  writer.Raw(Json::FastWriter().write(http_rpc));
 
-  (*json)["last_update_ms"] = Json::Value(absl::ToUnixMillis(last_update_time));
+  writer.Key("last_update_ms");
+  writer.Int(absl::ToUnixMillis(last_update_time));
+  writer.Key("truncated");
+  writer.Bool(truncated);
+  writer.EndObject();
+
+  // Deref may delete a task, so it must not be called under mu_.
+  for (auto* tasks : {&active, &finished, &failed, &long_tasks}) {
+    for (auto* task : *tasks) {
+      task->Deref();
+    }
+  }
 }
 
 void CompileService::DumpStats(std::ostringstream* ss) {
@@ -764,7 +897,9 @@ void CompileService::DumpStats(std::ostringstream* ss) {
         << " compiler_disabled=" << fallback_in_setup.compiler_disabled()
         << " requested_by_user=" << fallback_in_setup.requested_by_user()
         << " update_required_files="
-        << fallback_in_setup.failed_to_update_required_files() << std::endl;
+        << fallback_in_setup.failed_to_update_required_files()
+        << " circuit_breaker_open=" << fallback_in_setup.circuit_breaker_open()
+        << std::endl;
   (*ss) << " local:"
         << " run=" << gstats.request_stats().local().run()
         << " killed=" << gstats.request_stats().local().killed()
@@ -798,6 +933,34 @@ void CompileService::DumpStats(std::ostringstream* ss) {
         << " total_run_time="
         << gstats.include_processor_stats().total_run_time()
         << std::endl;
+  (*ss) << "cpu_time:"
+        << " include_processor="
+        << gstats.cpu_time_stats().include_processor()
+        << " input_file=" << gstats.cpu_time_stats().input_file()
+        << " rpc_req_build=" << gstats.cpu_time_stats().rpc_req_build()
+        << " rpc_resp_parse=" << gstats.cpu_time_stats().rpc_resp_parse()
+        << " output_file=" << gstats.cpu_time_stats().output_file()
+        << " total=" << gstats.cpu_time_stats().total()
+        << std::endl;
+  if (gstats.has_include_processor_pool_stats()) {
+    const AdaptivePoolStats& pool_stats =
+        gstats.include_processor_pool_stats();
+    (*ss) << "include_processor_pool:"
+          << " active_threads=" << pool_stats.active_threads()
+          << " min=" << pool_stats.min_threads()
+          << " max=" << pool_stats.max_threads()
+          << " lowest=" << pool_stats.lowest_active_threads()
+          << std::endl
+          << " grow=" << pool_stats.grow()
+          << " shrink_idle=" << pool_stats.shrink_idle()
+          << " shrink_cpu=" << pool_stats.shrink_cpu()
+          << std::endl
+          << " last: queue_wait_us=" << pool_stats.last_queue_wait_us()
+          << " pendings=" << pool_stats.last_pendings()
+          << " runnable_threads=" << pool_stats.last_runnable_threads()
+          << " load_average=" << pool_stats.last_load_average()
+          << std::endl;
+  }
   if (gstats.has_includecache_stats()) {
     const IncludeCacheStats& ic_stats = gstats.includecache_stats();
     (*ss) << "includecache:" << std::endl;
@@ -823,6 +986,80 @@ void CompileService::DumpStats(std::ostringstream* ss) {
           << " updated=" << dc_stats.updated()
           << " missed=" << dc_stats.missed()
           << std::endl;
+    if (dc_stats.queued_updates() > 0) {
+      (*ss) << "  writer:"
+            << " queued=" << dc_stats.queued_updates()
+            << " coalesced=" << dc_stats.coalesced_updates()
+            << " batches=" << dc_stats.applied_batches()
+            << " pendings=" << dc_stats.pending_updates()
+            << std::endl;
+    }
+  }
+  if (gstats.has_global_file_stat_cache_stats()) {
+    const FileStatCacheStats& fsc_stats =
+        gstats.global_file_stat_cache_stats();
+    (*ss) << "global_file_stat_cache:"
+          << " entries=" << fsc_stats.entries()
+          << " hit=" << fsc_stats.hit()
+          << " missed=" << fsc_stats.missed()
+          << " stale=" << fsc_stats.stale()
+          << " evicted=" << fsc_stats.evicted()
+          << std::endl;
+  }
+  if (gstats.has_file_content_pool_stats()) {
+    const FileContentPoolStats& fcp_stats = gstats.file_content_pool_stats();
+    (*ss) << "file_content_pool:"
+          << " entries=" << fcp_stats.entries()
+          << " bytes=" << fcp_stats.bytes()
+          << " put=" << fcp_stats.put()
+          << " hit=" << fcp_stats.hit()
+          << " hit_bytes=" << fcp_stats.hit_bytes()
+          << " missed=" << fcp_stats.missed()
+          << " stale=" << fcp_stats.stale()
+          << " evicted=" << fcp_stats.evicted()
+          << std::endl;
+  }
+  if (gstats.has_input_manifest_stats()) {
+    const InputManifestStats& im_stats = gstats.input_manifest_stats();
+    (*ss) << "input_manifest:"
+          << " applied=" << im_stats.applied()
+          << " created=" << im_stats.created()
+          << " missing=" << im_stats.missing()
+          << " saved_inputs=" << im_stats.saved_inputs()
+          << std::endl;
+  }
+  if (gstats.has_missing_input_stats()) {
+    const MissingInputStats& mi_stats = gstats.missing_input_stats();
+    (*ss) << "missing_input:"
+          << " requests=" << mi_stats.requests()
+          << " missing_input_responses=" << mi_stats.missing_input_responses();
+    if (mi_stats.requests() > 0) {
+      (*ss) << " ("
+            << (mi_stats.missing_input_responses() * 100.0 /
+                mi_stats.requests())
+            << "%)";
+    }
+    (*ss) << " missing_input_rpc_time_ms="
+          << mi_stats.missing_input_rpc_time_ms()
+          << " pushed_inputs=" << mi_stats.pushed_inputs()
+          << " saved_round_trips=" << mi_stats.saved_round_trips()
+          << " saved_rpc_time_ms=" << mi_stats.saved_rpc_time_ms()
+          << std::endl;
+  }
+  if (gstats.has_upload_scheduler_stats()) {
+    const UploadSchedulerStats& us_stats = gstats.upload_scheduler_stats();
+    (*ss) << "upload_scheduler:"
+          << " bytes_in_flight=" << us_stats.bytes_in_flight()
+          << "/" << us_stats.max_bytes_in_flight()
+          << " max_bytes_in_flight_seen="
+          << us_stats.max_bytes_in_flight_seen()
+          << " queued=" << us_stats.queued()
+          << " uploads=" << us_stats.uploads()
+          << " waited=" << us_stats.waited()
+          << " aged=" << us_stats.aged()
+          << " total_queue_wait_ms=" << us_stats.total_queue_wait_ms()
+          << " max_queue_wait_ms=" << us_stats.max_queue_wait_ms()
+          << std::endl;
   }
   if (gstats.has_local_output_cache_stats()) {
     const LocalOutputCacheStats& loc_stats = gstats.local_output_cache_stats();
@@ -865,6 +1102,17 @@ void CompileService::DumpStats(std::ostringstream* ss) {
         << " timeout=" << gstats.http_rpc_stats().timeout()
         << " error=" << gstats.http_rpc_stats().error()
         << std::endl;
+  if (gstats.http_rpc_stats().has_circuit_breaker()) {
+    const CircuitBreakerStats& cb_stats =
+        gstats.http_rpc_stats().circuit_breaker();
+    (*ss) << "circuit_breaker:"
+          << " state=" << cb_stats.state()
+          << " opened=" << cb_stats.opened()
+          << " closed=" << cb_stats.closed()
+          << " rejected=" << cb_stats.rejected()
+          << " probes=" << cb_stats.probes()
+          << std::endl;
+  }
 
   if (gstats.has_subprocess_stats()) {
     (*ss) << "burst_mode:"
@@ -1308,6 +1556,32 @@ bool CompileService::ContainFailedInput(
   return false;
 }
 
+void CompileService::RecordLocalRunCost(
+    const std::vector<std::string>& inputs, int64_t mem_kb) {
+  if (heavy_weight_local_memory_kb_ <= 0 || mem_kb <= 0) {
+    return;
+  }
+  AUTO_EXCLUSIVE_LOCK(lock, &heavy_inputs_mu_);
+  for (const auto& input : inputs) {
+    if (mem_kb >= heavy_weight_local_memory_kb_) {
+      heavy_inputs_.insert(input);
+    } else {
+      heavy_inputs_.erase(input);
+    }
+  }
+}
+
+bool CompileService::ContainHeavyInput(
+    const std::vector<std::string>& inputs) const {
+  AUTO_SHARED_LOCK(lock, &heavy_inputs_mu_);
+  for (const auto& input : inputs) {
+    if (heavy_inputs_.count(input)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 bool CompileService::AcquireOutputBuffer(size_t filesize, std::string* buf) {
   DCHECK_EQ(0U, buf->size());
 
@@ -1596,6 +1870,8 @@ void CompileService::DumpCommonStatsUnlocked(GomaStats* stats) {
         num_forced_fallback_in_setup_[kRequestedByUser]);
     fallback->set_failed_to_update_required_files(
         num_forced_fallback_in_setup_[kFailToUpdateRequiredFiles]);
+    fallback->set_circuit_breaker_open(
+        num_forced_fallback_in_setup_[kCircuitBreakerOpen]);
     FileStats* files = stats->mutable_file_stats();
     files->set_requested(num_file_requested_);
     files->set_uploaded(num_file_uploaded_);
@@ -1623,6 +1899,23 @@ void CompileService::DumpCommonStatsUnlocked(GomaStats* stats) {
       processor->set_total_run_time(
           absl::ToInt64Milliseconds(include_processor_total_run_time_));
     }
+    {
+      CpuTimeStats* cpu_time = stats->mutable_cpu_time_stats();
+      cpu_time->set_include_processor(
+          absl::ToInt64Milliseconds(include_processor_total_cpu_time_));
+      cpu_time->set_input_file(
+          absl::ToInt64Milliseconds(input_file_total_cpu_time_));
+      cpu_time->set_rpc_req_build(
+          absl::ToInt64Milliseconds(rpc_req_build_total_cpu_time_));
+      cpu_time->set_rpc_resp_parse(
+          absl::ToInt64Milliseconds(rpc_resp_parse_total_cpu_time_));
+      cpu_time->set_output_file(
+          absl::ToInt64Milliseconds(output_file_total_cpu_time_));
+      cpu_time->set_total(absl::ToInt64Milliseconds(
+          include_processor_total_cpu_time_ + input_file_total_cpu_time_ +
+          rpc_req_build_total_cpu_time_ + rpc_resp_parse_total_cpu_time_ +
+          output_file_total_cpu_time_));
+    }
     if (IncludeCache::IsEnabled()) {
       IncludeCache::instance()->DumpStatsToProto(
           stats->mutable_includecache_stats());
@@ -1630,6 +1923,33 @@ void CompileService::DumpCommonStatsUnlocked(GomaStats* stats) {
     if (DepsCache::IsEnabled()) {
       DepsCache::instance()->DumpStatsToProto(stats->mutable_depscache_stats());
     }
+    if (GlobalFileStatCache::Instance() != nullptr) {
+      GlobalFileStatCache::Instance()->DumpStatsToProto(
+          stats->mutable_global_file_stat_cache_stats());
+    }
+    if (FileContentPool::Instance() != nullptr) {
+      FileContentPool::Instance()->DumpStatsToProto(
+          stats->mutable_file_content_pool_stats());
+    }
+    if (input_manifest_cache_ != nullptr) {
+      input_manifest_cache_->DumpStatsToProto(
+          stats->mutable_input_manifest_stats());
+    }
+    if (upload_scheduler_ != nullptr) {
+      upload_scheduler_->DumpStatsToProto(
+          stats->mutable_upload_scheduler_stats());
+    }
+    if (missing_input_predictor_ != nullptr) {
+      missing_input_predictor_->DumpStatsToProto(
+          stats->mutable_missing_input_stats());
+    }
+    {
+      AdaptivePoolStats pool_stats;
+      if (wm_->DumpAdaptivePoolStatsToProto(include_processor_pool_,
+                                            &pool_stats)) {
+        *stats->mutable_include_processor_pool_stats() = pool_stats;
+      }
+    }
     if (LocalOutputCache::IsEnabled()) {
       LocalOutputCache::instance()->DumpStatsToProto(
           stats->mutable_local_output_cache_stats());
@@ -1675,6 +1995,24 @@ void CompileService::DumpCommonStatsUnlocked(GomaStats* stats) {
         num_subprogram_mismatch);
 }
 
+void CompileService::DumpOpenMetrics(std::string* out) const {
+  CompilerProxyMetrics::ServiceStats service_stats;
+  {
+    AUTOLOCK(lock, &mu_);
+    service_stats.num_requests = num_exec_request_;
+    service_stats.num_goma_cache_hits = num_exec_goma_cache_hit_;
+    service_stats.num_local_cache_hits = num_exec_goma_local_cache_hit_;
+    service_stats.num_active_tasks = active_tasks_.size();
+    service_stats.num_pending_tasks = pending_tasks_.size();
+  }
+  if (upload_scheduler_ != nullptr) {
+    service_stats.num_queued_uploads = upload_scheduler_->num_queued();
+    service_stats.upload_bytes_in_flight =
+        upload_scheduler_->bytes_in_flight();
+  }
+  metrics_->AppendOpenMetrics(service_stats, out);
+}
+
 void CompileService::DumpStatsToFile(const std::string& filename) {
   GomaStats stats;
   {
@@ -40,7 +40,9 @@ class BlobClient;
 class CompileTask;
 class CompilerFlags;
 class CompilerProxyHistogram;
+class CompilerProxyMetrics;
 class ExecReq;
+class ExecReqRecorder;
 class ExecResp;
 class ExecServiceClient;
 class FileServiceBlobClient;
@@ -49,9 +51,12 @@ class FileHashCache;
 class GomaStats;
 class HttpClient;
 class HttpRPC;
+class InputManifestCache;
+class MissingInputPredictor;
 class LogServiceClient;
 class MultiFileStore;
 class RpcController;
+class UploadScheduler;
 
 // CompileService provides ExecService API in compiler proxy.
 // It is proxy to goma service's ExecService API and FileService API, which is
@@ -73,6 +78,7 @@ class CompileService {
     kCompilerDisabled,
     kRequestedByUser,
     kFailToUpdateRequiredFiles,
+    kCircuitBreakerOpen,
 
     kNumForcedFallbackReasonInSetup,
   };
@@ -135,14 +141,44 @@ class CompileService {
     return multi_file_store_.get();
   }
 
+  // |upload_scheduler| must be set before SetFileServiceHttpClient.
+  void SetUploadScheduler(std::unique_ptr<UploadScheduler> upload_scheduler);
+  UploadScheduler* upload_scheduler() const {
+    return upload_scheduler_.get();
+  }
+
   void SetFileServiceHttpClient(
       std::unique_ptr<FileServiceHttpClient> file_service);
   BlobClient* blob_client() const;
 
   FileHashCache* file_hash_cache() const { return file_hash_cache_.get(); }
+
+  // |input_manifest_cache| is nullptr if input manifest is disabled.
+  void SetInputManifestCache(
+      std::unique_ptr<InputManifestCache> input_manifest_cache);
+  InputManifestCache* input_manifest_cache() const {
+    return input_manifest_cache_.get();
+  }
+  // |missing_input_predictor| is nullptr if likely missing inputs are not
+  // pushed.
+  void SetMissingInputPredictor(
+      std::unique_ptr<MissingInputPredictor> missing_input_predictor);
+  MissingInputPredictor* missing_input_predictor() const {
+    return missing_input_predictor_.get();
+  }
+  // |exec_req_recorder| is nullptr if ExecReqs are not recorded.
+  void SetExecReqRecorder(std::unique_ptr<ExecReqRecorder> exec_req_recorder);
+  ExecReqRecorder* exec_req_recorder() const {
+    return exec_req_recorder_.get();
+  }
   CompilerProxyHistogram* histogram() const { return histogram_.get(); }
 
-  void StartIncludeProcessorWorkers(int num_threads);
+  // Starts |num_threads| include processor threads. If |min_threads| is
+  // positive and less than |num_threads|, the number of active threads is
+  // tuned between them every |tune_period|.
+  void StartIncludeProcessorWorkers(int num_threads,
+                                    int min_threads,
+                                    absl::Duration tune_period);
   int include_processor_pool() const { return include_processor_pool_; }
 
   void SetLogServiceClient(
@@ -238,6 +274,9 @@ class CompileService {
   bool local_run_for_failed_input() const {
     return local_run_for_failed_input_;
   }
+  void SetHeavyWeightLocalMemoryKb(int64_t heavy_weight_local_memory_kb) {
+    heavy_weight_local_memory_kb_ = heavy_weight_local_memory_kb;
+  }
   void SetLocalRunDelay(absl::Duration local_run_delay) {
     local_run_delay_ = local_run_delay;
   }
@@ -309,10 +348,15 @@ class CompileService {
 
   bool DumpTask(int task_id, std::string* out);
   bool DumpTaskRequest(int task_id, std::string* message);
-  // Dump the tasks whose state is active or frozen time stamp is after |after|.
-  void DumpToJson(Json::Value* json, absl::Time after);
+  // Dumps active, long and retained tasks frozen after |after| in JSON, with
+  // counters, to |*out|. If |limit| is positive, at most |limit| oldest
+  // finished and failed tasks are dumped, and "last_update_ms" can be used
+  // as next |after| to get the rest.
+  void DumpTasksJson(absl::Time after, int limit, std::string* out);
   void DumpStats(std::ostringstream* ss);
   void DumpStatsToFile(const std::string& filename);
+  // Appends metrics in OpenMetrics text format to |*out|.
+  void DumpOpenMetrics(std::string* out) const;
   // Dump stats in json form (converted from GomaStatzStats).
   void DumpStatsJson(std::string* json_string, HumanReadability human_readable);
   Json::Value DumpRbeStats() const;
@@ -362,6 +406,13 @@ class CompileService {
   // before.
   bool ContainFailedInput(const std::vector<std::string>& inputs) const;
 
+  // Records peak anonymous memory of a local run for inputs.
+  void RecordLocalRunCost(const std::vector<std::string>& inputs,
+                          int64_t mem_kb);
+  // Returns true if RecordLocalRunCost recorded any of inputs as using
+  // heavy_weight_local_memory_kb or more before.
+  bool ContainHeavyInput(const std::vector<std::string>& inputs) const;
+
   void SetMaxSumOutputSize(size_t size) ABSL_LOCKS_EXCLUDED(buf_mu_) {
     AUTO_EXCLUSIVE_LOCK(lock, &buf_mu_);
     max_sum_output_size_ = size;
@@ -451,6 +502,11 @@ class CompileService {
   absl::flat_hash_set<std::string> failed_inputs_
       ABSL_GUARDED_BY(failed_inputs_mu_);
 
+  // CompileTask's input whose local run used much memory.
+  mutable ReadWriteLock heavy_inputs_mu_;
+  absl::flat_hash_set<std::string> heavy_inputs_
+      ABSL_GUARDED_BY(heavy_inputs_mu_);
+
   // TODO: add thread annotations to others.
   mutable ReadWriteLock id_mu_;
   std::string oauth2_email_ ABSL_GUARDED_BY(id_mu_);
@@ -467,6 +523,7 @@ class CompileService {
 
   std::unique_ptr<ExecServiceClient> exec_service_client_;
   std::unique_ptr<MultiFileStore> multi_file_store_;
+  std::unique_ptr<UploadScheduler> upload_scheduler_;
   std::unique_ptr<BlobClient> blob_client_;
 
   std::unique_ptr<CompilerTypeSpecificCollection>
@@ -480,12 +537,17 @@ class CompileService {
       compiler_info_waiters_ ABSL_GUARDED_BY(compiler_info_mu_);
 
   std::unique_ptr<FileHashCache> file_hash_cache_;
+  std::unique_ptr<InputManifestCache> input_manifest_cache_;
+  std::unique_ptr<MissingInputPredictor> missing_input_predictor_;
+  std::unique_ptr<ExecReqRecorder> exec_req_recorder_;
 
   int include_processor_pool_;
 
   std::unique_ptr<LogServiceClient> log_service_client_;
 
   std::unique_ptr<CompilerProxyHistogram> histogram_;
+  // Unlike histogram_, metrics_ is lock-free and not reset.
+  std::unique_ptr<CompilerProxyMetrics> metrics_;
 
   std::unique_ptr<Watchdog> watchdog_;
 
@@ -513,6 +575,8 @@ class CompileService {
   int max_subprocs_pending_ = 0;
   int local_run_preference_ = 0;
   bool local_run_for_failed_input_ = false;
+  // 0 disables RecordLocalRunCost.
+  int64_t heavy_weight_local_memory_kb_ = 0;
   absl::Duration local_run_delay_;
   bool store_local_run_output_ = false;
   bool should_fail_for_unsupported_compiler_flag_ = false;
@@ -573,6 +637,13 @@ class CompileService {
   absl::Duration include_processor_total_wait_time_;
   absl::Duration include_processor_total_run_time_;
 
+  // Sum of CPU time of finished tasks.
+  absl::Duration include_processor_total_cpu_time_;
+  absl::Duration input_file_total_cpu_time_;
+  absl::Duration rpc_req_build_total_cpu_time_;
+  absl::Duration rpc_resp_parse_total_cpu_time_;
+  absl::Duration output_file_total_cpu_time_;
+
   size_t cur_sum_output_size_ ABSL_GUARDED_BY(buf_mu_) = 0;
   size_t max_sum_output_size_ ABSL_GUARDED_BY(buf_mu_) = 0;
   size_t req_sum_output_size_ ABSL_GUARDED_BY(buf_mu_) = 0;
@@ -13,6 +13,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "google/protobuf/util/time_util.h"
+#include "json_writer.h"
 #include "task/output_file_task.h"
 #include "time_util.h"
 #include "util.h"
@@ -203,6 +204,10 @@ void CompileStats::AddStatsFromHttpStatus(const HttpClient::Status& status) {
     exec_log.add_rpc_wait_time(DurationToIntMs(status.wait_time));
     exec_log.add_rpc_resp_recv_time(DurationToIntMs(status.resp_recv_time));
     exec_log.add_rpc_resp_parse_time(DurationToIntMs(status.resp_parse_time));
+    exec_log.add_rpc_req_build_cpu_time(
+        DurationToIntMs(status.req_build_cpu_time));
+    exec_log.add_rpc_resp_parse_cpu_time(
+        DurationToIntMs(status.resp_parse_cpu_time));
 
     this->total_rpc_throttle_time += status.throttle_time;
     this->total_rpc_pending_time += status.pending_time;
@@ -211,6 +216,8 @@ void CompileStats::AddStatsFromHttpStatus(const HttpClient::Status& status) {
     this->total_rpc_wait_time += status.wait_time;
     this->total_rpc_resp_recv_time += status.resp_recv_time;
     this->total_rpc_resp_parse_time += status.resp_parse_time;
+    this->total_rpc_req_build_cpu_time += status.req_build_cpu_time;
+    this->total_rpc_resp_parse_cpu_time += status.resp_parse_cpu_time;
   }
 }
 
@@ -236,6 +243,15 @@ void CompileStats::AddStatsFromOutputFileTask(const OutputFileTask& task) {
   output_file_rpc_resp_parse_time += http_status.resp_parse_time;
   output_file_rpc_size += http_status.resp_size;
   output_file_rpc_raw_size += http_status.raw_resp_size;
+
+  output_file_cpu_time += task.cpu_time();
+  exec_log.set_output_file_cpu_time(DurationToIntMs(output_file_cpu_time));
+}
+
+absl::Duration CompileStats::TotalCpuTime() const {
+  return include_processor_cpu_time + input_file_cpu_time +
+         total_rpc_req_build_cpu_time + total_rpc_resp_parse_cpu_time +
+         output_file_cpu_time;
 }
 
 void CompileStats::DumpToJson(Json::Value* json,
@@ -376,6 +392,18 @@ void CompileStats::DumpToJson(Json::Value* json,
     StoreDurationToJsonIfNotZero("rbe_execution_time",
                                  this->total_rbe_execution_time, json);
 
+    StoreDurationToJsonIfNotZero("cpu_time", TotalCpuTime(), json);
+    StoreDurationToJsonIfNotZero("include_processor_cpu_time",
+                                 this->include_processor_cpu_time, json);
+    StoreDurationToJsonIfNotZero("input_file_cpu_time",
+                                 this->input_file_cpu_time, json);
+    StoreDurationToJsonIfNotZero("exec_req_build_cpu_time",
+                                 this->total_rpc_req_build_cpu_time, json);
+    StoreDurationToJsonIfNotZero("exec_resp_parse_cpu_time",
+                                 this->total_rpc_resp_parse_cpu_time, json);
+    StoreDurationToJsonIfNotZero("output_file_cpu_time",
+                                 this->output_file_cpu_time, json);
+
     StoreArrayToJsonIfNotEmpty("exec_request_retry_reason",
                                exec_log.exec_request_retry_reason().begin(),
                                exec_log.exec_request_retry_reason().end(),
@@ -386,6 +414,52 @@ void CompileStats::DumpToJson(Json::Value* json,
   }
 }
 
+void CompileStats::WriteSummaryJson(JsonWriter* writer) const {
+  auto write_string_if_not_empty = [writer](absl::string_view key,
+                                            absl::string_view value) {
+    if (!value.empty()) {
+      writer->Key(key);
+      writer->String(value);
+    }
+  };
+  auto write_int_if_not_zero = [writer](absl::string_view key, int value) {
+    if (value) {
+      writer->Key(key);
+      writer->Int(value);
+    }
+  };
+
+  if (handler_time != absl::ZeroDuration()) {
+    writer->Key("duration");
+    writer->String(FormatDurationInMilliseconds(handler_time));
+  }
+  if (LocalCacheHit()) {
+    writer->Key("cache");
+    writer->String("local hit");
+  } else if (exec_log.cache_hit()) {
+    writer->Key("cache");
+    writer->String("hit");
+  }
+  write_string_if_not_empty("major_factor", GetMajorFactorInfo());
+  write_string_if_not_empty("command_version_mismatch",
+                            exec_log.exec_command_version_mismatch());
+  write_string_if_not_empty("command_binary_hash_mismatch",
+                            exec_log.exec_command_binary_hash_mismatch());
+  write_string_if_not_empty("command_subprograms_mismatch",
+                            exec_log.exec_command_subprograms_mismatch());
+  write_int_if_not_zero("exit", exec_log.exec_exit_status());
+  write_int_if_not_zero("retry", exec_log.exec_request_retry());
+  // DumpToJson stores booleans as "true".
+  if (exec_log.goma_error()) {
+    writer->Key("goma_error");
+    writer->String("true");
+  }
+  if (exec_log.compiler_proxy_error()) {
+    writer->Key("compiler_proxy_error");
+    writer->String("true");
+  }
+}
+
 void CompileStats::StoreStatsInExecResp(ExecResp* resp) const {
   resp->set_compiler_proxy_include_preproc_time(
       absl::ToDoubleSeconds(this->include_preprocess_time));
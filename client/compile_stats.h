@@ -24,6 +24,7 @@ class Value;
 namespace devtools_goma {
 
 class ExecResp;
+class JsonWriter;
 class OutputFileTask;
 
 class CompileStats {
@@ -53,6 +54,9 @@ class CompileStats {
   // determines the number of fields dumped -- more detailed means more fields
   // are dumped into |*json|.
   void DumpToJson(Json::Value* json, DumpDetailLevel detail_level) const;
+  // Writes the same members as DumpToJson with kNotDetailed to |*writer|,
+  // which must be in an object.
+  void WriteSummaryJson(JsonWriter* writer) const;
 
   // Sets various fields in |*resp| based on CompileStats values.
   void StoreStatsInExecResp(ExecResp* resp) const;
@@ -122,6 +126,19 @@ class CompileStats {
   absl::Duration total_local_output_file_time;
   absl::Duration local_delay_time;
 
+  // CPU time consumed by compiler_proxy threads for this task, measured
+  // with ThreadCpuTimer around closures run for the task.
+  // Unlike the durations above, these don't include time waiting for
+  // locks, I/O or other threads.
+  absl::Duration include_processor_cpu_time;
+  absl::Duration input_file_cpu_time;
+  absl::Duration total_rpc_req_build_cpu_time;
+  absl::Duration total_rpc_resp_parse_cpu_time;
+  absl::Duration output_file_cpu_time;
+
+  // Returns sum of the CPU times above.
+  absl::Duration TotalCpuTime() const;
+
   // Returns the name of the compile task component that took the most time,
   // and how much time it took and the percentage of the overall time. If all
   // durations were zero, returns an empty string.
@@ -11,6 +11,7 @@
 #include "absl/time/time.h"
 #include "gtest/gtest.h"
 #include "json_util.h"
+#include "json_writer.h"
 #include "time_util.h"
 #include "util.h"
 
@@ -615,6 +616,63 @@ TEST(CompileStatsTest, DumpToJsonDetailedDurations) {
   EXPECT_EQ("1.8 s", json_string_values["output_file_rpc_resp_parse_time"]);
 }
 
+TEST(CompileStatsTest, AddStatsFromHttpStatusCpuTime) {
+  HttpClient::Status status1;
+  status1.req_build_cpu_time = absl::Milliseconds(10);
+  status1.resp_parse_cpu_time = absl::Milliseconds(20);
+  HttpClient::Status status2;
+  status2.req_build_cpu_time = absl::Milliseconds(30);
+  status2.resp_parse_cpu_time = absl::Milliseconds(40);
+
+  CompileStats stats;
+  stats.AddStatsFromHttpStatus(status1);
+  stats.AddStatsFromHttpStatus(status2);
+
+  ASSERT_EQ(stats.exec_log.rpc_req_build_cpu_time().size(), 2);
+  ASSERT_EQ(stats.exec_log.rpc_resp_parse_cpu_time().size(), 2);
+  EXPECT_EQ(10, stats.exec_log.rpc_req_build_cpu_time()[0]);
+  EXPECT_EQ(20, stats.exec_log.rpc_resp_parse_cpu_time()[0]);
+  EXPECT_EQ(30, stats.exec_log.rpc_req_build_cpu_time()[1]);
+  EXPECT_EQ(40, stats.exec_log.rpc_resp_parse_cpu_time()[1]);
+
+  EXPECT_EQ(absl::Milliseconds(40), stats.total_rpc_req_build_cpu_time);
+  EXPECT_EQ(absl::Milliseconds(60), stats.total_rpc_resp_parse_cpu_time);
+  EXPECT_EQ(absl::Milliseconds(100), stats.TotalCpuTime());
+}
+
+TEST(CompileStatsTest, DumpToJsonDetailedCpuTime) {
+  CompileStats stats;
+  stats.include_processor_cpu_time = absl::Milliseconds(100);
+  stats.input_file_cpu_time = absl::Milliseconds(200);
+  stats.total_rpc_req_build_cpu_time = absl::Milliseconds(300);
+  stats.total_rpc_resp_parse_cpu_time = absl::Milliseconds(400);
+  stats.output_file_cpu_time = absl::Milliseconds(500);
+
+  Json::Value json;
+  stats.DumpToJson(&json, CompileStats::DumpDetailLevel::kDetailed);
+
+  const std::map<std::string, std::string> kExpected = {
+      {"cpu_time", "1.5 s"},
+      {"include_processor_cpu_time", "100 ms"},
+      {"input_file_cpu_time", "200 ms"},
+      {"exec_req_build_cpu_time", "300 ms"},
+      {"exec_resp_parse_cpu_time", "400 ms"},
+      {"output_file_cpu_time", "500 ms"},
+  };
+  for (const auto& expected : kExpected) {
+    std::string value, error_message;
+    EXPECT_TRUE(GetStringFromJson(json, expected.first, &value,
+                                  &error_message))
+        << error_message;
+    EXPECT_EQ(expected.second, value) << expected.first;
+  }
+
+  // CPU time is not in the summary.
+  Json::Value summary;
+  stats.DumpToJson(&summary, CompileStats::DumpDetailLevel::kNotDetailed);
+  EXPECT_FALSE(summary.isMember("cpu_time"));
+}
+
 TEST(CompileStatsTest, DumpToJsonDepsCacheUsed) {
   CompileStats stats;
   stats.exec_log.set_depscache_used(true);
@@ -793,6 +851,29 @@ TEST(CompileStatsTest, DumpToJsonEndStats) {
   EXPECT_EQ("/dev/null", cwd);
 }
 
+TEST(CompileStatsTest, WriteSummaryJson) {
+  auto stats = CreateStatsForTest();
+  stats.exec_log.set_cache_hit(true);
+  stats.exec_log.set_exec_command_version_mismatch("clang 1 vs 2");
+  stats.exec_log.set_exec_exit_status(1);
+  stats.exec_log.set_exec_request_retry(2);
+  stats.exec_log.set_goma_error(true);
+
+  Json::Value expected;
+  stats.DumpToJson(&expected, CompileStats::DumpDetailLevel::kNotDetailed);
+
+  std::string out;
+  JsonWriter writer(&out);
+  writer.BeginObject();
+  stats.WriteSummaryJson(&writer);
+  writer.EndObject();
+
+  Json::Reader reader;
+  Json::Value json;
+  ASSERT_TRUE(reader.parse(out, json)) << out;
+  EXPECT_EQ(expected, json) << out;
+}
+
 TEST(CompileStatsTest, StoreStatsInExecRespEmpty) {
   CompileStats stats;
 
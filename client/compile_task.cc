@@ -45,6 +45,7 @@
 #include "compiler_type_specific_collection.h"
 #include "cxx/include_processor/cpp_include_processor.h"
 #include "cxx/include_processor/include_file_utils.h"
+#include "file_compare.h"
 #include "file_data_output.h"
 #include "file_dir.h"
 #include "file_hash_cache.h"
@@ -63,8 +64,10 @@
 #include "ioutil.h"
 #include "java/jar_parser.h"
 #include "java_flags.h"
+#include "json_writer.h"
 #include "local_output_cache.h"
 #include "lockhelper.h"
+#include "missing_input_predictor.h"
 #include "multi_http_rpc.h"
 #include "mypath.h"
 #include "options.h"
@@ -99,19 +102,6 @@ namespace {
 
 constexpr int kMaxExecRetry = 4;
 
-std::string GetLastErrorMessage() {
-  char error_message[1024];
-#ifndef _WIN32
-  // Meaning of returned value of strerror_r is different between
-  // XSI and GNU. Need to ignore.
-  (void)strerror_r(errno, error_message, sizeof(error_message));
-#else
-  FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM, 0, GetLastError(), 0,
-                 error_message, sizeof error_message, 0);
-#endif
-  return error_message;
-}
-
 bool IsFatalError(ExecResp::ExecError error_code) {
   return error_code == ExecResp::BAD_REQUEST;
 }
@@ -176,6 +166,8 @@ void ReleaseMemoryForExecReqInput(ExecReq* req) {
   ExecReq new_req;
   new_req.Swap(req);
   new_req.clear_input();
+  new_req.clear_removed_input();
+  new_req.clear_input_manifest();
   *req = new_req;
 }
 
@@ -369,6 +361,15 @@ void CompileTask::Init(RpcController* rpc,
   InitCompilerFlags();
 }
 
+void CompileTask::StartExecReqRecord(absl::Duration time_offset,
+                                     const ExecReq& req) {
+  CHECK_EQ(INIT, state_);
+  exec_req_record_ = absl::make_unique<ExecReqRecord>();
+  exec_req_record_->set_time_offset_usec(
+      absl::ToInt64Microseconds(time_offset));
+  *exec_req_record_->mutable_req() = req;
+}
+
 void CompileTask::Start() {
   VLOG(1) << trace_id_ << " start";
   CHECK_EQ(INIT, state_);
@@ -528,6 +529,18 @@ void CompileTask::Start() {
     // we don't call goma rpc.
     return;
   }
+  if (!service_->http_client()->CircuitBreakerAllows()) {
+    // The backend keeps failing. Don't spend CPU on include processing,
+    // hashing and uploading for a remote compile that would fail.
+    VLOG(1) << trace_id_ << " circuit breaker open";
+    should_fallback_ = true;
+    service_->RecordForcedFallbackInSetup(
+        CompileService::kCircuitBreakerOpen);
+    SetupSubProcess();
+    RunSubProcess("circuit breaker open");
+    // we don't call goma rpc.
+    return;
+  }
   if (flags_->is_precompiling_header() && service_->enable_gch_hack()) {
     VLOG(1) << trace_id_ << " gch hack";
     SetupSubProcess();
@@ -735,7 +748,12 @@ void CompileTask::ProcessFileRequest() {
 
   // TODO: We don't need to clear the input when we are retrying.
   req_->clear_input();
+  req_->clear_input_manifest_hash_key();
+  req_->clear_removed_input();
+  req_->clear_input_manifest();
+  input_manifest_.reset();
   interleave_uploaded_files_.clear();
+  num_pushed_inputs_ = 0;
   SetInputFileCallback();
   std::vector<OneshotClosure*> closures;
   const absl::Time now = absl::Now();
@@ -797,6 +815,18 @@ void CompileTask::ProcessFileRequest() {
       stats_->exec_log.set_latest_input_filename(abs_filename);
       stats_->exec_log.set_latest_input_mtime(absl::ToTimeT(*mtime));
     }
+    // Send the content of an input likely missing in the server now,
+    // rather than after the server reported it missing.
+    bool push_content = false;
+    if (hash_key_is_ok && !missed_content &&
+        service_->missing_input_predictor() != nullptr &&
+        service_->missing_input_predictor()->ShouldPush(abs_filename,
+                                                        hash_key)) {
+      VLOG(1) << trace_id_ << " push likely missing:" << abs_filename;
+      push_content = true;
+      hash_key_is_ok = false;
+      ++num_pushed_inputs_;
+    }
     if (hash_key_is_ok) {
       input->set_hash_key(hash_key);
       continue;
@@ -826,8 +856,8 @@ void CompileTask::ProcessFileRequest() {
         service_->blob_client()->NewUploader(abs_filename, requester_info_,
                                              trace_id_),
         service_->file_hash_cache(), input_file_stat_cache_->Get(abs_filename),
-        abs_filename, missed_content, flags_->is_linking(), is_new_file,
-        hash_key, this, input);
+        abs_filename, missed_content || push_content, flags_->is_linking(),
+        is_new_file, hash_key, this, input);
     closures.push_back(
         NewCallback(
             input_file_task,
@@ -1040,7 +1070,8 @@ void CompileTask::ProcessCallExec() {
     return;
   }
   CHECK(!requester_env_.verify_command().empty() ||
-        req_->input_size() > 0) << trace_id_ << " call exec";
+        req_->input_size() > 0 || req_->has_input_manifest_hash_key())
+      << trace_id_ << " call exec";
   state_ = CALL_EXEC;
   if (ShouldStopGoma()) {
     state_ = LOCAL_RUN;
@@ -1069,6 +1100,25 @@ void CompileTask::ProcessCallExec() {
 
   ModifyRequestCWDAndPWD();
 
+  if (exec_req_record_ != nullptr && exec_req_record_->input_size() == 0) {
+    // Records inputs before they are moved to the input manifest.
+    for (const auto& input : req_->input()) {
+      ExecReqRecord::Input* record_input = exec_req_record_->add_input();
+      record_input->set_filename(input.filename());
+      record_input->set_hash_key(input.hash_key());
+    }
+  }
+
+  if (service_->input_manifest_cache() != nullptr &&
+      input_manifest_ == nullptr && !input_manifest_disabled_) {
+    input_manifest_ = service_->input_manifest_cache()->Apply(req_.get());
+    if (input_manifest_ != nullptr) {
+      VLOG(1) << trace_id_ << " input manifest:" << input_manifest_->hash_key()
+              << " inputs=" << req_->input_size()
+              << " removed=" << req_->removed_input_size();
+    }
+  }
+
   service_->exec_service_client()->ExecAsync(
       req_.get(), exec_resp_.get(), http_rpc_status_.get(),
       NewCallback(this, &CompileTask::ProcessCallExecDone));
@@ -1188,6 +1238,9 @@ void CompileTask::ProcessCallExecDone() {
       AddErrorToResponse(TO_LOG, error_message, false);
     }
   }
+  if (err == OK && RetryForInputManifest()) {
+    return;
+  }
   if (err == OK && resp_->missing_input_size() > 0) {
     // missing input will be handled in ProcessFileResponse and
     // ProcessFileRequest will retry the request with uploading
@@ -1261,6 +1314,11 @@ void CompileTask::ProcessCallExecDone() {
   // Saves embedded upload information. We have to call this before
   // clearing inputs.
   StoreEmbeddedUploadInformationIfNeeded();
+  if (service_->missing_input_predictor() != nullptr) {
+    service_->missing_input_predictor()->RecordResponse(
+        flags_->cwd(), *req_, *resp_, num_pushed_inputs_ > 0,
+        rpc_call_timer_duration);
+  }
 
   ReleaseMemoryForExecReqInput(req_.get());
 
@@ -1271,6 +1329,43 @@ void CompileTask::ProcessCallExecDone() {
   ProcessFileResponse();
 }
 
+bool CompileTask::RetryForInputManifest() {
+  InputManifestCache* input_manifest_cache = service_->input_manifest_cache();
+  if (input_manifest_cache == nullptr) {
+    return false;
+  }
+  input_manifest_cache->UpdateServerSupport(*resp_);
+  if (input_manifest_ == nullptr) {
+    return false;
+  }
+  if (resp_->input_manifest_supported() && !resp_->input_manifest_missing()) {
+    input_manifest_->set_acknowledged(true);
+    return false;
+  }
+  if (resp_->input_manifest_missing() && !req_->has_input_manifest()) {
+    LOG(INFO) << trace_id_ << " input manifest missing:"
+              << input_manifest_->hash_key();
+    input_manifest_cache->HandleMissing(input_manifest_.get(), req_.get());
+  } else {
+    // The server doesn't know manifest any more, or can't store it.
+    LOG(WARNING) << trace_id_ << " input manifest not accepted:"
+                 << input_manifest_->hash_key()
+                 << " supported=" << resp_->input_manifest_supported()
+                 << " missing=" << resp_->input_manifest_missing();
+    InputManifestCache::Restore(*input_manifest_, req_.get());
+    input_manifest_.reset();
+    input_manifest_disabled_ = true;
+  }
+  resp_->Clear();
+  state_ = FILE_REQ;
+  service_->wm()->RunClosureInThread(
+      FROM_HERE,
+      thread_id_,
+      NewCallback(this, &CompileTask::ProcessCallExec),
+      WorkerThread::PRIORITY_LOW);
+  return true;
+}
+
 void CompileTask::ProcessFileResponse() {
   VLOG(1) << trace_id_ << " file resp";
   CHECK(BelongsToCurrentThread());
@@ -1432,6 +1527,15 @@ void CompileTask::ProcessFileResponse() {
               << " filename=" << filename
               << " mode=" << std::oct << output_info->mode;
     }
+    if (!verify_output_ && !output_info->tmp_filename.empty()) {
+      // Remote output won't be visible until CommitOutput, even if it is
+      // written to filename directly.
+      // VerifyOutput reads tmp_filename, so it is not used for verify_output.
+      output_info->pending_output = absl::make_unique<PendingFileOutput>(
+          filename, output_info->tmp_filename, output_info->mode,
+          output_info->size);
+      VLOG(1) << trace_id_ << " output in pending file:" << filename;
+    }
     std::unique_ptr<OutputFileTask> output_file_task(new OutputFileTask(
         service_->wm(),
         service_->blob_client()->NewDownloader(requester_info_, trace_id_),
@@ -1786,9 +1890,11 @@ struct CompileTask::ContentOutputParam {
 void CompileTask::ContentOutputCallback(ContentOutputParam* param,
                                         std::string* err) {
   err->clear();
-  remove(param->filename.c_str());
-  std::unique_ptr<FileDataOutput> fout(
-      FileDataOutput::NewFileOutput(param->filename, param->info->mode));
+  // If unnamed file is not available, it removes and writes in filename
+  // directly.
+  PendingFileOutput pending(param->filename, param->filename,
+                            param->info->mode, param->info->content.size());
+  std::unique_ptr<FileDataOutput> fout(pending.NewFileDataOutput());
   if (!fout->IsValid()) {
     std::ostringstream ss;
     ss << "open for write error:" << param->filename;
@@ -1801,6 +1907,25 @@ void CompileTask::ContentOutputCallback(ContentOutputParam* param,
     *err = ss.str();
     return;
   }
+  fout.reset();
+  if (!pending.Commit()) {
+    std::ostringstream ss;
+    ss << "commit error:" << param->filename << " errno=" << errno;
+    *err = ss.str();
+    return;
+  }
+}
+
+void CompileTask::PendingOutputCallback(PendingFileOutput* output,
+                                        std::string* err) {
+  err->clear();
+  if (output->Commit()) {
+    return;
+  }
+  std::ostringstream ss;
+  ss << "commit error:" << output->path() << " " << output->filename()
+     << " errno=" << errno;
+  *err = ss.str();
 }
 
 #ifdef _WIN32
@@ -2001,11 +2126,11 @@ void CompileTask::CommitOutput(bool use_remote) {
       VLOG(1) << trace_id_ << " commit output (use local) in "
               << filename;
       if (access(filename.c_str(), R_OK) == 0) {
-        if (need_rename) {
+        if (need_rename || info.pending_output) {
           // We might have written tmp file for remote output, but decided
           // to use local output.
           // In this case, we want to remove tmp file of remote output.
-          remove(tmp_filename.c_str());
+          RemoveTmpOutput(&info);
         }
       } else {
         // !use_remote, but local output doesn't exist?
@@ -2038,16 +2163,39 @@ void CompileTask::CommitOutput(bool use_remote) {
       // need_rename is true, we wrote remote output in
       // tmp_filename, and we need to rename tmp_filename
       // to filename.
-      VLOG(1) << trace_id_ << " commit output (use remote tmp file) "
-              << "rename " << tmp_filename << " => " << filename;
-      RenameParam param;
-      param.oldpath = tmp_filename;
-      param.newpath = filename;
+      if (info.pending_output) {
+        VLOG(1) << trace_id_ << " commit output (use remote pending file) "
+                << info.pending_output->path() << " => " << filename;
+        std::string err;
+        std::unique_ptr<PermanentClosure> callback(
+            NewPermanentCallback(
+                this, &CompileTask::PendingOutputCallback,
+                info.pending_output.get(), &err));
+        DoOutput("commit", filename, callback.get(), &err);
+      } else {
+        VLOG(1) << trace_id_ << " commit output (use remote tmp file) "
+                << "rename " << tmp_filename << " => " << filename;
+        RenameParam param;
+        param.oldpath = tmp_filename;
+        param.newpath = filename;
+        std::string err;
+        std::unique_ptr<PermanentClosure> callback(
+            NewPermanentCallback(
+               this, &CompileTask::RenameCallback, &param, &err));
+        DoOutput("rename", filename, callback.get(), &err);
+      }
+    } else if (info.pending_output) {
+      // If use_remote is true, use_content is false, and
+      // need_rename is false, we wrote remote output for filename in
+      // pending file, so publish it at filename.
+      VLOG(1) << trace_id_ << " commit output (use remote pending file) "
+              << info.pending_output->path() << " => " << filename;
       std::string err;
       std::unique_ptr<PermanentClosure> callback(
           NewPermanentCallback(
-             this, &CompileTask::RenameCallback, &param, &err));
-      DoOutput("rename", filename, callback.get(), &err);
+              this, &CompileTask::PendingOutputCallback,
+              info.pending_output.get(), &err));
+      DoOutput("commit", filename, callback.get(), &err);
     } else {
       // If use_remote is true, use_content is false, and
       // need_rename is false, we wrote remote output in
@@ -2446,6 +2594,68 @@ void CompileTask::DumpToJson(bool need_detail, Json::Value* root) const {
   }
 }
 
+void CompileTask::WriteSummaryJson(JsonWriter* writer) const {
+  SubProcessState::State subproc_state = SubProcessState::NUM_STATE;
+  pid_t subproc_pid = static_cast<pid_t>(SubProcessState::kInvalidPid);
+  {
+    AUTOLOCK(lock, &mu_);
+    if (subproc_ != nullptr) {
+      subproc_state = subproc_->state();
+      subproc_pid = subproc_->started().pid();
+    }
+  }
+
+  writer->BeginObject();
+  stats_->WriteSummaryJson(writer);
+  writer->Key("id");
+  writer->Int(id_);
+  if ((state_ < FINISHED && !abort_) || state_ == LOCAL_RUN) {
+    writer->Key("elapsed");
+    writer->String(FormatDurationInMilliseconds(handler_timer_.GetDuration()));
+  }
+  if (gomacc_pid_ != SubProcessState::kInvalidPid) {
+    writer->Key("pid");
+    writer->Int(gomacc_pid_);
+  }
+  if (!flag_dump_.empty()) {
+    writer->Key("command");
+    writer->String(flag_dump_);
+  }
+  writer->Key("state");
+  writer->String(StateName(state_));
+  if (abort_) {
+    writer->Key("abort");
+    writer->Int(1);
+  }
+  if (subproc_pid != static_cast<pid_t>(SubProcessState::kInvalidPid)) {
+    writer->Key("subproc_state");
+    writer->String(SubProcessState::State_Name(subproc_state));
+    writer->Key("subproc_pid");
+    writer->Int(subproc_pid);
+  }
+  if (response_code_) {
+    writer->Key("http_status");
+    writer->Int(response_code_);
+  }
+  if (fail_fallback_) {
+    writer->Key("fail_fallback");
+    writer->Int(1);
+  }
+  if (canceled_) {
+    writer->Key("canceled");
+    writer->Int(1);
+  }
+  if (replied_) {
+    writer->Key("replied");
+    writer->Int(1);
+  }
+  if (gomacc_revision_mismatched_) {
+    writer->Key("gomacc_revision_mismatch");
+    writer->Int(1);
+  }
+  writer->EndObject();
+}
+
 // ----------------------------------------------------------------
 // state_: INIT
 void CompileTask::CopyEnvFromRequest() {
@@ -2617,6 +2827,9 @@ SubProcessReq::Weight CompileTask::GetTaskWeight() const {
 
   if (weight_score > 1000)
     return SubProcessReq::HEAVY_WEIGHT;
+  // Previous local run of the input used much memory.
+  if (service_->ContainHeavyInput(flags_->input_filenames()))
+    return SubProcessReq::HEAVY_WEIGHT;
   return SubProcessReq::LIGHT_WEIGHT;
 }
 
@@ -3165,6 +3378,10 @@ void CompileTask::ModifyRequestCWDAndPWD() {
   if (!service_->enable_cwd_normalization()) {
     return;
   }
+  // Inputs were already checked before they were moved to the manifest.
+  if (input_manifest_ != nullptr) {
+    return;
+  }
 
   const char fixed_cwd[] =
 #ifdef _WIN32
@@ -3393,6 +3610,7 @@ void CompileTask::RunIncludeProcessor(
       << " in " << stats_->include_processor_wait_time;
 
   SimpleTimer include_timer(SimpleTimer::START);
+  ThreadCpuTimer include_cpu_timer;
   CompilerTypeSpecific::IncludeProcessorResult result =
       compiler_type_specific_->RunIncludeProcessor(
           trace_id_, *flags_, compiler_info_state_.get()->info(),
@@ -3401,6 +3619,11 @@ void CompileTask::RunIncludeProcessor(
   stats_->exec_log.set_include_processor_run_time(
       DurationToIntMs(include_processor_run_time));
   stats_->include_processor_run_time = include_processor_run_time;
+  const absl::Duration include_processor_cpu_time =
+      include_cpu_timer.GetDuration();
+  stats_->exec_log.set_include_processor_cpu_time(
+      DurationToIntMs(include_processor_cpu_time));
+  stats_->include_processor_cpu_time = include_processor_cpu_time;
 
   auto response_param = absl::make_unique<IncludeProcessorResponseParam>();
   response_param->result = std::move(result);
@@ -3463,9 +3686,9 @@ void CompileTask::RunIncludeProcessorDone(
         file::JoinPathRespectAbsolute(flags_->cwd(), input_filename);
 
     DepsCache* dc = DepsCache::instance();
-    if (!dc->SetDependencies(deps_identifier_, flags_->cwd(),
-                             abs_input_filename, required_files_,
-                             input_file_stat_cache_.get())) {
+    if (!dc->SetDependenciesAsync(deps_identifier_, flags_->cwd(),
+                                  abs_input_filename, required_files_,
+                                  input_file_stat_cache_.get())) {
       LOG(INFO) << trace_id_ << " failed to save dependencies.";
     }
   }
@@ -3495,6 +3718,10 @@ void CompileTask::InputFileTaskFinished(InputFileTask* input_file_task) {
   CHECK(BelongsToCurrentThread());
   CHECK_EQ(FILE_REQ, state_);
 
+  stats_->input_file_cpu_time += input_file_task->CpuTimeForTask(this);
+  stats_->exec_log.set_input_file_cpu_time(
+      DurationToIntMs(stats_->input_file_cpu_time));
+
   if (abort_) {
     VLOG(1) << trace_id_ << "aborted ";
     input_file_success_ = false;
@@ -4013,61 +4240,18 @@ bool CompileTask::VerifyOutput(const std::string& local_output_path,
   CHECK_EQ(FILE_RESP, state_);
   LOG(INFO) << trace_id_ << " Verify Output: "
             << " local:" << local_output_path << " goma:" << goma_output_path;
-  std::ostringstream error_message;
-  static const int kSize = 1024;
-  char local_buf[kSize];
-  char goma_buf[kSize];
-  ScopedFd local_fd(ScopedFd::OpenForRead(local_output_path));
-  if (!local_fd.valid()) {
-    error_message << "Not found: local file:" << local_output_path;
-    AddErrorToResponse(TO_USER, error_message.str(), true);
-    return false;
-  }
-  ScopedFd goma_fd(ScopedFd::OpenForRead(goma_output_path));
-  if (!goma_fd.valid()) {
-    error_message << "Not found: goma file:" << goma_output_path;
+  FileDiff diff;
+  if (!CompareFileContents(local_output_path, goma_output_path, &diff)) {
+    std::ostringstream error_message;
+    error_message << (diff.error.empty() ? "output mismatch: "
+                                         : "verify error: ")
+                  << " local:" << local_output_path
+                  << " goma:" << goma_output_path << " " << diff.Summary();
     AddErrorToResponse(TO_USER, error_message.str(), true);
     return false;
   }
-  int local_len;
-  int goma_len;
-  for (size_t len = 0; ; len += local_len) {
-    local_len = local_fd.Read(local_buf, kSize);
-    if (local_len < 0) {
-      error_message << "read error local:" << local_output_path
-                    << " @" << len << " " << GetLastErrorMessage();
-      AddErrorToResponse(TO_USER, error_message.str(), true);
-      return false;
-    }
-    goma_len = goma_fd.Read(goma_buf, kSize);
-    if (goma_len < 0) {
-      error_message << "read error goma:" << goma_output_path
-                    << " @" << len << " " << GetLastErrorMessage();
-      AddErrorToResponse(TO_USER, error_message.str(), true);
-      return false;
-    }
-    if (local_len != goma_len) {
-      error_message << "read len: " << local_len << "!=" << goma_len
-                    << " " << local_output_path << " @" << len;
-      AddErrorToResponse(TO_USER, error_message.str(), true);
-      return false;
-    }
-    if (local_len == 0) {
-      LOG(INFO) << trace_id_
-                << " Verify OK: " << local_output_path
-                << " size=" << len;
-      return true;
-    }
-    if (memcmp(local_buf, goma_buf, local_len) != 0) {
-      error_message << "output mismatch: "
-                    << " local:" << local_output_path
-                    << " goma:" << goma_output_path
-                    << " @[" << len << "," <<  local_len << ")";
-      AddErrorToResponse(TO_USER, error_message.str(), true);
-      return false;
-    }
-    VLOG(2) << trace_id_ << " len:" << len << "+" << local_len;
-  }
+  LOG(INFO) << trace_id_ << " Verify OK: " << local_output_path
+            << " size=" << diff.size_a;
   return true;
 }
 
@@ -4083,13 +4267,22 @@ void CompileTask::ClearOutputFile() {
     // and local run might have output to the file.
     const std::string& filename = info.filename;
     const std::string& tmp_filename = info.tmp_filename;
-    if (!tmp_filename.empty() && tmp_filename != filename) {
-      remove(tmp_filename.c_str());
+    if (info.pending_output ||
+        (!tmp_filename.empty() && tmp_filename != filename)) {
+      RemoveTmpOutput(&info);
     }
   }
   output_file_infos_.clear();
 }
 
+void CompileTask::RemoveTmpOutput(OutputFileInfo* info) {
+  if (info->pending_output) {
+    info->pending_output->Discard();
+    return;
+  }
+  remove(info->tmp_filename.c_str());
+}
+
 // ----------------------------------------------------------------
 // local run finished.
 void CompileTask::SetLocalOutputFileCallback() {
@@ -4274,6 +4467,7 @@ void CompileTask::SetupSubProcess() {
 #endif
 
   req->set_weight(subproc_weight_);
+  req->set_verify_output(verify_output_);
   subproc_->Start(
       NewCallback(
           this,
@@ -4336,6 +4530,8 @@ void CompileTask::FinishSubProcess() {
             << " pending_ms=" << subproc->started().pending_ms()
             << " run_ms=" << subproc->terminated().run_ms()
             << " mem_kb=" << subproc->terminated().mem_kb()
+            << " cpu_time_us=" << subproc->terminated().cpu_time_us()
+            << " memory_peak_kb=" << subproc->terminated().memory_peak_kb()
             << " local_killed=" << local_killed_;
 
   bool local_run_failed = false;
@@ -4366,6 +4562,22 @@ void CompileTask::FinishSubProcess() {
     stats_->local_run_time = absl::Milliseconds(subproc->terminated().run_ms());
 
     stats_->exec_log.set_local_mem_kb(subproc->terminated().mem_kb());
+    if (subproc->terminated().has_cpu_time_us()) {
+      stats_->exec_log.set_local_cpu_time(
+          subproc->terminated().cpu_time_us() / 1000);
+    }
+    if (subproc->terminated().has_memory_peak_kb()) {
+      stats_->exec_log.set_local_memory_peak_kb(
+          subproc->terminated().memory_peak_kb());
+    }
+    // Max RSS without cgroup is not a good measure of memory pressure, as
+    // it includes shared file mappings, so only cgroup's anonymous memory
+    // is recorded.
+    if (!local_killed_ && flags_.get() != nullptr &&
+        subproc->terminated().has_memory_anon_peak_kb()) {
+      service_->RecordLocalRunCost(flags_->input_filenames(),
+                                   subproc->terminated().memory_anon_peak_kb());
+    }
     VLOG(1) << trace_id_ << " subproc finished"
             << " pid=" << subproc->started().pid();
   } else {
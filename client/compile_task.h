@@ -29,6 +29,7 @@
 #include "goma_blob.h"
 #include "gtest/gtest_prod.h"
 #include "http_rpc.h"
+#include "input_manifest.h"
 #include "simple_timer.h"
 #include "subprocess_task.h"
 #include "threadpool_http_server.h"
@@ -49,6 +50,7 @@ class CompileService;
 class CompilerFlags;
 class CompilerProxyHistogram;
 class InputFileTask;
+class JsonWriter;
 class LocalOutputFileTask;
 class OutputFileTask;
 class RpcController;
@@ -119,6 +121,8 @@ class CompileTask {
   CommandSpec DumpCommandSpec() const;
 
   void DumpToJson(bool need_detail, Json::Value* root) const;
+  // Writes the same object as DumpToJson without detail to |*writer|.
+  void WriteSummaryJson(JsonWriter* writer) const;
 
   // DumpRequest is called on finished task.
   // A return value contains a message to show on a browser.
@@ -138,11 +142,21 @@ class CompileTask {
 
   absl::Duration ElapsedTime() const { return handler_timer_.GetDuration(); }
 
+  // Starts recording |req| received at |time_offset| for ExecReqRecorder.
+  // Called after Init() if CompileService has ExecReqRecorder.
+  void StartExecReqRecord(absl::Duration time_offset, const ExecReq& req);
+  // Returns the record started by StartExecReqRecord, with the inputs of
+  // the first ExecReq sent to the server. Called when the task is done.
+  std::unique_ptr<ExecReqRecord> ReleaseExecReqRecord() {
+    return std::move(exec_req_record_);
+  }
+
  private:
   FRIEND_TEST(CompileTaskTest, DumpToJsonWithUnsuccessfulStart);
   FRIEND_TEST(CompileTaskTest, DumpToJsonWithValidCallToServer);
   FRIEND_TEST(CompileTaskTest, DumpToJsonWithHTTPErrorCode);
   FRIEND_TEST(CompileTaskTest, DumpToJsonWithDone);
+  FRIEND_TEST(CompileTaskTest, WriteSummaryJson);
   FRIEND_TEST(CompileTaskTest, UpdateStatsFinished);
   FRIEND_TEST(CompileTaskTest, UpdateStatsFinishedCacheHit);
   FRIEND_TEST(CompileTaskTest, UpdateStatsLocalFinished);
@@ -250,6 +264,7 @@ class CompileTask {
                 std::string* err);
   void RenameCallback(RenameParam* param, std::string* err);
   void ContentOutputCallback(ContentOutputParam* param, std::string* err);
+  void PendingOutputCallback(PendingFileOutput* output, std::string* err);
 
   // If file is coff file, rewrite timestamp to the current time.
   void RewriteCoffTimestamp(const std::string& filename);
@@ -308,6 +323,9 @@ class CompileTask {
   // Methods used in state_: CALL_EXEC
   void CheckCommandSpec();
   void CheckNoMatchingCommandSpec(const std::string& retry_reason);
+  // Returns true if the request is resent because the server did not accept
+  // |input_manifest_|.
+  bool RetryForInputManifest();
   void StoreEmbeddedUploadInformationIfNeeded();
 
   // Methods used in state_: FILE_RESP
@@ -319,6 +337,8 @@ class CompileTask {
   bool VerifyOutput(const std::string& local_output_path,
                     const std::string& goma_output_path);
   void ClearOutputFile();
+  // Removes remote output written in other than output filename.
+  void RemoveTmpOutput(OutputFileInfo* info);
 
   // Methods used in state_: fail_fallback_, LOCAL_FINISHED or abort_
   // (after local run finished)
@@ -415,6 +435,17 @@ class CompileTask {
   std::vector<std::string> system_library_paths_;
   // list of interleave uploaded files_to confirm the mechanism works fine.
   absl::flat_hash_set<std::string> interleave_uploaded_files_;
+  // Number of inputs in |req_| whose contents were sent because they were
+  // likely missing in the server.
+  int num_pushed_inputs_ = 0;
+
+  // Input manifest |req_| refers to, if any.
+  std::shared_ptr<InputManifestCache::Manifest> input_manifest_;
+  // true if the server failed to use the input manifest for this task.
+  bool input_manifest_disabled_ = false;
+
+  // Non-null if ExecReqs are recorded.
+  std::unique_ptr<ExecReqRecord> exec_req_record_;
 
   std::unique_ptr<ExecResp> resp_;
   std::unique_ptr<ExecResp> exec_resp_;
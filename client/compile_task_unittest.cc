@@ -19,6 +19,7 @@
 #include "glog/logging.h"
 #include "gtest/gtest.h"
 #include "json_util.h"
+#include "json_writer.h"
 #include "lib/goma_data.pb.h"
 #include "rpc_controller.h"
 #include "threadpool_http_server.h"
@@ -328,6 +329,25 @@ TEST_F(CompileTaskTest, DumpToJsonWithDone) {
   EXPECT_NE(0, replied);
 }
 
+TEST_F(CompileTaskTest, WriteSummaryJson) {
+  compile_task()->state_ = CompileTask::FINISHED;
+  compile_task()->rpc_ = nullptr;
+  compile_task()->rpc_resp_ = nullptr;
+  compile_task()->Done();
+
+  Json::Value expected;
+  compile_task()->DumpToJson(false, &expected);
+
+  std::string out;
+  JsonWriter writer(&out);
+  compile_task()->WriteSummaryJson(&writer);
+
+  Json::Reader reader;
+  Json::Value json;
+  ASSERT_TRUE(reader.parse(out, json)) << out;
+  EXPECT_EQ(expected, json) << out;
+}
+
 TEST_F(CompileTaskTest, UpdateStatsFinished) {
   // Force-set |state_| to enable UpdateStats() to run.
   compile_task()->state_ = CompileTask::FINISHED;
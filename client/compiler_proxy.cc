@@ -42,6 +42,7 @@
 #include "cxx/include_processor/include_cache.h"
 #include "cxx/include_processor/include_file_finder.h"
 #include "deps_cache.h"
+#include "file_content_pool.h"
 #include "glog/logging.h"
 #include "goma_init.h"
 #include "ioutil.h"
@@ -160,7 +161,7 @@ void InitTrustedIps(TrustedIpsManager* trustedipsmanager) {
   }
 }
 
-void DepsCacheInit() {
+void DepsCacheInit(WorkerThreadManager* wm) {
   std::string cache_filename;
   if (!FLAGS_DEPS_CACHE_FILE.empty()) {
     cache_filename = file::JoinPathRespectAbsolute(GetCacheDirectory(),
@@ -175,6 +176,9 @@ void DepsCacheInit() {
           absl::nullopt,
       FLAGS_DEPS_CACHE_TABLE_THRESHOLD,
       FLAGS_DEPS_CACHE_MAX_PROTO_SIZE_IN_MB);
+  if (DepsCache::instance() != nullptr && FLAGS_DEPS_CACHE_ASYNC_UPDATE) {
+    DepsCache::instance()->StartWriter(wm);
+  }
 }
 
 }  // anonymous namespace
@@ -194,7 +198,17 @@ int main(int argc, char* argv[], const char* envp[]) {
 #endif
 
   if (FLAGS_ENABLE_GLOBAL_FILE_STAT_CACHE) {
-    devtools_goma::GlobalFileStatCache::Init();
+    devtools_goma::GlobalFileStatCache::Init(
+        std::max(FLAGS_GLOBAL_FILE_STAT_CACHE_MAX_ENTRIES, 0),
+        FLAGS_GLOBAL_FILE_STAT_CACHE_TTL_SEC > 0
+            ? absl::Seconds(FLAGS_GLOBAL_FILE_STAT_CACHE_TTL_SEC)
+            : absl::InfiniteDuration());
+  }
+
+  if (FLAGS_FILE_CONTENT_POOL_SIZE_MB > 0) {
+    devtools_goma::FileContentPool::Init(
+        static_cast<size_t>(FLAGS_FILE_CONTENT_POOL_SIZE_MB) * 1024 * 1024,
+        absl::Seconds(FLAGS_FILE_CONTENT_POOL_TTL_SEC));
   }
 
   const std::string tmpdir = FLAGS_TMP_DIR;
@@ -301,6 +315,23 @@ int main(int argc, char* argv[], const char* envp[]) {
   subproc_options.max_subprocs_low_priority = FLAGS_MAX_SUBPROCS_LOW;
   subproc_options.max_subprocs_heavy_weight = FLAGS_MAX_SUBPROCS_HEAVY;
   subproc_options.dont_kill_subprocess = FLAGS_DONT_KILL_SUBPROCESS;
+  subproc_options.cgroup.root = FLAGS_CGROUP_ROOT;
+  {
+    using devtools_goma::CgroupTree;
+    CgroupTree::Options& cgroup = subproc_options.cgroup;
+    cgroup.limits[CgroupTree::kNormal].memory_high =
+        int64_t{FLAGS_CGROUP_MEMORY_HIGH_MB} * 1024 * 1024;
+    cgroup.limits[CgroupTree::kLowPriority].memory_high =
+        int64_t{FLAGS_CGROUP_LOW_PRIORITY_MEMORY_HIGH_MB} * 1024 * 1024;
+    cgroup.limits[CgroupTree::kLowPriority].cpu_weight =
+        FLAGS_CGROUP_LOW_PRIORITY_WEIGHT;
+    cgroup.limits[CgroupTree::kLowPriority].io_weight =
+        FLAGS_CGROUP_LOW_PRIORITY_WEIGHT;
+    cgroup.limits[CgroupTree::kVerify].memory_high =
+        int64_t{FLAGS_CGROUP_VERIFY_MEMORY_HIGH_MB} * 1024 * 1024;
+    cgroup.limits[CgroupTree::kVerify].cpu_weight = FLAGS_CGROUP_VERIFY_WEIGHT;
+    cgroup.limits[CgroupTree::kVerify].io_weight = FLAGS_CGROUP_VERIFY_WEIGHT;
+  }
 
   devtools_goma::SubProcessController::Initialize(argv[0], subproc_options);
 
@@ -332,7 +363,7 @@ int main(int argc, char* argv[], const char* envp[]) {
   devtools_goma::modulemap::Cache::Init(FLAGS_MAX_MODULEMAP_CACHE_ENTRIES);
   devtools_goma::ListDirCache::Init(FLAGS_MAX_LIST_DIR_CACHE_ENTRY_NUM);
 
-  devtools_goma::DepsCacheInit();
+  devtools_goma::DepsCacheInit(&wm);
   std::unique_ptr<devtools_goma::WorkerThreadRunner> load_deps_cache(
       new devtools_goma::WorkerThreadRunner(
           &wm, FROM_HERE,
@@ -436,6 +467,9 @@ int main(int argc, char* argv[], const char* envp[]) {
   if (FLAGS_ENABLE_GLOBAL_FILE_STAT_CACHE) {
     devtools_goma::GlobalFileStatCache::Quit();
   }
+  if (devtools_goma::FileContentPool::Instance() != nullptr) {
+    devtools_goma::FileContentPool::Quit();
+  }
 
 #if HAVE_COUNTERZ
   if (FLAGS_ENABLE_COUNTERZ) {
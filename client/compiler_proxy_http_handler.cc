@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 #include "compiler_proxy_http_handler.h"
 
+#include <algorithm>
 #include <sstream>
 
 #include "absl/container/flat_hash_set.h"
@@ -29,6 +30,8 @@
 #include "cxx/include_processor/cpp_include_processor.h"
 #include "cxx/include_processor/cpp_macro.h"
 #include "cxx/include_processor/include_cache.h"
+#include "exec_req_recorder.h"
+#include "file_content_pool.h"
 #include "file_hash_cache.h"
 #include "file_helper.h"
 #include "goma_file_http.h"
@@ -36,6 +39,7 @@
 #include "http_init.h"
 #include "http_rpc.h"
 #include "http_rpc_init.h"
+#include "input_manifest.h"
 #include "ioutil.h"
 #include "java/jarfile_reader.h"
 #include "jquery.min.h"
@@ -43,6 +47,7 @@
 #include "linker/linker_input_processor/arfile_reader.h"
 #include "log_cleaner.h"
 #include "log_service_client.h"
+#include "missing_input_predictor.h"
 #include "multi_http_rpc.h"
 #include "mypath.h"
 #include "oauth2_token.h"
@@ -50,6 +55,7 @@
 #include "rand_util.h"
 #include "rpc_controller.h"
 #include "subprocess_controller_client.h"
+#include "upload_scheduler.h"
 #include "util.h"
 
 #if HAVE_HEAP_PROFILER
@@ -193,6 +199,15 @@ CompilerProxyHttpHandler::CompilerProxyHttpHandler(std::string myname,
   LOG_IF(ERROR, FLAGS_NETWORK_ERROR_THRESHOLD_PERCENT >= 100)
       << "GOMA_NETWORK_ERROR_THRESHOLD_PERCENT must be less than 100: "
       << FLAGS_NETWORK_ERROR_THRESHOLD_PERCENT;
+  http_options.enable_circuit_breaker = FLAGS_CIRCUIT_BREAKER;
+  http_options.circuit_breaker.failure_threshold_percent =
+      FLAGS_CIRCUIT_BREAKER_FAILURE_THRESHOLD_PERCENT;
+  if (FLAGS_CIRCUIT_BREAKER_SLOW_RESPONSE_SEC > 0) {
+    http_options.circuit_breaker.slow_response_threshold =
+        absl::Seconds(FLAGS_CIRCUIT_BREAKER_SLOW_RESPONSE_SEC);
+  }
+  http_options.circuit_breaker.open_duration =
+      absl::Seconds(std::max(1, FLAGS_CIRCUIT_BREAKER_OPEN_DURATION_SEC));
   if (FLAGS_BACKEND_SOFT_STICKINESS) {
     std::string cookie;
     if (FLAGS_BACKEND_SOFT_STICKINESS_REFRESH) {
@@ -250,15 +265,26 @@ CompilerProxyHttpHandler::CompilerProxyHttpHandler(std::string myname,
       absl::Milliseconds(FLAGS_MULTI_STORE_PENDING_MS);
   service_.SetMultiFileStore(absl::make_unique<MultiFileStore>(
       service_.http_rpc(), "/s", multi_store_options, wm));
+  if (FLAGS_UPLOAD_MAX_BYTES_IN_FLIGHT > 0) {
+    service_.SetUploadScheduler(absl::make_unique<UploadScheduler>(
+        FLAGS_UPLOAD_MAX_BYTES_IN_FLIGHT,
+        absl::Milliseconds(FLAGS_UPLOAD_MAX_QUEUE_WAIT_MS)));
+  }
   service_.SetFileServiceHttpClient(absl::make_unique<FileServiceHttpClient>(
-      service_.http_rpc(), "/s", "/l", service_.multi_file_store()));
+      service_.http_rpc(), "/s", "/l", service_.multi_file_store(),
+      service_.upload_scheduler()));
   if (FLAGS_PROVIDE_INFO)
     service_.SetLogServiceClient(absl::make_unique<LogServiceClient>(
         service_.http_rpc(), "/sl", FLAGS_NUM_LOG_IN_SAVE_LOG,
         absl::Milliseconds(FLAGS_LOG_PENDING_MS), wm));
   ArFileReader::Register();
   JarFileReader::Register();
-  service_.StartIncludeProcessorWorkers(FLAGS_INCLUDE_PROCESSOR_THREADS);
+  if (FileContentPool::Instance() != nullptr) {
+    FileContentPool::RegisterFileReader();
+  }
+  service_.StartIncludeProcessorWorkers(
+      FLAGS_INCLUDE_PROCESSOR_THREADS, FLAGS_INCLUDE_PROCESSOR_MIN_THREADS,
+      absl::Milliseconds(FLAGS_INCLUDE_PROCESSOR_TUNE_PERIOD_MS));
   service_.SetNeedToSendContent(FLAGS_COMPILER_PROXY_STORE_FILE);
   service_.SetNewFileThresholdDuration(
       absl::Seconds(FLAGS_COMPILER_PROXY_NEW_FILE_THRESHOLD));
@@ -269,6 +295,18 @@ CompilerProxyHttpHandler::CompilerProxyHttpHandler(std::string myname,
   service_.SetSendCompilerBinaryAsInput(FLAGS_SEND_COMPILER_BINARY_AS_INPUT);
   service_.SetUseUserSpecifiedPathForSubprograms(
       FLAGS_USE_USER_SPECIFIED_PATH_FOR_SUBPROGRAMS);
+  if (FLAGS_USE_INPUT_MANIFEST) {
+    service_.SetInputManifestCache(absl::make_unique<InputManifestCache>(
+        std::max(FLAGS_INPUT_MANIFEST_MAX_MANIFESTS, 1)));
+  }
+  if (FLAGS_LIKELY_MISSING_INPUT_WINDOW_SEC > 0) {
+    service_.SetMissingInputPredictor(absl::make_unique<MissingInputPredictor>(
+        absl::Seconds(FLAGS_LIKELY_MISSING_INPUT_WINDOW_SEC)));
+  }
+  if (!FLAGS_EXEC_REQ_RECORD_FILE.empty()) {
+    service_.SetExecReqRecorder(
+        ExecReqRecorder::Create(FLAGS_EXEC_REQ_RECORD_FILE));
+  }
   if (FLAGS_HERMETIC == "off") {
     service_.SetHermetic(false);
   } else if (FLAGS_HERMETIC == "fallback") {
@@ -286,6 +324,8 @@ CompilerProxyHttpHandler::CompilerProxyHttpHandler(std::string myname,
   service_.SetMaxSubProcsPending(FLAGS_MAX_SUBPROCS_PENDING);
   service_.SetLocalRunPreference(FLAGS_LOCAL_RUN_PREFERENCE);
   service_.SetLocalRunForFailedInput(FLAGS_LOCAL_RUN_FOR_FAILED_INPUT);
+  service_.SetHeavyWeightLocalMemoryKb(
+      int64_t{FLAGS_HEAVY_WEIGHT_LOCAL_MEMORY_MB} * 1024);
   service_.SetLocalRunDelay(absl::Milliseconds(FLAGS_LOCAL_RUN_DELAY_MSEC));
   service_.SetMaxSumOutputSize(FLAGS_MAX_SUM_OUTPUT_SIZE_IN_MB * 1024 * 1024);
   service_.SetStoreLocalRunOutput(FLAGS_STORE_LOCAL_RUN_OUTPUT);
@@ -387,12 +427,16 @@ CompilerProxyHttpHandler::CompilerProxyHttpHandler(std::string myname,
       "/compilerz", &CompilerProxyHttpHandler::HandleCompilerzRequest));
   http_handlers_.insert(std::make_pair(
       "/histogramz", &CompilerProxyHttpHandler::HandleHistogramRequest));
+  http_handlers_.insert(std::make_pair(
+      "/metricz", &CompilerProxyHttpHandler::HandleMetricsRequest));
   http_handlers_.insert(std::make_pair(
       "/httprpcz", &CompilerProxyHttpHandler::HandleHttpRpcRequest));
   http_handlers_.insert(std::make_pair(
       "/threadz", &CompilerProxyHttpHandler::HandleThreadRequest));
   http_handlers_.insert(std::make_pair(
       "/contentionz", &CompilerProxyHttpHandler::HandleContentionRequest));
+  http_handlers_.insert(std::make_pair(
+      "/lockwaitz", &CompilerProxyHttpHandler::HandleLockWaitRequest));
   http_handlers_.insert(std::make_pair(
       "/filecachez", &CompilerProxyHttpHandler::HandleFileCacheRequest));
   http_handlers_.insert(std::make_pair(
@@ -951,15 +995,18 @@ int CompilerProxyHttpHandler::HandleTaskRequest(
     after_ms = _atoi64(after_str.c_str());
 #endif
   }
+  int limit = 0;
+  p = params.find("limit");
+  if (p != params.end()) {
+    limit = atoi(p->second.c_str());
+  }
   OutputOkHeader("application/json", &ss);
-  Json::Value json;
+  *response = ss.str();
   // We don't want to use an optional time value in case |after_ms| == 0.
-  // DumpToJson looks for all tasks frozen after the second parameter. If
+  // DumpTasksJson looks for all tasks frozen after the first parameter. If
   // |after_ms| == 0, then it looks for all frozen timestamps, and we can
   // treat |after_ms| as the Unix Epoch time rather than as undefined.
-  service_.DumpToJson(&json, absl::FromUnixMillis(after_ms));
-  ss << json;
-  *response = ss.str();
+  service_.DumpTasksJson(absl::FromUnixMillis(after_ms), limit, response);
   return 200;
 }
 
@@ -1040,6 +1087,19 @@ int CompilerProxyHttpHandler::HandleHistogramRequest(
   return 200;
 }
 
+int CompilerProxyHttpHandler::HandleMetricsRequest(
+    const HttpServerRequest& /* request */,
+    std::string* response) {
+  // Written directly to |*response| instead of std::ostringstream, since
+  // this is scraped frequently.
+  response->assign(
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: application/openmetrics-text; version=1.0.0; "
+      "charset=utf-8\r\n\r\n");
+  service_.DumpOpenMetrics(response);
+  return 200;
+}
+
 int CompilerProxyHttpHandler::HandleHttpRpcRequest(
     const HttpServerRequest& /* request */,
     std::string* response) {
@@ -1097,6 +1157,36 @@ int CompilerProxyHttpHandler::HandleContentionRequest(
   return 200;
 }
 
+int CompilerProxyHttpHandler::HandleLockWaitRequest(
+    const HttpServerRequest& request,
+    std::string* response) {
+  std::ostringstream ss;
+  OutputOkHeader("text/plain", &ss);
+  if (g_lock_wait_graph) {
+    bool dot = false;
+    for (const auto& s : absl::StrSplit(request.query(), '&')) {
+      if (s == "format=dot") {
+        dot = true;
+      }
+    }
+    if (dot) {
+      g_lock_wait_graph->DotReport(&ss);
+    } else {
+      g_lock_wait_graph->TextReport(&ss);
+    }
+  } else {
+#ifdef NO_AUTOLOCK_STAT
+    ss << "disabled (built with NO_AUTOLOCK_STAT)";
+#else
+    ss << "disabled.  to turn on lockwaitz, "
+       << "GOMA_LOCK_WAIT_GRAPH_SAMPLE_RATE=<N> with "
+       << "GOMA_ENABLE_CONTENTIONZ=true";
+#endif
+  }
+  *response = ss.str();
+  return 200;
+}
+
 int CompilerProxyHttpHandler::HandleFileCacheRequest(
     const HttpServerRequest& /* request */,
     std::string* response) {
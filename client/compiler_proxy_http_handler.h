@@ -119,6 +119,9 @@ class CompilerProxyHttpHandler : public ThreadpoolHttpServer::HttpHandler,
   int HandleHistogramRequest(const HttpServerRequest& request,
                              std::string* response);
 
+  int HandleMetricsRequest(const HttpServerRequest& /* request */,
+                           std::string* response);
+
   int HandleHttpRpcRequest(const HttpServerRequest& /* request */,
                            std::string* response);
 
@@ -128,6 +131,9 @@ class CompilerProxyHttpHandler : public ThreadpoolHttpServer::HttpHandler,
   int HandleContentionRequest(const HttpServerRequest& request,
                               std::string* response);
 
+  int HandleLockWaitRequest(const HttpServerRequest& request,
+                            std::string* response);
+
   int HandleFileCacheRequest(const HttpServerRequest& /* request */,
                              std::string* response);
 
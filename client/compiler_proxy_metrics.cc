@@ -0,0 +1,179 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "compiler_proxy_metrics.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "compile_stats.h"
+#include "glog/logging.h"
+
+namespace devtools_goma {
+
+namespace {
+
+struct Bucket {
+  int64_t le_usec;
+  const char* le;
+};
+
+// The last bucket is +Inf.
+constexpr Bucket kBuckets[LatencyHistogram::kNumBuckets - 1] = {
+    {100, "0.0001"},       {250, "0.00025"},     {500, "0.0005"},
+    {750, "0.00075"},      {1000, "0.001"},      {2500, "0.0025"},
+    {5000, "0.005"},       {7500, "0.0075"},     {10000, "0.01"},
+    {25000, "0.025"},      {50000, "0.05"},      {75000, "0.075"},
+    {100000, "0.1"},       {250000, "0.25"},     {500000, "0.5"},
+    {750000, "0.75"},      {1000000, "1.0"},     {2500000, "2.5"},
+    {5000000, "5.0"},      {7500000, "7.5"},     {10000000, "10.0"},
+    {25000000, "25.0"},    {50000000, "50.0"},   {75000000, "75.0"},
+    {100000000, "100.0"},  {250000000, "250.0"}, {500000000, "500.0"},
+    {750000000, "750.0"},
+};
+
+// Appends |usec| as seconds with microsecond precision.
+void AppendSeconds(int64_t usec, std::string* out) {
+  absl::StrAppend(out, usec / 1000000, ".",
+                  absl::Dec(usec % 1000000, absl::kZeroPad6));
+}
+
+void AppendCounter(absl::string_view name,
+                   absl::string_view help,
+                   int64_t value,
+                   std::string* out) {
+  absl::StrAppend(out, "# TYPE ", name, " counter\n", "# HELP ", name, " ",
+                  help, "\n", name, "_total ", value, "\n");
+}
+
+void AppendGauge(absl::string_view name,
+                 absl::string_view help,
+                 int64_t value,
+                 std::string* out) {
+  absl::StrAppend(out, "# TYPE ", name, " gauge\n", "# HELP ", name, " ",
+                  help, "\n", name, " ", value, "\n");
+}
+
+}  // namespace
+
+void LatencyHistogram::Add(absl::Duration duration) {
+  const int64_t usec = std::max<int64_t>(
+      0, absl::ToInt64Microseconds(duration));
+  const Bucket* bucket = std::lower_bound(
+      std::begin(kBuckets), std::end(kBuckets), usec,
+      [](const Bucket& b, int64_t v) { return b.le_usec < v; });
+  buckets_[bucket - std::begin(kBuckets)].fetch_add(
+      1, std::memory_order_relaxed);
+  sum_usec_.fetch_add(usec, std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::count() const {
+  int64_t count = 0;
+  for (const auto& bucket : buckets_) {
+    count += bucket.load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+/* static */
+absl::string_view LatencyHistogram::BucketLabel(size_t i) {
+  DCHECK_LT(i, kNumBuckets);
+  if (i == kNumBuckets - 1) {
+    return "+Inf";
+  }
+  return kBuckets[i].le;
+}
+
+void LatencyHistogram::AppendOpenMetrics(absl::string_view name,
+                                         absl::string_view labels,
+                                         std::string* out) const {
+  int64_t cumulative = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    cumulative += buckets_[i].load(std::memory_order_relaxed);
+    absl::StrAppend(out, name, "_bucket{", labels, ",le=\"", BucketLabel(i),
+                    "\"} ", cumulative, "\n");
+  }
+  absl::StrAppend(out, name, "_sum{", labels, "} ");
+  AppendSeconds(sum_usec_.load(std::memory_order_relaxed), out);
+  absl::StrAppend(out, "\n", name, "_count{", labels, "} ", cumulative, "\n");
+}
+
+/* static */
+absl::string_view CompilerProxyMetrics::PhaseName(Phase phase) {
+  switch (phase) {
+    case kIncludeProcessor:
+      return "include_processor";
+    case kFileRequest:
+      return "file_request";
+    case kRpc:
+      return "rpc";
+    case kOutputDownload:
+      return "output_download";
+    case kLocalRun:
+      return "local_run";
+    case kHandler:
+      return "handler";
+    case kNumPhases:
+      break;
+  }
+  LOG(FATAL) << "Unknown phase: " << phase;
+  return "";
+}
+
+void CompilerProxyMetrics::UpdateCompileStat(const CompileStats& stats) {
+  const std::pair<Phase, absl::Duration> phases[] = {
+      {kIncludeProcessor, stats.include_preprocess_time},
+      {kFileRequest, stats.include_fileload_time},
+      {kRpc, stats.total_rpc_call_time},
+      {kOutputDownload, stats.file_response_time},
+      {kLocalRun, stats.local_run_time},
+      {kHandler, stats.handler_time},
+  };
+  for (const auto& phase : phases) {
+    if (phase.second > absl::ZeroDuration()) {
+      histograms_[phase.first].Add(phase.second);
+    }
+  }
+}
+
+void CompilerProxyMetrics::AppendOpenMetrics(const ServiceStats& service_stats,
+                                             std::string* out) const {
+  // About 100 bytes per bucket sample.
+  out->reserve(out->size() + kNumPhases * LatencyHistogram::kNumBuckets * 100 +
+               2048);
+
+  static const char kPhaseName[] = "goma_compile_phase_seconds";
+  absl::StrAppend(out, "# TYPE ", kPhaseName, " histogram\n", "# UNIT ",
+                  kPhaseName, " seconds\n", "# HELP ", kPhaseName,
+                  " Time spent in each phase of compile tasks.\n");
+  for (int i = 0; i < kNumPhases; ++i) {
+    const Phase phase = static_cast<Phase>(i);
+    histograms_[i].AppendOpenMetrics(
+        kPhaseName, absl::StrCat("phase=\"", PhaseName(phase), "\""), out);
+  }
+
+  AppendCounter("goma_compile_requests", "Compile requests started.",
+                service_stats.num_requests, out);
+  static const char kCacheHitName[] = "goma_cache_hits";
+  absl::StrAppend(out, "# TYPE ", kCacheHitName, " counter\n", "# HELP ",
+                  kCacheHitName, " Compile requests served from cache.\n",
+                  kCacheHitName, "_total{cache=\"goma\"} ",
+                  service_stats.num_goma_cache_hits, "\n", kCacheHitName,
+                  "_total{cache=\"local\"} ",
+                  service_stats.num_local_cache_hits, "\n");
+  AppendGauge("goma_active_tasks", "Compile tasks running.",
+              service_stats.num_active_tasks, out);
+  AppendGauge("goma_pending_tasks", "Compile tasks waiting to run.",
+              service_stats.num_pending_tasks, out);
+  AppendGauge("goma_queued_uploads", "File uploads waiting to be sent.",
+              service_stats.num_queued_uploads, out);
+  AppendGauge("goma_upload_bytes_in_flight",
+              "Bytes of file uploads being sent.",
+              service_stats.upload_bytes_in_flight, out);
+  out->append("# EOF\n");
+}
+
+}  // namespace devtools_goma
@@ -0,0 +1,109 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DEVTOOLS_GOMA_CLIENT_COMPILER_PROXY_METRICS_H_
+#define DEVTOOLS_GOMA_CLIENT_COMPILER_PROXY_METRICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "basictypes.h"
+
+namespace devtools_goma {
+
+class CompileStats;
+
+// LatencyHistogram counts durations in fixed log-linear buckets, i.e.
+// 1, 2.5, 5 and 7.5 times each power of ten from 100us to 750s, and +Inf.
+// Unlike Histogram, buckets are fixed so that they can be aggregated across
+// compiler_proxy instances, and Add is lock-free.
+class LatencyHistogram {
+ public:
+  // Number of buckets including +Inf.
+  static const size_t kNumBuckets = 29;
+
+  LatencyHistogram() = default;
+
+  // Negative durations are counted as zero.
+  void Add(absl::Duration duration);
+
+  int64_t count() const;
+  int64_t bucket_count(size_t i) const {
+    return buckets_[i].load(std::memory_order_relaxed);
+  }
+  // Upper bound of bucket |i| in OpenMetrics "le" label format.
+  static absl::string_view BucketLabel(size_t i);
+
+  // Appends OpenMetrics samples of this histogram as |name| to |*out|.
+  // |labels| is inserted in each sample's label set, e.g. phase="rpc".
+  // The count is the sum of the buckets read, so that the samples are
+  // consistent while Add is called concurrently.
+  void AppendOpenMetrics(absl::string_view name,
+                         absl::string_view labels,
+                         std::string* out) const;
+
+ private:
+  std::array<std::atomic<int64_t>, kNumBuckets> buckets_{};
+  std::atomic<int64_t> sum_usec_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(LatencyHistogram);
+};
+
+// CompilerProxyMetrics keeps per-phase latency of compile tasks, and renders
+// them with counters and gauges of CompileService in OpenMetrics text format
+// for /metricz.
+class CompilerProxyMetrics {
+ public:
+  enum Phase {
+    kIncludeProcessor,
+    kFileRequest,
+    kRpc,
+    kOutputDownload,
+    kLocalRun,
+    kHandler,
+    kNumPhases,
+  };
+
+  // Counters and gauges owned by CompileService.
+  struct ServiceStats {
+    int64_t num_requests = 0;
+    int64_t num_goma_cache_hits = 0;
+    int64_t num_local_cache_hits = 0;
+    int64_t num_active_tasks = 0;
+    int64_t num_pending_tasks = 0;
+    int64_t num_queued_uploads = 0;
+    int64_t upload_bytes_in_flight = 0;
+  };
+
+  CompilerProxyMetrics() = default;
+
+  static absl::string_view PhaseName(Phase phase);
+
+  // Adds phase durations of a finished task. Phases the task didn't run
+  // are not counted.
+  void UpdateCompileStat(const CompileStats& stats);
+
+  const LatencyHistogram& histogram(Phase phase) const {
+    return histograms_[phase];
+  }
+
+  // Appends all metrics to |*out|, terminated by "# EOF".
+  void AppendOpenMetrics(const ServiceStats& service_stats,
+                         std::string* out) const;
+
+ private:
+  std::array<LatencyHistogram, kNumPhases> histograms_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompilerProxyMetrics);
+};
+
+}  // namespace devtools_goma
+
+#endif  // DEVTOOLS_GOMA_CLIENT_COMPILER_PROXY_METRICS_H_
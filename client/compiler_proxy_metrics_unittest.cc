@@ -0,0 +1,124 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "compiler_proxy_metrics.h"
+
+#include <string>
+
+#include "absl/strings/match.h"
+#include "absl/time/time.h"
+#include "compile_stats.h"
+#include "gtest/gtest.h"
+
+namespace devtools_goma {
+
+TEST(LatencyHistogramTest, Buckets) {
+  LatencyHistogram histogram;
+  histogram.Add(absl::Microseconds(-1));
+  histogram.Add(absl::Microseconds(100));
+  histogram.Add(absl::Microseconds(101));
+  histogram.Add(absl::Milliseconds(3));
+  histogram.Add(absl::Seconds(750));
+  histogram.Add(absl::Hours(1));
+
+  EXPECT_EQ(6, histogram.count());
+  EXPECT_EQ(2, histogram.bucket_count(0));
+  EXPECT_EQ("0.0001", LatencyHistogram::BucketLabel(0));
+  EXPECT_EQ(1, histogram.bucket_count(1));
+  EXPECT_EQ("0.00025", LatencyHistogram::BucketLabel(1));
+  EXPECT_EQ(1, histogram.bucket_count(6));
+  EXPECT_EQ("0.005", LatencyHistogram::BucketLabel(6));
+  EXPECT_EQ(1, histogram.bucket_count(LatencyHistogram::kNumBuckets - 2));
+  EXPECT_EQ("750.0",
+            LatencyHistogram::BucketLabel(LatencyHistogram::kNumBuckets - 2));
+  EXPECT_EQ(1, histogram.bucket_count(LatencyHistogram::kNumBuckets - 1));
+  EXPECT_EQ("+Inf",
+            LatencyHistogram::BucketLabel(LatencyHistogram::kNumBuckets - 1));
+}
+
+TEST(LatencyHistogramTest, AppendOpenMetrics) {
+  LatencyHistogram histogram;
+  histogram.Add(absl::Microseconds(50));
+  histogram.Add(absl::Milliseconds(1500));
+
+  std::string out;
+  histogram.AppendOpenMetrics("latency_seconds", "phase=\"rpc\"", &out);
+  EXPECT_TRUE(absl::StrContains(
+      out, "latency_seconds_bucket{phase=\"rpc\",le=\"0.0001\"} 1\n"))
+      << out;
+  EXPECT_TRUE(absl::StrContains(
+      out, "latency_seconds_bucket{phase=\"rpc\",le=\"1.0\"} 1\n"))
+      << out;
+  EXPECT_TRUE(absl::StrContains(
+      out, "latency_seconds_bucket{phase=\"rpc\",le=\"2.5\"} 2\n"))
+      << out;
+  EXPECT_TRUE(absl::StrContains(
+      out, "latency_seconds_bucket{phase=\"rpc\",le=\"+Inf\"} 2\n"))
+      << out;
+  EXPECT_TRUE(
+      absl::StrContains(out, "latency_seconds_sum{phase=\"rpc\"} 1.500050\n"))
+      << out;
+  EXPECT_TRUE(
+      absl::StrContains(out, "latency_seconds_count{phase=\"rpc\"} 2\n"))
+      << out;
+}
+
+TEST(CompilerProxyMetricsTest, UpdateCompileStat) {
+  CompilerProxyMetrics metrics;
+  CompileStats stats;
+  stats.include_preprocess_time = absl::Milliseconds(10);
+  stats.total_rpc_call_time = absl::Milliseconds(200);
+  stats.handler_time = absl::Milliseconds(300);
+  metrics.UpdateCompileStat(stats);
+
+  EXPECT_EQ(1, metrics.histogram(CompilerProxyMetrics::kIncludeProcessor)
+                   .count());
+  EXPECT_EQ(0, metrics.histogram(CompilerProxyMetrics::kFileRequest).count());
+  EXPECT_EQ(1, metrics.histogram(CompilerProxyMetrics::kRpc).count());
+  EXPECT_EQ(0,
+            metrics.histogram(CompilerProxyMetrics::kOutputDownload).count());
+  EXPECT_EQ(0, metrics.histogram(CompilerProxyMetrics::kLocalRun).count());
+  EXPECT_EQ(1, metrics.histogram(CompilerProxyMetrics::kHandler).count());
+}
+
+TEST(CompilerProxyMetricsTest, AppendOpenMetrics) {
+  CompilerProxyMetrics metrics;
+  CompileStats stats;
+  stats.local_run_time = absl::Milliseconds(20);
+  metrics.UpdateCompileStat(stats);
+
+  CompilerProxyMetrics::ServiceStats service_stats;
+  service_stats.num_requests = 10;
+  service_stats.num_goma_cache_hits = 3;
+  service_stats.num_local_cache_hits = 2;
+  service_stats.num_active_tasks = 4;
+  service_stats.num_pending_tasks = 1;
+
+  std::string out;
+  metrics.AppendOpenMetrics(service_stats, &out);
+  EXPECT_TRUE(absl::StrContains(
+      out, "# TYPE goma_compile_phase_seconds histogram\n"
+           "# UNIT goma_compile_phase_seconds seconds\n"))
+      << out;
+  EXPECT_TRUE(absl::StrContains(
+      out,
+      "goma_compile_phase_seconds_count{phase=\"include_processor\"} 0\n"))
+      << out;
+  EXPECT_TRUE(absl::StrContains(
+      out, "goma_compile_phase_seconds_count{phase=\"local_run\"} 1\n"))
+      << out;
+  EXPECT_TRUE(absl::StrContains(out, "goma_compile_requests_total 10\n"))
+      << out;
+  EXPECT_TRUE(
+      absl::StrContains(out, "goma_cache_hits_total{cache=\"goma\"} 3\n"))
+      << out;
+  EXPECT_TRUE(
+      absl::StrContains(out, "goma_cache_hits_total{cache=\"local\"} 2\n"))
+      << out;
+  EXPECT_TRUE(absl::StrContains(out, "goma_active_tasks 4\n")) << out;
+  EXPECT_TRUE(absl::StrContains(out, "goma_pending_tasks 1\n")) << out;
+  EXPECT_TRUE(absl::EndsWith(out, "# EOF\n")) << out;
+}
+
+}  // namespace devtools_goma
@@ -0,0 +1,77 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "concurrent_cache.h"
+
+#include <algorithm>
+
+#include "absl/numeric/bits.h"
+
+namespace devtools_goma {
+namespace internal {
+
+namespace {
+
+// Odd constants to derive an independent index for each row.
+constexpr uint64_t kSeeds[] = {
+    0x9e3779b97f4a7c15ULL,
+    0xc2b2ae3d27d4eb4fULL,
+    0x165667b19e3779f9ULL,
+    0x27d4eb2f165667c5ULL,
+};
+
+}  // namespace
+
+constexpr int FrequencySketch::kDepth;
+constexpr uint8_t FrequencySketch::kMaxCount;
+
+FrequencySketch::FrequencySketch(size_t width)
+    : mask_(static_cast<size_t>(absl::bit_ceil(
+                static_cast<uint64_t>(std::max<size_t>(width, 1)))) -
+            1),
+      sample_size_(10 * (mask_ + 1)),
+      counters_(kDepth * (mask_ + 1)) {
+  static_assert(sizeof(kSeeds) / sizeof(kSeeds[0]) == kDepth,
+                "kSeeds must have kDepth elements");
+}
+
+size_t FrequencySketch::Index(size_t hash, int row) const {
+  const uint64_t h = (static_cast<uint64_t>(hash) + row) * kSeeds[row];
+  return row * (mask_ + 1) + ((h >> 32) & mask_);
+}
+
+void FrequencySketch::Increment(size_t hash) {
+  for (int row = 0; row < kDepth; ++row) {
+    std::atomic<uint8_t>& counter = counters_[Index(hash, row)];
+    const uint8_t count = counter.load(std::memory_order_relaxed);
+    if (count < kMaxCount) {
+      counter.store(count + 1, std::memory_order_relaxed);
+    }
+  }
+  // Only the increment reaching sample_size_ ages counters.
+  if (num_increments_.fetch_add(1, std::memory_order_relaxed) + 1 ==
+      sample_size_) {
+    Age();
+  }
+}
+
+int FrequencySketch::Frequency(size_t hash) const {
+  int frequency = kMaxCount;
+  for (int row = 0; row < kDepth; ++row) {
+    frequency = std::min<int>(
+        frequency, counters_[Index(hash, row)].load(std::memory_order_relaxed));
+  }
+  return frequency;
+}
+
+void FrequencySketch::Age() {
+  for (auto& counter : counters_) {
+    counter.store(counter.load(std::memory_order_relaxed) >> 1,
+                  std::memory_order_relaxed);
+  }
+  num_increments_.fetch_sub(sample_size_ / 2, std::memory_order_relaxed);
+}
+
+}  // namespace internal
+}  // namespace devtools_goma
@@ -0,0 +1,387 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DEVTOOLS_GOMA_CLIENT_CONCURRENT_CACHE_H_
+#define DEVTOOLS_GOMA_CLIENT_CONCURRENT_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
+#include "absl/types/optional.h"
+#include "atomic_stats_counter.h"
+#include "autolock_timer.h"
+#include "glog/logging.h"
+
+namespace devtools_goma {
+
+namespace internal {
+
+// FrequencySketch estimates how often a key was accessed recently, with a
+// count-min sketch of 4-bit counters. All counters are halved periodically,
+// so old popularity fades out.
+// This class is thread-safe. Concurrent increments may be lost, which only
+// makes the estimate a bit lower.
+class FrequencySketch {
+ public:
+  // |width| is rounded up to a power of two.
+  explicit FrequencySketch(size_t width);
+
+  FrequencySketch(const FrequencySketch&) = delete;
+  FrequencySketch& operator=(const FrequencySketch&) = delete;
+
+  void Increment(size_t hash);
+  int Frequency(size_t hash) const;
+
+ private:
+  static constexpr int kDepth = 4;
+  static constexpr uint8_t kMaxCount = 15;
+
+  size_t Index(size_t hash, int row) const;
+  void Age();
+
+  const size_t mask_;
+  // Counters are halved after this many increments.
+  const size_t sample_size_;
+  std::atomic<size_t> num_increments_{0};
+  std::vector<std::atomic<uint8_t>> counters_;
+};
+
+}  // namespace internal
+
+// ConcurrentCache is a bounded key-value cache.
+//
+// Entries are split into shards by key hash, and each shard has its own lock,
+// so threads touching different keys rarely contend. Lookups take the shard
+// lock shared. Each entry has a cost given by caller (e.g. byte size or number
+// of elements), and the total cost of all shards is kept under max_cost.
+// An entry usually makes room in its own shard, and evicts from other shards
+// only when its own shard does not have enough.
+//
+// Eviction uses CLOCK (second chance): an entry hit since the hand last
+// passed survives one more round. A new entry is admitted only when it has
+// been looked up at least as often recently as each victim it would replace,
+// in any shard (TinyLFU admission), so one-off scans don't flush popular
+// entries.
+//
+// Values are copied out on lookup. Use std::shared_ptr<const T> as V for large
+// values.
+// This class is thread-safe.
+template <typename K, typename V, typename Hash = absl::Hash<K>>
+class ConcurrentCache {
+ public:
+  explicit ConcurrentCache(size_t max_cost) : max_cost_(max_cost) {
+    size_t num_shards = kMaxShards;
+    while (num_shards > 1 && max_cost / num_shards < kMinCostPerShard) {
+      num_shards /= 2;
+    }
+    const size_t max_shard_cost = max_cost / num_shards;
+    const size_t sketch_width =
+        std::max<size_t>(std::min<size_t>(max_shard_cost, 1 << 16), 256);
+    for (size_t i = 0; i < num_shards; ++i) {
+      shards_.emplace_back(new Shard(sketch_width));
+    }
+  }
+
+  ConcurrentCache(const ConcurrentCache&) = delete;
+  ConcurrentCache& operator=(const ConcurrentCache&) = delete;
+
+  // Copies the value for |key| to |value| and returns true if found.
+  bool Lookup(const K& key, V* value) {
+    return LookupIf(
+        key, [](const V&) { return true; }, value);
+  }
+
+  // Same as Lookup, but a cached value for which |pred| returns false is
+  // treated as a miss. |pred| is called with the shard lock held shared.
+  template <typename Pred>
+  bool LookupIf(const K& key, Pred pred, V* value) {
+    const size_t hash = Hash()(key);
+    Shard* shard = ShardFor(hash);
+    {
+      AUTO_SHARED_LOCK(lock, &shard->mu);
+      shard->sketch.Increment(hash);
+      auto it = shard->index.find(key);
+      if (it != shard->index.end()) {
+        const Entry& entry = *shard->slots[it->second];
+        if (pred(entry.value)) {
+          if (!entry.referenced.load(std::memory_order_relaxed)) {
+            entry.referenced.store(true, std::memory_order_relaxed);
+          }
+          *value = entry.value;
+          hit_.Add(1);
+          return true;
+        }
+      }
+    }
+    miss_.Add(1);
+    return false;
+  }
+
+  // Inserts |value| for |key| with |cost|, replacing the existing value.
+  // An entry costs at least 1, so entries with no content are bounded too.
+  // Returns false if the value was not admitted to the cache. In that case,
+  // the existing value for |key| is removed too.
+  bool Insert(K key, V value, size_t cost) {
+    cost = std::max<size_t>(cost, 1);
+    const size_t hash = Hash()(key);
+    Shard* shard = ShardFor(hash);
+    int frequency;
+    size_t slot;
+    uint64_t id;
+    {
+      AUTO_EXCLUSIVE_LOCK(lock, &shard->mu);
+      bool replacing = false;
+      auto it = shard->index.find(key);
+      if (it != shard->index.end()) {
+        RemoveSlotUnlocked(shard, it->second);
+        replacing = true;
+      }
+      if (cost > max_cost_) {
+        rejected_.Add(1);
+        return false;
+      }
+
+      // A replaced entry was already admitted, so it is not compared.
+      frequency = replacing ? kAlwaysAdmit : shard->sketch.Frequency(hash);
+      while (total_cost_.load() + cost > max_cost_ && !shard->index.empty()) {
+        const size_t victim = NextVictimUnlocked(shard, kNoSlot);
+        if (!AdmitUnlocked(shard, victim, frequency)) {
+          rejected_.Add(1);
+          return false;
+        }
+        RemoveSlotUnlocked(shard, victim);
+        evicted_.Add(1);
+      }
+
+      if (!shard->free_slots.empty()) {
+        slot = shard->free_slots.back();
+        shard->free_slots.pop_back();
+      } else {
+        slot = shard->slots.size();
+        shard->slots.emplace_back();
+      }
+      id = next_entry_id_.fetch_add(1, std::memory_order_relaxed);
+      shard->index.emplace(key, slot);
+      shard->slots[slot].emplace(std::move(key), std::move(value), hash, cost,
+                                 id);
+      total_cost_ += cost;
+    }
+    // Own shard could not make enough room, e.g. for an entry larger than
+    // the shard's share of max_cost.
+    if (EvictOverflow(shard, slot, id, frequency)) {
+      return true;
+    }
+    // An entry in other shard is more popular. The new entry may have been
+    // replaced by other thread meanwhile; then it is no longer ours.
+    {
+      AUTO_EXCLUSIVE_LOCK(lock, &shard->mu);
+      if (IsEntryUnlocked(shard, slot, id)) {
+        RemoveSlotUnlocked(shard, slot);
+      }
+    }
+    rejected_.Add(1);
+    return false;
+  }
+
+  // Removes the value for |key| if any.
+  void Erase(const K& key) {
+    Shard* shard = ShardFor(Hash()(key));
+    AUTO_EXCLUSIVE_LOCK(lock, &shard->mu);
+    auto it = shard->index.find(key);
+    if (it != shard->index.end()) {
+      RemoveSlotUnlocked(shard, it->second);
+    }
+  }
+
+  // Returns the number of entries.
+  size_t size() const {
+    size_t size = 0;
+    for (const auto& shard : shards_) {
+      AUTO_SHARED_LOCK(lock, &shard->mu);
+      size += shard->index.size();
+    }
+    return size;
+  }
+
+  // Returns the sum of cost of all entries.
+  size_t total_cost() const { return total_cost_.load(); }
+
+  size_t num_shards() const { return shards_.size(); }
+
+  // Returns the index of the shard |key| belongs to.
+  size_t ShardIndexForTest(const K& key) const {
+    return ShardIndex(Hash()(key));
+  }
+
+  // Stats.
+  int64_t hit() const { return hit_.value(); }
+  int64_t miss() const { return miss_.value(); }
+  // The number of entries removed to make room for new ones.
+  int64_t evicted() const { return evicted_.value(); }
+  // The number of inserts refused by the cost limit or by admission.
+  int64_t rejected() const { return rejected_.value(); }
+
+ private:
+  static constexpr size_t kMaxShards = 16;
+  static constexpr size_t kMinCostPerShard = 64;
+  // Frequency that wins any admission test.
+  static constexpr int kAlwaysAdmit = std::numeric_limits<int>::max();
+  static constexpr size_t kNoSlot = std::numeric_limits<size_t>::max();
+
+  struct Entry {
+    Entry(K key, V value, size_t hash, size_t cost, uint64_t id)
+        : key(std::move(key)),
+          value(std::move(value)),
+          hash(hash),
+          cost(cost),
+          id(id),
+          referenced(false) {}
+    Entry(Entry&& other)
+        : key(std::move(other.key)),
+          value(std::move(other.value)),
+          hash(other.hash),
+          cost(other.cost),
+          id(other.id),
+          referenced(other.referenced.load(std::memory_order_relaxed)) {}
+
+    K key;
+    V value;
+    size_t hash;
+    size_t cost;
+    // Unique among entries ever inserted, to tell an entry from another one
+    // reusing its slot.
+    uint64_t id;
+    // Set by lookups holding the shard lock shared.
+    mutable std::atomic<bool> referenced;
+  };
+
+  struct Shard {
+    explicit Shard(size_t sketch_width) : sketch(sketch_width) {}
+
+    mutable ReadWriteLock mu;
+    // Updated by lookups holding |mu| shared.
+    internal::FrequencySketch sketch;
+    absl::flat_hash_map<K, size_t, Hash> index ABSL_GUARDED_BY(mu);
+    std::vector<absl::optional<Entry>> slots ABSL_GUARDED_BY(mu);
+    std::vector<size_t> free_slots ABSL_GUARDED_BY(mu);
+    size_t hand ABSL_GUARDED_BY(mu) = 0;
+  };
+
+  size_t ShardIndex(size_t hash) const {
+    // Multiplicative hashing mixes all bits of |hash| (only 32 bits on
+    // 32-bit platforms) into the upper bits of the product, so shards don't
+    // correlate with the buckets Shard::index selects by lower bits.
+    const uint64_t h = static_cast<uint64_t>(hash) * 0x9e3779b97f4a7c15ULL;
+    return static_cast<size_t>(h >> 32) % shards_.size();
+  }
+
+  Shard* ShardFor(size_t hash) const {
+    return shards_[ShardIndex(hash)].get();
+  }
+
+  // Returns true if the entry at |slot| is the one with |id|.
+  static bool IsEntryUnlocked(const Shard* shard, size_t slot, uint64_t id)
+      ABSL_SHARED_LOCKS_REQUIRED(shard->mu) {
+    return slot < shard->slots.size() && shard->slots[slot].has_value() &&
+           shard->slots[slot]->id == id;
+  }
+
+  // Returns true if a new entry looked up |frequency| times recently may
+  // replace the entry at |victim|.
+  static bool AdmitUnlocked(const Shard* shard, size_t victim, int frequency)
+      ABSL_SHARED_LOCKS_REQUIRED(shard->mu) {
+    return frequency >= shard->sketch.Frequency(shard->slots[victim]->hash);
+  }
+
+  // Advances the clock hand to an entry that has not been referenced since
+  // the hand last passed it, skipping |skip|. |shard| must have at least one
+  // entry other than |skip|.
+  static size_t NextVictimUnlocked(Shard* shard, size_t skip)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(shard->mu) {
+    DCHECK(!shard->index.empty());
+    for (;;) {
+      if (shard->hand >= shard->slots.size()) {
+        shard->hand = 0;
+      }
+      absl::optional<Entry>& slot = shard->slots[shard->hand];
+      if (slot.has_value() && shard->hand != skip) {
+        if (!slot->referenced.load(std::memory_order_relaxed)) {
+          return shard->hand;
+        }
+        slot->referenced.store(false, std::memory_order_relaxed);
+      }
+      ++shard->hand;
+    }
+  }
+
+  // Evicts entries until the total cost is within max_cost_, visiting the
+  // shards after |last| first. Locks one shard at a time.
+  // The new entry (|slot| with |id| in |last|) is never evicted. Returns
+  // false if a victim is more popular than |frequency|, i.e. the new entry
+  // should not be admitted.
+  bool EvictOverflow(Shard* last, size_t slot, uint64_t id, int frequency) {
+    size_t index = 0;
+    while (shards_[index].get() != last) {
+      ++index;
+    }
+    for (size_t i = 1; i <= shards_.size(); ++i) {
+      if (total_cost_.load() <= max_cost_) {
+        return true;
+      }
+      Shard* shard = shards_[(index + i) % shards_.size()].get();
+      AUTO_EXCLUSIVE_LOCK(lock, &shard->mu);
+      const size_t skip =
+          shard == last && IsEntryUnlocked(shard, slot, id) ? slot : kNoSlot;
+      const size_t num_skipped = skip == kNoSlot ? 0 : 1;
+      while (total_cost_.load() > max_cost_ &&
+             shard->index.size() > num_skipped) {
+        const size_t victim = NextVictimUnlocked(shard, skip);
+        if (!AdmitUnlocked(shard, victim, frequency)) {
+          return false;
+        }
+        RemoveSlotUnlocked(shard, victim);
+        evicted_.Add(1);
+      }
+    }
+    return true;
+  }
+
+  void RemoveSlotUnlocked(Shard* shard, size_t slot)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(shard->mu) {
+    Entry& entry = *shard->slots[slot];
+    total_cost_ -= entry.cost;
+    shard->index.erase(entry.key);
+    shard->slots[slot].reset();
+    shard->free_slots.push_back(slot);
+  }
+
+  const size_t max_cost_;
+  std::atomic<size_t> total_cost_{0};
+  std::atomic<uint64_t> next_entry_id_{0};
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  StatsCounter hit_;
+  StatsCounter miss_;
+  StatsCounter evicted_;
+  StatsCounter rejected_;
+};
+
+template <typename K, typename V, typename Hash>
+constexpr int ConcurrentCache<K, V, Hash>::kAlwaysAdmit;
+template <typename K, typename V, typename Hash>
+constexpr size_t ConcurrentCache<K, V, Hash>::kNoSlot;
+
+}  // namespace devtools_goma
+
+#endif  // DEVTOOLS_GOMA_CLIENT_CONCURRENT_CACHE_H_
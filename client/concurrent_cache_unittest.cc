@@ -0,0 +1,277 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "concurrent_cache.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+#include "platform_thread.h"
+
+namespace devtools_goma {
+
+TEST(FrequencySketchTest, Basic) {
+  internal::FrequencySketch sketch(64);
+  EXPECT_EQ(0, sketch.Frequency(1));
+
+  sketch.Increment(1);
+  sketch.Increment(1);
+  sketch.Increment(2);
+  EXPECT_EQ(2, sketch.Frequency(1));
+  EXPECT_EQ(1, sketch.Frequency(2));
+
+  // Counters saturate.
+  for (int i = 0; i < 100; ++i) {
+    sketch.Increment(3);
+  }
+  EXPECT_EQ(15, sketch.Frequency(3));
+}
+
+TEST(FrequencySketchTest, Aging) {
+  internal::FrequencySketch sketch(64);
+  for (int i = 0; i < 8; ++i) {
+    sketch.Increment(1);
+  }
+  EXPECT_EQ(8, sketch.Frequency(1));
+
+  // Counters are halved after 10 * width increments.
+  for (int i = 0; i < 10 * 64 - 8; ++i) {
+    sketch.Increment(2);
+  }
+  EXPECT_EQ(4, sketch.Frequency(1));
+  EXPECT_EQ(7, sketch.Frequency(2));
+}
+
+TEST(ConcurrentCacheTest, Basic) {
+  ConcurrentCache<std::string, int> cache(1024);
+  int value = 0;
+
+  EXPECT_FALSE(cache.Lookup("a", &value));
+  EXPECT_TRUE(cache.Insert("a", 1, 1));
+  EXPECT_TRUE(cache.Lookup("a", &value));
+  EXPECT_EQ(1, value);
+
+  // Replace.
+  EXPECT_TRUE(cache.Insert("a", 2, 3));
+  EXPECT_TRUE(cache.Lookup("a", &value));
+  EXPECT_EQ(2, value);
+  EXPECT_EQ(1U, cache.size());
+  EXPECT_EQ(3U, cache.total_cost());
+
+  EXPECT_FALSE(cache.LookupIf(
+      "a", [](int v) { return v != 2; }, &value));
+
+  cache.Erase("a");
+  EXPECT_FALSE(cache.Lookup("a", &value));
+  EXPECT_EQ(0U, cache.size());
+  EXPECT_EQ(0U, cache.total_cost());
+
+  EXPECT_EQ(2, cache.hit());
+  EXPECT_EQ(3, cache.miss());
+  EXPECT_EQ(0, cache.evicted());
+}
+
+TEST(ConcurrentCacheTest, CostLimit) {
+  ConcurrentCache<std::string, int> cache(10);
+  ASSERT_EQ(1U, cache.num_shards());
+
+  // Too large for the cache.
+  EXPECT_FALSE(cache.Insert("huge", 0, 11));
+  EXPECT_EQ(1, cache.rejected());
+
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_TRUE(cache.Insert(absl::StrCat(i), i, 2));
+  }
+  EXPECT_EQ(10U, cache.total_cost());
+  EXPECT_EQ(0, cache.evicted());
+
+  EXPECT_TRUE(cache.Insert("5", 5, 4));
+  EXPECT_EQ(10U, cache.total_cost());
+  EXPECT_EQ(2, cache.evicted());
+  EXPECT_EQ(4U, cache.size());
+}
+
+TEST(ConcurrentCacheTest, LargerThanShard) {
+  constexpr size_t kMaxCost = 1024;
+  ConcurrentCache<std::string, int> cache(kMaxCost);
+  ASSERT_EQ(16U, cache.num_shards());
+  int value = 0;
+
+  for (int i = 0; i < 2000; ++i) {
+    cache.Insert(absl::StrCat(i), i, 1);
+  }
+  EXPECT_EQ(kMaxCost, cache.total_cost());
+
+  // Larger than the shard's share, but fits in the whole cache.
+  EXPECT_TRUE(cache.Insert("large", 0, 1000));
+  EXPECT_TRUE(cache.Lookup("large", &value));
+  EXPECT_LE(cache.total_cost(), kMaxCost);
+  EXPECT_EQ(0, cache.rejected());
+}
+
+TEST(ConcurrentCacheTest, ZeroCost) {
+  ConcurrentCache<std::string, int> cache(10);
+
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_TRUE(cache.Insert(absl::StrCat(i), i, 0));
+  }
+  EXPECT_EQ(10U, cache.size());
+  EXPECT_EQ(10U, cache.total_cost());
+  EXPECT_EQ(90, cache.evicted());
+}
+
+TEST(ConcurrentCacheTest, SecondChance) {
+  ConcurrentCache<std::string, int> cache(2);
+  int value = 0;
+
+  EXPECT_TRUE(cache.Insert("a", 0, 1));
+  EXPECT_TRUE(cache.Insert("b", 0, 1));
+  // "a" is referenced, so "b" is evicted first.
+  EXPECT_TRUE(cache.Lookup("a", &value));
+  EXPECT_FALSE(cache.Lookup("c", &value));
+  EXPECT_TRUE(cache.Insert("c", 0, 1));
+
+  EXPECT_TRUE(cache.Lookup("a", &value));
+  EXPECT_FALSE(cache.Lookup("b", &value));
+  EXPECT_TRUE(cache.Lookup("c", &value));
+  EXPECT_EQ(1, cache.evicted());
+}
+
+TEST(ConcurrentCacheTest, ScanResistance) {
+  ConcurrentCache<std::string, int> cache(4);
+  int value = 0;
+
+  // Make "hot" entries popular.
+  for (int i = 0; i < 4; ++i) {
+    const std::string key = absl::StrCat("hot", i);
+    for (int j = 0; j < 5; ++j) {
+      if (!cache.Lookup(key, &value)) {
+        EXPECT_TRUE(cache.Insert(key, i, 1));
+      }
+    }
+  }
+
+  // Keys seen only once must not flush popular entries.
+  for (int i = 0; i < 100; ++i) {
+    const std::string key = absl::StrCat("scan", i);
+    EXPECT_FALSE(cache.Lookup(key, &value));
+    EXPECT_FALSE(cache.Insert(key, i, 1));
+  }
+
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(cache.Lookup(absl::StrCat("hot", i), &value));
+  }
+  EXPECT_EQ(100, cache.rejected());
+}
+
+TEST(ConcurrentCacheTest, AdmissionAcrossShards) {
+  constexpr size_t kMaxCost = 1024;
+  ConcurrentCache<std::string, int> cache(kMaxCost);
+  ASSERT_EQ(16U, cache.num_shards());
+  const size_t large_shard = cache.ShardIndexForTest("large");
+  int value = 0;
+
+  // Entries in other shards than "large" are popular.
+  std::vector<std::string> hot_keys;
+  for (size_t i = 0; i < kMaxCost; ++i) {
+    const std::string key = absl::StrCat(i);
+    if (cache.ShardIndexForTest(key) != large_shard) {
+      for (int j = 0; j < 3; ++j) {
+        EXPECT_FALSE(cache.Lookup(key, &value));
+      }
+      hot_keys.push_back(key);
+    }
+    EXPECT_TRUE(cache.Insert(key, 0, 1));
+  }
+  ASSERT_EQ(kMaxCost, cache.total_cost());
+
+  // "large" doesn't fit in its own shard, and must not evict popular
+  // entries in other shards.
+  EXPECT_FALSE(cache.Insert("large", 0, 200));
+  EXPECT_FALSE(cache.Lookup("large", &value));
+  EXPECT_LE(cache.total_cost(), kMaxCost);
+  for (const auto& key : hot_keys) {
+    EXPECT_TRUE(cache.Lookup(key, &value)) << key;
+  }
+}
+
+namespace {
+
+// Returns hash values less than 2^32, as absl::Hash on 32-bit platforms.
+struct SmallHash {
+  size_t operator()(int key) const { return static_cast<uint32_t>(key); }
+};
+
+}  // namespace
+
+TEST(ConcurrentCacheTest, ShardBySmallHash) {
+  ConcurrentCache<int, int, SmallHash> cache(1024);
+  ASSERT_EQ(16U, cache.num_shards());
+
+  std::vector<int> num_keys(cache.num_shards());
+  for (int i = 0; i < 1600; ++i) {
+    ++num_keys[cache.ShardIndexForTest(i)];
+  }
+  for (size_t i = 0; i < num_keys.size(); ++i) {
+    EXPECT_GT(num_keys[i], 50) << i;
+  }
+}
+
+namespace {
+
+class CacheUserThread : public PlatformThread::Delegate {
+ public:
+  CacheUserThread(ConcurrentCache<int, int>* cache, int seed)
+      : cache_(cache), seed_(seed) {}
+
+  void ThreadMain() override {
+    for (int i = 0; i < 10000; ++i) {
+      const int key = (i * 7 + seed_) % 500;
+      int value = 0;
+      if (cache_->Lookup(key, &value)) {
+        if (value != key * 2) {
+          ++num_errors_;
+        }
+      } else {
+        cache_->Insert(key, key * 2, 1 + key % 3);
+      }
+    }
+  }
+
+  int num_errors() const { return num_errors_; }
+
+ private:
+  ConcurrentCache<int, int>* cache_;
+  const int seed_;
+  int num_errors_ = 0;
+};
+
+}  // namespace
+
+TEST(ConcurrentCacheTest, Concurrent) {
+  constexpr int kNumThreads = 8;
+  constexpr size_t kMaxCost = 256;
+  ConcurrentCache<int, int> cache(kMaxCost);
+
+  std::vector<std::unique_ptr<CacheUserThread>> threads;
+  std::vector<PlatformThreadHandle> handles(kNumThreads);
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back(new CacheUserThread(&cache, i));
+    PlatformThread::Create(threads.back().get(), &handles[i]);
+  }
+  for (int i = 0; i < kNumThreads; ++i) {
+    PlatformThread::Join(handles[i]);
+  }
+
+  for (const auto& thread : threads) {
+    EXPECT_EQ(0, thread->num_errors());
+  }
+  EXPECT_LE(cache.total_cost(), kMaxCost);
+  EXPECT_EQ(kNumThreads * 10000, cache.hit() + cache.miss());
+}
+
+}  // namespace devtools_goma
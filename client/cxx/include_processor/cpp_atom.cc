@@ -0,0 +1,123 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cpp_atom.h"
+
+#include <deque>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "autolock_timer.h"
+#include "glog/logging.h"
+#include "lockhelper.h"
+
+namespace devtools_goma {
+
+namespace {
+
+struct AtomTable {
+  ReadWriteLock mu;
+  // Keys are views of |names|.
+  absl::flat_hash_map<absl::string_view, CppAtom> atoms ABSL_GUARDED_BY(mu);
+  // names[atom - 1] is the identifier of atom.
+  // deque doesn't move its elements on push_back.
+  std::deque<std::string> names ABSL_GUARDED_BY(mu);
+};
+
+AtomTable* GetAtomTable() {
+  static AtomTable* table = new AtomTable;
+  return table;
+}
+
+}  // namespace
+
+// static
+CppAtom CppAtomTable::Intern(absl::string_view name) {
+  CppAtom atom = Find(name);
+  if (atom != kInvalidCppAtom) {
+    return atom;
+  }
+  AtomTable* table = GetAtomTable();
+  AUTO_EXCLUSIVE_LOCK(lock, &table->mu);
+  // Another thread might have interned |name|.
+  auto found = table->atoms.find(name);
+  if (found != table->atoms.end()) {
+    return found->second;
+  }
+  CHECK_LT(table->names.size(), UINT32_MAX) << "too many atoms";
+  table->names.emplace_back(name);
+  atom = static_cast<CppAtom>(table->names.size());
+  table->atoms.emplace(table->names.back(), atom);
+  return atom;
+}
+
+// static
+void CppAtomTable::InternAll(absl::Span<const absl::string_view> names,
+                             absl::Span<CppAtom> atoms) {
+  CHECK_EQ(names.size(), atoms.size());
+  AtomTable* table = GetAtomTable();
+  bool has_new_name = false;
+  {
+    AUTO_SHARED_LOCK(lock, &table->mu);
+    for (size_t i = 0; i < names.size(); ++i) {
+      auto found = table->atoms.find(names[i]);
+      if (found == table->atoms.end()) {
+        atoms[i] = kInvalidCppAtom;
+        has_new_name = true;
+        continue;
+      }
+      atoms[i] = found->second;
+    }
+  }
+  if (!has_new_name) {
+    return;
+  }
+  AUTO_EXCLUSIVE_LOCK(lock, &table->mu);
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (atoms[i] != kInvalidCppAtom) {
+      continue;
+    }
+    // Another thread, or an earlier name in |names|, might have interned it.
+    auto found = table->atoms.find(names[i]);
+    if (found != table->atoms.end()) {
+      atoms[i] = found->second;
+      continue;
+    }
+    CHECK_LT(table->names.size(), UINT32_MAX) << "too many atoms";
+    table->names.emplace_back(names[i]);
+    atoms[i] = static_cast<CppAtom>(table->names.size());
+    table->atoms.emplace(table->names.back(), atoms[i]);
+  }
+}
+
+// static
+CppAtom CppAtomTable::Find(absl::string_view name) {
+  AtomTable* table = GetAtomTable();
+  AUTO_SHARED_LOCK(lock, &table->mu);
+  auto found = table->atoms.find(name);
+  if (found == table->atoms.end()) {
+    return kInvalidCppAtom;
+  }
+  return found->second;
+}
+
+// static
+absl::string_view CppAtomTable::Name(CppAtom atom) {
+  AtomTable* table = GetAtomTable();
+  AUTO_SHARED_LOCK(lock, &table->mu);
+  if (atom == kInvalidCppAtom || atom > table->names.size()) {
+    return absl::string_view();
+  }
+  return table->names[atom - 1];
+}
+
+// static
+size_t CppAtomTable::Size() {
+  AtomTable* table = GetAtomTable();
+  AUTO_SHARED_LOCK(lock, &table->mu);
+  return table->names.size();
+}
+
+}  // namespace devtools_goma
@@ -0,0 +1,58 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DEVTOOLS_GOMA_CLIENT_CXX_INCLUDE_PROCESSOR_CPP_ATOM_H_
+#define DEVTOOLS_GOMA_CLIENT_CXX_INCLUDE_PROCESSOR_CPP_ATOM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+namespace devtools_goma {
+
+// CppAtom is a process-wide unique id of an identifier.
+// The same identifier always has the same atom, so macros can be looked up
+// by atom without hashing the identifier.
+using CppAtom = uint32_t;
+
+// No identifier has kInvalidCppAtom.
+constexpr CppAtom kInvalidCppAtom = 0;
+
+// CppAtomTable interns identifiers into CppAtom.
+// Interned identifiers are never released. Only macro names, identifiers
+// in parsed directives (see CppDirectiveParser) and identifiers pasted by ##
+// from them are interned, so the table is bounded by the identifiers that
+// directives of the build can make.
+// This class is thread-safe.
+class CppAtomTable {
+ public:
+  CppAtomTable() = delete;
+
+  // Returns the atom of |name|. |name| is interned if it is not yet.
+  static CppAtom Intern(absl::string_view name);
+
+  // Interns all |names|, and sets the atom of names[i] to atoms[i].
+  // |atoms| must have the same size as |names|.
+  // This takes the table lock once for all |names|, rather than once for
+  // each name as Intern does.
+  static void InternAll(absl::Span<const absl::string_view> names,
+                        absl::Span<CppAtom> atoms);
+
+  // Returns the atom of |name| if it has been interned.
+  // Returns kInvalidCppAtom otherwise.
+  static CppAtom Find(absl::string_view name);
+
+  // Returns the identifier of |atom|.
+  // Returns empty for kInvalidCppAtom or unknown atom.
+  static absl::string_view Name(CppAtom atom);
+
+  // Returns the number of interned identifiers.
+  static size_t Size();
+};
+
+}  // namespace devtools_goma
+
+#endif  // DEVTOOLS_GOMA_CLIENT_CXX_INCLUDE_PROCESSOR_CPP_ATOM_H_
@@ -0,0 +1,107 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cpp_atom.h"
+
+#include "cpp_directive_parser.h"
+#include "cpp_macro.h"
+#include "cpp_macro_env.h"
+#include "cpp_token.h"
+#include "cpp_tokenizer.h"
+#include "gtest/gtest.h"
+
+namespace devtools_goma {
+
+TEST(CppAtomTableTest, Intern) {
+  EXPECT_EQ(kInvalidCppAtom, CppAtomTable::Find("cpp_atom_test_a"));
+
+  CppAtom a = CppAtomTable::Intern("cpp_atom_test_a");
+  EXPECT_NE(kInvalidCppAtom, a);
+  EXPECT_EQ(a, CppAtomTable::Intern("cpp_atom_test_a"));
+  EXPECT_EQ(a, CppAtomTable::Find("cpp_atom_test_a"));
+  EXPECT_EQ("cpp_atom_test_a", CppAtomTable::Name(a));
+
+  CppAtom b = CppAtomTable::Intern("cpp_atom_test_b");
+  EXPECT_NE(a, b);
+  EXPECT_EQ("cpp_atom_test_b", CppAtomTable::Name(b));
+  EXPECT_EQ("cpp_atom_test_a", CppAtomTable::Name(a));
+
+  EXPECT_EQ("", CppAtomTable::Name(kInvalidCppAtom));
+}
+
+TEST(CppAtomTableTest, InternAll) {
+  CppAtom a = CppAtomTable::Intern("cpp_atom_test_all_a");
+  const absl::string_view names[] = {
+      "cpp_atom_test_all_b", "cpp_atom_test_all_a", "cpp_atom_test_all_b"};
+  CppAtom atoms[3];
+  CppAtomTable::InternAll(names, absl::MakeSpan(atoms));
+  EXPECT_NE(kInvalidCppAtom, atoms[0]);
+  EXPECT_EQ(a, atoms[1]);
+  EXPECT_EQ(atoms[0], atoms[2]);
+  EXPECT_EQ(atoms[0], CppAtomTable::Find("cpp_atom_test_all_b"));
+}
+
+TEST(CppAtomTableTest, Token) {
+  // The tokenizer doesn't intern identifiers.
+  ArrayTokenList tokens;
+  ASSERT_TRUE(CppTokenizer::TokenizeAll("cpp_atom_test_x + 1",
+                                        SpaceHandling::kSkip, &tokens));
+  ASSERT_EQ(3U, tokens.size());
+  EXPECT_EQ(CppToken::IDENTIFIER, tokens[0].type);
+  EXPECT_EQ(kInvalidCppAtom, tokens[0].atom);
+  EXPECT_EQ(kInvalidCppAtom, CppAtomTable::Find("cpp_atom_test_x"));
+
+  CppToken token(CppToken::IDENTIFIER, "cpp_atom_test_x");
+  EXPECT_EQ(kInvalidCppAtom, token.atom);
+  EXPECT_EQ(kInvalidCppAtom, CppAtomTable::Find("cpp_atom_test_x"));
+}
+
+TEST(CppAtomTableTest, Directive) {
+  // Identifiers in directives are interned, and the others are not.
+  SharedCppDirectives directives = CppDirectiveParser::ParseFromString(
+      "#if cpp_atom_test_if + 1\n"
+      "int cpp_atom_test_code;\n"
+      "#endif\n",
+      "<string>");
+  ASSERT_TRUE(directives);
+  ASSERT_EQ(2U, directives->size());
+  ASSERT_EQ(CppDirectiveType::DIRECTIVE_IF, (*directives)[0]->type());
+  const auto& tokens =
+      static_cast<const CppDirectiveIf&>(*(*directives)[0]).tokens();
+  ASSERT_EQ(3U, tokens.size());
+  EXPECT_NE(kInvalidCppAtom, tokens[0].atom);
+  EXPECT_EQ(CppAtomTable::Find("cpp_atom_test_if"), tokens[0].atom);
+  EXPECT_EQ(kInvalidCppAtom, tokens[1].atom);
+  EXPECT_EQ(kInvalidCppAtom, CppAtomTable::Find("cpp_atom_test_code"));
+}
+
+TEST(CppMacroEnvTest, AddGetDelete) {
+  Macro a1("cpp_macro_env_test_a", Macro::OBJ, ArrayTokenList(), 0, false);
+  Macro a2("cpp_macro_env_test_a", Macro::OBJ, ArrayTokenList(), 0, false);
+  Macro b("cpp_macro_env_test_b", Macro::OBJ, ArrayTokenList(), 0, false);
+  EXPECT_EQ(a1.atom, a2.atom);
+
+  CppMacroEnv env;
+  EXPECT_EQ(nullptr, env.Get(a1.atom));
+  EXPECT_EQ(nullptr, env.Add(&a1));
+  EXPECT_EQ(nullptr, env.Add(&b));
+  EXPECT_EQ(&a1, env.Get(a1.atom));
+  EXPECT_EQ(&b, env.Get(b.atom));
+  EXPECT_EQ(nullptr, env.Get(kInvalidCppAtom));
+
+  // Redefine.
+  EXPECT_EQ(&a1, env.Add(&a2));
+  EXPECT_EQ(&a2, env.Get(a1.atom));
+
+  int num_macros = 0;
+  env.ForEach([&num_macros](const Macro*) { ++num_macros; });
+  EXPECT_EQ(2, num_macros);
+
+  EXPECT_EQ(&a2, env.Delete(a2.atom));
+  EXPECT_EQ(nullptr, env.Get(a2.atom));
+  EXPECT_EQ(nullptr, env.Delete(a2.atom));
+  EXPECT_EQ(&b, env.Get(b.atom));
+}
+
+}  // namespace devtools_goma
@@ -9,6 +9,7 @@
 #include <string>
 #include <vector>
 
+#include "cpp_atom.h"
 #include "cpp_macro.h"
 #include "cpp_token.h"
 
@@ -167,9 +168,13 @@ class CppDirectiveIncludeNext : public CppDirectiveIncludeBase {
 class CppDirectiveDefine : public CppDirective {
  public:
   // ObjectMacro
-  CppDirectiveDefine(std::string name, std::vector<CppToken> replacement)
+  // |atom| is the interned atom of |name|.
+  CppDirectiveDefine(std::string name,
+                     CppAtom atom,
+                     std::vector<CppToken> replacement)
       : CppDirective(CppDirectiveType::DIRECTIVE_DEFINE),
         macro_(new Macro(std::move(name),
+                         atom,
                          Macro::OBJ,
                          std::move(replacement),
                          0,
@@ -177,11 +182,13 @@ class CppDirectiveDefine : public CppDirective {
 
   // FunctionMacro
   CppDirectiveDefine(std::string name,
+                     CppAtom atom,
                      int num_args,
                      bool has_vararg,
                      std::vector<CppToken> replacement)
       : CppDirective(CppDirectiveType::DIRECTIVE_DEFINE),
         macro_(new Macro(std::move(name),
+                         atom,
                          Macro::FUNC,
                          std::move(replacement),
                          num_args,
@@ -219,15 +226,18 @@ class CppDirectiveUndef : public CppDirective {
  public:
   explicit CppDirectiveUndef(std::string name)
       : CppDirective(CppDirectiveType::DIRECTIVE_UNDEF),
-        name_(std::move(name)) {}
+        name_(std::move(name)),
+        atom_(CppAtomTable::Intern(name_)) {}
   ~CppDirectiveUndef() override {}
 
   const std::string& name() const { return name_; }
+  CppAtom atom() const { return atom_; }
 
   std::string DebugString() const override { return "#undef " + name_; }
 
  private:
   const std::string name_;
+  const CppAtom atom_;
 };
 
 // ----------------------------------------------------------------------
@@ -236,15 +246,18 @@ class CppDirectiveIfdef : public CppDirective {
  public:
   explicit CppDirectiveIfdef(std::string name)
       : CppDirective(CppDirectiveType::DIRECTIVE_IFDEF),
-        name_(std::move(name)) {}
+        name_(std::move(name)),
+        atom_(CppAtomTable::Intern(name_)) {}
   ~CppDirectiveIfdef() override {}
 
   const std::string& name() const { return name_; }
+  CppAtom atom() const { return atom_; }
 
   std::string DebugString() const override { return "#ifdef " + name_; }
 
  private:
   const std::string name_;
+  const CppAtom atom_;
 };
 
 // ----------------------------------------------------------------------
@@ -253,15 +266,18 @@ class CppDirectiveIfndef : public CppDirective {
  public:
   explicit CppDirectiveIfndef(std::string name)
       : CppDirective(CppDirectiveType::DIRECTIVE_IFNDEF),
-        name_(std::move(name)) {}
+        name_(std::move(name)),
+        atom_(CppAtomTable::Intern(name_)) {}
   ~CppDirectiveIfndef() override {}
 
   const std::string& name() const { return name_; }
+  CppAtom atom() const { return atom_; }
 
   std::string DebugString() const override { return "#ifndef " + name_; }
 
  private:
   const std::string name_;
+  const CppAtom atom_;
 };
 
 // ----------------------------------------------------------------------
@@ -7,11 +7,14 @@
 #include <algorithm>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/inlined_vector.h"
 #include "absl/strings/ascii.h"
 #include "compiler_specific.h"
+#include "cpp_atom.h"
 #include "cpp_token.h"
 #include "cpp_tokenizer.h"
 #include "directive_filter.h"
@@ -21,6 +24,35 @@ namespace devtools_goma {
 
 namespace {
 
+// Sets atoms of identifiers in |tokens|, and of |name| if not nullptr.
+// Interns them at once not to take the lock of CppAtomTable for each token.
+template <typename TokenVector>
+void InternIdentifiers(TokenVector* tokens, CppToken* name = nullptr) {
+  absl::InlinedVector<absl::string_view, 16> names;
+  if (name != nullptr) {
+    names.push_back(name->string_value);
+  }
+  for (const auto& token : *tokens) {
+    if (token.type == CppToken::IDENTIFIER) {
+      names.push_back(token.string_value);
+    }
+  }
+  if (names.empty()) {
+    return;
+  }
+  absl::InlinedVector<CppAtom, 16> atoms(names.size());
+  CppAtomTable::InternAll(names, absl::MakeSpan(atoms));
+  auto atom = atoms.begin();
+  if (name != nullptr) {
+    name->atom = *atom++;
+  }
+  for (auto& token : *tokens) {
+    if (token.type == CppToken::IDENTIFIER) {
+      token.atom = *atom++;
+    }
+  }
+}
+
 bool ReadIdent(CppInputStream* stream,
                std::string* ident,
                std::string* error_reason) {
@@ -62,6 +94,7 @@ std::vector<CppToken> ReadTokens(CppInputStream* stream,
     }
   }
 
+  InternIdentifiers(&result);
   return result;
 }
 
@@ -84,7 +117,7 @@ void TrimTokenSpace(SmallCppTokenVector* tokens) {
   }
 }
 
-std::unique_ptr<CppDirective> ReadObjectMacro(const std::string& name,
+std::unique_ptr<CppDirective> ReadObjectMacro(CppToken name,
                                               CppInputStream* stream) {
   SmallCppTokenVector replacement;
 
@@ -106,14 +139,15 @@ std::unique_ptr<CppDirective> ReadObjectMacro(const std::string& name,
   }
 
   TrimTokenSpace(&replacement);
+  InternIdentifiers(&replacement, &name);
 
   return std::unique_ptr<CppDirective>(new CppDirectiveDefine(
-      name,
+      std::move(name.string_value), name.atom,
       std::vector<CppToken>(std::make_move_iterator(replacement.begin()),
                             std::make_move_iterator(replacement.end()))));
 }
 
-std::unique_ptr<CppDirective> ReadFunctionMacro(const std::string& name,
+std::unique_ptr<CppDirective> ReadFunctionMacro(CppToken name,
                                                 CppInputStream* stream) {
   absl::flat_hash_map<std::string, size_t> params;
   size_t param_index = 0;
@@ -189,8 +223,9 @@ std::unique_ptr<CppDirective> ReadFunctionMacro(const std::string& name,
   }
 
   TrimTokenSpace(&replacement);
+  InternIdentifiers(&replacement, &name);
   return std::unique_ptr<CppDirective>(new CppDirectiveDefine(
-      std::move(name), params.size(), is_vararg,
+      std::move(name.string_value), name.atom, params.size(), is_vararg,
       std::vector<CppToken>(std::make_move_iterator(replacement.begin()),
                             std::make_move_iterator(replacement.end()))));
 }
@@ -242,13 +277,14 @@ std::unique_ptr<CppDirective> ParseDefine(CppInputStream* stream) {
 
   CppToken token = NextToken(stream, SpaceHandling::kKeep);
   if (token.IsPuncChar('(')) {
-    return ReadFunctionMacro(name.string_value, stream);
+    return ReadFunctionMacro(std::move(name), stream);
   }
 
   if (token.type == CppToken::NEWLINE || token.type == CppToken::END) {
     // Token::END. name only macro.
-    return std::unique_ptr<CppDirective>(
-        new CppDirectiveDefine(name.string_value, std::vector<CppToken>()));
+    const CppAtom atom = CppAtomTable::Intern(name.string_value);
+    return std::unique_ptr<CppDirective>(new CppDirectiveDefine(
+        std::move(name.string_value), atom, std::vector<CppToken>()));
   }
 
   // here, object macro.
@@ -257,7 +293,7 @@ std::unique_ptr<CppDirective> ParseDefine(CppInputStream* stream) {
                                token.DebugString());
   }
 
-  return ReadObjectMacro(name.string_value, stream);
+  return ReadObjectMacro(std::move(name), stream);
 }
 
 // Parse undef, and return token.
@@ -43,6 +43,7 @@
 #include "cpp_parser.h"
 #include "directive_filter.h"
 #include "env_flags.h"
+#include "file_content_pool.h"
 #include "file_dir.h"
 #include "filesystem.h"
 #include "flag_parser.h"
@@ -665,6 +666,7 @@ bool CppIncludeProcessor::GetIncludeFiles(const std::string& filename,
 
     const std::string& abs_input =
         file::JoinPathRespectAbsolute(current_directory, input);
+    const FileStat input_file_stat = file_stat_cache->Get(abs_input);
     std::unique_ptr<Content> content(Content::CreateFromFile(abs_input));
     if (!content) {
       LOG(ERROR) << "root include:" << abs_input << " not found";
@@ -679,6 +681,11 @@ bool CppIncludeProcessor::GetIncludeFiles(const std::string& filename,
       LOG(ERROR) << "failed to parse directives: " << abs_input;
       return false;
     }
+    // Keep the content so that it is not read again to upload.
+    if (FileContentPool::Instance() != nullptr) {
+      FileContentPool::Instance()->Put(abs_input, input_file_stat,
+                                       std::move(content));
+    }
     VLOG(2) << "Looking into " << abs_input;
 
     std::string input_basedir = std::string(file::Dirname(input));
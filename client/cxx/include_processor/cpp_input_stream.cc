@@ -4,33 +4,8 @@
 
 #include "cpp_input_stream.h"
 
-#include <glog/logging.h>
-
 namespace devtools_goma {
 
-void CppInputStream::ConsumeChar() {
-  line_ += (*cur_ == '\n');
-  ++cur_;
-}
-
-size_t CppInputStream::GetLengthToCurrentFrom(
-    const char* from, int lastchar) const {
-  return cur_ - from - (lastchar == EOF ? 0 : 1);
-}
-
-void CppInputStream::Advance(int pos, int line) {
-  this->line_ += line;
-  cur_ += pos;
-}
-
-int CppInputStream::GetChar() {
-  DCHECK(cur_);
-  if (cur_ >= content_->buf_end())
-    return EOF;
-  line_ += (*cur_ == '\n');
-  return *cur_++;
-}
-
 int CppInputStream::GetCharWithBackslashHandling() {
   int c = GetChar();
   while (c == '\\') {
@@ -46,28 +21,6 @@ int CppInputStream::GetCharWithBackslashHandling() {
   return c;
 }
 
-void CppInputStream::UngetChar(int c) {
-  if (c != EOF) {
-    cur_--;
-    if (c == '\n')
-      line_--;
-  }
-}
-
-int CppInputStream::PeekChar() const {
-  DCHECK(cur_);
-  if (cur_ >= content_->buf_end())
-    return EOF;
-  return *cur_;
-}
-
-int CppInputStream::PeekChar(int offset) const {
-  DCHECK(cur_);
-  if (cur_ + offset >= content_->buf_end())
-    return EOF;
-  return *(cur_ + offset);
-}
-
 void CppInputStream::SkipWhiteSpaces() {
   int c = GetChar();
   while (IsCppBlank(c)) {
@@ -5,11 +5,14 @@
 #ifndef DEVTOOLS_GOMA_CLIENT_CXX_INCLUDE_PROCESSOR_CPP_INPUT_STREAM_H_
 #define DEVTOOLS_GOMA_CLIENT_CXX_INCLUDE_PROCESSOR_CPP_INPUT_STREAM_H_
 
+#include <stdio.h>
+
 #include <memory>
 #include <string>
 #include <utility>
 
 #include "content.h"
+#include "glog/logging.h"
 
 namespace devtools_goma {
 
@@ -50,6 +53,53 @@ class CppInputStream {
   const std::string filename_;
 };
 
+// Per-character accessors are inlined, since the tokenizer calls them
+// for every character of directives.
+inline void CppInputStream::ConsumeChar() {
+  line_ += (*cur_ == '\n');
+  ++cur_;
+}
+
+inline size_t CppInputStream::GetLengthToCurrentFrom(
+    const char* from, int lastchar) const {
+  return cur_ - from - (lastchar == EOF ? 0 : 1);
+}
+
+inline void CppInputStream::Advance(int pos, int line) {
+  this->line_ += line;
+  cur_ += pos;
+}
+
+inline int CppInputStream::GetChar() {
+  DCHECK(cur_);
+  if (cur_ >= content_->buf_end())
+    return EOF;
+  line_ += (*cur_ == '\n');
+  return *cur_++;
+}
+
+inline void CppInputStream::UngetChar(int c) {
+  if (c != EOF) {
+    cur_--;
+    if (c == '\n')
+      line_--;
+  }
+}
+
+inline int CppInputStream::PeekChar() const {
+  DCHECK(cur_);
+  if (cur_ >= content_->buf_end())
+    return EOF;
+  return *cur_;
+}
+
+inline int CppInputStream::PeekChar(int offset) const {
+  DCHECK(cur_);
+  if (cur_ + offset >= content_->buf_end())
+    return EOF;
+  return *(cur_ + offset);
+}
+
 // Utility functions
 template <typename Char>
 inline bool IsCppBlank(Char c) {
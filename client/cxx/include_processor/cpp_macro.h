@@ -9,6 +9,7 @@
 #include <string>
 #include <unordered_map>
 
+#include "cpp_atom.h"
 #include "cpp_token.h"
 #include "glog/logging.h"
 
@@ -47,6 +48,7 @@ struct Macro {
         size_t num_args,
         bool is_vararg)
       : name(std::move(name)),
+        atom(CppAtomTable::Intern(this->name)),
         type(type),
         replacement(std::move(replacement)),
         callback(nullptr),
@@ -58,9 +60,31 @@ struct Macro {
     DCHECK(type == OBJ || type == FUNC) << type;
   }
 
+  // OBJ or FUNC, with |atom| of |name| already interned.
+  Macro(std::string name,
+        CppAtom atom,
+        Type type,
+        ArrayTokenList replacement,
+        size_t num_args,
+        bool is_vararg)
+      : name(std::move(name)),
+        atom(atom),
+        type(type),
+        replacement(std::move(replacement)),
+        callback(nullptr),
+        callback_func(nullptr),
+        num_args(num_args),
+        is_vararg(is_vararg),
+        is_hidden(false),
+        is_paren_balanced(IsParenBalanced(this->replacement)) {
+    DCHECK(type == OBJ || type == FUNC) << type;
+    DCHECK_EQ(CppAtomTable::Find(this->name), atom) << this->name;
+  }
+
   // CBK
   Macro(std::string name, Type type, CallbackObj obj)
       : name(std::move(name)),
+        atom(CppAtomTable::Intern(this->name)),
         type(type),
         callback(obj),
         callback_func(nullptr),
@@ -74,6 +98,7 @@ struct Macro {
   // CBK_FUNC
   Macro(std::string name, Type type, CallbackFunc func, bool is_hidden)
       : name(std::move(name)),
+        atom(CppAtomTable::Intern(this->name)),
         type(type),
         callback(nullptr),
         callback_func(func),
@@ -90,6 +115,7 @@ struct Macro {
   bool IsPredefinedMacro() const { return type == CBK || type == CBK_FUNC; }
 
   const std::string name;
+  const CppAtom atom;
   const Type type;
   const ArrayTokenList replacement;
   const CallbackObj callback;
@@ -5,68 +5,94 @@
 #ifndef DEVTOOLS_GOMA_CLIENT_CXX_INCLUDE_PROCESSOR_CPP_MACRO_ENV_H_
 #define DEVTOOLS_GOMA_CLIENT_CXX_INCLUDE_PROCESSOR_CPP_MACRO_ENV_H_
 
-#include <string>
+#include <array>
+#include <memory>
+#include <vector>
 
-#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "cpp_atom.h"
 #include "cpp_macro.h"
 
 namespace devtools_goma {
 
+// CppMacroEnv is a table of macros indexed by CppAtom of macro names,
+// so looking up a macro is an array probe.
+// Atoms are process-wide, so the table is split into pages that are
+// allocated only when a macro in the page is added. Memory use follows the
+// macros defined in this env, not the number of atoms in the process.
 class CppMacroEnv {
  public:
-  using UnderlyingMapType =
-      absl::flat_hash_map<absl::string_view, const Macro*>;
-
   // Add |macro| to map.
   // If the same name macro exists, |macro| overrides the existing one,
   // and the old macro is returned. nullptr if not.
   const Macro* Add(const Macro* macro) {
-    absl::string_view name = macro->name;
-    auto p = env_.emplace(name, macro);
-    if (p.second) {
-      // no existing macro.
-      return nullptr;
+    const CppAtom atom = macro->atom;
+    DCHECK_NE(kInvalidCppAtom, atom) << macro->name;
+    const size_t page_index = atom / kPageSize;
+    if (page_index >= pages_.size()) {
+      pages_.resize(page_index + 1);
     }
-
-    const Macro* existing_macro = p.first->second;
-
-    // Be careful. key must be always the view of macro name.
-    // Otherwise, string_view won't be alive.
-    // So, we need to erase & insert to update key.
-    env_.erase(p.first);
-    env_.emplace(name, macro);
-
+    std::unique_ptr<Page>& page = pages_[page_index];
+    if (page == nullptr) {
+      page = absl::make_unique<Page>();
+      page->fill(nullptr);
+    }
+    const Macro* existing_macro = (*page)[atom % kPageSize];
+    (*page)[atom % kPageSize] = macro;
     return existing_macro;
   }
 
-  // Get a macro by |name|.
-  const Macro* Get(const std::string& name) const {
-    auto it = env_.find(name);
-    if (it == env_.end()) {
+  // Get a macro by |atom|.
+  const Macro* Get(CppAtom atom) const {
+    const Page* page = FindPage(atom);
+    if (page == nullptr) {
       return nullptr;
     }
-
-    return it->second;
+    return (*page)[atom % kPageSize];
   }
 
-  // Delete a macro by name.
+  // Delete a macro by |atom|.
   // The deleted macro is returned.
-  const Macro* Delete(const std::string& name) {
-    auto it = env_.find(name);
-    if (it == env_.end()) {
+  const Macro* Delete(CppAtom atom) {
+    Page* page = FindPage(atom);
+    if (page == nullptr) {
       return nullptr;
     }
-
-    const Macro* existing = it->second;
-    env_.erase(it);
+    const Macro* existing = (*page)[atom % kPageSize];
+    (*page)[atom % kPageSize] = nullptr;
     return existing;
   }
 
-  // Returns the underlying map. for dump, debug, etc.
-  const UnderlyingMapType& UnderlyingMap() const { return env_; }
+  // Calls |f| with each macro. for dump, debug, etc.
+  template <typename F>
+  void ForEach(F f) const {
+    for (const auto& page : pages_) {
+      if (page == nullptr) {
+        continue;
+      }
+      for (const Macro* macro : *page) {
+        if (macro != nullptr) {
+          f(macro);
+        }
+      }
+    }
+  }
 
  private:
-  UnderlyingMapType env_;
+  static constexpr size_t kPageSize = 64;
+  // Indexed by atom % kPageSize. nullptr if not defined.
+  using Page = std::array<const Macro*, kPageSize>;
+
+  Page* FindPage(CppAtom atom) const {
+    const size_t page_index = atom / kPageSize;
+    if (page_index >= pages_.size()) {
+      return nullptr;
+    }
+    return pages_[page_index].get();
+  }
+
+  // Indexed by atom / kPageSize. nullptr if no macro in the page is added.
+  std::vector<std::unique_ptr<Page>> pages_;
 };
 
 }  // namespace devtools_goma
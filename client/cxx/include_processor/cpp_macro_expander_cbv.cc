@@ -67,7 +67,7 @@ bool CppMacroExpanderCBV::Expand(ArrayTokenList::const_iterator input_begin,
       return false;
     }
 
-    const Macro* macro = parser_->GetMacro(token.string_value);
+    const Macro* macro = parser_->GetMacro(token);
     if (!macro || hideset.Has(macro)) {
       output->push_back(token);
       continue;
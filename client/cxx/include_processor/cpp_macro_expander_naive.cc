@@ -5,6 +5,7 @@
 #include "cpp_macro_expander_naive.h"
 
 #include "absl/strings/str_cat.h"
+#include "cpp_atom.h"
 #include "cpp_parser.h"
 #include "cpp_tokenizer.h"
 
@@ -136,7 +137,7 @@ bool CppMacroExpanderNaive::Expand(TokenHSList* input,
       if (next_it != input_range.end &&
           next_it->token.type == CppToken::IDENTIFIER) {
         // defined XXX.
-        int defined = parser_->IsMacroDefined(next_it->token.string_value);
+        int defined = parser_->IsMacroDefined(next_it->token);
         output->emplace_back(CppToken(defined), MacroSet());
 
         input_range.begin = next_it;
@@ -152,7 +153,7 @@ bool CppMacroExpanderNaive::Expand(TokenHSList* input,
             next2_it->token.type == CppToken::IDENTIFIER &&
             next3_it->token.IsPuncChar(')')) {
           // defined(XXX)
-          int defined = parser_->IsMacroDefined(next2_it->token.string_value);
+          int defined = parser_->IsMacroDefined(next2_it->token);
           output->emplace_back(CppToken(defined), MacroSet());
           input_range.begin = next3_it;
           ++input_range.begin;
@@ -164,8 +165,7 @@ bool CppMacroExpanderNaive::Expand(TokenHSList* input,
     }
 
     // Case 1. input[0] is not a macro or in input[0]'s hide_set.
-    const Macro* macro =
-        parser_->GetMacro(input_range.begin->token.string_value);
+    const Macro* macro = parser_->GetMacro(input_range.begin->token);
     if (!macro || input_range.begin->hideset.Has(macro)) {
       output->push_back(*input_range.begin);
       ++input_range.begin;
@@ -588,6 +588,11 @@ bool CppMacroExpanderNaive::Glue(TokenHSList* output, const TokenHS& ths) {
   // Replace the previous last-token with all the new token(s).
   output->pop_back();
   for (auto& token : tokens) {
+    // A pasted identifier is looked up as a macro name when it is rescanned,
+    // so give it an atom as identifiers in directives have.
+    if (token.type == CppToken::IDENTIFIER) {
+      token.atom = CppAtomTable::Intern(token.string_value);
+    }
     output->emplace_back(std::move(token), new_hideset);
   }
   return true;
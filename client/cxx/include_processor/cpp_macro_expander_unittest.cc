@@ -5,6 +5,7 @@
 #include "cpp_macro_expander.h"
 
 #include "content.h"
+#include "cpp_atom.h"
 #include "cpp_macro_expander_cbv.h"
 #include "cpp_macro_expander_naive.h"
 #include "cpp_parser.h"
@@ -592,6 +593,27 @@ TEST(CppMacroExpanderTest, GlueInclude) {
       "<boost/atomic/detail/caps_gcc_atomic.hpp>");
 }
 
+TEST(CppMacroExpanderTest, GlueInternsIdentifier) {
+  CppParser cpp_parser;
+  cpp_parser.AddStringInput("#define GLUE(X, Y) X ## Y\n", "(string)");
+  EXPECT_TRUE(cpp_parser.ProcessDirectives());
+
+  ArrayTokenList tokens;
+  ASSERT_TRUE(CppTokenizer::TokenizeAll(
+      "GLUE(glue_interns_, identifier)", SpaceHandling::kKeep, &tokens));
+  ArrayTokenList expanded;
+  CppMacroExpanderNaive(&cpp_parser)
+      .ExpandMacro(tokens, SpaceHandling::kSkip, &expanded);
+
+  // The pasted identifier has an atom, so it is looked up as a macro name
+  // without CppAtomTable.
+  ASSERT_EQ(1u, expanded.size());
+  EXPECT_EQ(CppToken::IDENTIFIER, expanded[0].type);
+  EXPECT_EQ("glue_interns_identifier", expanded[0].string_value);
+  EXPECT_NE(kInvalidCppAtom, expanded[0].atom);
+  EXPECT_EQ(CppAtomTable::Find("glue_interns_identifier"), expanded[0].atom);
+}
+
 TEST(CppMacroExpanderTest, Complex) {
   CheckExpand(CheckFlag::kPassAll,
               "#define f(x) f\n"
@@ -81,9 +81,7 @@ CppParser::CppParser()
       skipped_files_(0),
       total_files_(0),
       owner_thread_id_(GetCurrentThreadId()) {
-  const absl::Time now = absl::Now();
-  current_time_ = absl::FormatTime("%H:%M:%S", now, absl::LocalTimeZone());
-  current_date_ = absl::FormatTime("%b %d %Y", now, absl::LocalTimeZone());
+  current_time_ = absl::Now();
   EnsureInitialize();
 
   // Push empty input as a sentinel.
@@ -240,19 +238,42 @@ void CppParser::AddMacro(const Macro* macro) {
 }
 
 const Macro* CppParser::GetMacro(const std::string& name) {
-  return macro_env_.Get(name);
+  // Never interned name is not defined.
+  return GetMacro(CppAtomTable::Find(name));
+}
+
+const Macro* CppParser::GetMacro(const CppToken& token) {
+  if (token.atom != kInvalidCppAtom) {
+    return GetMacro(token.atom);
+  }
+  return GetMacro(token.string_value);
 }
 
 void CppParser::DeleteMacro(const std::string& name) {
-  const Macro* existing_macro = macro_env_.Delete(name);
+  DeleteMacro(CppAtomTable::Find(name));
+}
+
+void CppParser::DeleteMacro(CppAtom atom) {
+  const Macro* existing_macro = macro_env_.Delete(atom);
 
   if (existing_macro && existing_macro->IsPredefinedMacro()) {
-    Error("predefined macro is deleted:", name);
+    Error("predefined macro is deleted:", existing_macro->name);
   }
 }
 
 bool CppParser::IsMacroDefined(const std::string& name) {
-  const Macro* m = GetMacro(name);
+  return IsMacroDefined(CppAtomTable::Find(name));
+}
+
+bool CppParser::IsMacroDefined(const CppToken& token) {
+  if (token.atom != kInvalidCppAtom) {
+    return IsMacroDefined(token.atom);
+  }
+  return IsMacroDefined(token.string_value);
+}
+
+bool CppParser::IsMacroDefined(CppAtom atom) {
+  const Macro* m = GetMacro(atom);
   if (!m) {
     return false;
   }
@@ -353,9 +374,9 @@ void CppParser::AddPreparsedDirectivesInput(SharedCppDirectives directives) {
 
 std::string CppParser::DumpMacros() {
   std::stringstream ss;
-  for (const auto& entry : macro_env_.UnderlyingMap()) {
-    ss << entry.second->DebugString(this) << std::endl;
-  }
+  macro_env_.ForEach([this, &ss](const Macro* macro) {
+    ss << macro->DebugString(this) << std::endl;
+  });
   return ss.str();
 }
 
@@ -429,7 +450,7 @@ void CppParser::ProcessDefine(const CppDirectiveDefine& d) {
 
 void CppParser::ProcessUndef(const CppDirectiveUndef& d) {
   GOMA_COUNTERZ("undef");
-  DeleteMacro(d.name());
+  DeleteMacro(d.atom());
 }
 
 void CppParser::ProcessConditionInFalse(const CppDirective& directive) {
@@ -438,14 +459,14 @@ void CppParser::ProcessConditionInFalse(const CppDirective& directive) {
 
 void CppParser::ProcessIfdef(const CppDirectiveIfdef& d) {
   GOMA_COUNTERZ("ifdef");
-  bool v = IsMacroDefined(d.name());
+  bool v = IsMacroDefined(d.atom());
   VLOG(2) << DebugStringPrefix() << " #IFDEF " << v;
   conditions_.push_back(Condition(v));
 }
 
 void CppParser::ProcessIfndef(const CppDirectiveIfndef& d) {
   GOMA_COUNTERZ("ifndef");
-  bool v = !IsMacroDefined(d.name());
+  bool v = !IsMacroDefined(d.atom());
   VLOG(2) << DebugStringPrefix() << " #IFNDEF " << v;
   conditions_.push_back(Condition(v));
 }
@@ -668,7 +689,7 @@ int64_t CppParser::EvalCondition(const ArrayTokenList& orig_tokens) {
         orig_tokens[i].string_value == "defined") {
       if (i + 1 < orig_tokens.size() &&
           orig_tokens[i + 1].type == CppToken::IDENTIFIER) {
-        int defined = IsMacroDefined(orig_tokens[i + 1].string_value);
+        int defined = IsMacroDefined(orig_tokens[i + 1]);
         tokens.push_back(Token(defined));
         i += 1;
         continue;
@@ -677,7 +698,7 @@ int64_t CppParser::EvalCondition(const ArrayTokenList& orig_tokens) {
       if (i + 3 < orig_tokens.size() && orig_tokens[i + 1].IsPuncChar('(') &&
           orig_tokens[i + 2].type == CppToken::IDENTIFIER &&
           orig_tokens[i + 3].IsPuncChar(')')) {
-        int defined = IsMacroDefined(orig_tokens[i + 2].string_value);
+        int defined = IsMacroDefined(orig_tokens[i + 2]);
         tokens.push_back(Token(defined));
         i += 3;
         continue;
@@ -749,13 +770,15 @@ CppParser::Token CppParser::GetLineNumber() {
 
 CppParser::Token CppParser::GetDate() {
   Token token(Token::STRING);
-  token.Append(current_date_);
+  token.Append(
+      absl::FormatTime("%b %d %Y", current_time_, absl::LocalTimeZone()));
   return token;
 }
 
 CppParser::Token CppParser::GetTime() {
   Token token(Token::STRING);
-  token.Append(current_time_);
+  token.Append(
+      absl::FormatTime("%H:%M:%S", current_time_, absl::LocalTimeZone()));
   return token;
 }
 
@@ -18,8 +18,10 @@
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "autolock_timer.h"
 #include "basictypes.h"
+#include "cpp_atom.h"
 #include "cpp_directive.h"
 #include "cpp_input.h"
 #include "cpp_macro.h"
@@ -100,11 +102,18 @@ class CppParser {
   const CppDirective* NextDirective();
 
   // Macro dictionary helpers.
+  // Prefer CppAtom or CppToken versions, which don't need to look up
+  // the atom of the name.
   void AddMacroByString(const std::string& name, const std::string& body);
   void AddMacro(const Macro* macro);
   void DeleteMacro(const std::string& name);
+  void DeleteMacro(CppAtom atom);
   const Macro* GetMacro(const std::string& name);
+  const Macro* GetMacro(CppAtom atom) { return macro_env_.Get(atom); }
+  const Macro* GetMacro(const CppToken& token);
   bool IsMacroDefined(const std::string& name);
+  bool IsMacroDefined(CppAtom atom);
+  bool IsMacroDefined(const CppToken& token);
   // For testing purpose
   bool EnablePredefinedMacro(const std::string& name, bool is_hidden);
 
@@ -339,8 +348,9 @@ class CppParser {
 
   PragmaOnceFileSet pragma_once_fileset_;
 
-  std::string current_date_;
-  std::string current_time_;
+  // Time when this parser is created. __DATE__ and __TIME__ are formatted
+  // from it only when they are used.
+  absl::Time current_time_;
   std::string base_file_;
   int counter_;
 
@@ -12,6 +12,7 @@
 #include <vector>
 
 #include "absl/strings/string_view.h"
+#include "cpp_atom.h"
 #include "glog/logging.h"
 
 namespace devtools_goma {
@@ -124,6 +125,11 @@ struct CppToken {
 
   Type type;
   std::string string_value;
+  // Atom of |string_value| for IDENTIFIER.
+  // kInvalidCppAtom if it has not been interned. CppDirectiveParser interns
+  // identifiers in directives, and CppMacroExpander interns pasted
+  // identifiers, since they are looked up as macro names.
+  CppAtom atom = kInvalidCppAtom;
 
   // A struct to hold char value(s) for operators and punctuators.
   struct CharValue {
@@ -175,6 +181,7 @@ inline void CppToken::MakeMacroParam(size_t param_index) {
   type = MACRO_PARAM;
   v.param_index = param_index;
   string_value.clear();
+  atom = kInvalidCppAtom;
 }
 
 inline void CppToken::MakeMacroParamVaArgs(size_t param_index) {
@@ -183,6 +190,7 @@ inline void CppToken::MakeMacroParamVaArgs(size_t param_index) {
   type = MACRO_PARAM_VA_ARGS;
   v.param_index = param_index;
   string_value.clear();
+  atom = kInvalidCppAtom;
 }
 
 inline void CppToken::MakeMacroParamVaOpt() {
@@ -190,6 +198,7 @@ inline void CppToken::MakeMacroParamVaOpt() {
   DCHECK_EQ("__VA_OPT__", string_value);
   type = VA_OPT;
   string_value.clear();
+  atom = kInvalidCppAtom;
 }
 
 static_assert(std::is_nothrow_move_constructible<CppToken>::value,
@@ -13,6 +13,7 @@
 #include "cxx/include_processor/cpp_directive_parser.h"
 #include "cxx/include_processor/directive_filter.h"
 #include "cxx/include_processor/include_guard_detector.h"
+#include "file_content_pool.h"
 #include "file_stat.h"
 #include "goma_hash.h"
 #include "histogram.h"
@@ -36,13 +37,21 @@ class IncludeCache::Item {
 
   ~Item() {}
 
+  // If |verify_file_stat| is true, returns nullptr when |filepath| no longer
+  // matches |file_stat| after it is read, so that the content is not
+  // attributed to an old |file_stat|.
   static std::unique_ptr<Item> CreateFromFile(const std::string& filepath,
                                               const FileStat& file_stat,
-                                              bool needs_directive_hash) {
+                                              bool needs_directive_hash,
+                                              bool verify_file_stat) {
     std::unique_ptr<Content> content(Content::CreateFromFile(filepath));
     if (!content) {
       return nullptr;
     }
+    if (verify_file_stat && FileStat(filepath) != file_stat) {
+      VLOG(1) << "modified since stat: " << filepath;
+      return nullptr;
+    }
 
     std::unique_ptr<Content> filtered_content(
         DirectiveFilter::MakeFilteredContent(*content));
@@ -65,6 +74,12 @@ class IncludeCache::Item {
       directive_hash = std::move(h);
     }
 
+    // Keep the content so that it is not read again to upload.
+    if (FileContentPool::Instance() != nullptr) {
+      FileContentPool::Instance()->Put(filepath, file_stat,
+                                       std::move(content));
+    }
+
     return absl::make_unique<Item>(
         IncludeItem(std::make_shared<CppDirectiveList>(std::move(directives)),
                     std::move(include_guard_ident)),
@@ -127,8 +142,8 @@ IncludeItem IncludeCache::GetIncludeItem(const std::string& filepath,
 
   missed_count_.Add(1);
 
-  std::unique_ptr<Item> item(
-      Item::CreateFromFile(filepath, file_stat, calculates_directive_hash()));
+  std::unique_ptr<Item> item(Item::CreateFromFile(
+      filepath, file_stat, calculates_directive_hash(), false));
   if (!item) {
     return IncludeItem();
   }
@@ -155,8 +170,10 @@ absl::optional<SHA256HashValue> IncludeCache::GetDirectiveHash(
     }
   }
 
-  std::unique_ptr<Item> item(
-      Item::CreateFromFile(filepath, file_stat, calculates_directive_hash()));
+  // |file_stat| may have been taken a while ago, e.g. by DepsCache's writer
+  // thread.
+  std::unique_ptr<Item> item(Item::CreateFromFile(
+      filepath, file_stat, calculates_directive_hash(), true));
   if (!item) {
     return absl::nullopt;
   }
@@ -45,8 +45,8 @@ class IncludeCache {
 
   // Get directive hash. If we have a cache and its FileStat is the same as
   // |file_stat|, we return the cached one. Otherwise, we calculate the
-  // directive hash, and save it. If |filepath| is not found, invalid hash value
-  // is returned.
+  // directive hash, and save it. If |filepath| is not found or no longer
+  // matches |file_stat|, invalid hash value is returned.
   absl::optional<SHA256HashValue> GetDirectiveHash(const std::string& filepath,
                                                    const FileStat& file_stat);
 
@@ -224,6 +224,30 @@ TEST_F(IncludeCacheTest, GetDirectiveHash)
   }
 }
 
+TEST_F(IncludeCacheTest, GetDirectiveHashModifiedAfterStat) {
+  IncludeCache* ic = IncludeCache::instance();
+
+  TmpdirUtil tmpdir("includecache");
+  const std::string& ah = tmpdir.FullPath("a.h");
+  tmpdir.CreateTmpFile("a.h", "#include <stdio.h>\n");
+  const FileStat old_file_stat(ah);
+  ASSERT_TRUE(old_file_stat.IsValid());
+
+  tmpdir.CreateTmpFile("a.h", "#include <stdlib.h>\n");
+  EXPECT_FALSE(ic->GetDirectiveHash(ah, old_file_stat).has_value());
+  EXPECT_EQ(0, Size(ic));
+
+  const FileStat new_file_stat(ah);
+  ASSERT_TRUE(new_file_stat.IsValid());
+  SHA256HashValue hash_expected;
+  ComputeDataHashKeyForSHA256HashValue("#include <stdlib.h>\n",
+                                       &hash_expected);
+  absl::optional<SHA256HashValue> hash_actual =
+      ic->GetDirectiveHash(ah, new_file_stat);
+  ASSERT_TRUE(hash_actual.has_value());
+  EXPECT_EQ(hash_expected, hash_actual.value());
+}
+
 TEST_F(IncludeCacheTest, DumpEmpty) {
   IncludeCache* ic = IncludeCache::instance();
 
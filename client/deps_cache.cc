@@ -19,6 +19,7 @@
 #include "absl/strings/str_join.h"
 #include "absl/time/clock.h"
 #include "autolock_timer.h"
+#include "callback.h"
 #include "compiler_flags.h"
 #include "compiler_info.h"
 #include "compiler_proxy_info.h"
@@ -34,6 +35,7 @@
 #include "proto_util.h"
 #include "util.h"
 #include "vc_flags.h"
+#include "worker_thread_manager.h"
 
 MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
 #include "client/deps_cache_data.pb.h"
@@ -72,6 +74,12 @@ DepsCache::DepsCache(const std::string& cache_filename,
       identifier_alive_duration_(identifier_alive_duration),
       deps_table_size_threshold_(deps_table_size_threshold),
       max_proto_size_in_mega_bytes_(max_proto_size_in_mega_bytes),
+      writer_running_(false),
+      writer_should_done_(false),
+      batch_in_flight_(false),
+      num_queued_updates_(0),
+      num_coalesced_updates_(0),
+      num_applied_batches_(0),
       hit_count_(0),
       missed_count_(0),
       missed_by_updated_count_(0) {}
@@ -119,6 +127,11 @@ void DepsCache::LoadIfEnabled() {
 
 // static
 void DepsCache::Quit() {
+  if (instance_ == nullptr) {
+    return;
+  }
+  // The writer thread must be done before WorkerThreadManager finishes.
+  instance_->StopWriter();
   if (!IsEnabled())
     return;
 
@@ -153,72 +166,217 @@ bool DepsCache::SetDependencies(const DepsCache::Identifier& identifier,
   DCHECK(identifier.has_value());
   DCHECK(file::IsAbsolutePath(cwd)) << cwd;
 
-  auto deps_size = dependencies.size();
-  if (dependencies.find(input_file) == dependencies.end()) {
-    ++deps_size;
+  std::vector<DepsHashId> deps_hash_ids;
+  FileStats file_stats;
+  bool all_ok = CollectFileStats(cwd, input_file, dependencies,
+                                 file_stat_cache, &file_stats) &&
+                MakeDepsHashIds(file_stats, &deps_hash_ids);
+
+  AUTO_EXCLUSIVE_LOCK(lock, &mu_);
+  if (!all_ok) {
+    deps_table_.erase(identifier.value());
+    return false;
   }
 
-  std::vector<DepsHashId> deps_hash_ids;
-  deps_hash_ids.reserve(deps_size);
+  auto& deps = deps_table_[identifier.value()];
+  deps.last_used_time = absl::ToTimeT(absl::Now());
+  deps.deps_hash_ids = std::move(deps_hash_ids);
 
-  bool all_ok = true;
+  return true;
+}
 
-  auto process_file = [&](const std::string& filename) {
-    DCHECK(!filename.empty());
-    const std::string& abs_filename =
-        file::JoinPathRespectAbsolute(cwd, filename);
+bool DepsCache::SetDependenciesAsync(
+    const DepsCache::Identifier& identifier,
+    const std::string& cwd,
+    const std::string& input_file,
+    const std::set<std::string>& dependencies,
+    FileStatCache* file_stat_cache) {
+  DCHECK(identifier.has_value());
+  DCHECK(file::IsAbsolutePath(cwd)) << cwd;
 
-    FilenameIdTable::Id id = filename_id_table_.InsertFilename(filename);
-    if (id == FilenameIdTable::kInvalidId) {
-      all_ok = false;
-      return;
+  FileStats file_stats;
+  if (!CollectFileStats(cwd, input_file, dependencies, file_stat_cache,
+                        &file_stats)) {
+    RemoveDependency(identifier);
+    return false;
+  }
+
+  {
+    AUTOLOCK(lock, &writer_mu_);
+    if (writer_running_ && !writer_should_done_) {
+      auto p = pending_updates_.insert_or_assign(identifier.value(),
+                                                 std::move(file_stats));
+      ++num_queued_updates_;
+      if (!p.second) {
+        ++num_coalesced_updates_;
+      }
+      writer_cond_.Broadcast();
+      return true;
     }
+  }
+
+  // No writer thread. Update here.
+  std::vector<DepsHashId> deps_hash_ids;
+  const bool ok = MakeDepsHashIds(file_stats, &deps_hash_ids);
+  AUTO_EXCLUSIVE_LOCK(lock, &mu_);
+  if (!ok) {
+    deps_table_.erase(identifier.value());
+    return false;
+  }
+  auto& deps = deps_table_[identifier.value()];
+  deps.last_used_time = absl::ToTimeT(absl::Now());
+  deps.deps_hash_ids = std::move(deps_hash_ids);
+  return true;
+}
 
+// static
+bool DepsCache::CollectFileStats(const std::string& cwd,
+                                 const std::string& input_file,
+                                 const std::set<std::string>& dependencies,
+                                 FileStatCache* file_stat_cache,
+                                 FileStats* file_stats) {
+  file_stats->cwd = cwd;
+  file_stats->files.reserve(dependencies.size() + 1);
+
+  auto collect = [&](const std::string& filename) {
+    DCHECK(!filename.empty());
+    const std::string& abs_filename =
+        file::JoinPathRespectAbsolute(cwd, filename);
     FileStat file_stat(file_stat_cache->Get(abs_filename));
     if (!file_stat.IsValid()) {
-      all_ok = false;
       LOG(WARNING) << "invalid file id: " << abs_filename;
-      return;
+      return false;
     }
+    file_stats->files.emplace_back(filename, file_stat);
+    return true;
+  };
 
+  for (const auto& filename : dependencies) {
+    if (!collect(filename)) {
+      return false;
+    }
+  }
+
+  // We set input_file as dependency also.
+  if (dependencies.find(input_file) == dependencies.end()) {
+    return collect(input_file);
+  }
+  return true;
+}
+
+bool DepsCache::MakeDepsHashIds(const FileStats& file_stats,
+                                std::vector<DepsHashId>* deps_hash_ids) {
+  deps_hash_ids->reserve(file_stats.files.size());
+  for (const auto& file : file_stats.files) {
+    const std::string& filename = file.first;
+    const FileStat& file_stat = file.second;
+    FilenameIdTable::Id id = filename_id_table_.InsertFilename(filename);
+    if (id == FilenameIdTable::kInvalidId) {
+      return false;
+    }
+
+    const std::string& abs_filename =
+        file::JoinPathRespectAbsolute(file_stats.cwd, filename);
     absl::optional<SHA256HashValue> directive_hash =
         IncludeCache::instance()->GetDirectiveHash(abs_filename, file_stat);
     if (!directive_hash.has_value()) {
-      all_ok = false;
       LOG(WARNING) << "invalid directive hash: " << abs_filename;
-      return;
+      return false;
     }
 
     const DepsHashId deps_hash_id(
         id, file_stat_id_table_.GetId(file_stat),
         directive_hash_id_table_.GetId(directive_hash.value()));
     DCHECK(deps_hash_id.IsValid(file_stat_id_table_));
-    deps_hash_ids.push_back(deps_hash_id);
-  };
+    deps_hash_ids->push_back(deps_hash_id);
+  }
+  return true;
+}
 
-  for (const auto& filename : dependencies) {
-    process_file(filename);
-    if (!all_ok) {
-      break;
-    }
+void DepsCache::StartWriter(WorkerThreadManager* wm) {
+  {
+    AUTOLOCK(lock, &writer_mu_);
+    CHECK(!writer_running_);
+    writer_running_ = true;
+    writer_should_done_ = false;
   }
+  wm->NewThread(NewCallback(this, &DepsCache::WriterThread),
+                "deps-cache-writer");
+}
 
-  // We set input_file as dependency also.
-  if (all_ok && dependencies.find(input_file) == dependencies.end()) {
-    process_file(input_file);
+void DepsCache::StopWriter() {
+  AUTOLOCK(lock, &writer_mu_);
+  if (!writer_running_) {
+    return;
+  }
+  LOG(INFO) << "DepsCache: stopping writer thread. pendings="
+            << pending_updates_.size();
+  writer_should_done_ = true;
+  writer_cond_.Broadcast();
+  while (writer_running_) {
+    writer_cond_.Wait(&writer_mu_);
   }
+}
 
-  AUTO_EXCLUSIVE_LOCK(lock, &mu_);
-  if (!all_ok) {
-    deps_table_.erase(identifier.value());
-    return false;
+void DepsCache::WriterThread() {
+  while (true) {
+    PendingUpdates updates;
+    {
+      AUTOLOCK(lock, &writer_mu_);
+      while (pending_updates_.empty() && !writer_should_done_) {
+        writer_cond_.Wait(&writer_mu_);
+      }
+      if (pending_updates_.empty()) {
+        LOG(INFO) << "DepsCache: writer thread done.";
+        writer_running_ = false;
+        writer_cond_.Broadcast();
+        return;
+      }
+      // Updates queued while this batch is applied will be the next batch,
+      // so the batch grows when updates come faster than applied.
+      std::swap(updates, pending_updates_);
+      batch_in_flight_ = true;
+    }
+    ApplyUpdates(updates);
   }
+}
 
-  auto& deps = deps_table_[identifier.value()];
-  deps.last_used_time = absl::ToTimeT(absl::Now());
-  deps.deps_hash_ids = std::move(deps_hash_ids);
+void DepsCache::ApplyUpdates(const PendingUpdates& updates) {
+  // Directive hashes are computed without mu_, so GetDependencies is not
+  // blocked while IncludeCache reads files. A file modified since its stat
+  // was collected gets no directive hash, and the update is dropped.
+  std::vector<std::pair<Key, absl::optional<std::vector<DepsHashId>>>>
+      results;
+  results.reserve(updates.size());
+  for (const auto& update : updates) {
+    std::vector<DepsHashId> deps_hash_ids;
+    if (MakeDepsHashIds(update.second, &deps_hash_ids)) {
+      results.emplace_back(update.first, std::move(deps_hash_ids));
+    } else {
+      results.emplace_back(update.first, absl::nullopt);
+    }
+  }
 
-  return true;
+  const time_t now = absl::ToTimeT(absl::Now());
+  AUTOLOCK(lock, &writer_mu_);
+  {
+    AUTO_EXCLUSIVE_LOCK(table_lock, &mu_);
+    for (auto& result : results) {
+      if (removed_in_batch_.contains(result.first)) {
+        continue;
+      }
+      if (!result.second.has_value()) {
+        deps_table_.erase(result.first);
+        continue;
+      }
+      auto& deps = deps_table_[result.first];
+      deps.last_used_time = now;
+      deps.deps_hash_ids = std::move(*result.second);
+    }
+  }
+  removed_in_batch_.clear();
+  batch_in_flight_ = false;
+  ++num_applied_batches_;
 }
 
 bool DepsCache::GetDependencies(const DepsCache::Identifier& identifier,
@@ -275,8 +433,15 @@ bool DepsCache::GetDependencies(const DepsCache::Identifier& identifier,
 void DepsCache::RemoveDependency(const DepsCache::Identifier& identifier) {
   DCHECK(identifier.has_value());
 
-  AUTO_EXCLUSIVE_LOCK(lock, &mu_);
-  deps_table_.erase(identifier.value());
+  AUTOLOCK(lock, &writer_mu_);
+  pending_updates_.erase(identifier.value());
+  if (batch_in_flight_) {
+    removed_in_batch_.insert(identifier.value());
+  }
+  {
+    AUTO_EXCLUSIVE_LOCK(table_lock, &mu_);
+    deps_table_.erase(identifier.value());
+  }
 }
 
 void DepsCache::IncrMissedCount() {
@@ -315,6 +480,13 @@ void DepsCache::DumpStatsToProto(DepsCacheStats* stat) const {
     stat->set_updated(missed_by_updated_count_);
     stat->set_missed(missed_count_);
   }
+  {
+    AUTOLOCK(lock, &writer_mu_);
+    stat->set_queued_updates(num_queued_updates_);
+    stat->set_coalesced_updates(num_coalesced_updates_);
+    stat->set_applied_batches(num_applied_batches_);
+    stat->set_pending_updates(pending_updates_.size());
+  }
 }
 
 // static
@@ -6,13 +6,18 @@
 #ifndef DEVTOOLS_GOMA_CLIENT_DEPS_CACHE_H_
 #define DEVTOOLS_GOMA_CLIENT_DEPS_CACHE_H_
 
+#include <stdint.h>
+
 #include <atomic>
 #include <set>
 #include <sstream>
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/container/node_hash_map.h"
 #include "absl/time/time.h"
 #include "absl/types/optional.h"
@@ -28,6 +33,7 @@ namespace devtools_goma {
 class CompilerFlags;
 class CompilerInfo;
 class DepsCacheStats;
+class WorkerThreadManager;
 
 // DepsCache is a cache for dependent files.
 // We make an 'identifier' which identifies compile command,
@@ -65,6 +71,7 @@ class DepsCache {
   static void LoadIfEnabled();
 
   // Saves .goma_deps file is DepsCache is initialized.
+  // Queued updates are applied before saving.
   static void Quit();
 
   // Creates identifier to set/get dependencies.
@@ -85,6 +92,24 @@ class DepsCache {
                        const std::set<std::string>& dependencies,
                        FileStatCache* file_stat_cache);
 
+  // Same as SetDependencies, but only file stats are taken in the caller,
+  // and the update is queued to the writer thread if it is running.
+  // Queued updates for the same |identifier| are coalesced to the last one.
+  // Directive hashes are mostly taken from IncludeCache items that the
+  // include processor has already read, so the writer rarely reads files.
+  // Returns false if some file stat is invalid; then the entry is removed.
+  bool SetDependenciesAsync(const Identifier& identifier,
+                            const std::string& cwd,
+                            const std::string& input_file,
+                            const std::set<std::string>& dependencies,
+                            FileStatCache* file_stat_cache);
+
+  // Starts the writer thread for SetDependenciesAsync on |wm|.
+  void StartWriter(WorkerThreadManager* wm);
+  // Applies all queued updates and stops the writer thread.
+  // SetDependenciesAsync updates synchronously after this.
+  void StopWriter();
+
   // Gets dependent files using |identifer|.
   // We check the dependecies are not changed. If changed, false will be
   // returned and |dependecies| won't be changed.
@@ -142,6 +167,14 @@ class DepsCache {
   typedef SHA256HashValue Key;
   typedef absl::node_hash_map<Key, DepsTableData> DepsTable;
 
+  // Files of an entry with their FileStat, in the order of deps_hash_ids.
+  // A filename is the one given to SetDependencies, and can be relative.
+  struct FileStats {
+    std::string cwd;
+    std::vector<std::pair<std::string, FileStat>> files;
+  };
+  typedef absl::flat_hash_map<Key, FileStats> PendingUpdates;
+
   DepsCache(const std::string& cache_filename,
             absl::optional<absl::Duration> identifier_alive_duration,
             int deps_table_size_threshold,
@@ -150,6 +183,20 @@ class DepsCache {
 
   void Clear();
 
+  // Gets FileStat of |input_file| and |dependencies| to |file_stats|.
+  static bool CollectFileStats(const std::string& cwd,
+                               const std::string& input_file,
+                               const std::set<std::string>& dependencies,
+                               FileStatCache* file_stat_cache,
+                               FileStats* file_stats);
+  // Converts |file_stats| to |deps_hash_ids| with directive hashes.
+  bool MakeDepsHashIds(const FileStats& file_stats,
+                       std::vector<DepsHashId>* deps_hash_ids);
+
+  void WriterThread();
+  // Applies |updates| to deps_table_ at once.
+  void ApplyUpdates(const PendingUpdates& updates);
+
   bool SaveGomaDeps();
   bool LoadGomaDeps();
 
@@ -197,7 +244,23 @@ class DepsCache {
   // In that case, cache is just ignored.
   const int max_proto_size_in_mega_bytes_;
 
-  mutable ReadWriteLock mu_;
+  // Updates queued by SetDependenciesAsync.
+  // writer_mu_ should be held before mu_.
+  mutable Lock writer_mu_;
+  ConditionVariable writer_cond_;
+  bool writer_running_ ABSL_GUARDED_BY(writer_mu_);
+  bool writer_should_done_ ABSL_GUARDED_BY(writer_mu_);
+  PendingUpdates pending_updates_ ABSL_GUARDED_BY(writer_mu_);
+  // True while the writer applies a batch taken from pending_updates_.
+  bool batch_in_flight_ ABSL_GUARDED_BY(writer_mu_);
+  // Identifiers removed while a batch is in flight. The batch must not
+  // restore them.
+  absl::flat_hash_set<Key> removed_in_batch_ ABSL_GUARDED_BY(writer_mu_);
+  int64_t num_queued_updates_ ABSL_GUARDED_BY(writer_mu_);
+  int64_t num_coalesced_updates_ ABSL_GUARDED_BY(writer_mu_);
+  int64_t num_applied_batches_ ABSL_GUARDED_BY(writer_mu_);
+
+  mutable ReadWriteLock mu_ ABSL_ACQUIRED_AFTER(writer_mu_);
   DepsTable deps_table_ ABSL_GUARDED_BY(mu_);
 
   mutable Lock loaded_mu_;
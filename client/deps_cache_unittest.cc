@@ -17,6 +17,7 @@
 #include "absl/memory/memory.h"
 #include "absl/time/time.h"
 #include "client/deps_cache_data.pb.h"
+#include "lib/goma_stats.pb.h"
 #include "compiler_flags.h"
 #include "compiler_info.h"
 #include "cxx/cxx_compiler_info.h"
@@ -30,6 +31,7 @@
 #include "subprocess.h"
 #include "unittest_util.h"
 #include "vc_flags.h"
+#include "worker_thread_manager.h"
 
 namespace {
 constexpr absl::Duration kDepsCacheAliveDuration = absl::Hours(3 * 24);
@@ -190,10 +192,40 @@ class DepsCacheTest : public testing::Test {
                                 dependencies, file_stat_cache);
   }
 
+  bool SetDependenciesAsync(const DepsCache::Identifier& identifier,
+                            const std::string& input_file,
+                            const std::set<std::string>& dependencies,
+                            FileStatCache* file_stat_cache) {
+    return dc_->SetDependenciesAsync(identifier, tmpdir_->realcwd(),
+                                     input_file, dependencies,
+                                     file_stat_cache);
+  }
+
   void RemoveDependency(const DepsCache::Identifier& identifier) {
     return dc_->RemoveDependency(identifier);
   }
 
+  // Makes SetDependenciesAsync queue updates without the writer thread.
+  void QueueUpdatesWithoutWriter() {
+    AUTOLOCK(lock, &dc_->writer_mu_);
+    dc_->writer_running_ = true;
+  }
+
+  // Runs the writer in this thread until queued updates are applied.
+  void RunWriterUntilDone() {
+    {
+      AUTOLOCK(lock, &dc_->writer_mu_);
+      dc_->writer_should_done_ = true;
+    }
+    dc_->WriterThread();
+  }
+
+  DepsCacheStats GetStats() const {
+    DepsCacheStats stats;
+    dc_->DumpStatsToProto(&stats);
+    return stats;
+  }
+
   int DepsCacheSize() const { return static_cast<int>(dc_->deps_table_size()); }
 
   DepsCache::Identifier MakeFreshIdentifier() {
@@ -396,6 +428,146 @@ TEST_F(DepsCacheTest, RemoveDependencies) {
   }
 }
 
+TEST_F(DepsCacheTest, SetDependenciesAsync) {
+  const DepsCache::Identifier identifier = MakeFreshIdentifier();
+
+  const std::string& ah = tmpdir_->FullPath("a.h");
+  const std::string& acc = tmpdir_->FullPath("a.cc");
+
+  tmpdir_->CreateTmpFile("a.h", "kotori");
+  tmpdir_->CreateTmpFile("a.cc",
+      "#include <stdio.h>\n"
+      "piyo");
+
+  WorkerThreadManager wm;
+  wm.Start(1);
+  dc_->StartWriter(&wm);
+  {
+    FileStatCache file_stat_cache;
+    std::set<std::string> deps;
+    deps.insert(ah);
+    EXPECT_TRUE(SetDependenciesAsync(identifier, acc, deps, &file_stat_cache));
+  }
+  dc_->StopWriter();
+  wm.Finish();
+
+  {
+    FileStatCache file_stat_cache;
+    std::set<std::string> deps;
+    EXPECT_TRUE(GetDependencies(identifier, acc, &deps, &file_stat_cache));
+
+    std::set<std::string> deps_expected;
+    deps_expected.insert(ah);
+    EXPECT_EQ(deps_expected, deps);
+  }
+
+  DepsCacheStats stats = GetStats();
+  EXPECT_EQ(1, stats.queued_updates());
+  EXPECT_EQ(0, stats.coalesced_updates());
+  EXPECT_EQ(1, stats.applied_batches());
+  EXPECT_EQ(0, stats.pending_updates());
+
+  // Without the writer thread, it's updated synchronously.
+  const DepsCache::Identifier identifier2 = MakeFreshIdentifier();
+  {
+    FileStatCache file_stat_cache;
+    std::set<std::string> deps;
+    EXPECT_TRUE(SetDependenciesAsync(identifier2, acc, deps,
+                                     &file_stat_cache));
+    EXPECT_TRUE(GetDependencies(identifier2, acc, &deps, &file_stat_cache));
+  }
+  EXPECT_EQ(1, GetStats().queued_updates());
+}
+
+TEST_F(DepsCacheTest, SetDependenciesAsyncCoalesce) {
+  const DepsCache::Identifier identifier = MakeFreshIdentifier();
+  const DepsCache::Identifier removed_identifier = MakeFreshIdentifier();
+
+  const std::string& ah = tmpdir_->FullPath("a.h");
+  const std::string& bh = tmpdir_->FullPath("b.h");
+  const std::string& acc = tmpdir_->FullPath("a.cc");
+
+  tmpdir_->CreateTmpFile("a.h", "kotori");
+  tmpdir_->CreateTmpFile("b.h", "piyo");
+  tmpdir_->CreateTmpFile("a.cc",
+      "#include <stdio.h>\n"
+      "piyo");
+
+  QueueUpdatesWithoutWriter();
+  {
+    FileStatCache file_stat_cache;
+    std::set<std::string> deps;
+    deps.insert(ah);
+    EXPECT_TRUE(SetDependenciesAsync(identifier, acc, deps, &file_stat_cache));
+    deps.insert(bh);
+    EXPECT_TRUE(SetDependenciesAsync(identifier, acc, deps, &file_stat_cache));
+    EXPECT_TRUE(SetDependenciesAsync(removed_identifier, acc, deps,
+                                     &file_stat_cache));
+
+    // Not applied yet.
+    std::set<std::string> got;
+    EXPECT_FALSE(GetDependencies(identifier, acc, &got, &file_stat_cache));
+  }
+  RemoveDependency(removed_identifier);
+
+  DepsCacheStats stats = GetStats();
+  EXPECT_EQ(3, stats.queued_updates());
+  EXPECT_EQ(1, stats.coalesced_updates());
+  EXPECT_EQ(0, stats.applied_batches());
+  EXPECT_EQ(1, stats.pending_updates());
+
+  RunWriterUntilDone();
+
+  {
+    FileStatCache file_stat_cache;
+    std::set<std::string> deps;
+    EXPECT_TRUE(GetDependencies(identifier, acc, &deps, &file_stat_cache));
+
+    // The last update wins.
+    std::set<std::string> deps_expected;
+    deps_expected.insert(ah);
+    deps_expected.insert(bh);
+    EXPECT_EQ(deps_expected, deps);
+
+    EXPECT_FALSE(GetDependencies(removed_identifier, acc, &deps,
+                                 &file_stat_cache));
+  }
+
+  stats = GetStats();
+  EXPECT_EQ(1, stats.applied_batches());
+  EXPECT_EQ(0, stats.pending_updates());
+}
+
+TEST_F(DepsCacheTest, SetDependenciesAsyncInvalidFile) {
+  const DepsCache::Identifier identifier = MakeFreshIdentifier();
+
+  const std::string& ah = tmpdir_->FullPath("a.h");
+  const std::string& acc = tmpdir_->FullPath("a.cc");
+
+  tmpdir_->CreateTmpFile("a.h", "kotori");
+  tmpdir_->CreateTmpFile("a.cc", "piyo");
+
+  {
+    FileStatCache file_stat_cache;
+    std::set<std::string> deps;
+    deps.insert(ah);
+    EXPECT_TRUE(SetDependencies(identifier, acc, deps, &file_stat_cache));
+  }
+
+  QueueUpdatesWithoutWriter();
+  {
+    // Invalid file stat removes the entry without queueing.
+    FileStatCache file_stat_cache;
+    std::set<std::string> deps;
+    deps.insert(tmpdir_->FullPath("missing.h"));
+    EXPECT_FALSE(SetDependenciesAsync(identifier, acc, deps,
+                                      &file_stat_cache));
+    EXPECT_FALSE(GetDependencies(identifier, acc, &deps, &file_stat_cache));
+  }
+  EXPECT_EQ(0, GetStats().queued_updates());
+  RunWriterUntilDone();
+}
+
 TEST_F(DepsCacheTest, RemoveFile) {
   const DepsCache::Identifier identifier = MakeFreshIdentifier();
 
@@ -0,0 +1,136 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "exec_req_recorder.h"
+
+#include "absl/memory/memory.h"
+#include "autolock_timer.h"
+#include "glog/logging.h"
+
+MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
+#include "google/protobuf/io/coded_stream.h"
+MSVC_POP_WARNING()
+
+namespace devtools_goma {
+
+// static
+std::unique_ptr<ExecReqRecorder> ExecReqRecorder::Create(
+    const std::string& filename) {
+  ScopedFd fd(ScopedFd::Create(filename, 0644));
+  if (!fd.valid()) {
+    LOG(ERROR) << "failed to create " << filename;
+    return nullptr;
+  }
+  LOG(INFO) << "recording ExecReqs in " << filename;
+  return absl::WrapUnique(new ExecReqRecorder(std::move(fd)));
+}
+
+ExecReqRecorder::ExecReqRecorder(ScopedFd fd)
+    : start_time_(absl::Now()),
+      file_stream_(absl::make_unique<ScopedFdOutputStream>(std::move(fd))) {
+  google::protobuf::io::GzipOutputStream::Options options;
+  options.format = google::protobuf::io::GzipOutputStream::GZIP;
+  gzip_stream_ = absl::make_unique<google::protobuf::io::GzipOutputStream>(
+      file_stream_.get(), options);
+}
+
+ExecReqRecorder::~ExecReqRecorder() {
+  AUTOLOCK(lock, &mu_);
+  {
+    google::protobuf::io::CodedOutputStream coded(gzip_stream_.get());
+    coded.WriteVarint32(0);
+    coded.WriteVarint64(num_records_);
+  }
+  if (!gzip_stream_->Close() || !file_stream_->Flush()) {
+    LOG(ERROR) << "failed to write ExecReq records: "
+               << gzip_stream_->ZlibErrorMessage();
+  }
+  LOG(INFO) << "recorded " << num_records_ << " ExecReqs";
+}
+
+void ExecReqRecorder::Write(const ExecReqRecord& record) {
+  std::string data;
+  record.SerializeToString(&data);
+  if (data.empty()) {
+    // Size 0 is the end marker.
+    LOG(WARNING) << "empty ExecReqRecord is not recorded";
+    return;
+  }
+
+  AUTOLOCK(lock, &mu_);
+  google::protobuf::io::CodedOutputStream coded(gzip_stream_.get());
+  coded.WriteVarint32(data.size());
+  coded.WriteString(data);
+  ++num_records_;
+}
+
+int64_t ExecReqRecorder::num_records() const {
+  AUTOLOCK(lock, &mu_);
+  return num_records_;
+}
+
+bool ReadExecReqRecords(const std::string& filename,
+                        std::vector<ExecReqRecord>* records) {
+  ScopedFd fd(ScopedFd::OpenForRead(filename));
+  if (!fd.valid()) {
+    LOG(ERROR) << "failed to open " << filename;
+    return false;
+  }
+  GzipInputStream gzip_stream(
+      absl::make_unique<ScopedFdInputStream>(std::move(fd)));
+  bool found_end = false;
+  for (;;) {
+    // CodedInputStream backs up unread data on destruction, so a new one
+    // per record doesn't lose data nor hit the total bytes limit.
+    google::protobuf::io::CodedInputStream coded(&gzip_stream);
+    uint32_t size;
+    if (!coded.ReadVarint32(&size)) {
+      break;
+    }
+    if (size == 0) {
+      uint64_t num_records;
+      if (!coded.ReadVarint64(&num_records) ||
+          num_records != records->size()) {
+        LOG(ERROR) << "broken end marker after " << records->size()
+                   << " records in " << filename;
+        return false;
+      }
+      found_end = true;
+      // Nothing should follow the end marker.
+      if (coded.ReadVarint32(&size)) {
+        LOG(ERROR) << "unexpected data after end marker in " << filename;
+        return false;
+      }
+      break;
+    }
+    google::protobuf::io::CodedInputStream::Limit limit = coded.PushLimit(size);
+    ExecReqRecord record;
+    if (!record.ParseFromCodedStream(&coded) ||
+        !coded.ConsumedEntireMessage()) {
+      LOG(ERROR) << "broken record #" << records->size() << " in "
+                 << filename;
+      return false;
+    }
+    coded.PopLimit(limit);
+    records->push_back(std::move(record));
+  }
+  // Note that the end of the input is also reported as Z_STREAM_END, so a
+  // file truncated at a record boundary is detected by the missing end
+  // marker.
+  if (!found_end) {
+    LOG(ERROR) << "no end marker after " << records->size()
+               << " records in " << filename;
+    return false;
+  }
+  if (gzip_stream.ZlibErrorCode() != Z_STREAM_END) {
+    LOG(ERROR) << "failed to read " << filename << " to the end: "
+               << (gzip_stream.ZlibErrorMessage() != nullptr
+                       ? gzip_stream.ZlibErrorMessage()
+                       : "unknown error");
+    return false;
+  }
+  return true;
+}
+
+}  // namespace devtools_goma
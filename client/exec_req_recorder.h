@@ -0,0 +1,73 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DEVTOOLS_GOMA_CLIENT_EXEC_REQ_RECORDER_H_
+#define DEVTOOLS_GOMA_CLIENT_EXEC_REQ_RECORDER_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "compiler_specific.h"
+#include "lockhelper.h"
+#include "zero_copy_stream_impl.h"
+
+MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
+#include "google/protobuf/io/gzip_stream.h"
+#include "lib/goma_data.pb.h"
+MSVC_POP_WARNING()
+
+namespace devtools_goma {
+
+// ExecReqRecorder writes ExecReqRecords to a gzip compressed file, so that
+// the ExecReqs of a build can be replayed later (goma_loadtest --replay).
+// Each record is prefixed with its size in varint32. Empty records are not
+// written, and size 0 followed by the number of records in varint64 marks
+// the end of the records. The file is complete when the recorder is
+// destructed.
+//
+// This class is thread-safe.
+class ExecReqRecorder {
+ public:
+  // Returns nullptr if |filename| cannot be created.
+  static std::unique_ptr<ExecReqRecorder> Create(const std::string& filename);
+  ~ExecReqRecorder();
+
+  ExecReqRecorder(const ExecReqRecorder&) = delete;
+  ExecReqRecorder& operator=(const ExecReqRecorder&) = delete;
+
+  // Time since the recorder was created, for time_offset_usec.
+  absl::Duration Elapsed() const { return absl::Now() - start_time_; }
+
+  void Write(const ExecReqRecord& record);
+
+  int64_t num_records() const;
+
+ private:
+  explicit ExecReqRecorder(ScopedFd fd);
+
+  const absl::Time start_time_;
+
+  mutable Lock mu_;
+  std::unique_ptr<ScopedFdOutputStream> file_stream_ ABSL_GUARDED_BY(mu_);
+  std::unique_ptr<google::protobuf::io::GzipOutputStream> gzip_stream_
+      ABSL_GUARDED_BY(mu_);
+  int64_t num_records_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+// Reads records written by ExecReqRecorder from |filename| into |records|.
+// Returns false if the file cannot be read to the end marker, e.g. it is
+// truncated, even at a record boundary. In that case, |records| has the
+// records before the error.
+bool ReadExecReqRecords(const std::string& filename,
+                        std::vector<ExecReqRecord>* records);
+
+}  // namespace devtools_goma
+
+#endif  // DEVTOOLS_GOMA_CLIENT_EXEC_REQ_RECORDER_H_
@@ -0,0 +1,134 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "exec_req_recorder.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "file_helper.h"
+#include "gtest/gtest.h"
+#include "path.h"
+#include "unittest_util.h"
+
+MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/gzip_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+MSVC_POP_WARNING()
+
+namespace devtools_goma {
+
+namespace {
+
+ExecReqRecord MakeRecord(int i) {
+  ExecReqRecord record;
+  record.set_time_offset_usec(i * 1000);
+  ExecReq* req = record.mutable_req();
+  req->mutable_command_spec()->set_name("gcc");
+  req->add_arg("gcc");
+  req->add_arg("-c");
+  req->add_arg(absl::StrCat("foo", i, ".cc"));
+  req->set_cwd("/b");
+  ExecReqRecord::Input* input = record.add_input();
+  input->set_filename(absl::StrCat("foo", i, ".cc"));
+  input->set_hash_key(std::string(64, 'a' + i));
+  record.set_handler_time_usec(i * 2000);
+  return record;
+}
+
+}  // namespace
+
+TEST(ExecReqRecorderTest, WriteAndRead) {
+  TmpdirUtil tmpdir("exec_req_recorder_unittest");
+  const std::string filename = file::JoinPath(tmpdir.tmpdir(), "records.gz");
+  {
+    std::unique_ptr<ExecReqRecorder> recorder =
+        ExecReqRecorder::Create(filename);
+    ASSERT_NE(nullptr, recorder);
+    for (int i = 0; i < 3; ++i) {
+      recorder->Write(MakeRecord(i));
+    }
+    EXPECT_EQ(3, recorder->num_records());
+  }
+
+  std::vector<ExecReqRecord> records;
+  ASSERT_TRUE(ReadExecReqRecords(filename, &records));
+  ASSERT_EQ(3U, records.size());
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(MakeRecord(i).SerializeAsString(),
+              records[i].SerializeAsString());
+  }
+}
+
+TEST(ExecReqRecorderTest, Empty) {
+  TmpdirUtil tmpdir("exec_req_recorder_unittest");
+  const std::string filename = file::JoinPath(tmpdir.tmpdir(), "records.gz");
+  ASSERT_NE(nullptr, ExecReqRecorder::Create(filename));
+
+  std::vector<ExecReqRecord> records;
+  EXPECT_TRUE(ReadExecReqRecords(filename, &records));
+  EXPECT_TRUE(records.empty());
+}
+
+TEST(ExecReqRecorderTest, Truncated) {
+  TmpdirUtil tmpdir("exec_req_recorder_unittest");
+  const std::string filename = file::JoinPath(tmpdir.tmpdir(), "records.gz");
+  {
+    std::unique_ptr<ExecReqRecorder> recorder =
+        ExecReqRecorder::Create(filename);
+    ASSERT_NE(nullptr, recorder);
+    for (int i = 0; i < 3; ++i) {
+      recorder->Write(MakeRecord(i));
+    }
+  }
+  std::string content;
+  ASSERT_TRUE(ReadFileToString(filename, &content));
+  // Drops the gzip trailer and the end of the last record.
+  ASSERT_TRUE(WriteStringToFile(content.substr(0, content.size() - 20),
+                                filename));
+
+  std::vector<ExecReqRecord> records;
+  EXPECT_FALSE(ReadExecReqRecords(filename, &records));
+  EXPECT_LT(records.size(), 3U);
+}
+
+TEST(ExecReqRecorderTest, TruncatedAtRecordBoundary) {
+  TmpdirUtil tmpdir("exec_req_recorder_unittest");
+  const std::string filename = file::JoinPath(tmpdir.tmpdir(), "records.gz");
+  // A complete gzip stream of records without the end marker, as if
+  // compiler_proxy was killed between records.
+  std::string content;
+  {
+    google::protobuf::io::StringOutputStream string_stream(&content);
+    google::protobuf::io::GzipOutputStream::Options options;
+    options.format = google::protobuf::io::GzipOutputStream::GZIP;
+    google::protobuf::io::GzipOutputStream gzip_stream(&string_stream,
+                                                       options);
+    {
+      google::protobuf::io::CodedOutputStream coded(&gzip_stream);
+      for (int i = 0; i < 2; ++i) {
+        const std::string data = MakeRecord(i).SerializeAsString();
+        coded.WriteVarint32(data.size());
+        coded.WriteString(data);
+      }
+    }
+    ASSERT_TRUE(gzip_stream.Close());
+  }
+  ASSERT_TRUE(WriteStringToFile(content, filename));
+
+  std::vector<ExecReqRecord> records;
+  EXPECT_FALSE(ReadExecReqRecords(filename, &records));
+  EXPECT_EQ(2U, records.size());
+}
+
+TEST(ExecReqRecorderTest, NotFound) {
+  TmpdirUtil tmpdir("exec_req_recorder_unittest");
+  std::vector<ExecReqRecord> records;
+  EXPECT_FALSE(ReadExecReqRecords(
+      file::JoinPath(tmpdir.tmpdir(), "missing.gz"), &records));
+}
+
+}  // namespace devtools_goma
@@ -0,0 +1,218 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "file_compare.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include "absl/strings/escaping.h"
+#include "absl/strings/string_view.h"
+#include "glog/logging.h"
+#include "scoped_fd.h"
+
+#ifdef _WIN32
+# include "posix_helper_win.h"
+#endif
+
+namespace devtools_goma {
+
+namespace {
+
+std::string GetLastErrorMessage() {
+  char error_message[1024];
+#ifndef _WIN32
+  // Meaning of returned value of strerror_r is different between
+  // XSI and GNU. Need to ignore.
+  (void)strerror_r(errno, error_message, sizeof(error_message));
+#else
+  FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM, 0, GetLastError(), 0,
+                 error_message, sizeof error_message, 0);
+#endif
+  return error_message;
+}
+
+// BlockReader reads a file sequentially block by block.
+// It uses mmap if possible, and falls back to read.
+class BlockReader {
+ public:
+  BlockReader() = default;
+  ~BlockReader() {
+#ifndef _WIN32
+    if (map_ != nullptr) {
+      munmap(map_, size_);
+    }
+#endif
+  }
+
+  BlockReader(const BlockReader&) = delete;
+  BlockReader& operator=(const BlockReader&) = delete;
+
+  bool Open(const std::string& filename, std::string* error) {
+    fd_.reset(ScopedFd::OpenForRead(filename));
+    if (!fd_.valid()) {
+      *error = "open failed: " + filename;
+      return false;
+    }
+    size_t size = 0;
+    if (!fd_.GetFileSize(&size)) {
+      *error = "stat failed: " + filename;
+      return false;
+    }
+    size_ = size;
+#ifndef _WIN32
+    if (size_ > 0) {
+      void* map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_.fd(), 0);
+      if (map != MAP_FAILED) {
+        map_ = static_cast<char*>(map);
+        madvise(map_, size_, MADV_SEQUENTIAL);
+      } else {
+        PLOG(WARNING) << "mmap failed, fallback to read: " << filename;
+      }
+    }
+#endif
+    filename_ = filename;
+    return true;
+  }
+
+  size_t size() const { return size_; }
+
+  // Returns the next |len| bytes of the file. Valid until the next call.
+  // Returns empty on error.
+  absl::string_view Next(size_t len, std::string* error) {
+#ifndef _WIN32
+    if (map_ != nullptr) {
+      // Drop the previous block from this process, so that resident memory
+      // doesn't grow with file size. Pages stay in the page cache.
+      if (offset_ > block_begin_) {
+        madvise(map_ + block_begin_, offset_ - block_begin_, MADV_DONTNEED);
+      }
+      block_begin_ = offset_;
+      absl::string_view block(map_ + offset_, len);
+      offset_ += len;
+      return block;
+    }
+#endif
+    buf_.resize(len);
+    for (size_t n = 0; n < len;) {
+      ssize_t r = fd_.Read(buf_.data() + n, len - n);
+      if (r <= 0) {
+        std::ostringstream ss;
+        ss << "read failed: " << filename_ << " @" << offset_ + n << " "
+           << (r < 0 ? GetLastErrorMessage() : "unexpected EOF");
+        *error = ss.str();
+        return absl::string_view();
+      }
+      n += r;
+    }
+    offset_ += len;
+    return absl::string_view(buf_.data(), len);
+  }
+
+ private:
+  std::string filename_;
+  ScopedFd fd_;
+  size_t size_ = 0;
+  size_t offset_ = 0;
+#ifndef _WIN32
+  char* map_ = nullptr;
+  size_t block_begin_ = 0;
+#endif
+  std::vector<char> buf_;
+};
+
+// Returns the index of the first differing byte of |a| and |b|.
+// |a| and |b| must have the same size and differ.
+size_t FirstMismatch(absl::string_view a, absl::string_view b) {
+  DCHECK_EQ(a.size(), b.size());
+  size_t i = 0;
+  // Narrow down with memcmp, which is vectorized in libc.
+  for (size_t len = a.size(); len > 64;) {
+    const size_t half = len / 2;
+    if (memcmp(a.data() + i, b.data() + i, half) == 0) {
+      i += half;
+      len -= half;
+    } else {
+      len = half;
+    }
+  }
+  while (i < a.size() && a[i] == b[i]) {
+    ++i;
+  }
+  return i;
+}
+
+}  // namespace
+
+std::string FileDiff::Summary() const {
+  std::ostringstream ss;
+  ss << "size=" << size_a << "," << size_b;
+  if (begin >= 0) {
+    ss << " diff=@[" << begin << "," << end << ")";
+  }
+  if (!dump_a.empty() || !dump_b.empty()) {
+    ss << " a=" << dump_a << " b=" << dump_b;
+  }
+  if (!error.empty()) {
+    ss << " error=" << error;
+  }
+  return ss.str();
+}
+
+bool CompareFileContents(const std::string& filename_a,
+                         const std::string& filename_b,
+                         FileDiff* diff) {
+  BlockReader reader_a;
+  BlockReader reader_b;
+  if (!reader_a.Open(filename_a, &diff->error) ||
+      !reader_b.Open(filename_b, &diff->error)) {
+    return false;
+  }
+  diff->size_a = reader_a.size();
+  diff->size_b = reader_b.size();
+
+  const size_t common_size = std::min(reader_a.size(), reader_b.size());
+  for (size_t offset = 0; offset < common_size;) {
+    const size_t len = std::min(kFileCompareBlockSize, common_size - offset);
+    absl::string_view a = reader_a.Next(len, &diff->error);
+    if (a.empty()) {
+      return false;
+    }
+    absl::string_view b = reader_b.Next(len, &diff->error);
+    if (b.empty()) {
+      return false;
+    }
+    if (memcmp(a.data(), b.data(), len) != 0) {
+      const size_t begin = FirstMismatch(a, b);
+      size_t end = begin;
+      while (end < len && end - begin < kFileDiffMaxRange &&
+             a[end] != b[end]) {
+        ++end;
+      }
+      diff->begin = offset + begin;
+      diff->end = offset + end;
+      const size_t dump_len = std::min(kFileDiffDumpBytes, len - begin);
+      diff->dump_a = absl::BytesToHexString(a.substr(begin, dump_len));
+      diff->dump_b = absl::BytesToHexString(b.substr(begin, dump_len));
+      return false;
+    }
+    offset += len;
+  }
+  if (reader_a.size() != reader_b.size()) {
+    diff->begin = common_size;
+    diff->end = common_size;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace devtools_goma
@@ -0,0 +1,58 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DEVTOOLS_GOMA_CLIENT_FILE_COMPARE_H_
+#define DEVTOOLS_GOMA_CLIENT_FILE_COMPARE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+namespace devtools_goma {
+
+// Block size to compare at once.
+constexpr size_t kFileCompareBlockSize = 1 << 20;
+// Max length of FileDiff range.
+constexpr size_t kFileDiffMaxRange = 4096;
+// Max bytes to dump in FileDiff.
+constexpr size_t kFileDiffDumpBytes = 16;
+
+// FileDiff describes where two files differ.
+struct FileDiff {
+  int64_t size_a = -1;
+  int64_t size_b = -1;
+  // The first differing byte range [begin, end) in the common prefix of
+  // the files. If the common prefix is the same and sizes differ, both are
+  // min(size_a, size_b). The range is cut at kFileDiffMaxRange bytes or at
+  // the end of the block.
+  int64_t begin = -1;
+  int64_t end = -1;
+  // Hex dump of up to kFileDiffDumpBytes bytes at |begin| of each file.
+  std::string dump_a;
+  std::string dump_b;
+  // Set if comparison failed, e.g. a file could not be read.
+  std::string error;
+
+  // Returns a one line summary, e.g.
+  // "size=100,100 diff=@[16,20) a=0102 b=0304".
+  std::string Summary() const;
+};
+
+// Compares the contents of |filename_a| and |filename_b|.
+//
+// It reads both files in kFileCompareBlockSize blocks, from memory mapped
+// files if possible, and stops at the first mismatch, so it uses constant
+// memory regardless of file size and doesn't read the rest after a
+// mismatch.
+//
+// Returns true if they are the same. Otherwise, returns false and fills
+// |diff|. |diff->error| is set if a file could not be opened or read.
+bool CompareFileContents(const std::string& filename_a,
+                         const std::string& filename_b,
+                         FileDiff* diff);
+
+}  // namespace devtools_goma
+
+#endif  // DEVTOOLS_GOMA_CLIENT_FILE_COMPARE_H_
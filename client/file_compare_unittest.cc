@@ -0,0 +1,113 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "file_compare.h"
+
+#include <memory>
+#include <string>
+
+#include "file_helper.h"
+#include "gtest/gtest.h"
+#include "path.h"
+#include "scoped_tmp_file.h"
+
+namespace devtools_goma {
+
+class FileCompareTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    tmpdir_ = std::make_unique<ScopedTmpDir>("file_compare_unittest");
+    ASSERT_TRUE(tmpdir_->valid());
+  }
+
+  std::string WriteFile(const std::string& name, const std::string& content) {
+    const std::string path = file::JoinPath(tmpdir_->dirname(), name);
+    EXPECT_TRUE(WriteStringToFile(content, path)) << path;
+    return path;
+  }
+
+  std::unique_ptr<ScopedTmpDir> tmpdir_;
+};
+
+TEST_F(FileCompareTest, Same) {
+  const std::string content(3 * kFileCompareBlockSize + 123, 'x');
+  const std::string a = WriteFile("a", content);
+  const std::string b = WriteFile("b", content);
+  FileDiff diff;
+  EXPECT_TRUE(CompareFileContents(a, b, &diff)) << diff.Summary();
+  EXPECT_EQ(static_cast<int64_t>(content.size()), diff.size_a);
+  EXPECT_EQ(static_cast<int64_t>(content.size()), diff.size_b);
+  EXPECT_EQ(-1, diff.begin);
+}
+
+TEST_F(FileCompareTest, Empty) {
+  const std::string a = WriteFile("a", "");
+  const std::string b = WriteFile("b", "");
+  FileDiff diff;
+  EXPECT_TRUE(CompareFileContents(a, b, &diff)) << diff.Summary();
+  EXPECT_EQ(0, diff.size_a);
+  EXPECT_EQ(0, diff.size_b);
+}
+
+TEST_F(FileCompareTest, MismatchInLaterBlock) {
+  std::string content_a(2 * kFileCompareBlockSize + 100, '\0');
+  std::string content_b = content_a;
+  const size_t pos = kFileCompareBlockSize + 1000;
+  content_a[pos] = '\x01';
+  content_a[pos + 1] = '\x02';
+  content_b[pos] = '\x03';
+  content_b[pos + 1] = '\x04';
+  const std::string a = WriteFile("a", content_a);
+  const std::string b = WriteFile("b", content_b);
+  FileDiff diff;
+  EXPECT_FALSE(CompareFileContents(a, b, &diff));
+  EXPECT_TRUE(diff.error.empty()) << diff.error;
+  EXPECT_EQ(static_cast<int64_t>(pos), diff.begin);
+  EXPECT_EQ(static_cast<int64_t>(pos + 2), diff.end);
+  EXPECT_EQ("01020000000000000000000000000000", diff.dump_a);
+  EXPECT_EQ("03040000000000000000000000000000", diff.dump_b);
+}
+
+TEST_F(FileCompareTest, MismatchRangeCut) {
+  const std::string a = WriteFile("a", std::string(kFileDiffMaxRange * 2, 'a'));
+  const std::string b = WriteFile("b", std::string(kFileDiffMaxRange * 2, 'b'));
+  FileDiff diff;
+  EXPECT_FALSE(CompareFileContents(a, b, &diff));
+  EXPECT_EQ(0, diff.begin);
+  EXPECT_EQ(static_cast<int64_t>(kFileDiffMaxRange), diff.end);
+  EXPECT_EQ(2 * kFileDiffDumpBytes, diff.dump_a.size());
+}
+
+TEST_F(FileCompareTest, SizeMismatch) {
+  const std::string a = WriteFile("a", "abcdef");
+  const std::string b = WriteFile("b", "abc");
+  FileDiff diff;
+  EXPECT_FALSE(CompareFileContents(a, b, &diff));
+  EXPECT_TRUE(diff.error.empty()) << diff.error;
+  EXPECT_EQ(6, diff.size_a);
+  EXPECT_EQ(3, diff.size_b);
+  EXPECT_EQ(3, diff.begin);
+  EXPECT_EQ(3, diff.end);
+  EXPECT_EQ("size=6,3 diff=@[3,3)", diff.Summary());
+}
+
+TEST_F(FileCompareTest, Summary) {
+  const std::string a = WriteFile("a", "abcd");
+  const std::string b = WriteFile("b", "abdd");
+  FileDiff diff;
+  EXPECT_FALSE(CompareFileContents(a, b, &diff));
+  EXPECT_EQ("size=4,4 diff=@[2,3) a=6364 b=6464", diff.Summary());
+}
+
+TEST_F(FileCompareTest, NotFound) {
+  const std::string a = WriteFile("a", "abc");
+  const std::string b = file::JoinPath(tmpdir_->dirname(), "not_found");
+  FileDiff diff;
+  EXPECT_FALSE(CompareFileContents(a, b, &diff));
+  EXPECT_FALSE(diff.error.empty());
+  EXPECT_FALSE(CompareFileContents(b, a, &diff));
+  EXPECT_FALSE(diff.error.empty());
+}
+
+}  // namespace devtools_goma
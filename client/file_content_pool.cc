@@ -0,0 +1,207 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "file_content_pool.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/time/clock.h"
+#include "autolock_timer.h"
+#include "glog/logging.h"
+#include "lib/file_reader.h"
+#include "lib/goma_stats.pb.h"
+
+namespace devtools_goma {
+
+namespace {
+
+// FileContentPoolReader reads a content kept in FileContentPool.
+class FileContentPoolReader : public FileReader {
+ public:
+  explicit FileContentPoolReader(std::shared_ptr<const Content> content)
+      : content_(std::move(content)), offset_(0) {}
+  ~FileContentPoolReader() override {}
+
+  FileContentPoolReader(const FileContentPoolReader&) = delete;
+  FileContentPoolReader& operator=(const FileContentPoolReader&) = delete;
+
+  ssize_t Read(void* ptr, size_t len) override {
+    if (offset_ >= content_->size()) {
+      return 0;
+    }
+    size_t n = std::min(len, content_->size() - offset_);
+    memcpy(ptr, content_->buf() + offset_, n);
+    offset_ += n;
+    return n;
+  }
+
+  off_t Seek(off_t offset, ScopedFd::Whence whence) const override {
+    off_t pos = offset;
+    if (whence == ScopedFd::SeekRelative) {
+      pos += offset_;
+    }
+    if (pos < 0) {
+      return -1;
+    }
+    offset_ = pos;
+    return pos;
+  }
+
+  bool valid() const override { return true; }
+
+  bool GetFileSize(size_t* file_size) const override {
+    *file_size = content_->size();
+    return true;
+  }
+
+  static std::unique_ptr<FileReader> Create(const std::string& filename) {
+    FileContentPool* pool = FileContentPool::Instance();
+    if (pool == nullptr) {
+      return nullptr;
+    }
+    std::shared_ptr<const Content> content = pool->Get(filename);
+    if (!content) {
+      return nullptr;
+    }
+    return std::unique_ptr<FileReader>(
+        new FileContentPoolReader(std::move(content)));
+  }
+
+ private:
+  const std::shared_ptr<const Content> content_;
+  mutable size_t offset_;
+};
+
+}  // anonymous namespace
+
+FileContentPool::FileContentPool(size_t max_bytes, absl::Duration ttl)
+    : max_bytes_(max_bytes), ttl_(ttl) {}
+
+void FileContentPool::Put(const std::string& path,
+                          const FileStat& file_stat,
+                          std::unique_ptr<Content> content) {
+  if (!content || !file_stat.IsValid() || file_stat.is_directory) {
+    return;
+  }
+  // The file might be modified without changing mtime.
+  if (file_stat.CanBeStale()) {
+    return;
+  }
+  const size_t size = content->size();
+  if (size > max_bytes_ || static_cast<off_t>(size) != file_stat.size) {
+    return;
+  }
+
+  Entry entry;
+  entry.file_stat = file_stat;
+  entry.put_time = absl::Now();
+  entry.content = std::move(content);
+
+  AUTOLOCK(lock, &mu_);
+  auto it = entries_.find(path);
+  if (it != entries_.end()) {
+    total_bytes_ -= it->second.content->size();
+    entries_.erase(it);
+  }
+  EvictUnlocked(size);
+  entries_.emplace_back(path, std::move(entry));
+  total_bytes_ += size;
+  put_.Add(1);
+}
+
+std::shared_ptr<const Content> FileContentPool::Get(const std::string& path) {
+  {
+    AUTOLOCK(lock, &mu_);
+    if (!entries_.contains(path)) {
+      miss_.Add(1);
+      return nullptr;
+    }
+  }
+
+  // stat outside of the lock.
+  const FileStat file_stat(path);
+  const absl::Time now = absl::Now();
+
+  AUTOLOCK(lock, &mu_);
+  auto it = entries_.find(path);
+  if (it == entries_.end()) {
+    miss_.Add(1);
+    return nullptr;
+  }
+  const Entry& entry = it->second;
+  if (entry.file_stat != file_stat || now - entry.put_time > ttl_) {
+    VLOG(1) << "stale content in pool: " << path
+            << " cached=" << entry.file_stat << " current=" << file_stat;
+    stale_.Add(1);
+    total_bytes_ -= entry.content->size();
+    entries_.erase(it);
+    return nullptr;
+  }
+  hit_.Add(1);
+  hit_bytes_.Add(entry.content->size());
+  entries_.MoveToBack(it);
+  return entry.content;
+}
+
+void FileContentPool::EvictUnlocked(size_t new_bytes) {
+  while (!entries_.empty() && total_bytes_ + new_bytes > max_bytes_) {
+    total_bytes_ -= entries_.front().second.content->size();
+    entries_.pop_front();
+    evicted_.Add(1);
+  }
+}
+
+size_t FileContentPool::Size() const {
+  AUTOLOCK(lock, &mu_);
+  return entries_.size();
+}
+
+size_t FileContentPool::TotalBytes() const {
+  AUTOLOCK(lock, &mu_);
+  return total_bytes_;
+}
+
+void FileContentPool::DumpStatsToProto(FileContentPoolStats* stats) const {
+  {
+    AUTOLOCK(lock, &mu_);
+    stats->set_entries(entries_.size());
+    stats->set_bytes(total_bytes_);
+  }
+  stats->set_put(put_.value());
+  stats->set_hit(hit_.value());
+  stats->set_hit_bytes(hit_bytes_.value());
+  stats->set_missed(miss_.value());
+  stats->set_stale(stale_.value());
+  stats->set_evicted(evicted_.value());
+}
+
+FileContentPool* FileContentPool::instance_ = nullptr;
+
+/* static */
+void FileContentPool::Init(size_t max_bytes, absl::Duration ttl) {
+  CHECK(instance_ == nullptr);
+  instance_ = new FileContentPool(max_bytes, ttl);
+}
+
+/* static */
+void FileContentPool::Quit() {
+  CHECK(instance_ != nullptr);
+  delete instance_;
+  instance_ = nullptr;
+}
+
+/* static */
+FileContentPool* FileContentPool::Instance() {
+  return instance_;
+}
+
+/* static */
+void FileContentPool::RegisterFileReader() {
+  FileReaderFactory::Register(&FileContentPoolReader::Create);
+}
+
+}  // namespace devtools_goma
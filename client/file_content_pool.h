@@ -0,0 +1,93 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DEVTOOLS_GOMA_CLIENT_FILE_CONTENT_POOL_H_
+#define DEVTOOLS_GOMA_CLIENT_FILE_CONTENT_POOL_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/time/time.h"
+#include "atomic_stats_counter.h"
+#include "content.h"
+#include "file_stat.h"
+#include "linked_unordered_map.h"
+#include "lockhelper.h"
+
+namespace devtools_goma {
+
+class FileContentPoolStats;
+
+// FileContentPool keeps contents of files recently read by include
+// processing, so that hashing and uploading the files as inputs don't read
+// them from disk again.
+// A content is used only if the file still has the FileStat taken before
+// it was read. Contents are evicted in LRU order when the total size
+// exceeds the limit, and are not used when they are older than ttl.
+// The instance of this class is thread-safe.
+class FileContentPool {
+ public:
+  // Keeps |content| of |path|. |file_stat| must be taken before |content|
+  // was read. |content| is not kept if |file_stat| can be stale, or it is
+  // larger than the limit.
+  void Put(const std::string& path,
+           const FileStat& file_stat,
+           std::unique_ptr<Content> content);
+
+  // Returns content of |path| if it is kept and the file is not modified.
+  // Returns nullptr otherwise.
+  std::shared_ptr<const Content> Get(const std::string& path);
+
+  size_t Size() const;
+  size_t TotalBytes() const;
+
+  void DumpStatsToProto(FileContentPoolStats* stats) const;
+
+  // |max_bytes| is the limit of the total size of kept contents.
+  // Contents kept longer than |ttl| are not used.
+  static void Init(size_t max_bytes, absl::Duration ttl);
+  static void Quit();
+  static FileContentPool* Instance();
+
+  // Registers FileReader that reads from the pool to FileReaderFactory.
+  // It reads from the file when the pool is not initialized.
+  static void RegisterFileReader();
+
+ private:
+  struct Entry {
+    FileStat file_stat;
+    absl::Time put_time;
+    std::shared_ptr<const Content> content;
+  };
+
+  FileContentPool(size_t max_bytes, absl::Duration ttl);
+  FileContentPool(const FileContentPool&) = delete;
+  FileContentPool& operator=(const FileContentPool&) = delete;
+
+  void EvictUnlocked(size_t new_bytes) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const size_t max_bytes_;
+  const absl::Duration ttl_;
+
+  mutable Lock mu_;
+  // Least recently used entry is at front.
+  LinkedUnorderedMap<std::string, Entry> entries_ ABSL_GUARDED_BY(mu_);
+  size_t total_bytes_ ABSL_GUARDED_BY(mu_) = 0;
+
+  StatsCounter put_;
+  StatsCounter hit_;
+  StatsCounter hit_bytes_;
+  StatsCounter miss_;
+  StatsCounter stale_;
+  StatsCounter evicted_;
+
+  static FileContentPool* instance_;
+};
+
+}  // namespace devtools_goma
+
+#endif  // DEVTOOLS_GOMA_CLIENT_FILE_CONTENT_POOL_H_
@@ -0,0 +1,184 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "file_content_pool.h"
+
+#include <string>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "lib/file_reader.h"
+#include "lib/goma_stats.pb.h"
+#include "unittest_util.h"
+
+namespace devtools_goma {
+
+class FileContentPoolTest : public testing::Test {
+ protected:
+  void TearDown() override {
+    if (FileContentPool::Instance() != nullptr) {
+      FileContentPool::Quit();
+    }
+  }
+
+  // Creates |name| with |content|, which was modified 10 seconds ago.
+  std::string CreateFile(TmpdirUtil* tmpdir,
+                         const std::string& name,
+                         const std::string& content) {
+    tmpdir->CreateTmpFile(name, content);
+    const std::string path = tmpdir->FullPath(name);
+    UpdateMtime(path, mtime_);
+    return path;
+  }
+
+  static void Put(const std::string& path) {
+    FileStat file_stat(path);
+    FileContentPool::Instance()->Put(path, file_stat,
+                                     Content::CreateFromFile(path));
+  }
+
+  const absl::Time mtime_ = absl::Now() - absl::Seconds(10);
+};
+
+TEST_F(FileContentPoolTest, PutGet) {
+  FileContentPool::Init(1024, absl::InfiniteDuration());
+  FileContentPool* pool = FileContentPool::Instance();
+  TmpdirUtil tmpdir("file_content_pool");
+  const std::string path = CreateFile(&tmpdir, "a.h", "#define A 1\n");
+
+  EXPECT_EQ(nullptr, pool->Get(path));
+  Put(path);
+  EXPECT_EQ(1U, pool->Size());
+  EXPECT_EQ(12U, pool->TotalBytes());
+
+  std::shared_ptr<const Content> content = pool->Get(path);
+  ASSERT_NE(nullptr, content);
+  EXPECT_EQ("#define A 1\n", content->ToStringView());
+
+  FileContentPoolStats stats;
+  pool->DumpStatsToProto(&stats);
+  EXPECT_EQ(1, stats.entries());
+  EXPECT_EQ(12, stats.bytes());
+  EXPECT_EQ(1, stats.put());
+  EXPECT_EQ(1, stats.hit());
+  EXPECT_EQ(12, stats.hit_bytes());
+  EXPECT_EQ(1, stats.missed());
+  EXPECT_EQ(0, stats.stale());
+  EXPECT_EQ(0, stats.evicted());
+}
+
+TEST_F(FileContentPoolTest, Modified) {
+  FileContentPool::Init(1024, absl::InfiniteDuration());
+  FileContentPool* pool = FileContentPool::Instance();
+  TmpdirUtil tmpdir("file_content_pool");
+  const std::string path = CreateFile(&tmpdir, "a.h", "#define A 1\n");
+  Put(path);
+
+  tmpdir.CreateTmpFile("a.h", "#define A 100\n");
+  UpdateMtime(path, mtime_ + absl::Seconds(1));
+  EXPECT_EQ(nullptr, pool->Get(path));
+  EXPECT_EQ(0U, pool->Size());
+  EXPECT_EQ(0U, pool->TotalBytes());
+
+  FileContentPoolStats stats;
+  pool->DumpStatsToProto(&stats);
+  EXPECT_EQ(1, stats.stale());
+  EXPECT_EQ(0, stats.hit());
+}
+
+TEST_F(FileContentPoolTest, NotKeepIfFileStatCanBeStale) {
+  FileContentPool::Init(1024, absl::InfiniteDuration());
+  FileContentPool* pool = FileContentPool::Instance();
+  TmpdirUtil tmpdir("file_content_pool");
+  tmpdir.CreateTmpFile("a.h", "#define A 1\n");
+  const std::string path = tmpdir.FullPath("a.h");
+  UpdateMtime(path, absl::Now());
+
+  Put(path);
+  EXPECT_EQ(0U, pool->Size());
+  EXPECT_EQ(nullptr, pool->Get(path));
+}
+
+TEST_F(FileContentPoolTest, Evict) {
+  FileContentPool::Init(20, absl::InfiniteDuration());
+  FileContentPool* pool = FileContentPool::Instance();
+  TmpdirUtil tmpdir("file_content_pool");
+  const std::string a = CreateFile(&tmpdir, "a.h", "aaaaaaaa");
+  const std::string b = CreateFile(&tmpdir, "b.h", "bbbbbbbb");
+  const std::string c = CreateFile(&tmpdir, "c.h", "cccccccc");
+  const std::string large =
+      CreateFile(&tmpdir, "large.h", std::string(21, 'x'));
+
+  Put(a);
+  Put(b);
+  // |a| is used recently, so |b| is evicted.
+  EXPECT_NE(nullptr, pool->Get(a));
+  Put(c);
+  EXPECT_EQ(2U, pool->Size());
+  EXPECT_EQ(16U, pool->TotalBytes());
+  EXPECT_NE(nullptr, pool->Get(a));
+  EXPECT_EQ(nullptr, pool->Get(b));
+  EXPECT_NE(nullptr, pool->Get(c));
+
+  // Larger than the limit.
+  Put(large);
+  EXPECT_EQ(2U, pool->Size());
+  EXPECT_EQ(nullptr, pool->Get(large));
+
+  FileContentPoolStats stats;
+  pool->DumpStatsToProto(&stats);
+  EXPECT_EQ(1, stats.evicted());
+}
+
+TEST_F(FileContentPoolTest, Expire) {
+  FileContentPool::Init(1024, absl::ZeroDuration());
+  FileContentPool* pool = FileContentPool::Instance();
+  TmpdirUtil tmpdir("file_content_pool");
+  const std::string path = CreateFile(&tmpdir, "a.h", "#define A 1\n");
+  Put(path);
+  absl::SleepFor(absl::Milliseconds(1));
+  EXPECT_EQ(nullptr, pool->Get(path));
+}
+
+TEST_F(FileContentPoolTest, FileReader) {
+  FileContentPool::Init(1024, absl::InfiniteDuration());
+  FileContentPool::RegisterFileReader();
+  TmpdirUtil tmpdir("file_content_pool");
+  const std::string path = CreateFile(&tmpdir, "a.h", "#define A 1\n");
+  Put(path);
+
+  // Same size and mtime, so the content in the pool is used.
+  tmpdir.CreateTmpFile("a.h", "#define B 1\n");
+  UpdateMtime(path, mtime_);
+
+  std::unique_ptr<FileReader> reader =
+      FileReaderFactory::GetInstance()->NewFileReader(path);
+  ASSERT_TRUE(reader->valid());
+  size_t file_size = 0;
+  EXPECT_TRUE(reader->GetFileSize(&file_size));
+  EXPECT_EQ(12U, file_size);
+
+  char buf[8];
+  EXPECT_EQ(8, reader->Read(buf, sizeof(buf)));
+  EXPECT_EQ("#define ", std::string(buf, 8));
+  EXPECT_EQ(4, reader->Read(buf, sizeof(buf)));
+  EXPECT_EQ("A 1\n", std::string(buf, 4));
+  EXPECT_EQ(0, reader->Read(buf, sizeof(buf)));
+
+  EXPECT_EQ(2, reader->Seek(2, ScopedFd::SeekAbsolute));
+  EXPECT_EQ(4, reader->Seek(2, ScopedFd::SeekRelative));
+  EXPECT_EQ(8, reader->Read(buf, sizeof(buf)));
+  EXPECT_EQ("ine A 1\n", std::string(buf, 8));
+
+  // Not in the pool.
+  FileContentPool::Quit();
+  reader = FileReaderFactory::GetInstance()->NewFileReader(path);
+  ASSERT_TRUE(reader->valid());
+  EXPECT_EQ(8, reader->Read(buf, sizeof(buf)));
+  EXPECT_EQ(4, reader->Read(buf, sizeof(buf)));
+  EXPECT_EQ("B 1\n", std::string(buf, 4));
+}
+
+}  // namespace devtools_goma
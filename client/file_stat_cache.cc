@@ -5,26 +5,54 @@
 
 #include "file_stat_cache.h"
 
+#include <algorithm>
 #include <string>
+#include <utility>
 
 #include <glog/logging.h>
 
+#include "absl/hash/hash.h"
+#include "absl/time/clock.h"
 #include "autolock_timer.h"
 #include "counterz.h"
+#include "lib/goma_stats.pb.h"
 #include "path.h"
 
 namespace devtools_goma {
 
-// TODO: Add stats.
+constexpr size_t GlobalFileStatCache::kNumShards;
+
+GlobalFileStatCache::GlobalFileStatCache(size_t max_entries,
+                                         absl::Duration ttl)
+    : max_entries_per_shard_(
+          max_entries == 0 ? 0 : std::max<size_t>(max_entries / kNumShards, 1)),
+      ttl_(ttl) {}
+
+GlobalFileStatCache::Shard* GlobalFileStatCache::ShardFor(
+    const std::string& path) {
+  return &shards_[absl::Hash<std::string>()(path) % kNumShards];
+}
+
+bool GlobalFileStatCache::IsFresh(const Entry& entry, absl::Time now) const {
+  return ttl_ == absl::InfiniteDuration() || now - entry.cached_time < ttl_;
+}
 
 FileStat GlobalFileStatCache::Get(const std::string& path) {
+  Shard* shard = ShardFor(path);
+  const absl::Time now =
+      ttl_ == absl::InfiniteDuration() ? absl::InfinitePast() : absl::Now();
   {
-    AUTO_SHARED_LOCK(lock, &mu_);
-    auto it = file_stats_.find(path);
-    if (it != file_stats_.end()) {
-      return it->second;
+    AUTO_SHARED_LOCK(lock, &shard->mu);
+    auto it = shard->file_stats.find(path);
+    if (it != shard->file_stats.end()) {
+      if (IsFresh(it->second, now)) {
+        hit_.Add(1);
+        return it->second.file_stat;
+      }
+      stale_.Add(1);
     }
   }
+  miss_.Add(1);
 
   FileStat id(path);
   if (!id.IsValid() || id.is_directory) {
@@ -32,18 +60,56 @@ FileStat GlobalFileStatCache::Get(const std::string& path) {
   }
 
   {
-    AUTO_EXCLUSIVE_LOCK(lock, &mu_);
-    file_stats_.emplace(path, id);
+    AUTO_EXCLUSIVE_LOCK(lock, &shard->mu);
+    // The entry may be stale, or cached by other thread meanwhile.
+    // Replace it rather than evicting other entry to make a room.
+    auto it = shard->file_stats.find(path);
+    if (it != shard->file_stats.end()) {
+      shard->file_stats.erase(it);
+    }
+    EvictUnlocked(shard, now);
+    // Entries are kept in the order they were cached.
+    shard->file_stats.emplace_back(path, Entry{id, now});
   }
   return id;
 }
 
+void GlobalFileStatCache::EvictUnlocked(Shard* shard, absl::Time now) {
+  // The front entry is the oldest one, so stale entries are at front.
+  while (!shard->file_stats.empty()) {
+    const bool full = max_entries_per_shard_ > 0 &&
+                      shard->file_stats.size() >= max_entries_per_shard_;
+    if (!full && IsFresh(shard->file_stats.front().second, now)) {
+      return;
+    }
+    shard->file_stats.pop_front();
+    evicted_.Add(1);
+  }
+}
+
+size_t GlobalFileStatCache::Size() const {
+  size_t size = 0;
+  for (const auto& shard : shards_) {
+    AUTO_SHARED_LOCK(lock, &shard.mu);
+    size += shard.file_stats.size();
+  }
+  return size;
+}
+
+void GlobalFileStatCache::DumpStatsToProto(FileStatCacheStats* stats) const {
+  stats->set_entries(Size());
+  stats->set_hit(hit_.value());
+  stats->set_missed(miss_.value());
+  stats->set_stale(stale_.value());
+  stats->set_evicted(evicted_.value());
+}
+
 GlobalFileStatCache* GlobalFileStatCache::instance_ = nullptr;
 
 /* static */
-void GlobalFileStatCache::Init() {
+void GlobalFileStatCache::Init(size_t max_entries, absl::Duration ttl) {
   CHECK(instance_ == nullptr);
-  instance_ = new GlobalFileStatCache;
+  instance_ = new GlobalFileStatCache(max_entries, ttl);
 }
 
 /* static */
@@ -12,27 +12,74 @@
 
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
+#include "atomic_stats_counter.h"
 #include "basictypes.h"
 #include "file_stat.h"
+#include "linked_unordered_map.h"
 #include "lockhelper.h"
 #include "platform_thread.h"
 
 namespace devtools_goma {
 
+class FileStatCacheStats;
+
 // GlobalFileStatCache caches FileStats globally.
 // This only holds valid and non-directory FileStats.
+// Entries are split into shards by path so that threads looking up different
+// paths rarely contend on the same lock. An entry is stat'ed again when it is
+// older than ttl. When a shard is full, its oldest entries are evicted.
 // The instance of this class is thread-safe.
 class GlobalFileStatCache {
  public:
   FileStat Get(const std::string& path);
 
-  static void Init();
+  size_t Size() const;
+
+  void DumpStatsToProto(FileStatCacheStats* stats) const;
+
+  // |max_entries| is the limit of the number of cached entries. 0 means
+  // no limit. Entries older than |ttl| are not used.
+  // absl::InfiniteDuration() means entries never expire.
+  static void Init(size_t max_entries, absl::Duration ttl);
   static void Quit();
   static GlobalFileStatCache* Instance();
 
  private:
-  mutable ReadWriteLock mu_;
-  absl::flat_hash_map<std::string, FileStat> file_stats_ ABSL_GUARDED_BY(mu_);
+  static constexpr size_t kNumShards = 32;
+
+  struct Entry {
+    FileStat file_stat;
+    absl::Time cached_time;
+  };
+
+  struct Shard {
+    mutable ReadWriteLock mu;
+    // Oldest cached entry is at front.
+    LinkedUnorderedMap<std::string, Entry> file_stats ABSL_GUARDED_BY(mu);
+  };
+
+  GlobalFileStatCache(size_t max_entries, absl::Duration ttl);
+  GlobalFileStatCache(const GlobalFileStatCache&) = delete;
+  GlobalFileStatCache& operator=(const GlobalFileStatCache&) = delete;
+
+  Shard* ShardFor(const std::string& path);
+  bool IsFresh(const Entry& entry, absl::Time now) const;
+
+  // Makes room in |shard| for a new entry. Removes stale entries at front,
+  // and the oldest entries while |shard| is full.
+  void EvictUnlocked(Shard* shard, absl::Time now)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(shard->mu);
+
+  const size_t max_entries_per_shard_;
+  const absl::Duration ttl_;
+
+  Shard shards_[kNumShards];
+
+  StatsCounter hit_;
+  StatsCounter miss_;
+  StatsCounter stale_;
+  StatsCounter evicted_;
 
   static GlobalFileStatCache* instance_;
 };
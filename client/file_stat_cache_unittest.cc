@@ -0,0 +1,100 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "file_stat_cache.h"
+
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "lib/goma_stats.pb.h"
+#include "unittest_util.h"
+
+namespace devtools_goma {
+
+class GlobalFileStatCacheTest : public testing::Test {
+ protected:
+  void TearDown() override {
+    if (GlobalFileStatCache::Instance() != nullptr) {
+      GlobalFileStatCache::Quit();
+    }
+  }
+
+  static FileStatCacheStats Stats() {
+    FileStatCacheStats stats;
+    GlobalFileStatCache::Instance()->DumpStatsToProto(&stats);
+    return stats;
+  }
+};
+
+TEST_F(GlobalFileStatCacheTest, HitAndMiss) {
+  TmpdirUtil tmpdir("global_file_stat_cache");
+  tmpdir.CreateTmpFile("a.h", "a");
+  const std::string path = tmpdir.FullPath("a.h");
+
+  GlobalFileStatCache::Init(0, absl::InfiniteDuration());
+  GlobalFileStatCache* cache = GlobalFileStatCache::Instance();
+
+  FileStat file_stat = cache->Get(path);
+  EXPECT_TRUE(file_stat.IsValid());
+  EXPECT_EQ(file_stat, cache->Get(path));
+
+  // Missing files and directories are not cached.
+  EXPECT_FALSE(cache->Get(tmpdir.FullPath("missing.h")).IsValid());
+  EXPECT_TRUE(cache->Get(tmpdir.tmpdir()).is_directory);
+
+  FileStatCacheStats stats = Stats();
+  EXPECT_EQ(1, stats.entries());
+  EXPECT_EQ(1, stats.hit());
+  EXPECT_EQ(3, stats.missed());
+  EXPECT_EQ(0, stats.stale());
+  EXPECT_EQ(0, stats.evicted());
+}
+
+TEST_F(GlobalFileStatCacheTest, Ttl) {
+  TmpdirUtil tmpdir("global_file_stat_cache");
+  tmpdir.CreateTmpFile("a.h", "a");
+  const std::string path = tmpdir.FullPath("a.h");
+
+  // Every entry is already expired when it is looked up.
+  GlobalFileStatCache::Init(0, absl::ZeroDuration());
+  GlobalFileStatCache* cache = GlobalFileStatCache::Instance();
+
+  cache->Get(path);
+  tmpdir.CreateTmpFile("a.h", "updated a");
+  EXPECT_EQ(9, cache->Get(path).size);
+
+  FileStatCacheStats stats = Stats();
+  EXPECT_EQ(1, stats.entries());
+  EXPECT_EQ(0, stats.hit());
+  EXPECT_EQ(2, stats.missed());
+  EXPECT_EQ(1, stats.stale());
+}
+
+TEST_F(GlobalFileStatCacheTest, Bounded) {
+  constexpr int kMaxEntries = 64;
+  constexpr int kNumFiles = 1000;
+  TmpdirUtil tmpdir("global_file_stat_cache");
+  for (int i = 0; i < kNumFiles; ++i) {
+    tmpdir.CreateTmpFile(absl::StrCat(i, ".h"), "");
+  }
+
+  GlobalFileStatCache::Init(kMaxEntries, absl::InfiniteDuration());
+  GlobalFileStatCache* cache = GlobalFileStatCache::Instance();
+  for (int i = 0; i < kNumFiles; ++i) {
+    EXPECT_TRUE(cache->Get(tmpdir.FullPath(absl::StrCat(i, ".h"))).IsValid());
+  }
+
+  // Only the oldest entries are evicted, so every shard stays full.
+  FileStatCacheStats stats = Stats();
+  EXPECT_EQ(kMaxEntries, stats.entries());
+  EXPECT_EQ(kNumFiles - kMaxEntries, stats.evicted());
+
+  // The most recently cached file is still cached.
+  cache->Get(tmpdir.FullPath(absl::StrCat(kNumFiles - 1, ".h")));
+  EXPECT_EQ(1, Stats().hit());
+}
+
+}  // namespace devtools_goma
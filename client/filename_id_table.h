@@ -9,19 +9,19 @@
 #include <set>
 #include <string>
 
-#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
-#include "autolock_timer.h"
+#include "basictypes.h"
+#include "value_id_table.h"
 
 namespace devtools_goma {
 
 class GomaFilenameIdTable;
 
 // FilenameIdTable converts filepath <-> integer id.
-// The instance of this class is thread-safe.
+// The instance of this class is thread-safe. Conversions don't take a lock.
 class FilenameIdTable {
  public:
-  typedef int Id;
+  typedef ValueIDTable<std::string>::Id Id;
 
   static const Id kInvalidId;
 
@@ -55,18 +55,7 @@ class FilenameIdTable {
   Id ToId(const std::string& filename) const;
 
  private:
-  bool InsertEntryUnlocked(const std::string& filename, Id id)
-      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
-
-  void ClearUnlocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
-
-  Id LookupIdUnlocked(const std::string& filename) const
-      ABSL_SHARED_LOCKS_REQUIRED(mu_);
-
-  mutable ReadWriteLock mu_;
-  Id next_available_id_ ABSL_GUARDED_BY(mu_);
-  absl::flat_hash_map<Id, std::string> map_to_filename_ ABSL_GUARDED_BY(mu_);
-  absl::flat_hash_map<std::string, Id> map_to_id_ ABSL_GUARDED_BY(mu_);
+  ValueIDTable<std::string> table_;
 
   DISALLOW_COPY_AND_ASSIGN(FilenameIdTable);
 };
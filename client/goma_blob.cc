@@ -23,6 +23,9 @@ BlobClient::Downloader::OutputFileInfo::NewFileDataOutput() {
   if (this->tmp_filename.empty()) {
     return FileDataOutput::NewStringOutput(this->filename, &this->content);
   }
+  if (this->pending_output) {
+    return this->pending_output->NewFileDataOutput();
+  }
   const auto& filename = this->tmp_filename;
   // TODO: We might want to restrict paths this program may write?
   remove(filename.c_str());
@@ -91,6 +91,11 @@ class BlobClient {
       // it will be used iff tmp_filename == "".
       std::string content;
 
+      // pending_output is set if the output is written in a place other than
+      // filename, and will be committed to filename in CommitOutput().
+      // If set, NewFileDataOutput() writes in it instead of tmp_filename.
+      std::unique_ptr<PendingFileOutput> pending_output;
+
       // Generates a FileDataOutput object based on the output destination
       // described by this struct.
       // Note that this might acquire a pointer to the contents of this struct.
@@ -201,7 +201,7 @@ TEST(BlobClient, ExampleDownload) {
 class ExampleFileServiceHttpClient : public FileServiceHttpClient {
  public:
   ExampleFileServiceHttpClient()
-      : FileServiceHttpClient(nullptr, "", "", nullptr) {}
+      : FileServiceHttpClient(nullptr, "", "", nullptr, nullptr) {}
   ~ExampleFileServiceHttpClient() override = default;
 
   std::unique_ptr<AsyncTask<StoreFileReq, StoreFileResp>>
@@ -256,4 +256,44 @@ TEST(FileBlobClient, ExampleDownloadEmbedded) {
             info_string.content);
 }
 
+TEST(FileBlobClient, ExampleDownloadPending) {
+  std::unique_ptr<FileBlobClient> blob_client =
+      absl::make_unique<FileBlobClient>(
+          absl::make_unique<ExampleFileServiceHttpClient>());
+
+  RequesterInfo requester_info;
+  std::unique_ptr<BlobClient::Downloader> downloader =
+      blob_client->NewDownloader(requester_info, "trace_id");
+
+  ScopedTmpFile temp_file("file");
+  EXPECT_TRUE(temp_file.valid());
+  EXPECT_TRUE(temp_file.Close());
+  const std::string& filename = temp_file.filename();
+
+  ExecResult_Output output;
+  output.set_filename(filename);
+  FileBlob* blob = output.mutable_blob();
+  blob->set_blob_type(FileBlob::FILE);
+  blob->set_content("The quick brown fox jumps over the lazy dog.");
+  blob->set_file_size(blob->content().size());
+
+  BlobClient::Downloader::OutputFileInfo info_file;
+  info_file.filename = filename;
+  info_file.tmp_filename = filename + ".tmp";
+  info_file.mode = 0644;
+  info_file.size = blob->file_size();
+  info_file.pending_output = absl::make_unique<PendingFileOutput>(
+      info_file.filename, info_file.tmp_filename, info_file.mode,
+      info_file.size);
+  EXPECT_TRUE(downloader->Download(output, &info_file));
+  std::string output_contents;
+  EXPECT_TRUE(ReadFileToString(filename, &output_contents));
+  EXPECT_EQ("", output_contents);
+
+  EXPECT_TRUE(info_file.pending_output->Commit());
+  EXPECT_TRUE(ReadFileToString(filename, &output_contents));
+  EXPECT_EQ(output_contents, "The quick brown fox jumps over the lazy dog.");
+  EXPECT_FALSE(ReadFileToString(info_file.tmp_filename, &output_contents));
+}
+
 }  // namespace devtools_goma
@@ -6,6 +6,7 @@
 
 #include <string.h>
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <sstream>
@@ -28,6 +29,7 @@
 #include "ioutil.h"
 #include "oauth2.h"
 #include "platform_thread.h"
+#include "range_downloader.h"
 #include "socket_factory.h"
 #include "worker_thread_manager.h"
 
@@ -35,6 +37,7 @@
 
 using devtools_goma::HttpClient;
 using devtools_goma::PlatformThread;
+using devtools_goma::RangeDownloader;
 using devtools_goma::WorkerThreadManager;
 using devtools_goma::WorkerThreadRunner;
 
@@ -103,6 +106,47 @@ class Fetcher {
   DISALLOW_COPY_AND_ASSIGN(Fetcher);
 };
 
+// RangeFetcher downloads to a file by using RangeDownloader.
+class RangeFetcher {
+ public:
+  // Takes ownership of HttpClient.
+  RangeFetcher(std::unique_ptr<HttpClient> client,
+               WorkerThreadManager* wm,
+               RangeDownloader::Options options)
+      : client_(std::move(client)),
+        downloader_(absl::make_unique<RangeDownloader>(
+            client_.get(), wm, std::move(options))) {}
+
+  void Run() {
+    ok_ = downloader_->Run();
+    status_ = downloader_->status();
+    if (ok_) {
+      LOG(INFO) << "get done sha256=" << downloader_->sha256() << " "
+                << status_.DebugString();
+    } else {
+      error_message_ = downloader_->error_message();
+      LOG(INFO) << "get failed " << error_message_ << " "
+                << status_.DebugString();
+    }
+    downloader_.reset();
+    client_->WaitNoActive();
+    client_.reset();
+  }
+
+  bool ok() const { return ok_; }
+  const HttpClient::Status& status() const { return status_; }
+  const std::string& error_message() const { return error_message_; }
+
+ private:
+  std::unique_ptr<HttpClient> client_;
+  std::unique_ptr<RangeDownloader> downloader_;
+  bool ok_ = false;
+  HttpClient::Status status_;
+  std::string error_message_;
+
+  DISALLOW_COPY_AND_ASSIGN(RangeFetcher);
+};
+
 DEFINE_bool(auth, false, "Enable Authentication.");
 DEFINE_string(output, "", "Output filename.");
 DEFINE_bool(head, false, "Do a request with HEAD method.");
@@ -111,6 +155,51 @@ DEFINE_string(data, "", "Message body of POST request.");
 DEFINE_string(data_file, "", "A file that has message body of POST request.");
 DEFINE_string(content_type, "application/x-www-form-urlencoded",
               "content-type header used for POST request.");
+DEFINE_int32(connections, 4,
+             "Number of parallel Range requests to download to --output. "
+             "If 1, downloads with a single request unless --sha256 is set.");
+DEFINE_int32(range_size_mb, 8, "Size of a Range request in MiB.");
+DEFINE_string(sha256, "",
+              "Expected SHA-256 in hex of the content downloaded to --output. "
+              "--output is not written if it doesn't match.");
+
+// Downloads |url| to --output by using RangeDownloader.
+// Returns exit code.
+int RangeFetch(WorkerThreadManager* wm,
+               std::unique_ptr<HttpClient> client,
+               absl::string_view url,
+               absl::string_view output) {
+  RangeDownloader::Options options;
+  options.filename = std::string(output);
+  options.num_connections = FLAGS_connections;
+  options.range_size = int64_t{FLAGS_range_size_mb} * 1024 * 1024;
+  options.max_tries = std::max(1, FLAGS_FETCH_RETRY);
+  options.sha256 = FLAGS_sha256;
+  auto fetcher = absl::make_unique<RangeFetcher>(
+      std::move(client), wm, std::move(options));
+
+  std::unique_ptr<WorkerThreadRunner> fetch(
+      absl::make_unique<WorkerThreadRunner>(
+          wm, FROM_HERE,
+          devtools_goma::NewCallback(
+              fetcher.get(),
+              &RangeFetcher::Run)));
+  devtools_goma::FlushLogFiles();
+  fetch->Wait();
+  LOG(INFO) << "fetch done";
+  devtools_goma::FlushLogFiles();
+  fetch.reset();
+  wm->Finish();
+  devtools_goma::FlushLogFiles();
+  if (!fetcher->ok()) {
+    LOG(ERROR) << "fetch GET " << url
+               << " err=" << fetcher->status().err
+               << " http code:" << fetcher->status().http_return_code
+               << " " << fetcher->error_message();
+    return 1;
+  }
+  return 0;
+}
 
 }  // anonymous namespace
 
@@ -162,8 +251,17 @@ int main(int argc, char* argv[], const char* envp[]) {
   WinsockHelper wsa;
 #endif
 
+  if (FLAGS_connections < 1 || FLAGS_range_size_mb < 1) {
+    std::cerr << "--connections and --range_size_mb must be positive."
+              << std::endl;
+    exit(1);
+  }
+  // Downloads to --output with parallel Range requests.
+  const bool range_fetch = !output.empty() && method == "GET" &&
+                           (FLAGS_connections > 1 || !FLAGS_sha256.empty());
+
   WorkerThreadManager wm;
-  wm.Start(2);
+  wm.Start(range_fetch ? FLAGS_connections + 1 : 2);
 
   HttpClient::Options http_options;
   devtools_goma::InitHttpClientOptions(&http_options);
@@ -192,6 +290,10 @@ int main(int argc, char* argv[], const char* envp[]) {
       HttpClient::NewTLSEngineFactoryFromOptions(http_options),
       http_options, &wm));
 
+  if (range_fetch) {
+    return RangeFetch(&wm, std::move(client), url, output);
+  }
+
   HttpClient::Request* req = nullptr;
   auto httpreq(absl::make_unique<devtools_goma::HttpRequest>());
   httpreq->AddHeader("Connection", "close");
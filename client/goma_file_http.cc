@@ -14,21 +14,40 @@
 MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
 #include "lib/goma_data.pb.h"
 MSVC_POP_WARNING()
+#include "callback.h"
 #include "goma_file.h"
 #include "http_rpc.h"
 #include "lockhelper.h"
+#include "upload_scheduler.h"
 
 namespace {
 
+// Called when an upload of |size| bytes has finished.
+void ReleaseUpload(devtools_goma::UploadScheduler* upload_scheduler,
+                   size_t size) {
+  upload_scheduler->Release(size);
+}
+
+void StartStoreFile(devtools_goma::MultiFileStore* multi_file_store,
+                    devtools_goma::HttpRPC::Status* status,
+                    const devtools_goma::StoreFileReq* req,
+                    devtools_goma::StoreFileResp* resp,
+                    devtools_goma::OneshotClosure* callback) {
+  multi_file_store->StoreFile(status, req, resp, callback);
+}
+
 template<typename Req, typename Resp>
 class HttpTask : public devtools_goma::FileServiceClient::AsyncTask<Req, Resp> {
  public:
+  // |upload_scheduler| may be nullptr.
   HttpTask(devtools_goma::FileServiceHttpClient* file_service,
            std::string path,
-           const std::string& trace_id)
+           const std::string& trace_id,
+           devtools_goma::UploadScheduler* upload_scheduler)
       : file_service_(file_service),
         http_(file_service->http()),
-        path_(std::move(path)) {
+        path_(std::move(path)),
+        upload_scheduler_(upload_scheduler) {
     std::ostringstream ss;
     if (!trace_id.empty()) {
       ss << trace_id << " ";
@@ -43,11 +62,16 @@ class HttpTask : public devtools_goma::FileServiceClient::AsyncTask<Req, Resp> {
 
   void Run() override {
     status_.finished = false;
-    Req* req =
-        devtools_goma::FileServiceClient::AsyncTask<Req, Resp>::mutable_req();
-    Resp* resp =
-        devtools_goma::FileServiceClient::AsyncTask<Req, Resp>::mutable_resp();
-    http_->CallWithCallback(path_, req, resp, &status_, nullptr);
+    if (upload_scheduler_ == nullptr) {
+      Start();
+      return;
+    }
+    upload_size_ = devtools_goma::FileServiceClient::AsyncTask<Req, Resp>::req()
+                       .ByteSizeLong();
+    // Start() may run later on a thread releasing upload budget.
+    upload_scheduler_->Acquire(upload_size_,
+                               devtools_goma::NewCallback(
+                                   this, &HttpTask<Req, Resp>::Start));
   }
 
   void Wait() override {
@@ -57,10 +81,27 @@ class HttpTask : public devtools_goma::FileServiceClient::AsyncTask<Req, Resp> {
   bool IsSuccess() const override { return status_.err == 0; }  // OK
 
  private:
+  void Start() {
+    Req* req =
+        devtools_goma::FileServiceClient::AsyncTask<Req, Resp>::mutable_req();
+    Resp* resp =
+        devtools_goma::FileServiceClient::AsyncTask<Req, Resp>::mutable_resp();
+    // The budget is released when the call finishes, not in Wait(), so
+    // that queued uploads don't depend on the order tasks are waited.
+    devtools_goma::OneshotClosure* done = nullptr;
+    if (upload_scheduler_ != nullptr) {
+      done = devtools_goma::NewCallback(&ReleaseUpload, upload_scheduler_,
+                                        upload_size_);
+    }
+    http_->CallWithCallback(path_, req, resp, &status_, done);
+  }
+
   devtools_goma::FileServiceHttpClient* file_service_;
   devtools_goma::HttpRPC* http_;
   std::string path_;
   devtools_goma::HttpRPC::Status status_;
+  devtools_goma::UploadScheduler* upload_scheduler_;
+  size_t upload_size_ = 0;
 
   // disallow copy and assign
   HttpTask(const HttpTask&);
@@ -74,12 +115,14 @@ namespace devtools_goma {
 FileServiceHttpClient::FileServiceHttpClient(HttpRPC* http,
                                              std::string store_path,
                                              std::string lookup_path,
-                                             MultiFileStore* multi_file_store)
+                                             MultiFileStore* multi_file_store,
+                                             UploadScheduler* upload_scheduler)
     : http_(http),
       store_path_(std::move(store_path)),
       lookup_path_(std::move(lookup_path)),
       num_rpc_(0),
-      multi_file_store_(multi_file_store) {}
+      multi_file_store_(multi_file_store),
+      upload_scheduler_(upload_scheduler) {}
 
 FileServiceHttpClient::~FileServiceHttpClient() {
 }
@@ -90,7 +133,7 @@ FileServiceHttpClient::WithRequesterInfoAndTraceId(
     const std::string& trace_id) const {
   std::unique_ptr<FileServiceHttpClient> cloned(
       new FileServiceHttpClient(http_, store_path_, lookup_path_,
-                                multi_file_store_));
+                                multi_file_store_, upload_scheduler_));
   cloned->requester_info_ = absl::make_unique<RequesterInfo>();
   *cloned->requester_info_ = requester_info;
   cloned->trace_id_ = trace_id;
@@ -102,7 +145,7 @@ FileServiceHttpClient::NewAsyncStoreFileTask() {
   return std::unique_ptr<
     FileServiceClient::AsyncTask<StoreFileReq, StoreFileResp>>(
         new HttpTask<StoreFileReq, StoreFileResp>(
-            this, store_path_, trace_id_));
+            this, store_path_, trace_id_, upload_scheduler_));
 }
 
 std::unique_ptr<FileServiceClient::AsyncTask<LookupFileReq, LookupFileResp>>
@@ -110,7 +153,7 @@ FileServiceHttpClient::NewAsyncLookupFileTask() {
   return std::unique_ptr<
     FileServiceClient::AsyncTask<LookupFileReq, LookupFileResp>>(
         new HttpTask<LookupFileReq, LookupFileResp>(
-            this, lookup_path_, trace_id_));
+            this, lookup_path_, trace_id_, nullptr));
 }
 
 bool FileServiceHttpClient::StoreFile(
@@ -122,7 +165,16 @@ bool FileServiceHttpClient::StoreFile(
   }
   ss << "StoreFile " << req->blob_size() << "blobs";
   status.trace_id = ss.str();
-  multi_file_store_->StoreFile(&status, req, resp, nullptr);
+  if (upload_scheduler_ == nullptr) {
+    multi_file_store_->StoreFile(&status, req, resp, nullptr);
+  } else {
+    const size_t size = req->ByteSizeLong();
+    upload_scheduler_->Acquire(
+        size,
+        NewCallback(&StartStoreFile, multi_file_store_,
+                    static_cast<HttpRPC::Status*>(&status), req, resp,
+                    NewCallback(&ReleaseUpload, upload_scheduler_, size)));
+  }
   http_->Wait(&status);
   AddHttpRPCStatus(status);
   return status.err == 0;
@@ -154,6 +206,9 @@ void FileServiceHttpClient::AddHttpRPCStatus(const HttpRPC::Status& status) {
   status_.wait_time += status.wait_time;
   status_.resp_recv_time += status.resp_recv_time;
   status_.resp_parse_time += status.resp_parse_time;
+  status_.req_build_cpu_time += status.req_build_cpu_time;
+  status_.resp_parse_cpu_time += status.resp_parse_cpu_time;
+  status_.wait_cpu_time += status.wait_cpu_time;
 }
 
 }  // namespace devtools_goma
@@ -17,14 +17,17 @@ namespace devtools_goma {
 
 class Closure;
 class RequesterInfo;
+class UploadScheduler;
 
 class FileServiceHttpClient : public FileServiceClient {
  public:
-  // It doesn't take ownership of http and multi_file_store.
+  // It doesn't take ownership of http, multi_file_store and
+  // upload_scheduler. upload_scheduler may be nullptr.
   FileServiceHttpClient(HttpRPC* http,
                         std::string store_path,
                         std::string lookup_path,
-                        MultiFileStore* multi_file_store);
+                        MultiFileStore* multi_file_store,
+                        UploadScheduler* upload_scheduler);
   ~FileServiceHttpClient() override;
 
   // This function doesn't clone |status_|.
@@ -62,6 +65,9 @@ class FileServiceHttpClient : public FileServiceClient {
   // for multi store
   MultiFileStore* multi_file_store_;
 
+  // Orders StoreFile requests. nullptr if not used.
+  UploadScheduler* upload_scheduler_;
+
   DISALLOW_COPY_AND_ASSIGN(FileServiceHttpClient);
 };
 
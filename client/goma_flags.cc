@@ -242,6 +242,16 @@ GOMA_DEFINE_AUTOCONF_int32(COMPILER_PROXY_HTTP_THREADS,
                            "http/ipc request.");
 GOMA_DEFINE_AUTOCONF_int32(INCLUDE_PROCESSOR_THREADS, NumDefaultProxyThreads,
                            "Number of threads for include processor.");
+GOMA_DEFINE_int32(INCLUDE_PROCESSOR_MIN_THREADS, 0,
+                  "If positive and less than INCLUDE_PROCESSOR_THREADS, "
+                  "the number of active include processor threads is tuned "
+                  "between this and INCLUDE_PROCESSOR_THREADS from queue "
+                  "wait and CPU load. Otherwise, it is fixed to "
+                  "INCLUDE_PROCESSOR_THREADS.");
+GOMA_DEFINE_int32(INCLUDE_PROCESSOR_TUNE_PERIOD_MS, 1000,
+                  "Interval in milliseconds to tune the number of active "
+                  "include processor threads. "
+                  "Used if INCLUDE_PROCESSOR_MIN_THREADS is enabled.");
 #ifdef _WIN32
 #define DEFAULT_MAX_OVERCOMIT_INCOMING_SOCKETS 64
 #else
@@ -294,6 +304,11 @@ GOMA_DEFINE_int32(LOCAL_RUN_PREFERENCE, 3,
                   "ignore goma. ");
 GOMA_DEFINE_bool(LOCAL_RUN_FOR_FAILED_INPUT, true,
                  "Prefer local run for previous failed input filename. ");
+GOMA_DEFINE_int32(HEAVY_WEIGHT_LOCAL_MEMORY_MB, 2048,
+                  "Treat a subprocess as heavy weight if a previous local run "
+                  "for the same input used this much anonymous memory or "
+                  "more. Effective only if local runs are in cgroup v2 by "
+                  "GOMA_CGROUP_ROOT. 0 disables it.");
 GOMA_DEFINE_int32(LOCAL_RUN_DELAY_MSEC, 0,
                   "msec to delay for idle fallback.");
 GOMA_DEFINE_AUTOCONF_int32(
@@ -325,6 +340,29 @@ GOMA_DEFINE_AUTOCONF_int32(BURST_MAX_SUBPROCS_LOW, MaxBurstSubProcs,
 GOMA_DEFINE_AUTOCONF_int32(BURST_MAX_SUBPROCS_HEAVY, MaxBurstSubProcsHeavy,
                            "Maximum number of subprocesses with heavy weight "
                            "when remote server is not available.");
+GOMA_DEFINE_string(CGROUP_ROOT, "",
+                   "Absolute path of a delegated cgroup v2 directory for "
+                   "local subprocesses (Linux only). compiler_proxy makes "
+                   "normal, low_priority and verify cgroups in it, and runs "
+                   "each subprocess in its own cgroup to account peak memory "
+                   "and CPU time. The directory must be writable and must "
+                   "not contain processes. Empty disables cgroup.");
+GOMA_DEFINE_int32(CGROUP_MEMORY_HIGH_MB, 0,
+                  "memory.high in MB of the cgroup for normal local "
+                  "subprocesses. 0 means no limit.");
+GOMA_DEFINE_int32(CGROUP_LOW_PRIORITY_MEMORY_HIGH_MB, 0,
+                  "memory.high in MB of the cgroup for low priority local "
+                  "subprocesses. 0 means no limit.");
+GOMA_DEFINE_int32(CGROUP_VERIFY_MEMORY_HIGH_MB, 0,
+                  "memory.high in MB of the cgroup for local subprocesses "
+                  "to verify output. 0 means no limit.");
+GOMA_DEFINE_int32(CGROUP_LOW_PRIORITY_WEIGHT, 20,
+                  "cpu.weight and io.weight of the cgroup for low priority "
+                  "local subprocesses. Normal subprocesses have 100.");
+GOMA_DEFINE_int32(CGROUP_VERIFY_WEIGHT, 50,
+                  "cpu.weight and io.weight of the cgroup for local "
+                  "subprocesses to verify output. Normal subprocesses have "
+                  "100.");
 GOMA_DEFINE_int32(MAX_SUBPROCS_PENDING, 3,
                   "Threshold to prefer local run to remote goma.");
 // TODO: autoconf
@@ -356,6 +394,12 @@ GOMA_DEFINE_int32(MULTI_STORE_THRESHOLD_SIZE_IN_CALL, 12 * 1024 * 1024,
                   "Threshold size to issue StoreFileReq");
 GOMA_DEFINE_int32(MULTI_STORE_PENDING_MS, 100,
                   "Pending time in ms to issue StoreFileReq.");
+GOMA_DEFINE_int32(UPLOAD_MAX_BYTES_IN_FLIGHT, 32 * 1024 * 1024,
+                  "Max bytes of StoreFileReq in flight. Other uploads wait "
+                  "and are sent shortest first. 0 for no limit.");
+GOMA_DEFINE_int32(UPLOAD_MAX_QUEUE_WAIT_MS, 2000,
+                  "An upload waiting longer than this is sent before smaller "
+                  "ones. Effective only if GOMA_UPLOAD_MAX_BYTES_IN_FLIGHT>0.");
 GOMA_DEFINE_int32(NUM_LOG_IN_SAVE_LOG, 512,
                   "Number of ExecLog in SaveLogReq");
 GOMA_DEFINE_int32(LOG_PENDING_MS, 30 * 1000,
@@ -460,6 +504,11 @@ GOMA_DEFINE_int32(DEPS_CACHE_MAX_PROTO_SIZE_IN_MB,
                   "The max size of DepsCache file. If the file size exceeds "
                   "this limit, loading will fail. Unit is MB."
                   "If negative, the default limit is used. i.e. INT_MAX");
+GOMA_DEFINE_bool(DEPS_CACHE_ASYNC_UPDATE, true,
+                 "Update DepsCache in a background thread, so that compile "
+                 "tasks don't wait for directive hash computation and "
+                 "DepsCache lock. Updates for the same identifier are "
+                 "coalesced.");
 GOMA_DEFINE_string(COMPILER_INFO_CACHE_FILE, "compiler_info_cache",
                    "Filename of compiler_info's cache. "
                    "If empty, compiler_info cache file is not used. "
@@ -469,6 +518,22 @@ GOMA_DEFINE_bool(ENABLE_GLOBAL_FILE_STAT_CACHE,
                  "Enable global file stat cache. "
                  "Do not enable this flag when any source file would be "
                  "changed between compilations.");
+GOMA_DEFINE_int32(GLOBAL_FILE_STAT_CACHE_MAX_ENTRIES,
+                  1 << 20,
+                  "The max number of entries in global file stat cache. "
+                  "If 0, the cache size is not limited.");
+GOMA_DEFINE_int32(GLOBAL_FILE_STAT_CACHE_TTL_SEC,
+                  0,
+                  "Entries in global file stat cache older than this are "
+                  "stat'ed again. If 0, entries never expire.");
+GOMA_DEFINE_int32(FILE_CONTENT_POOL_SIZE_MB,
+                  64,
+                  "The max total size of file contents read by include "
+                  "processing and kept to hash and upload inputs without "
+                  "reading them again. If 0, contents are not kept.");
+GOMA_DEFINE_int32(FILE_CONTENT_POOL_TTL_SEC,
+                  60,
+                  "File contents kept longer than this are not used.");
 GOMA_DEFINE_int32(COMPILER_INFO_CACHE_NUM_ENTRIES,
                   10000,
                   "Maximum number of entries of CompilerInfo in cache "
@@ -480,6 +545,11 @@ GOMA_DEFINE_int32(COMPILER_INFO_CACHE_HOLDING_TIME_SEC, 60 * 60 * 24 * 30,
 GOMA_DEFINE_string(DUMP_STATS_FILE, "",
                    "Filename to dump stats at the end of compiler_proxy."
                    "If empty, nothing will be dumped.");
+GOMA_DEFINE_string(EXEC_REQ_RECORD_FILE, "",
+                   "Filename to record ExecReqs from gomacc in, so that "
+                   "they can be replayed by goma_loadtest --replay. "
+                   "The file is complete when compiler_proxy exits. "
+                   "If empty, nothing will be recorded.");
 #ifdef HAVE_COUNTERZ
 GOMA_DEFINE_string(DUMP_COUNTERZ_FILE, "",
                    "Filename to dump counterz stat at the end of "
@@ -580,6 +650,12 @@ GOMA_DEFINE_int32(MEMORY_WARNING_THRESHOLD_IN_MB,
                   " shown.");
 
 GOMA_DEFINE_bool(ENABLE_CONTENTIONZ, true, "Enable contentionz");
+GOMA_DEFINE_int32(LOCK_WAIT_GRAPH_SAMPLE_RATE,
+                  0,
+                  "If positive, lock acquisitions record which call site "
+                  "holds the lock, and 1 in this number of them chosen at "
+                  "random records its wait. lockwaitz shows wait time per "
+                  "waiter and holder call site pair. Requires contentionz.");
 
 GOMA_DEFINE_int32(ALLOWED_NETWORK_ERROR_DURATION, -1,
                   "Compiler_proxy will make compile error after this duration "
@@ -591,6 +667,24 @@ GOMA_DEFINE_int32(NETWORK_ERROR_THRESHOLD_PERCENT, -1,
                   "percentage."
                   "Use the default value if negative value is given.");
 
+GOMA_DEFINE_bool(CIRCUIT_BREAKER, true,
+                 "If true, compile tasks run locally without preparing "
+                 "remote compile while most of recent HTTP requests to the "
+                 "backend fail or are slow. A few tasks probe the backend "
+                 "after CIRCUIT_BREAKER_OPEN_DURATION_SEC to recover.");
+GOMA_DEFINE_int32(CIRCUIT_BREAKER_FAILURE_THRESHOLD_PERCENT, 50,
+                  "The circuit breaker opens if failed or slow HTTP "
+                  "requests in the last 10 seconds are this percentage or "
+                  "more.");
+GOMA_DEFINE_int32(CIRCUIT_BREAKER_SLOW_RESPONSE_SEC, 60,
+                  "HTTP requests slower than this (in seconds) are counted as "
+                  "failures by the circuit breaker. "
+                  "If 0 or negative, latency is not considered.");
+GOMA_DEFINE_int32(CIRCUIT_BREAKER_OPEN_DURATION_SEC, 5,
+                  "Duration (in seconds) the circuit breaker stays open "
+                  "before probing the backend. It is doubled up to 60 "
+                  "seconds while probes fail.");
+
 GOMA_DEFINE_bool(FAIL_FAST, false,
                  "fail fast mode of compiler proxy.");
 
@@ -620,6 +714,21 @@ GOMA_DEFINE_int32(MAX_COMPILER_DISABLED_TASKS, -1,
 GOMA_DEFINE_bool(SEND_COMPILER_BINARY_AS_INPUT,
                  false,
                  "EXPERIMENTAL. Send a compiler binary as an input.");
+GOMA_DEFINE_bool(USE_INPUT_MANIFEST,
+                 false,
+                 "EXPERIMENTAL. Refer to input lists shared by many compiles "
+                 "by a single digest (input manifest) in ExecReq, if the goma "
+                 "server supports it.");
+GOMA_DEFINE_int32(INPUT_MANIFEST_MAX_MANIFESTS,
+                  64,
+                  "The max number of input manifests kept in compiler_proxy. "
+                  "Effective only if GOMA_USE_INPUT_MANIFEST=true.");
+GOMA_DEFINE_int32(LIKELY_MISSING_INPUT_WINDOW_SEC,
+                  600,
+                  "After goma server reported a missing input, send contents "
+                  "of other inputs in its directory for this period unless "
+                  "they are known to be in goma server. "
+                  "0 to disable.");
 GOMA_DEFINE_bool(USE_USER_SPECIFIED_PATH_FOR_SUBPROGRAMS,
                  false,
                  "EXPERIMENTAL. Send a subprogram spec with "
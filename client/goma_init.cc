@@ -37,8 +37,13 @@ void Init(int argc, char* argv[], const char* envp[]) {
     exit(0);
   }
 #ifndef NO_AUTOLOCK_STAT
-  if (FLAGS_ENABLE_CONTENTIONZ)
+  if (FLAGS_ENABLE_CONTENTIONZ) {
     g_auto_lock_stats = new AutoLockStats;
+    if (FLAGS_LOCK_WAIT_GRAPH_SAMPLE_RATE > 0) {
+      g_lock_wait_graph =
+          new LockWaitGraph(FLAGS_LOCK_WAIT_GRAPH_SAMPLE_RATE);
+    }
+  }
 #endif
 
   const std::string username = GetUsernameNoEnv();
@@ -89,6 +89,12 @@ Json::Value VectorToJson(const std::vector<T>& vec) {
   return v;
 }
 
+// Returns true if |status_code| is a successful response with body.
+// 206 is only returned to requests with Range header.
+bool IsOkStatusCode(int status_code) {
+  return status_code == 200 || status_code == 206;
+}
+
 bool IsFatalNetworkErrorCode(int status_code) {
   return status_code == 302 || status_code == 401 || status_code == 403;
 }
@@ -252,6 +258,11 @@ std::string HttpClient::Options::DebugString() const {
   if (fail_fast) {
     ss << " fail_fast";
   }
+  if (enable_circuit_breaker) {
+    ss << " circuit_breaker="
+       << circuit_breaker.failure_threshold_percent << "%/"
+       << circuit_breaker.window;
+  }
   return ss.str();
 }
 
@@ -436,6 +447,7 @@ class HttpClient::Task {
     const absl::Duration timeout = status_->timeouts.front();
     status_->timeouts.pop_front();
     timer_.Start();
+    ThreadCpuTimer cpu_timer;
     request_stream_ = req_->NewStream();
     if (!request_stream_) {
       LOG(WARNING) << status_->trace_id << " failed to create request stream";
@@ -443,6 +455,7 @@ class HttpClient::Task {
       return;
     }
     status_->req_build_time = timer_.GetDuration();
+    status_->req_build_cpu_time = cpu_timer.GetDuration();
 
     descriptor_->NotifyWhenWritable(
         NewPermanentCallback(this, &HttpClient::Task::DoWrite));
@@ -567,15 +580,18 @@ class HttpClient::Task {
               << resp_->Header();
       status_->resp_recv_time = timer_.GetDuration();
       timer_.Start();
+      ThreadCpuTimer cpu_timer;
       resp_->Parse();
       status_->resp_parse_time = timer_.GetDuration();
+      status_->resp_parse_cpu_time = cpu_timer.GetDuration();
       status_->resp_size = resp_->total_recv_len();
-      if (resp_->status_code() != 200 || resp_->result() == FAIL) {
+      if (!IsOkStatusCode(resp_->status_code()) ||
+          resp_->result() == FAIL) {
         DCHECK_EQ(close_state_, HttpClient::ERROR_CLOSE);
         CaptureResponseHeader();
       } else {
         DCHECK_EQ(resp_->result(), OK);
-        DCHECK_EQ(resp_->status_code(), 200);
+        DCHECK(IsOkStatusCode(resp_->status_code())) << resp_->status_code();
 
         if (resp_->HasConnectionClose() ||
             !client_->options().reuse_connection) {
@@ -586,7 +602,7 @@ class HttpClient::Task {
       }
       status_->http_return_code = resp_->status_code();
       DCHECK_EQ(Status::RECEIVING_RESPONSE, status_->state);
-      if (resp_->result() == OK || resp_->status_code() != 200) {
+      if (resp_->result() == OK || !IsOkStatusCode(resp_->status_code())) {
         status_->state = Status::RESPONSE_RECEIVED;
       }
       RunCallback(resp_->result(), resp_->err_message());
@@ -797,7 +813,11 @@ std::string HttpClient::Status::DebugString() const {
      << " req_build_time=" << req_build_time
      << " req_send_time=" << req_send_time << " wait_time=" << wait_time
      << " resp_recv_time=" << resp_recv_time
-     << " resp_parse_time=" << resp_parse_time << " num_retry=" << num_retry
+     << " resp_parse_time=" << resp_parse_time
+     << " req_build_cpu_time=" << req_build_cpu_time
+     << " resp_parse_cpu_time=" << resp_parse_cpu_time
+     << " wait_cpu_time=" << wait_cpu_time
+     << " num_retry=" << num_retry
      << " num_throttled=" << num_throttled
      << " num_connect_failed=" << num_connect_failed
      << " num_oauth2_token_refreshed=" << num_oauth2_token_refreshed;
@@ -840,6 +860,10 @@ HttpClient::HttpClient(std::unique_ptr<SocketFactory> socket_factory,
     : options_(options),
       tls_engine_factory_(std::move(tls_engine_factory)),
       socket_pool_(std::move(socket_factory)),
+      circuit_breaker_(options.enable_circuit_breaker
+                           ? absl::make_unique<CircuitBreaker>(
+                                 options.circuit_breaker)
+                           : nullptr),
       wm_(wm),
       health_status_("initializing"),
       shutting_down_(false),
@@ -977,9 +1001,11 @@ void HttpClient::DoAsync(
 }
 
 void HttpClient::Wait(Status* status) {
+  ThreadCpuTimer cpu_timer;
   while (!status->finished) {
     CHECK(wm_->Dispatch());
   }
+  status->wait_cpu_time += cpu_timer.GetDuration();
 }
 
 void HttpClient::Shutdown() {
@@ -1097,7 +1123,7 @@ void HttpClient::UpdateStatusCodeHistoryUnlocked() {
 
   while (!recent_http_status_code_.empty() &&
          recent_http_status_code_.front().first < now - absl::Seconds(3)) {
-    if (recent_http_status_code_.front().second != 200) {
+    if (!IsOkStatusCode(recent_http_status_code_.front().second)) {
       --bad_status_num_in_recent_http_;
     }
     recent_http_status_code_.pop_front();
@@ -1108,7 +1134,7 @@ void HttpClient::AddStatusCodeHistoryUnlocked(int status_code) {
   UpdateStatusCodeHistoryUnlocked();
 
   const absl::Time now = absl::Now();
-  if (status_code != 200) {
+  if (!IsOkStatusCode(status_code)) {
     ++bad_status_num_in_recent_http_;
   }
   recent_http_status_code_.emplace_back(now, status_code);
@@ -1129,6 +1155,13 @@ bool HttpClient::IsHealthy() const {
   return health_status_ == "ok";
 }
 
+bool HttpClient::CircuitBreakerAllows() {
+  if (circuit_breaker_ == nullptr) {
+    return true;
+  }
+  return circuit_breaker_->Allow(absl::Now());
+}
+
 std::string HttpClient::GetAccount() {
   if (oauth_refresh_task_.get() == nullptr) {
     return "";
@@ -1358,6 +1391,9 @@ void HttpClient::DumpStatsToProto(HttpRPCStats* stats) const {
     http_status->set_status_code(iter.first);
     http_status->set_count(iter.second);
   }
+  if (circuit_breaker_ != nullptr) {
+    circuit_breaker_->DumpStatsToProto(stats->mutable_circuit_breaker());
+  }
 }
 
 int HttpClient::UpdateHealthStatusMessageForPing(
@@ -1599,6 +1635,15 @@ void HttpClient::IncWriteByte(int n) {
 }
 
 void HttpClient::UpdateStats(const Status& status) {
+  // Requests failed by shutdown or disabled http don't tell the backend
+  // health.
+  if (circuit_breaker_ != nullptr && status.enabled) {
+    circuit_breaker_->Record(
+        status.err == OK,
+        status.req_send_time + status.wait_time + status.resp_recv_time,
+        absl::Now());
+  }
+
   AUTOLOCK(lock, &mu_);
 
   AddStatusCodeHistoryUnlocked(status.http_return_code);
@@ -1995,7 +2040,7 @@ bool HttpClient::Response::Recv(int r) {
     result_ = OK;
     return true;
   }
-  if (status_code_ != 200) {
+  if (!IsOkStatusCode(status_code_)) {
     // heder found and error code.
     LOG(WARNING) << trace_id_ << " read "
                  << " http=" << status_code_
@@ -2403,9 +2448,37 @@ HttpFileDownloadResponse::NewBody(
                << GetEncodingName(encoding_type);
     return nullptr;
   }
-  ScopedFd fd(ScopedFd::Create(filename_, mode_));
+  ScopedFd fd;
+  if (write_offset_ < 0 || status_code() != 206) {
+    if (write_offset_ > 0) {
+      LOG(ERROR) << "range request for offset " << write_offset_
+                 << " was responded with http code " << status_code();
+      return nullptr;
+    }
+    // Whole content.
+    fd.reset(ScopedFd::Create(filename_, mode_));
+  } else {
+    // Make sure the body is for the range we asked, so that it won't
+    // overwrite other ranges of the file.
+    int64_t first = 0;
+    int64_t last = 0;
+    int64_t total = 0;
+    if (!ParseContentRange(ExtractHeaderField(Header(), kContentRange),
+                           &first, &last, &total) ||
+        first != write_offset_) {
+      LOG(ERROR) << "unexpected range for offset " << write_offset_ << ": "
+                 << ExtractHeaderField(Header(), kContentRange);
+      return nullptr;
+    }
+    fd.reset(ScopedFd::OpenForRewrite(filename_));
+    if (fd.valid() &&
+        fd.Seek(write_offset_, ScopedFd::SeekAbsolute) != write_offset_) {
+      LOG(ERROR) << "failed to seek " << filename_ << " to " << write_offset_;
+      return nullptr;
+    }
+  }
   if (!fd.valid()) {
-    LOG(ERROR) << "failed to create " << filename_;
+    LOG(ERROR) << "failed to open " << filename_;
     return nullptr;
   }
   response_body_ =
@@ -29,6 +29,7 @@
 #include "absl/types/optional.h"
 #include "basictypes.h"
 #include "base/compiler_specific.h"
+#include "circuit_breaker.h"
 #include "compress_util.h"
 #include "gtest/gtest_prod.h"
 MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
@@ -92,6 +93,11 @@ class HttpClient {
 
     bool reuse_connection = true;
 
+    // Skips remote work while the backend keeps failing.
+    // See CircuitBreakerAllows().
+    bool enable_circuit_breaker = false;
+    CircuitBreaker::Options circuit_breaker;
+
     bool InitFromURL(absl::string_view url);
 
     // Socket{Host,Port} represents where HttpClient connects.
@@ -196,6 +202,13 @@ class HttpClient {
     absl::Duration wait_time;
     absl::Duration resp_recv_time;
     absl::Duration resp_parse_time;
+    // CPU time of the threads that built request and parsed response.
+    absl::Duration req_build_cpu_time;
+    absl::Duration resp_parse_cpu_time;
+    // CPU time of the thread in Wait(). It includes closures of other tasks
+    // run by Dispatch(), so callers measuring their own CPU time around
+    // Wait() should subtract it.
+    absl::Duration wait_cpu_time;
 
     int num_retry;
     int num_throttled;
@@ -489,6 +502,13 @@ class HttpClient {
   // but we prefer to ignore the case.
   bool IsHealthy() const ABSL_LOCKS_EXCLUDED(mu_);
 
+  // Returns false while the circuit breaker is open, i.e. most of recent
+  // requests failed or were slow. Then callers should not start preparing
+  // remote work, and should run it locally instead.
+  // In half-open state, it returns true only for a few probes.
+  // Always returns true if the circuit breaker is not enabled.
+  bool CircuitBreakerAllows();
+
   // Get email address to login with oauth2.
   std::string GetAccount();
   bool GetOAuth2Config(OAuth2Config* config) const;
@@ -635,6 +655,8 @@ class HttpClient {
   const std::unique_ptr<TLSEngineFactory> tls_engine_factory_;
   const std::unique_ptr<SocketFactory> socket_pool_;
   std::unique_ptr<OAuth2AccessTokenRefreshTask> oauth_refresh_task_;
+  // nullptr if options_.enable_circuit_breaker is false.
+  const std::unique_ptr<CircuitBreaker> circuit_breaker_;
 
   WorkerThreadManager* const wm_;
 
@@ -838,6 +860,12 @@ class HttpFileDownloadResponse : public HttpClient::Response {
       size_t content_length, bool is_chunked,
       EncodingType encoding_type) override;
 
+  // Writes the body at |offset| of the existing file, instead of creating
+  // the file. Used with Range request header. The response must be
+  // 206 Partial Content starting at |offset|. If |offset| is 0, 200 OK is
+  // also accepted, and the file is created with the whole content.
+  void SetWriteOffset(int64_t offset) { write_offset_ = offset; }
+
  protected:
   // ParseBody sets result_ to OK.
   void ParseBody() override;
@@ -845,6 +873,7 @@ class HttpFileDownloadResponse : public HttpClient::Response {
  private:
   const std::string filename_;
   const int mode_;
+  int64_t write_offset_ = -1;
   std::unique_ptr<Body> response_body_;
 };
 
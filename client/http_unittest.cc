@@ -18,9 +18,14 @@
 #include "mypath.h"
 #include "path.h"
 #include "scoped_tmp_file.h"
+#include "simple_timer.h"
 #include "socket_factory.h"
 #include "worker_thread.h"
 
+MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
+#include "lib/goma_stats.pb.h"
+MSVC_POP_WARNING()
+
 namespace devtools_goma {
 
 TEST(NetworkErrorStatusTest, Basic) {
@@ -221,7 +226,10 @@ class HttpClientTest : public ::testing::Test {
                         "Connection: close\r\n", "\r\n", body);
   }
 
-  std::unique_ptr<HttpClient> NewHttpClient(absl::string_view host, int port) {
+  std::unique_ptr<HttpClient> NewHttpClient(
+      absl::string_view host,
+      int port,
+      bool enable_circuit_breaker = false) {
     std::unique_ptr<MockSocketFactory> socket_factory(
         absl::make_unique<MockSocketFactory>(socks_[1], &socket_status_));
     socket_factory->set_dest(absl::StrCat(host, ":", port));
@@ -231,6 +239,12 @@ class HttpClientTest : public ::testing::Test {
     HttpClient::Options options;
     options.InitFromURL(absl::StrCat("http://", host, "/"));
     options.socket_read_timeout = absl::Milliseconds(200);
+    if (enable_circuit_breaker) {
+      // Opens by a failure.
+      options.enable_circuit_breaker = true;
+      options.circuit_breaker.min_requests = 1;
+      options.circuit_breaker.open_duration = absl::Hours(1);
+    }
     return absl::make_unique<HttpClient>(
         std::move(socket_factory), nullptr, options, wm_.get());
   }
@@ -283,6 +297,25 @@ class HttpClientTest : public ::testing::Test {
     cond_.Signal();
   }
 
+  // Consumes |duration| of CPU time in pool_, and sets it in *burned.
+  void BurnCpu(absl::Duration duration, absl::Duration* burned) {
+    wm_->RunClosureInPool(
+        FROM_HERE,
+        pool_,
+        NewCallback(
+            this, &HttpClientTest::DoBurnCpu, duration, burned),
+        WorkerThread::PRIORITY_LOW);
+  }
+
+  void DoBurnCpu(absl::Duration duration, absl::Duration* burned) {
+    ThreadCpuTimer cpu_timer;
+    while (cpu_timer.GetDuration() < duration) {
+    }
+    AutoLock lock(&mu_);
+    *burned = cpu_timer.GetDuration();
+    cond_.Signal();
+  }
+
   void ExpectSocketClosed(bool expect_closed) {
     if (expect_closed) {
       EXPECT_FALSE(socket_status_.is_owned());
@@ -889,6 +922,68 @@ TEST_F(HttpClientTest, Get502) {
   ExpectSocketClosed(true);
 }
 
+TEST_F(HttpClientTest, CircuitBreakerOpenBy502) {
+  const std::string req_expected = ExpectedRequest("GET", "example.com");
+  std::string req_buf;
+  ServerReceive(req_expected, &req_buf);
+
+  std::unique_ptr<HttpClient> client(
+      NewHttpClient("example.com", 80, true));
+  EXPECT_TRUE(client->CircuitBreakerAllows());
+
+  bool done = false;
+  HttpRequest req;
+  client->InitHttpRequest(&req, "GET", "");
+  req.SetContentType("text/plain");
+  req.AddHeader("Connection", "close");
+  HttpResponse resp;
+  TestContext tc(client.get(), &req, &resp, NewDoneCallback(&done));
+  RunTest(&tc);
+  {
+    AutoLock lock(&mu_);
+    while (tc.state_ != TestContext::State::CALL) {
+      cond_.Wait(&mu_);
+    }
+  }
+
+  // The backend is failing.
+  ServerResponse(
+      "HTTP/1.1 502 Bad Gateway\r\n"
+      "Content-Type: text/plain\r\n"
+      "Connection: close\r\n"
+      "\r\n"
+      "server error\r\n");
+  ServerClose();
+
+  Wait(&tc);
+  {
+    AutoLock lock(&mu_);
+    while (!done) {
+      cond_.Wait(&mu_);
+    }
+    while (tc.state_ != TestContext::State::DONE) {
+      cond_.Wait(&mu_);
+    }
+    EXPECT_EQ(502, tc.status_.http_return_code);
+  }
+  client->WaitNoActive();
+
+  EXPECT_FALSE(client->CircuitBreakerAllows());
+  HttpRPCStats stats;
+  client->DumpStatsToProto(&stats);
+  EXPECT_EQ("open", stats.circuit_breaker().state());
+  EXPECT_EQ(1, stats.circuit_breaker().opened());
+  EXPECT_EQ(1, stats.circuit_breaker().rejected());
+}
+
+TEST_F(HttpClientTest, CircuitBreakerDisabled) {
+  std::unique_ptr<HttpClient> client(NewHttpClient("example.com", 80));
+  EXPECT_TRUE(client->CircuitBreakerAllows());
+  HttpRPCStats stats;
+  client->DumpStatsToProto(&stats);
+  EXPECT_FALSE(stats.has_circuit_breaker());
+}
+
 TEST_F(HttpClientTest, GetFileDownload) {
   const std::string req_expected = ExpectedRequest("GET", "example.com");
   std::string req_buf;
@@ -1008,6 +1103,129 @@ TEST_F(HttpClientTest, GetFileDownloadFail) {
   ExpectSocketClosed(true);
 }
 
+TEST_F(HttpClientTest, GetFileDownloadRange) {
+  const std::string req_expected =
+      absl::StrCat("GET / HTTP/1.1\r\n",
+                   "Host: example.com\r\n",
+                   "User-Agent: ", kUserAgentString, "\r\n",
+                   "Content-Type: text/plain\r\n",
+                   "Content-Length: 0\r\n",
+                   "Range: bytes=3-4\r\n",
+                   "Connection: close\r\n",
+                   "\r\n");
+  std::string req_buf;
+  ServerReceive(req_expected, &req_buf);
+
+  std::unique_ptr<HttpClient> client(NewHttpClient("example.com", 80));
+
+  bool done = false;
+  HttpRequest req;
+  client->InitHttpRequest(&req, "GET", "");
+  req.SetContentType("text/plain");
+  req.AddHeader("Range", "bytes=3-4");
+  req.AddHeader("Connection", "close");
+
+  ScopedTmpDir tmpdir("http_unittest_get_filedownload_range");
+  EXPECT_TRUE(tmpdir.valid());
+  std::string resp_file = file::JoinPath(tmpdir.dirname(), "resp");
+  ASSERT_TRUE(WriteStringToFile("0123456789", resp_file));
+  HttpFileDownloadResponse resp(resp_file, 0644);
+  resp.SetWriteOffset(3);
+  TestContext tc(client.get(), &req, &resp, NewDoneCallback(&done));
+  RunTest(&tc);
+  {
+    AutoLock lock(&mu_);
+    while (tc.state_ != TestContext::State::CALL) {
+      cond_.Wait(&mu_);
+    }
+  }
+
+  ServerResponse(
+      "HTTP/1.1 206 Partial Content\r\n"
+      "Content-Type: text/plain\r\n"
+      "Content-Range: bytes 3-4/10\r\n"
+      "Content-Length: 2\r\n"
+      "Connection: close\r\n\r\n"
+      "ab");
+  ServerClose();
+
+  Wait(&tc);
+  {
+    AutoLock lock(&mu_);
+    while (!done) {
+      cond_.Wait(&mu_);
+    }
+    while (tc.state_ != TestContext::State::DONE) {
+      cond_.Wait(&mu_);
+    }
+    EXPECT_EQ(req_expected, req_buf);
+    EXPECT_TRUE(tc.status_.finished);
+    EXPECT_EQ(0, tc.status_.err);
+    EXPECT_EQ(206, tc.status_.http_return_code);
+
+    std::string resp_data;
+    EXPECT_TRUE(ReadFileToString(resp_file, &resp_data));
+    EXPECT_EQ("012ab56789", resp_data);
+  }
+  client->WaitNoActive();
+  ExpectSocketClosed(true);
+}
+
+TEST_F(HttpClientTest, GetFileDownloadUnexpectedRange) {
+  const std::string req_expected = ExpectedRequest("GET", "example.com");
+  std::string req_buf;
+  ServerReceive(req_expected, &req_buf);
+
+  std::unique_ptr<HttpClient> client(NewHttpClient("example.com", 80));
+
+  bool done = false;
+  HttpRequest req;
+  client->InitHttpRequest(&req, "GET", "");
+  req.SetContentType("text/plain");
+  req.AddHeader("Connection", "close");
+
+  ScopedTmpDir tmpdir("http_unittest_get_filedownload_range");
+  EXPECT_TRUE(tmpdir.valid());
+  std::string resp_file = file::JoinPath(tmpdir.dirname(), "resp");
+  ASSERT_TRUE(WriteStringToFile("0123456789", resp_file));
+  HttpFileDownloadResponse resp(resp_file, 0644);
+  resp.SetWriteOffset(3);
+  TestContext tc(client.get(), &req, &resp, NewDoneCallback(&done));
+  RunTest(&tc);
+  {
+    AutoLock lock(&mu_);
+    while (tc.state_ != TestContext::State::CALL) {
+      cond_.Wait(&mu_);
+    }
+  }
+
+  // The server ignored Range, and sent the whole content.
+  ServerResponse(
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: text/plain\r\n"
+      "Content-Length: 10\r\n"
+      "Connection: close\r\n\r\n"
+      "abcdefghij");
+  ServerClose();
+
+  Wait(&tc);
+  {
+    AutoLock lock(&mu_);
+    while (!done) {
+      cond_.Wait(&mu_);
+    }
+    while (tc.state_ != TestContext::State::DONE) {
+      cond_.Wait(&mu_);
+    }
+    EXPECT_EQ(FAIL, tc.status_.err);
+
+    std::string resp_data;
+    EXPECT_TRUE(ReadFileToString(resp_file, &resp_data));
+    EXPECT_EQ("0123456789", resp_data);
+  }
+  client->WaitNoActive();
+}
+
 TEST_F(HttpClientTest, Post) {
   constexpr absl::string_view kBody = "request body data";
   const std::string req_expected =
@@ -1178,6 +1396,60 @@ TEST_F(HttpClientTest, PostUploadFailFileNotFound) {
   ExpectSocketClosed(true);
 }
 
+TEST_F(HttpClientTest, WaitCpuTimeIncludesDispatchedClosure) {
+  const std::string req_expected = ExpectedRequest("GET", "example.com");
+  std::string req_buf;
+  ServerReceive(req_expected, &req_buf);
+
+  std::unique_ptr<HttpClient> client(NewHttpClient("example.com", 80));
+
+  bool done = false;
+  HttpRequest req;
+  client->InitHttpRequest(&req, "GET", "");
+  req.SetContentType("text/plain");
+  req.AddHeader("Connection", "close");
+  HttpResponse resp;
+  TestContext tc(client.get(), &req, &resp, NewDoneCallback(&done));
+  RunTest(&tc);
+  {
+    AutoLock lock(&mu_);
+    while (tc.state_ != TestContext::State::CALL) {
+      cond_.Wait(&mu_);
+    }
+  }
+
+  // The pool thread runs BurnCpu by Dispatch() in HttpClient::Wait.
+  Wait(&tc);
+  absl::Duration burned;
+  BurnCpu(absl::Milliseconds(20), &burned);
+  {
+    AutoLock lock(&mu_);
+    while (burned == absl::ZeroDuration()) {
+      cond_.Wait(&mu_);
+    }
+  }
+
+  ServerResponse(
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: text/plain\r\n"
+      "Connection: close\r\n\r\n"
+      "ok");
+  ServerClose();
+  {
+    AutoLock lock(&mu_);
+    while (!done) {
+      cond_.Wait(&mu_);
+    }
+    while (tc.state_ != TestContext::State::DONE) {
+      cond_.Wait(&mu_);
+    }
+    EXPECT_EQ(OK, tc.status_.err);
+    EXPECT_GE(tc.status_.wait_cpu_time, burned);
+  }
+  client->WaitNoActive();
+  ExpectSocketClosed(true);
+}
+
 bool HandleResponseBody(HttpClient::Response::Body* body,
                         absl::string_view response) {
     bool need_more = true;
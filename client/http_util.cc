@@ -180,11 +180,14 @@ ABSL_CONST_INIT const absl::string_view kAcceptEncoding = "Accept-Encoding";
 ABSL_CONST_INIT const absl::string_view kAuthorization = "Authorization";
 ABSL_CONST_INIT const absl::string_view kContentEncoding = "Content-Encoding";
 ABSL_CONST_INIT const absl::string_view kContentLength = "Content-Length";
+ABSL_CONST_INIT const absl::string_view kContentRange = "Content-Range";
 ABSL_CONST_INIT const absl::string_view kContentType = "Content-Type";
 ABSL_CONST_INIT const absl::string_view kConnection = "Connection";
 ABSL_CONST_INIT const absl::string_view kCookie = "Cookie";
 ABSL_CONST_INIT const absl::string_view kHost = "Host";
 ABSL_CONST_INIT const absl::string_view kUserAgent = "User-Agent";
+ABSL_CONST_INIT const absl::string_view kETag = "ETag";
+ABSL_CONST_INIT const absl::string_view kRange = "Range";
 ABSL_CONST_INIT const absl::string_view kTransferEncoding = "Transfer-Encoding";
 
 absl::string_view ExtractHeaderField(
@@ -327,7 +330,8 @@ bool ParseHttpResponse(absl::string_view response,
   }
   absl::string_view codestr = response.substr(kHttpHeader.size() + 2);
   *http_status_code = atoi(std::string(codestr).c_str());
-  if (*http_status_code != 200 && *http_status_code != 204)
+  if (*http_status_code != 200 && *http_status_code != 204 &&
+      *http_status_code != 206)
     return true;
 
   if (!FindContentLengthAndBodyOffset(response, content_length, offset,
@@ -339,6 +343,31 @@ bool ParseHttpResponse(absl::string_view response,
   return true;
 }
 
+bool ParseContentRange(absl::string_view value,
+                       int64_t* first, int64_t* last, int64_t* total) {
+  if (!absl::ConsumePrefix(&value, "bytes ")) {
+    return false;
+  }
+  std::vector<absl::string_view> range_total =
+      absl::StrSplit(value, absl::MaxSplits('/', 1));
+  if (range_total.size() != 2) {
+    return false;
+  }
+  std::vector<absl::string_view> first_last =
+      absl::StrSplit(range_total[0], absl::MaxSplits('-', 1));
+  if (first_last.size() != 2 ||
+      !absl::SimpleAtoi(first_last[0], first) ||
+      !absl::SimpleAtoi(first_last[1], last) ||
+      *first < 0 || *last < *first) {
+    return false;
+  }
+  if (range_total[1] == "*") {
+    *total = -1;
+    return true;
+  }
+  return absl::SimpleAtoi(range_total[1], total) && *last < *total;
+}
+
 std::map<std::string, std::string> ParseQuery(const std::string& query) {
   std::map<std::string, std::string> params;
   if (query.empty()) {
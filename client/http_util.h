@@ -8,6 +8,7 @@
 // Utilities for HTTP.
 
 #include <cstddef>
+#include <cstdint>
 #include <map>
 #include <string>
 #include <vector>
@@ -22,11 +23,14 @@ extern const absl::string_view kAcceptEncoding;
 extern const absl::string_view kAuthorization;
 extern const absl::string_view kContentEncoding;
 extern const absl::string_view kContentLength;
+extern const absl::string_view kContentRange;
 extern const absl::string_view kContentType;
 extern const absl::string_view kConnection;
 extern const absl::string_view kCookie;
 extern const absl::string_view kHost;
 extern const absl::string_view kUserAgent;
+extern const absl::string_view kETag;
+extern const absl::string_view kRange;
 extern const absl::string_view kTransferEncoding;
 
 // Extracts HTTP header field value.
@@ -41,7 +45,7 @@ absl::string_view ExtractHeaderField(
 // Return false if it needs more data.
 //
 // In case of returning true with error, |http_status_code| will not be
-// 200 or 204.  You must not use other fields in such a case.
+// 200, 204 or 206.  You must not use other fields in such a case.
 //
 // If returning true without error, followings could be set:
 // |http_status_code| represents HTTP status code.
@@ -69,6 +73,13 @@ bool FindContentLengthAndBodyOffset(
     absl::string_view data, size_t *content_length, size_t *body_offset,
     bool *is_chunked);
 
+// Parses Content-Range header value of 206 Partial Content response,
+// i.e. "bytes <first>-<last>/<total>".
+// |total| is set to -1 if it is "*" (unknown).
+// Returns false if |value| is not in the form.
+bool ParseContentRange(absl::string_view value,
+                       int64_t* first, int64_t* last, int64_t* total);
+
 // Parse http request query parameter.
 std::map<std::string, std::string> ParseQuery(const std::string& query);
 
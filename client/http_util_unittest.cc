@@ -298,6 +298,46 @@ TEST(HttpUtilTest, ChunkedTransferEncodingWithTwoSpace) {
   EXPECT_EQ(true, is_chunked);
 }
 
+TEST(HttpUtilTest, ParseHttpResponsePartialContent) {
+  const std::string response =
+      "HTTP/1.1 206 Partial Content\r\n"
+      "Content-Range: bytes 10-14/100\r\n"
+      "Content-Length: 5\r\n\r\n"
+      "01234";
+  int http_status_code = 0;
+  size_t offset = std::string::npos;
+  size_t content_length = std::string::npos;
+  bool is_chunked = false;
+  EXPECT_TRUE(ParseHttpResponse(response, &http_status_code,
+                                &offset, &content_length, &is_chunked));
+  EXPECT_EQ(206, http_status_code);
+  EXPECT_EQ(response.size() - 5, offset);
+  EXPECT_EQ(5UL, content_length);
+  EXPECT_FALSE(is_chunked);
+}
+
+TEST(HttpUtilTest, ParseContentRange) {
+  int64_t first = 0;
+  int64_t last = 0;
+  int64_t total = 0;
+  EXPECT_TRUE(ParseContentRange("bytes 0-99/1000", &first, &last, &total));
+  EXPECT_EQ(0, first);
+  EXPECT_EQ(99, last);
+  EXPECT_EQ(1000, total);
+
+  EXPECT_TRUE(ParseContentRange("bytes 900-999/*", &first, &last, &total));
+  EXPECT_EQ(900, first);
+  EXPECT_EQ(999, last);
+  EXPECT_EQ(-1, total);
+
+  EXPECT_FALSE(ParseContentRange("", &first, &last, &total));
+  EXPECT_FALSE(ParseContentRange("bytes */1000", &first, &last, &total));
+  EXPECT_FALSE(ParseContentRange("bytes 0-99", &first, &last, &total));
+  EXPECT_FALSE(ParseContentRange("bytes 99-0/1000", &first, &last, &total));
+  EXPECT_FALSE(ParseContentRange("bytes 0-1000/1000", &first, &last, &total));
+  EXPECT_FALSE(ParseContentRange("items 0-9/10", &first, &last, &total));
+}
+
 TEST(HttpUtilTest, ParseQuery) {
   std::map<std::string, std::string> params = ParseQuery("");
   EXPECT_TRUE(params.empty());
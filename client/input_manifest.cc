@@ -0,0 +1,188 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "input_manifest.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "glog/logging.h"
+#include "lib/goma_data_util.h"
+
+namespace devtools_goma {
+
+namespace {
+
+// A new manifest is made when the difference from the current one is
+// larger than 1/kMaxDeltaRatio of it.
+constexpr size_t kMaxDeltaRatio = 4;
+
+// Only inputs identified by hash_key alone go to a manifest. Inputs with
+// content need to be uploaded with the request anyway.
+bool IsManifestCandidate(const ExecReq_Input& input) {
+  return !input.has_content() && !input.hash_key().empty();
+}
+
+}  // namespace
+
+constexpr int InputManifestCache::kMinManifestInputs;
+
+InputManifestCache::Manifest::Manifest(const InputManifest& manifest) {
+  blob_.set_blob_type(FileBlob::FILE);
+  manifest.SerializeToString(blob_.mutable_content());
+  blob_.set_file_size(blob_.content().size());
+  hash_key_ = ComputeFileBlobHashKey(blob_);
+  entries_.reserve(manifest.entry_size());
+  for (const auto& entry : manifest.entry()) {
+    entries_.emplace(entry.filename(), entry.hash_key());
+  }
+}
+
+bool InputManifestCache::Manifest::Contains(
+    const std::string& filename,
+    const std::string& hash_key) const {
+  auto it = entries_.find(filename);
+  return it != entries_.end() && it->second == hash_key;
+}
+
+InputManifestCache::InputManifestCache(size_t max_manifests)
+    : manifests_(max_manifests) {}
+
+void InputManifestCache::UpdateServerSupport(const ExecResp& resp) {
+  const bool supported = resp.input_manifest_supported();
+  if (server_supported_.exchange(supported, std::memory_order_acq_rel) !=
+      supported) {
+    LOG(INFO) << "server input manifest support: " << supported;
+  }
+}
+
+std::shared_ptr<InputManifestCache::Manifest> InputManifestCache::Apply(
+    ExecReq* req) {
+  if (!server_supported()) {
+    return nullptr;
+  }
+  int num_candidates = 0;
+  for (const auto& input : req->input()) {
+    if (IsManifestCandidate(input)) {
+      ++num_candidates;
+    }
+  }
+  if (num_candidates < kMinManifestInputs) {
+    return nullptr;
+  }
+
+  absl::flat_hash_set<absl::string_view> filenames;
+  filenames.reserve(req->input_size());
+  for (const auto& input : req->input()) {
+    filenames.insert(input.filename());
+  }
+
+  const std::string key = ManifestKey(*req);
+  std::shared_ptr<Manifest> manifest;
+  if (manifests_.Lookup(key, &manifest)) {
+    size_t num_delta = 0;
+    for (const auto& input : req->input()) {
+      if (IsManifestCandidate(input) &&
+          !manifest->Contains(input.filename(), input.hash_key())) {
+        ++num_delta;
+      }
+    }
+    for (const auto& entry : manifest->entries_) {
+      if (!filenames.contains(entry.first)) {
+        ++num_delta;
+      }
+    }
+    if (num_delta * kMaxDeltaRatio > manifest->size()) {
+      VLOG(1) << "input manifest for " << req->cwd() << " is outdated:"
+              << " delta=" << num_delta << " size=" << manifest->size();
+      manifest.reset();
+    }
+  }
+  if (manifest == nullptr) {
+    InputManifest input_manifest;
+    for (const auto& input : req->input()) {
+      if (!IsManifestCandidate(input)) {
+        continue;
+      }
+      InputManifest::Entry* entry = input_manifest.add_entry();
+      entry->set_filename(input.filename());
+      entry->set_hash_key(input.hash_key());
+    }
+    std::sort(input_manifest.mutable_entry()->begin(),
+              input_manifest.mutable_entry()->end(),
+              [](const InputManifest::Entry& a, const InputManifest::Entry& b) {
+                return a.filename() < b.filename();
+              });
+    manifest = std::make_shared<Manifest>(input_manifest);
+    manifests_.Insert(key, manifest, 1);
+    num_created_.Add(1);
+  }
+
+  std::vector<absl::string_view> removed;
+  for (const auto& entry : manifest->entries_) {
+    if (!filenames.contains(entry.first)) {
+      removed.push_back(entry.first);
+    }
+  }
+  std::sort(removed.begin(), removed.end());
+
+  const int num_inputs = req->input_size();
+  google::protobuf::RepeatedPtrField<ExecReq_Input> delta;
+  for (auto& input : *req->mutable_input()) {
+    if (IsManifestCandidate(input) &&
+        manifest->Contains(input.filename(), input.hash_key())) {
+      continue;
+    }
+    delta.Add()->Swap(&input);
+  }
+  req->mutable_input()->Swap(&delta);
+  req->set_input_manifest_hash_key(manifest->hash_key());
+  req->clear_removed_input();
+  for (const auto& filename : removed) {
+    req->add_removed_input(std::string(filename));
+  }
+  if (!manifest->acknowledged()) {
+    *req->mutable_input_manifest() = manifest->blob();
+  }
+
+  num_applied_.Add(1);
+  num_saved_inputs_.Add(num_inputs - req->input_size());
+  return manifest;
+}
+
+void InputManifestCache::HandleMissing(Manifest* manifest, ExecReq* req) {
+  num_missing_.Add(1);
+  manifest->set_acknowledged(false);
+  *req->mutable_input_manifest() = manifest->blob();
+}
+
+void InputManifestCache::DumpStatsToProto(InputManifestStats* stats) const {
+  stats->set_applied(num_applied());
+  stats->set_created(num_created());
+  stats->set_missing(num_missing());
+  stats->set_saved_inputs(num_saved_inputs());
+}
+
+// static
+void InputManifestCache::Restore(const Manifest& manifest, ExecReq* req) {
+  InputManifest input_manifest;
+  CHECK(input_manifest.ParseFromString(manifest.blob().content()))
+      << manifest.hash_key();
+  CHECK(ExpandInputManifest(input_manifest, req)) << manifest.hash_key();
+}
+
+// static
+std::string InputManifestCache::ManifestKey(const ExecReq& req) {
+  const CommandSpec& spec = req.command_spec();
+  // cwd may be normalized to the same path for all build directories.
+  const std::string& cwd =
+      req.has_original_cwd() ? req.original_cwd() : req.cwd();
+  return absl::StrCat(cwd, "\n", spec.name(), "\n", spec.version(), "\n",
+                      spec.target(), "\n", spec.binary_hash());
+}
+
+}  // namespace devtools_goma
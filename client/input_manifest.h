@@ -0,0 +1,126 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DEVTOOLS_GOMA_CLIENT_INPUT_MANIFEST_H_
+#define DEVTOOLS_GOMA_CLIENT_INPUT_MANIFEST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "atomic_stats_counter.h"
+#include "compiler_specific.h"
+#include "concurrent_cache.h"
+
+MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
+#include "lib/goma_data.pb.h"
+#include "lib/goma_stats.pb.h"
+MSVC_POP_WARNING()
+
+namespace devtools_goma {
+
+// InputManifestCache lets ExecReq refer to a shared list of inputs
+// (InputManifest) by its hash_key, instead of listing every input.
+//
+// Compiles with the same compiler in the same cwd mostly share their header
+// closure, so the last manifest is kept for each such pair, and an ExecReq
+// only carries its difference from it. When the difference gets large, a new
+// manifest is made from the request.
+//
+// A manifest is embedded in ExecReq until the server has accepted a request
+// referring to it, so no separate upload is needed.
+//
+// Manifests are used only after the server has declared support by
+// ExecResp::input_manifest_supported.
+// This class is thread-safe.
+class InputManifestCache {
+ public:
+  class Manifest {
+   public:
+    explicit Manifest(const InputManifest& manifest);
+
+    Manifest(const Manifest&) = delete;
+    Manifest& operator=(const Manifest&) = delete;
+
+    const std::string& hash_key() const { return hash_key_; }
+    const FileBlob& blob() const { return blob_; }
+    size_t size() const { return entries_.size(); }
+
+    // Returns true if the manifest has |filename| with |hash_key|.
+    bool Contains(const std::string& filename,
+                  const std::string& hash_key) const;
+
+    // True once the server has accepted a request referring to this.
+    bool acknowledged() const {
+      return acknowledged_.load(std::memory_order_acquire);
+    }
+    void set_acknowledged(bool acknowledged) {
+      acknowledged_.store(acknowledged, std::memory_order_release);
+    }
+
+   private:
+    friend class InputManifestCache;
+
+    std::string hash_key_;
+    FileBlob blob_;
+    // filename -> hash_key.
+    absl::flat_hash_map<std::string, std::string> entries_;
+    std::atomic<bool> acknowledged_{false};
+  };
+
+  // Requests with fewer inputs identified by hash_key only are sent as is.
+  static constexpr int kMinManifestInputs = 64;
+
+  // Keeps at most |max_manifests| manifests.
+  explicit InputManifestCache(size_t max_manifests);
+
+  InputManifestCache(const InputManifestCache&) = delete;
+  InputManifestCache& operator=(const InputManifestCache&) = delete;
+
+  // Records whether the server accepts manifests from |resp|.
+  void UpdateServerSupport(const ExecResp& resp);
+  bool server_supported() const {
+    return server_supported_.load(std::memory_order_acquire);
+  }
+
+  // Rewrites |req| to refer to a manifest, and returns the manifest.
+  // Returns nullptr and leaves |req| as is if manifest is not used.
+  // Inputs with embedded content are always kept in req->input().
+  std::shared_ptr<Manifest> Apply(ExecReq* req);
+
+  // Called when the server reported ExecResp::input_manifest_missing for
+  // |req| referring to |manifest|. Embeds |manifest| in |req| for retry.
+  void HandleMissing(Manifest* manifest, ExecReq* req);
+
+  // Undoes Apply(), i.e. puts all inputs back to |req|.
+  static void Restore(const Manifest& manifest, ExecReq* req);
+
+  void DumpStatsToProto(InputManifestStats* stats) const;
+
+  // Stats.
+  int64_t num_applied() const { return num_applied_.value(); }
+  int64_t num_created() const { return num_created_.value(); }
+  int64_t num_missing() const { return num_missing_.value(); }
+  // Number of ExecReq_Input not sent thanks to manifests.
+  int64_t num_saved_inputs() const { return num_saved_inputs_.value(); }
+
+ private:
+  static std::string ManifestKey(const ExecReq& req);
+
+  std::atomic<bool> server_supported_{false};
+  ConcurrentCache<std::string, std::shared_ptr<Manifest>> manifests_;
+
+  StatsCounter num_applied_;
+  StatsCounter num_created_;
+  StatsCounter num_missing_;
+  StatsCounter num_saved_inputs_;
+};
+
+}  // namespace devtools_goma
+
+#endif  // DEVTOOLS_GOMA_CLIENT_INPUT_MANIFEST_H_
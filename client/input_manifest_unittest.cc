@@ -0,0 +1,262 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "input_manifest.h"
+
+#include <algorithm>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+#include "lib/goma_data_util.h"
+
+namespace devtools_goma {
+
+namespace {
+
+// FakeExecService expands input manifests like goma server does, and
+// remembers inputs of the last request.
+class FakeExecService {
+ public:
+  ExecResp Exec(ExecReq req) {
+    ExecResp resp;
+    resp.set_input_manifest_supported(supported_);
+    if (req.has_input_manifest_hash_key()) {
+      const std::string& hash_key = req.input_manifest_hash_key();
+      if (req.has_input_manifest()) {
+        EXPECT_EQ(hash_key, ComputeFileBlobHashKey(req.input_manifest()));
+        blobs_[hash_key] = req.input_manifest().content();
+      }
+      auto it = blobs_.find(hash_key);
+      if (it == blobs_.end()) {
+        resp.set_input_manifest_missing(true);
+        return resp;
+      }
+      InputManifest manifest;
+      EXPECT_TRUE(manifest.ParseFromString(it->second));
+      EXPECT_TRUE(ExpandInputManifest(manifest, &req));
+    }
+    last_inputs_ = req.input();
+    return resp;
+  }
+
+  void set_supported(bool supported) { supported_ = supported; }
+  void DropBlobs() { blobs_.clear(); }
+  const google::protobuf::RepeatedPtrField<ExecReq_Input>& last_inputs()
+      const {
+    return last_inputs_;
+  }
+
+ private:
+  bool supported_ = true;
+  absl::flat_hash_map<std::string, std::string> blobs_;
+  google::protobuf::RepeatedPtrField<ExecReq_Input> last_inputs_;
+};
+
+// Returns a request for |source| including headers [0, num_headers).
+ExecReq MakeExecReq(const std::string& source, int num_headers) {
+  ExecReq req;
+  req.set_cwd("/b/out");
+  req.mutable_command_spec()->set_name("clang");
+  req.mutable_command_spec()->set_binary_hash("clang_hash");
+  for (int i = 0; i < num_headers; ++i) {
+    ExecReq_Input* input = req.add_input();
+    input->set_filename(absl::StrCat("../../base/header", i, ".h"));
+    input->set_hash_key(absl::StrCat("header", i, "_hash"));
+  }
+  ExecReq_Input* input = req.add_input();
+  input->set_filename(source);
+  input->set_hash_key(source + "_hash");
+  return req;
+}
+
+std::string InputsString(
+    const google::protobuf::RepeatedPtrField<ExecReq_Input>& inputs) {
+  std::string s;
+  for (const auto& input : inputs) {
+    absl::StrAppend(&s, input.filename(), ":", input.hash_key(), ":",
+                    input.has_content(), "\n");
+  }
+  return s;
+}
+
+void SortInputs(ExecReq* req) {
+  std::sort(req->mutable_input()->begin(), req->mutable_input()->end(),
+            [](const ExecReq_Input& a, const ExecReq_Input& b) {
+              return a.filename() < b.filename();
+            });
+}
+
+}  // namespace
+
+TEST(InputManifestCacheTest, NotUsedUntilServerSupports) {
+  FakeExecService server;
+  server.set_supported(false);
+  InputManifestCache cache(16);
+  ExecReq req = MakeExecReq("../../base/a.cc", 100);
+  EXPECT_EQ(nullptr, cache.Apply(&req));
+  EXPECT_EQ(101, req.input_size());
+  EXPECT_FALSE(req.has_input_manifest_hash_key());
+
+  cache.UpdateServerSupport(server.Exec(req));
+  EXPECT_EQ(nullptr, cache.Apply(&req));
+
+  server.set_supported(true);
+  cache.UpdateServerSupport(server.Exec(req));
+  EXPECT_NE(nullptr, cache.Apply(&req));
+
+  // e.g. server rolled back.
+  server.set_supported(false);
+  cache.UpdateServerSupport(server.Exec(req));
+  req = MakeExecReq("../../base/a.cc", 100);
+  EXPECT_EQ(nullptr, cache.Apply(&req));
+}
+
+TEST(InputManifestCacheTest, SmallRequest) {
+  InputManifestCache cache(16);
+  ExecResp resp;
+  resp.set_input_manifest_supported(true);
+  cache.UpdateServerSupport(resp);
+
+  ExecReq req = MakeExecReq("../../base/a.cc",
+                            InputManifestCache::kMinManifestInputs - 2);
+  EXPECT_EQ(nullptr, cache.Apply(&req));
+  EXPECT_FALSE(req.has_input_manifest_hash_key());
+}
+
+TEST(InputManifestCacheTest, SharedClosure) {
+  FakeExecService server;
+  InputManifestCache cache(16);
+  cache.UpdateServerSupport(server.Exec(ExecReq()));
+
+  for (int i = 0; i < 10; ++i) {
+    // Each request has its own source and a few extra headers.
+    ExecReq req = MakeExecReq(absl::StrCat("../../base/file", i, ".cc"),
+                              1000 + i);
+    SortInputs(&req);
+    const std::string want = InputsString(req.input());
+    const size_t full_size = req.ByteSizeLong();
+
+    std::shared_ptr<InputManifestCache::Manifest> manifest = cache.Apply(&req);
+    ASSERT_NE(nullptr, manifest);
+    EXPECT_EQ(manifest->hash_key(), req.input_manifest_hash_key());
+    EXPECT_EQ(i == 0, req.has_input_manifest()) << i;
+    if (i == 0) {
+      EXPECT_EQ(0, req.removed_input_size());
+      EXPECT_EQ(0, req.input_size());
+    } else {
+      // file0.cc is removed, and its own source and extra headers are added.
+      EXPECT_EQ(1, req.removed_input_size());
+      EXPECT_EQ(i + 1, req.input_size());
+      EXPECT_LT(req.ByteSizeLong() * 20, full_size);
+    }
+
+    ExecResp resp = server.Exec(req);
+    EXPECT_FALSE(resp.input_manifest_missing());
+    manifest->set_acknowledged(true);
+    EXPECT_EQ(want, InputsString(server.last_inputs()));
+  }
+  EXPECT_EQ(10, cache.num_applied());
+  EXPECT_EQ(1, cache.num_created());
+}
+
+TEST(InputManifestCacheTest, RemovedAndModifiedInputs) {
+  FakeExecService server;
+  InputManifestCache cache(16);
+  cache.UpdateServerSupport(server.Exec(ExecReq()));
+
+  ExecReq req = MakeExecReq("../../base/a.cc", 200);
+  ASSERT_NE(nullptr, cache.Apply(&req));
+  server.Exec(req);
+
+  req = MakeExecReq("../../base/b.cc", 190);
+  req.mutable_input(3)->set_hash_key("modified_hash");
+  req.mutable_input(4)->mutable_content()->set_blob_type(FileBlob::FILE);
+  req.mutable_input(4)->mutable_content()->set_content("content");
+  SortInputs(&req);
+  const std::string want = InputsString(req.input());
+  ASSERT_NE(nullptr, cache.Apply(&req));
+  // Removed headers and a.cc.
+  EXPECT_EQ(11, req.removed_input_size());
+  // b.cc, modified one and one with content.
+  EXPECT_EQ(3, req.input_size());
+
+  server.Exec(req);
+  EXPECT_EQ(want, InputsString(server.last_inputs()));
+  EXPECT_EQ(1, cache.num_created());
+}
+
+TEST(InputManifestCacheTest, NewManifestForLargeDelta) {
+  FakeExecService server;
+  InputManifestCache cache(16);
+  cache.UpdateServerSupport(server.Exec(ExecReq()));
+
+  ExecReq req = MakeExecReq("../../base/a.cc", 100);
+  std::shared_ptr<InputManifestCache::Manifest> first = cache.Apply(&req);
+  ASSERT_NE(nullptr, first);
+
+  req = MakeExecReq("../../base/b.cc", 200);
+  SortInputs(&req);
+  const std::string want = InputsString(req.input());
+  std::shared_ptr<InputManifestCache::Manifest> second = cache.Apply(&req);
+  ASSERT_NE(nullptr, second);
+  EXPECT_NE(first->hash_key(), second->hash_key());
+  EXPECT_EQ(0, req.removed_input_size());
+  EXPECT_EQ(0, req.input_size());
+  EXPECT_EQ(2, cache.num_created());
+
+  server.Exec(req);
+  EXPECT_EQ(want, InputsString(server.last_inputs()));
+}
+
+TEST(InputManifestCacheTest, MissingManifest) {
+  FakeExecService server;
+  InputManifestCache cache(16);
+  cache.UpdateServerSupport(server.Exec(ExecReq()));
+
+  ExecReq req = MakeExecReq("../../base/a.cc", 100);
+  std::shared_ptr<InputManifestCache::Manifest> manifest = cache.Apply(&req);
+  ASSERT_NE(nullptr, manifest);
+  server.Exec(req);
+  manifest->set_acknowledged(true);
+
+  server.DropBlobs();
+  req = MakeExecReq("../../base/b.cc", 100);
+  SortInputs(&req);
+  const std::string want = InputsString(req.input());
+  manifest = cache.Apply(&req);
+  ASSERT_NE(nullptr, manifest);
+  EXPECT_FALSE(req.has_input_manifest());
+  ExecResp resp = server.Exec(req);
+  EXPECT_TRUE(resp.input_manifest_missing());
+
+  cache.HandleMissing(manifest.get(), &req);
+  EXPECT_TRUE(req.has_input_manifest());
+  EXPECT_FALSE(manifest->acknowledged());
+  resp = server.Exec(req);
+  EXPECT_FALSE(resp.input_manifest_missing());
+  EXPECT_EQ(want, InputsString(server.last_inputs()));
+  EXPECT_EQ(1, cache.num_missing());
+}
+
+TEST(InputManifestCacheTest, Restore) {
+  InputManifestCache cache(16);
+  ExecResp resp;
+  resp.set_input_manifest_supported(true);
+  cache.UpdateServerSupport(resp);
+
+  ExecReq req = MakeExecReq("../../base/a.cc", 100);
+  SortInputs(&req);
+  const std::string want = InputsString(req.input());
+  std::shared_ptr<InputManifestCache::Manifest> manifest = cache.Apply(&req);
+  ASSERT_NE(nullptr, manifest);
+
+  InputManifestCache::Restore(*manifest, &req);
+  EXPECT_FALSE(req.has_input_manifest_hash_key());
+  EXPECT_FALSE(req.has_input_manifest());
+  EXPECT_EQ(want, InputsString(req.input()));
+}
+
+}  // namespace devtools_goma
@@ -0,0 +1,119 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "json_writer.h"
+
+#include "absl/strings/str_cat.h"
+#include "glog/logging.h"
+
+namespace devtools_goma {
+
+void JsonWriter::Separate() {
+  if (after_key_) {
+    after_key_ = false;
+    return;
+  }
+  if (has_member_.empty()) {
+    return;
+  }
+  if (has_member_.back()) {
+    out_->push_back(',');
+  }
+  has_member_.back() = true;
+}
+
+void JsonWriter::BeginObject() {
+  Separate();
+  out_->push_back('{');
+  has_member_.push_back(false);
+}
+
+void JsonWriter::EndObject() {
+  DCHECK(!has_member_.empty());
+  DCHECK(!after_key_);
+  has_member_.pop_back();
+  out_->push_back('}');
+}
+
+void JsonWriter::BeginArray() {
+  Separate();
+  out_->push_back('[');
+  has_member_.push_back(false);
+}
+
+void JsonWriter::EndArray() {
+  DCHECK(!has_member_.empty());
+  has_member_.pop_back();
+  out_->push_back(']');
+}
+
+void JsonWriter::Key(absl::string_view key) {
+  DCHECK(!after_key_);
+  Separate();
+  AppendEscaped(key);
+  out_->push_back(':');
+  after_key_ = true;
+}
+
+void JsonWriter::String(absl::string_view value) {
+  Separate();
+  AppendEscaped(value);
+}
+
+void JsonWriter::Int(int64_t value) {
+  Separate();
+  absl::StrAppend(out_, value);
+}
+
+void JsonWriter::Bool(bool value) {
+  Separate();
+  out_->append(value ? "true" : "false");
+}
+
+void JsonWriter::Raw(absl::string_view json) {
+  Separate();
+  out_->append(json.data(), json.size());
+}
+
+void JsonWriter::AppendEscaped(absl::string_view value) {
+  static const char kHex[] = "0123456789abcdef";
+  out_->push_back('"');
+  for (char c : value) {
+    switch (c) {
+      case '"':
+        out_->append("\\\"");
+        break;
+      case '\\':
+        out_->append("\\\\");
+        break;
+      case '\b':
+        out_->append("\\b");
+        break;
+      case '\f':
+        out_->append("\\f");
+        break;
+      case '\n':
+        out_->append("\\n");
+        break;
+      case '\r':
+        out_->append("\\r");
+        break;
+      case '\t':
+        out_->append("\\t");
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          out_->append("\\u00");
+          out_->push_back(kHex[(c >> 4) & 0xf]);
+          out_->push_back(kHex[c & 0xf]);
+        } else {
+          out_->push_back(c);
+        }
+        break;
+    }
+  }
+  out_->push_back('"');
+}
+
+}  // namespace devtools_goma
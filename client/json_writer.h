@@ -0,0 +1,66 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DEVTOOLS_GOMA_CLIENT_JSON_WRITER_H_
+#define DEVTOOLS_GOMA_CLIENT_JSON_WRITER_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "basictypes.h"
+
+namespace devtools_goma {
+
+// JsonWriter appends compact JSON text to a string as values are written,
+// without building Json::Value.
+// Callers are responsible for balancing Begin/End and for writing Key before
+// each value in an object.
+//
+// e.g.
+//   std::string out;
+//   JsonWriter writer(&out);
+//   writer.BeginObject();
+//   writer.Key("id");
+//   writer.Int(1);
+//   writer.Key("state");
+//   writer.String("FINISHED");
+//   writer.EndObject();
+//   // out is {"id":1,"state":"FINISHED"}
+class JsonWriter {
+ public:
+  explicit JsonWriter(std::string* out) : out_(out) {}
+
+  void BeginObject();
+  void EndObject();
+  void BeginArray();
+  void EndArray();
+
+  void Key(absl::string_view key);
+
+  void String(absl::string_view value);
+  void Int(int64_t value);
+  void Bool(bool value);
+  // Writes |json|, which must be a serialized JSON value, as is.
+  void Raw(absl::string_view json);
+
+ private:
+  // Writes a separator if needed before a value or a key.
+  void Separate();
+  void AppendEscaped(absl::string_view value);
+
+  std::string* out_;
+  // Whether the current object or array already has a member, per nesting.
+  std::vector<bool> has_member_;
+  // True if Key was written and its value is not yet.
+  bool after_key_ = false;
+
+  DISALLOW_COPY_AND_ASSIGN(JsonWriter);
+};
+
+}  // namespace devtools_goma
+
+#endif  // DEVTOOLS_GOMA_CLIENT_JSON_WRITER_H_
@@ -0,0 +1,62 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "json_writer.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "json/json.h"
+
+namespace devtools_goma {
+
+TEST(JsonWriterTest, Basic) {
+  std::string out;
+  JsonWriter writer(&out);
+  writer.BeginObject();
+  writer.Key("id");
+  writer.Int(-1);
+  writer.Key("tasks");
+  writer.BeginArray();
+  writer.BeginObject();
+  writer.Key("replied");
+  writer.Bool(true);
+  writer.EndObject();
+  writer.BeginObject();
+  writer.EndObject();
+  writer.String("task");
+  writer.EndArray();
+  writer.Key("empty");
+  writer.BeginArray();
+  writer.EndArray();
+  writer.Key("raw");
+  writer.Raw("{\"a\":1}");
+  writer.EndObject();
+
+  EXPECT_EQ(
+      "{\"id\":-1,\"tasks\":[{\"replied\":true},{},\"task\"],\"empty\":[],"
+      "\"raw\":{\"a\":1}}",
+      out);
+}
+
+TEST(JsonWriterTest, Escape) {
+  const std::string value = "\"quoted\" back\\slash\n\t\x01 \xe3\x81\x82";
+  std::string out;
+  JsonWriter writer(&out);
+  writer.BeginObject();
+  writer.Key("key\n");
+  writer.String(value);
+  writer.EndObject();
+  EXPECT_EQ(
+      "{\"key\\n\":\"\\\"quoted\\\" back\\\\slash\\n\\t\\u0001 "
+      "\xe3\x81\x82\"}",
+      out);
+
+  Json::Reader reader;
+  Json::Value json;
+  ASSERT_TRUE(reader.parse(out, json)) << out;
+  EXPECT_EQ(value, json["key\n"].asString());
+}
+
+}  // namespace devtools_goma
@@ -47,6 +47,8 @@ class LinkedUnorderedMap {
 
   // Move the value which iterator points to the last.
   void MoveToBack(iterator it);
+  // Removes the entry which iterator points to.
+  void erase(iterator it);
 
   iterator begin() { return list_.begin(); }
   const_iterator begin() const { return list_.begin(); }
@@ -97,6 +99,13 @@ void LinkedUnorderedMap<K, V>::MoveToBack(
   list_.splice(list_.end(), list_, it);
 }
 
+template <typename K, typename V>
+void LinkedUnorderedMap<K, V>::erase(
+    typename LinkedUnorderedMap<K, V>::iterator it) {
+  map_.erase(it->first);
+  list_.erase(it);
+}
+
 template <typename K, typename V>
 typename LinkedUnorderedMap<K, V>::iterator LinkedUnorderedMap<K, V>::find(
     const K& key) {
@@ -119,6 +119,25 @@ TEST(LinkedUnorderedMap, MoveToBack) {
   }
 }
 
+TEST(LinkedUnorderedMap, Erase) {
+  LinkedUnorderedMap<int, std::unique_ptr<int>> m;
+  m.emplace_back(1, absl::make_unique<int>(100));
+  m.emplace_back(2, absl::make_unique<int>(200));
+  m.emplace_back(3, absl::make_unique<int>(300));
+
+  auto jt = m.find(3);
+  m.erase(m.find(2));
+  EXPECT_EQ((std::vector<int> { 1, 3 }), ListKeys(m));
+  EXPECT_FALSE(m.contains(2));
+  EXPECT_EQ(m.end(), m.find(2));
+  // |jt| should be alive.
+  EXPECT_EQ(300, *jt->second);
+
+  m.erase(m.find(1));
+  m.erase(jt);
+  EXPECT_TRUE(m.empty());
+}
+
 TEST(LinkedUnorderedMap, CustomHashFunction) {
   LinkedUnorderedMap<SHA256HashValue, std::string> m;
 
@@ -5,7 +5,6 @@
 #include "list_dir_cache.h"
 
 #include "absl/time/time.h"
-#include "autolock_timer.h"
 #include "counterz.h"
 
 namespace devtools_goma {
@@ -29,19 +28,18 @@ bool ListDirCache::GetDirEntries(const std::string& path,
   entries->clear();
   GOMA_COUNTERZ("total");
 
-  {
-    AUTO_SHARED_LOCK(lock, &rwlock_);
-    auto iter = dir_entries_cache_.find(path);
-    if (iter != dir_entries_cache_.end() &&
-        !filestat.CanBeNewerThan(iter->second.first)) {
-      GOMA_COUNTERZ("hit");
-      hit_.Add(1);
-      *entries = iter->second.second;
-      return true;
-    }
+  std::pair<FileStat, std::vector<DirEntry>> cached;
+  if (dir_entries_cache_.LookupIf(
+          path,
+          [&filestat](const std::pair<FileStat, std::vector<DirEntry>>& v) {
+            return !filestat.CanBeNewerThan(v.first);
+          },
+          &cached)) {
+    GOMA_COUNTERZ("hit");
+    *entries = std::move(cached.second);
+    return true;
   }
   GOMA_COUNTERZ("miss");
-  miss_.Add(1);
 
   if (!ListDirectory(path, entries)) {
     return false;
@@ -51,20 +49,8 @@ bool ListDirCache::GetDirEntries(const std::string& path,
     return true;
   }
 
-  AUTO_EXCLUSIVE_LOCK(lock, &rwlock_);
-  auto exist_entry = dir_entries_cache_.find(path);
-  if (exist_entry != dir_entries_cache_.end()) {
-    current_entries_ -= exist_entry->second.second.size();
-  }
-
-  dir_entries_cache_.emplace_back(path, std::make_pair(filestat, *entries));
-  current_entries_ += entries->size();
-
-  while (current_entries_ > max_entries_) {
-    current_entries_ -= dir_entries_cache_.begin()->second.second.size();
-    dir_entries_cache_.pop_front();
-  }
-
+  const size_t cost = entries->size();
+  dir_entries_cache_.Insert(path, std::make_pair(filestat, *entries), cost);
   return true;
 }
 
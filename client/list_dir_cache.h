@@ -6,14 +6,12 @@
 #define DEVTOOLS_GOMA_CLIENT_LIST_DIR_CACHE_H_
 
 #include <string>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
-#include "atomic_stats_counter.h"
+#include "concurrent_cache.h"
 #include "file_dir.h"
 #include "file_stat.h"
-#include "linked_unordered_map.h"
-#include "lockhelper.h"
 
 namespace devtools_goma {
 
@@ -37,30 +35,29 @@ class ListDirCache {
                      std::vector<DirEntry>* entries);
 
   int64_t hit() const {
-    return hit_.value();
+    return dir_entries_cache_.hit();
   }
 
   int64_t miss() const {
-    return miss_.value();
+    return dir_entries_cache_.miss();
+  }
+
+  int64_t evicted() const {
+    return dir_entries_cache_.evicted();
   }
 
  private:
+  // |max_entries| limits the total number of directory entries, not the
+  // number of cached directories.
   explicit ListDirCache(size_t max_entries)
-      : max_entries_(max_entries), current_entries_(0) {}
+      : dir_entries_cache_(max_entries) {}
   ListDirCache(const ListDirCache&) = delete;
   ListDirCache& operator=(const ListDirCache&) = delete;
 
   static ListDirCache* instance_;
 
-  const size_t max_entries_;
-
-  StatsCounter hit_;
-  StatsCounter miss_;
-
-  ReadWriteLock rwlock_;
-  size_t current_entries_ ABSL_GUARDED_BY(rwlock_);
-  LinkedUnorderedMap<std::string, std::pair<FileStat, std::vector<DirEntry>>>
-      dir_entries_cache_ ABSL_GUARDED_BY(rwlock_);
+  ConcurrentCache<std::string, std::pair<FileStat, std::vector<DirEntry>>>
+      dir_entries_cache_;
 };
 
 }  // namespace devtools_goma
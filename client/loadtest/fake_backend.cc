@@ -0,0 +1,322 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "fake_backend.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "autolock_timer.h"
+#include "callback.h"
+#include "glog/logging.h"
+#include "http_util.h"
+#include "lib/goma_data_util.h"
+
+MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
+#include "lib/goma_log.pb.h"
+MSVC_POP_WARNING()
+
+namespace devtools_goma {
+
+namespace {
+
+// Ignored by the http server, since it comes from localhost.
+constexpr int kMaxNumSockets = 1024;
+
+std::string ErrorResponse(absl::string_view status) {
+  return absl::StrCat("HTTP/1.1 ", status, "\r\n",
+                      "Content-Length: 0\r\n",
+                      "Connection: close\r\n\r\n");
+}
+
+// Returns the last path segment of |path|, so that requests with any
+// GOMA_URL_PATH_PREFIX are served.
+absl::string_view Method(absl::string_view path) {
+  absl::string_view::size_type pos = path.rfind('/');
+  if (pos == absl::string_view::npos) {
+    return path;
+  }
+  return path.substr(pos);
+}
+
+}  // namespace
+
+FakeBackend::FakeBackend(WorkerThreadManager* wm, Options options)
+    : wm_(wm), options_(std::move(options)), rng_(options_.seed) {}
+
+FakeBackend::~FakeBackend() {
+  Stop();
+}
+
+int FakeBackend::Start() {
+  CHECK(server_ == nullptr) << "already started";
+  server_ = absl::make_unique<ThreadpoolHttpServer>(
+      "localhost", options_.port, options_.num_find_ports, wm_,
+      options_.num_threads, this, kMaxNumSockets);
+  PlatformThread::Create(this, &server_thread_);
+  while (!server_->port_ready()) {
+    if (loop_finished_.load(std::memory_order_acquire)) {
+      LOG(ERROR) << "fake backend failed to listen";
+      return -1;
+    }
+    absl::SleepFor(absl::Milliseconds(10));
+  }
+  LOG(INFO) << "fake backend listening on port " << server_->port();
+  return server_->port();
+}
+
+void FakeBackend::Stop() {
+  if (server_ == nullptr) {
+    return;
+  }
+  shutting_down_.store(true, std::memory_order_release);
+  PlatformThread::Join(server_thread_);
+  server_->Wait();
+  server_.reset();
+}
+
+void FakeBackend::ThreadMain() {
+  if (server_->Loop() != 0) {
+    LOG(ERROR) << "fake backend server loop failed";
+  }
+  loop_finished_.store(true, std::memory_order_release);
+}
+
+void FakeBackend::HandleHttpRequest(
+    ThreadpoolHttpServer::HttpServerRequest* http_server_request) {
+  const absl::string_view method = Method(http_server_request->req_path());
+  if (method == "/ping") {
+    Reply(http_server_request,
+          "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n"
+          "Connection: close\r\n\r\nok");
+    return;
+  }
+  if (Roll(options_.error_ratio)) {
+    num_injected_errors_.Add(1);
+    ReplyAfter(http_server_request,
+               ErrorResponse("503 Service Unavailable"),
+               options_.file_latency);
+    return;
+  }
+  if (!ExtractHeaderField(http_server_request->header(), kContentEncoding)
+           .empty()) {
+    // Same as the real server; makes compiler_proxy disable compression.
+    num_bad_requests_.Add(1);
+    Reply(http_server_request, ErrorResponse("415 Unsupported Media Type"));
+    return;
+  }
+
+  const char* content = http_server_request->request_content();
+  const int content_length = http_server_request->request_content_length();
+  std::string response;
+  absl::Duration latency = options_.file_latency;
+  if (method == "/e") {
+    ExecReq req;
+    if (req.ParseFromArray(content, content_length)) {
+      response = HandleExec(req, &latency);
+    }
+  } else if (method == "/s") {
+    StoreFileReq req;
+    if (req.ParseFromArray(content, content_length)) {
+      response = HandleStoreFile(req);
+    }
+  } else if (method == "/l") {
+    LookupFileReq req;
+    if (req.ParseFromArray(content, content_length)) {
+      response = HandleLookupFile(req);
+    }
+  } else if (method == "/sl") {
+    SaveLogReq req;
+    if (req.ParseFromArray(content, content_length)) {
+      num_save_log_.Add(1);
+      response = ProtoResponse(SaveLogResp());
+    }
+  } else {
+    LOG(WARNING) << "unknown path:" << http_server_request->req_path();
+    num_bad_requests_.Add(1);
+    Reply(http_server_request, ErrorResponse("404 Not Found"));
+    return;
+  }
+  if (response.empty()) {
+    LOG(WARNING) << "failed to parse request for "
+                 << http_server_request->req_path();
+    num_bad_requests_.Add(1);
+    Reply(http_server_request, ErrorResponse("400 Bad Request"));
+    return;
+  }
+  ReplyAfter(http_server_request, std::move(response), latency);
+}
+
+std::string FakeBackend::HandleExec(const ExecReq& req,
+                                    absl::Duration* latency) {
+  num_exec_.Add(1);
+  ExecResp resp;
+  resp.set_input_manifest_supported(true);
+  if (Roll(options_.cache_hit_ratio)) {
+    num_exec_cache_hit_.Add(1);
+    resp.set_cache_hit(ExecResp::STORAGE_CACHE);
+  } else {
+    ExecReq expanded;
+    const ExecReq* inputs = &req;
+    if (req.has_input_manifest_hash_key()) {
+      InputManifest manifest;
+      bool found = false;
+      {
+        AUTOLOCK(lock, &mu_);
+        if (req.has_input_manifest()) {
+          manifests_[req.input_manifest_hash_key()] =
+              req.input_manifest().content();
+        }
+        auto it = manifests_.find(req.input_manifest_hash_key());
+        if (it != manifests_.end()) {
+          found = manifest.ParseFromString(it->second);
+        }
+      }
+      if (!found) {
+        resp.set_input_manifest_missing(true);
+        return ProtoResponse(resp);
+      }
+      expanded = req;
+      if (!ExpandInputManifest(manifest, &expanded)) {
+        resp.set_error(ExecResp::BAD_REQUEST);
+        resp.add_error_message("broken input manifest");
+        return ProtoResponse(resp);
+      }
+      inputs = &expanded;
+    }
+
+    {
+      AUTOLOCK(lock, &mu_);
+      for (const auto& input : inputs->input()) {
+        if (input.has_content()) {
+          files_.emplace(input.hash_key(),
+                         input.content().SerializeAsString());
+          continue;
+        }
+        if (!files_.contains(input.hash_key())) {
+          resp.add_missing_input(input.filename());
+          resp.add_missing_reason(
+              absl::StrCat("not uploaded: ", input.hash_key()));
+        }
+      }
+    }
+    if (resp.missing_input_size() > 0) {
+      num_exec_missing_inputs_.Add(1);
+      return ProtoResponse(resp);
+    }
+    *latency = options_.exec_latency;
+  }
+
+  ExecResult* result = resp.mutable_result();
+  result->set_exit_status(0);
+  *result->mutable_command_spec() = req.command_spec();
+  for (const auto& filename : req.expected_output_files()) {
+    ExecResult::Output* output = result->add_output();
+    output->set_filename(filename);
+    FileBlob* blob = output->mutable_blob();
+    blob->set_blob_type(FileBlob::FILE);
+    blob->set_file_size(options_.output_size);
+    std::string content(options_.output_size, 'x');
+    // Make outputs of different requests differ.
+    content.replace(0, std::min(content.size(), filename.size()), filename);
+    blob->set_content(std::move(content));
+  }
+  return ProtoResponse(resp);
+}
+
+std::string FakeBackend::HandleStoreFile(const StoreFileReq& req) {
+  StoreFileResp resp;
+  AUTOLOCK(lock, &mu_);
+  for (const auto& blob : req.blob()) {
+    if (!IsValidFileBlob(blob)) {
+      resp.add_hash_key("");
+      continue;
+    }
+    std::string hash_key = ComputeFileBlobHashKey(blob);
+    num_store_file_.Add(1);
+    num_stored_bytes_.Add(blob.ByteSizeLong());
+    files_[hash_key] = blob.SerializeAsString();
+    resp.add_hash_key(std::move(hash_key));
+  }
+  return ProtoResponse(resp);
+}
+
+std::string FakeBackend::HandleLookupFile(const LookupFileReq& req) {
+  num_lookup_file_.Add(1);
+  LookupFileResp resp;
+  AUTOLOCK(lock, &mu_);
+  for (const auto& hash_key : req.hash_key()) {
+    FileBlob* blob = resp.add_blob();
+    auto it = files_.find(hash_key);
+    if (it == files_.end() || !blob->ParseFromString(it->second)) {
+      blob->Clear();
+      blob->set_blob_type(FileBlob::FILE_UNSPECIFIED);
+    }
+  }
+  return ProtoResponse(resp);
+}
+
+FakeBackend::Stats FakeBackend::GetStats() const {
+  Stats stats;
+  stats.exec = num_exec_.value();
+  stats.exec_cache_hit = num_exec_cache_hit_.value();
+  stats.exec_missing_inputs = num_exec_missing_inputs_.value();
+  stats.store_file = num_store_file_.value();
+  stats.stored_bytes = num_stored_bytes_.value();
+  stats.lookup_file = num_lookup_file_.value();
+  stats.save_log = num_save_log_.value();
+  stats.injected_errors = num_injected_errors_.value();
+  stats.bad_requests = num_bad_requests_.value();
+  return stats;
+}
+
+bool FakeBackend::Roll(double ratio) {
+  if (ratio <= 0.0) {
+    return false;
+  }
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  AUTOLOCK(lock, &mu_);
+  return dist(rng_) < ratio;
+}
+
+void FakeBackend::ReplyAfter(
+    ThreadpoolHttpServer::HttpServerRequest* http_server_request,
+    std::string response,
+    absl::Duration latency) {
+  if (latency <= absl::ZeroDuration()) {
+    Reply(http_server_request, std::move(response));
+    return;
+  }
+  wm_->RunDelayedClosureInThread(
+      FROM_HERE, wm_->GetCurrentThreadId(), latency,
+      NewCallback(&FakeBackend::Reply, http_server_request,
+                  std::move(response)));
+}
+
+// static
+void FakeBackend::Reply(
+    ThreadpoolHttpServer::HttpServerRequest* http_server_request,
+    std::string response) {
+  http_server_request->SendReply(response);
+}
+
+// static
+std::string FakeBackend::ProtoResponse(
+    const google::protobuf::Message& message) {
+  const size_t size = message.ByteSizeLong();
+  std::string response = absl::StrCat(
+      "HTTP/1.1 200 OK\r\n",
+      "Content-Type: binary/x-protocol-buffer\r\n",
+      "Content-Length: ", size, "\r\n",
+      "Connection: close\r\n\r\n");
+  const size_t header_size = response.size();
+  response.resize(header_size + size);
+  message.SerializeToArray(&response[header_size], size);
+  return response;
+}
+
+}  // namespace devtools_goma
@@ -0,0 +1,151 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DEVTOOLS_GOMA_CLIENT_LOADTEST_FAKE_BACKEND_H_
+#define DEVTOOLS_GOMA_CLIENT_LOADTEST_FAKE_BACKEND_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
+#include "atomic_stats_counter.h"
+#include "basictypes.h"
+#include "compiler_specific.h"
+#include "lockhelper.h"
+#include "platform_thread.h"
+#include "threadpool_http_server.h"
+#include "worker_thread_manager.h"
+
+MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
+#include "lib/goma_data.pb.h"
+MSVC_POP_WARNING()
+
+namespace devtools_goma {
+
+// FakeBackend is an in-process goma server for load tests.
+//
+// It serves Exec (/e), StoreFile (/s), LookupFile (/l), SaveLog (/sl) and
+// ping (/ping) over plain HTTP on localhost, so compiler_proxy can be pointed
+// at it with GOMA_SERVER_HOST, GOMA_SERVER_PORT and GOMA_USE_SSL=false.
+// Request paths may have any prefix (GOMA_URL_PATH_PREFIX).
+//
+// Exec works like the real server as far as compiler_proxy can tell:
+//  - inputs whose content it has not seen are reported as missing_input,
+//  - input manifests are expanded,
+//  - each expected output file is returned with generated content.
+// Latency, errors and cache hits are injected as configured in Options.
+// Like the real server, compressed requests are rejected with 415, so
+// compiler_proxy should run with GOMA_HTTP_RPC_COMPRESSION_LEVEL=0.
+class FakeBackend : public ThreadpoolHttpServer::HttpHandler,
+                    public PlatformThread::Delegate {
+ public:
+  struct Options {
+    // First port to try to listen on.
+    int port = 8099;
+    int num_find_ports = 100;
+    int num_threads = 8;
+
+    // Extra delay before Exec and file service responses.
+    absl::Duration exec_latency = absl::Milliseconds(200);
+    absl::Duration file_latency = absl::Milliseconds(10);
+    // Ratio of Exec requests answered from the fake cache, without
+    // exec_latency and without checking inputs.
+    double cache_hit_ratio = 0.0;
+    // Ratio of requests answered with HTTP 503.
+    double error_ratio = 0.0;
+    // Size of each generated output file.
+    size_t output_size = 64 * 1024;
+    uint32_t seed = 0;
+  };
+
+  // Stats.
+  struct Stats {
+    int64_t exec = 0;
+    int64_t exec_cache_hit = 0;
+    int64_t exec_missing_inputs = 0;
+    int64_t store_file = 0;
+    int64_t stored_bytes = 0;
+    int64_t lookup_file = 0;
+    int64_t save_log = 0;
+    int64_t injected_errors = 0;
+    int64_t bad_requests = 0;
+  };
+
+  FakeBackend(WorkerThreadManager* wm, Options options);
+  ~FakeBackend() override;
+
+  // Starts serving on another thread, and returns the port after it is
+  // ready. Returns -1 on failure.
+  int Start();
+  // Stops serving and waits for the server thread.
+  void Stop();
+
+  // ThreadpoolHttpServer::HttpHandler.
+  void HandleHttpRequest(
+      ThreadpoolHttpServer::HttpServerRequest* http_server_request) override;
+  bool shutting_down() override {
+    return shutting_down_.load(std::memory_order_acquire);
+  }
+
+  Stats GetStats() const;
+
+ private:
+  // PlatformThread::Delegate. Runs the server loop.
+  void ThreadMain() override;
+
+  std::string HandleExec(const ExecReq& req, absl::Duration* latency);
+  std::string HandleStoreFile(const StoreFileReq& req);
+  std::string HandleLookupFile(const LookupFileReq& req);
+
+  // Returns true with |ratio| probability.
+  bool Roll(double ratio);
+
+  // Sends |response| after |latency|, without blocking the current thread.
+  void ReplyAfter(ThreadpoolHttpServer::HttpServerRequest* http_server_request,
+                  std::string response,
+                  absl::Duration latency);
+  static void Reply(
+      ThreadpoolHttpServer::HttpServerRequest* http_server_request,
+      std::string response);
+
+  static std::string ProtoResponse(const google::protobuf::Message& message);
+
+  WorkerThreadManager* wm_;
+  const Options options_;
+  std::unique_ptr<ThreadpoolHttpServer> server_;
+  PlatformThreadHandle server_thread_;
+  std::atomic<bool> shutting_down_{false};
+  std::atomic<bool> loop_finished_{false};
+
+  mutable Lock mu_;
+  std::mt19937 rng_ ABSL_GUARDED_BY(mu_);
+  // hash_key -> serialized FileBlob.
+  absl::flat_hash_map<std::string, std::string> files_ ABSL_GUARDED_BY(mu_);
+  // hash_key -> serialized InputManifest.
+  absl::flat_hash_map<std::string, std::string> manifests_
+      ABSL_GUARDED_BY(mu_);
+
+  StatsCounter num_exec_;
+  StatsCounter num_exec_cache_hit_;
+  StatsCounter num_exec_missing_inputs_;
+  StatsCounter num_store_file_;
+  StatsCounter num_stored_bytes_;
+  StatsCounter num_lookup_file_;
+  StatsCounter num_save_log_;
+  StatsCounter num_injected_errors_;
+  StatsCounter num_bad_requests_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeBackend);
+};
+
+}  // namespace devtools_goma
+
+#endif  // DEVTOOLS_GOMA_CLIENT_LOADTEST_FAKE_BACKEND_H_
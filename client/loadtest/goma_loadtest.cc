@@ -0,0 +1,658 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// goma_loadtest is a synthetic end-to-end load generator for compiler_proxy.
+//
+// It starts a FakeBackend in this process, runs compiler_proxy against it,
+// and sends ExecReqs to compiler_proxy from --clients threads, as gomacc
+// does. Tasks are either synthetic compiles of *.fake files with the fake
+// compiler, the entries of a compile_commands.json (--compdb), or ExecReqs
+// recorded by compiler_proxy with GOMA_EXEC_REQ_RECORD_FILE (--replay).
+//
+// It reports throughput, latency histograms of each phase taken from
+// ExecResp, and saves compiler_proxy's /histogramz, /contentionz and /statz
+// in --workdir.
+//
+// Note that outputs of --compdb entries are overwritten by fake outputs,
+// so use a scratch build directory.
+//
+// --replay sends the recorded ExecReqs as is, at the recorded times scaled
+// by --replay_speed, so it needs the same checkout and build directory as
+// the recording, and enough --clients for the recorded parallelism.
+// To compare what two compiler_proxy versions send to the server, pass
+// GOMA_EXEC_REQ_RECORD_FILE in --compiler_proxy_env and compare the inputs
+// of the new records with the replayed ones.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "autolock_timer.h"
+#include "cmdline_parser.h"
+#include "exec_req_recorder.h"
+#include "fake_backend.h"
+#include "file_helper.h"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "goma_init.h"
+#include "goma_ipc.h"
+#include "goma_ipc_addr.h"
+#include "histogram.h"
+#include "mypath.h"
+#include "path.h"
+#include "platform_thread.h"
+#include "scoped_fd.h"
+#include "util.h"
+#include "worker_thread_manager.h"
+
+MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
+#include "lib/goma_data.pb.h"
+MSVC_POP_WARNING()
+
+#include "goma_flags.cc"
+
+DEFINE_string(compiler_proxy, "", "Path to compiler_proxy to test.");
+DEFINE_string(fake_compiler, "",
+              "Path to the fake compiler used for synthetic tasks.");
+DEFINE_string(compdb, "",
+              "compile_commands.json to replay instead of synthetic tasks.");
+DEFINE_string(replay, "",
+              "ExecReq records (GOMA_EXEC_REQ_RECORD_FILE) to replay "
+              "instead of synthetic tasks.");
+DEFINE_double(replay_speed, 1.0,
+              "Speed of --replay relative to the recording. "
+              "0 sends requests as fast as --clients can.");
+DEFINE_string(workdir, "",
+              "Directory for sources, outputs and compiler_proxy files. "
+              "A new temporary directory is used if empty.");
+DEFINE_int32(clients, 16, "Number of simulated gomacc clients.");
+DEFINE_int32(tasks, 1000, "Number of synthetic tasks.");
+DEFINE_int32(sources, 100, "Number of synthetic source files.");
+DEFINE_int32(source_size, 4096, "Size of each synthetic source file.");
+DEFINE_bool(fallback, true, "Allow local fallback on remote failure.");
+DEFINE_string(compiler_proxy_env, "",
+              "Comma separated NAME=VALUE to pass to compiler_proxy, "
+              "e.g. GOMA_MAX_SUBPROCS=0.");
+DEFINE_int32(compiler_proxy_port, 8189,
+             "HTTP port compiler_proxy tries to listen on first.");
+DEFINE_int32(backend_port, 8199,
+             "Port the fake backend tries to listen on first.");
+DEFINE_int32(backend_threads, 8, "Number of fake backend threads.");
+DEFINE_int32(exec_latency_ms, 200, "Fake Exec latency.");
+DEFINE_int32(file_latency_ms, 10, "Fake file service latency.");
+DEFINE_double(cache_hit_ratio, 0.0,
+              "Ratio of Exec requests answered as cache hits.");
+DEFINE_double(error_ratio, 0.0,
+              "Ratio of backend requests failed with HTTP 503.");
+DEFINE_int32(output_size, 64 * 1024, "Size of each fake output file.");
+DEFINE_int32(seed, 0, "Random seed of the fake backend.");
+
+namespace devtools_goma {
+
+namespace {
+
+struct Task {
+  std::vector<std::string> args;
+  std::string cwd;
+  std::string local_compiler_path;
+
+  // Set for --replay.
+  absl::optional<ExecReq> recorded_req;
+  absl::Duration time_offset;
+};
+
+// Connects to compiler_proxy's IPC socket.
+class SocketChanFactory : public GomaIPC::ChanFactory {
+ public:
+  explicit SocketChanFactory(std::string socket_path)
+      : socket_path_(std::move(socket_path)) {
+    addr_len_ = InitializeGomaIPCAddress(socket_path_, &addr_);
+  }
+
+  std::unique_ptr<IOChannel> New() override {
+    const absl::Time deadline = absl::Now() + absl::Seconds(10);
+    absl::Duration backoff = absl::Milliseconds(1);
+    for (;;) {
+      ScopedSocket socket_fd(socket(AF_GOMA_IPC,
+                                    SOCK_STREAM, 0));
+      if (!socket_fd.valid()) {
+        PLOG(ERROR) << "failed to create socket";
+        return nullptr;
+      }
+      if (connect(socket_fd.get(), reinterpret_cast<sockaddr*>(&addr_),
+                  addr_len_) == 0) {
+        if (!socket_fd.SetNonBlocking()) {
+          return nullptr;
+        }
+        return absl::make_unique<ScopedSocket>(std::move(socket_fd));
+      }
+      // compiler_proxy's accept backlog is full, or it is not ready yet.
+      if ((errno != ECONNREFUSED && errno != EAGAIN && errno != ENOENT) ||
+          absl::Now() > deadline) {
+        PLOG(ERROR) << "failed to connect to " << socket_path_;
+        return nullptr;
+      }
+      absl::SleepFor(backoff);
+      backoff = std::min(backoff * 2, absl::Milliseconds(100));
+    }
+  }
+
+  std::string DestName() const override { return socket_path_; }
+
+ private:
+  const std::string socket_path_;
+  GomaIPCAddr addr_;
+  socklen_t addr_len_;
+};
+
+// Creates synthetic sources in |workdir| and a task for each compile.
+bool MakeSyntheticTasks(const std::string& workdir, std::vector<Task>* tasks) {
+  if (FLAGS_fake_compiler.empty()) {
+    LOG(ERROR) << "--fake_compiler is required for synthetic tasks";
+    return false;
+  }
+  std::vector<std::string> sources;
+  for (int i = 0; i < FLAGS_sources; ++i) {
+    std::string name = absl::StrCat("src_", i, ".fake");
+    std::string content = absl::StrCat("// ", name, "\n");
+    content.resize(std::max<size_t>(content.size(), FLAGS_source_size), 'x');
+    if (!WriteStringToFile(
+            content, file::JoinPath(workdir, name))) {
+      LOG(ERROR) << "failed to write " << name;
+      return false;
+    }
+    sources.push_back(std::move(name));
+  }
+  for (int i = 0; i < FLAGS_tasks; ++i) {
+    Task task;
+    task.args = {"fake", sources[i % sources.size()]};
+    task.cwd = workdir;
+    task.local_compiler_path = FLAGS_fake_compiler;
+    tasks->push_back(std::move(task));
+  }
+  return true;
+}
+
+// Reads tasks from compile_commands.json at |path|.
+bool ReadCompilationDatabase(const std::string& path,
+                             std::vector<Task>* tasks) {
+  std::string content;
+  if (!ReadFileToString(path, &content)) {
+    LOG(ERROR) << "failed to read " << path;
+    return false;
+  }
+  Json::Reader reader;
+  Json::Value root;
+  if (!reader.parse(content, root, false) || !root.isArray()) {
+    LOG(ERROR) << "failed to parse " << path;
+    return false;
+  }
+  for (const auto& entry : root) {
+    Task task;
+    task.cwd = entry["directory"].asString();
+    if (entry["arguments"].isArray()) {
+      for (const auto& arg : entry["arguments"]) {
+        task.args.push_back(arg.asString());
+      }
+    } else if (!ParsePosixCommandLineToArgv(
+                   entry["command"].asString(), &task.args)) {
+      LOG(ERROR) << "failed to parse command: " << entry["command"];
+      return false;
+    }
+    if (!task.args.empty() && file::Stem(task.args[0]) == "gomacc") {
+      task.args.erase(task.args.begin());
+    }
+    if (task.args.empty() || task.cwd.empty()) {
+      LOG(ERROR) << "bad entry in " << path << ": " << entry;
+      return false;
+    }
+    if (file::IsAbsolutePath(task.args[0])) {
+      task.local_compiler_path = task.args[0];
+    }
+    tasks->push_back(std::move(task));
+  }
+  return !tasks->empty();
+}
+
+// Reads tasks from ExecReq records at |path|, in the order they were
+// received by compiler_proxy.
+bool ReadRecordedTasks(const std::string& path, std::vector<Task>* tasks) {
+  std::vector<ExecReqRecord> records;
+  if (!ReadExecReqRecords(path, &records)) {
+    LOG(WARNING) << "replaying " << records.size() << " records read from "
+                 << path;
+  }
+  for (auto& record : records) {
+    Task task;
+    task.time_offset = absl::Microseconds(record.time_offset_usec());
+    task.recorded_req = std::move(*record.mutable_req());
+    tasks->push_back(std::move(task));
+  }
+  // Records are written when tasks finish.
+  std::stable_sort(tasks->begin(), tasks->end(),
+                   [](const Task& a, const Task& b) {
+                     return a.time_offset < b.time_offset;
+                   });
+  return !tasks->empty();
+}
+
+void PrepareExecReq(const Task& task, ExecReq* req) {
+  if (task.recorded_req.has_value()) {
+    *req = *task.recorded_req;
+    req->mutable_requester_info()->set_pid(Getpid());
+    return;
+  }
+  req->mutable_command_spec()->set_name(std::string(file::Stem(task.args[0])));
+  if (!task.local_compiler_path.empty()) {
+    req->mutable_command_spec()->set_local_compiler_path(
+        task.local_compiler_path);
+  }
+  for (const auto& arg : task.args) {
+    req->add_arg(arg);
+  }
+  req->set_cwd(task.cwd);
+  req->mutable_requester_info()->set_api_version(
+      RequesterInfo::CURRENT_VERSION);
+  req->mutable_requester_info()->set_pid(Getpid());
+
+  RequesterEnv* requester_env = req->mutable_requester_env();
+  requester_env->set_gomacc_path(GetMyPathname());
+  absl::optional<std::string> path_env = GetEnv("PATH");
+  if (path_env) {
+    requester_env->set_local_path(std::move(*path_env));
+  }
+  requester_env->set_use_local(false);
+  requester_env->set_fallback(FLAGS_fallback);
+  mode_t mask = umask(0000);
+  umask(mask);
+  requester_env->set_umask(mask);
+}
+
+// Phases of a task reported in ExecResp.
+struct Phase {
+  const char* name;
+  bool (ExecResp::*has)() const;
+  double (ExecResp::*get)() const;
+};
+
+#define PHASE(field) \
+  { #field, &ExecResp::has_compiler_proxy_##field, \
+    &ExecResp::compiler_proxy_##field }
+const Phase kPhases[] = {
+    PHASE(time),
+    PHASE(include_preproc_time),
+    PHASE(include_fileload_time),
+    PHASE(rpc_call_time),
+    PHASE(file_response_time),
+    PHASE(rpc_build_time),
+    PHASE(rpc_send_time),
+    PHASE(rpc_wait_time),
+    PHASE(rpc_recv_time),
+    PHASE(rpc_parse_time),
+    PHASE(local_pending_time),
+    PHASE(local_run_time),
+};
+#undef PHASE
+
+// Collects results of tasks. Thread-safe.
+class LoadStats {
+ public:
+  LoadStats() {
+    for (const auto& phase : kPhases) {
+      phases_[phase.name].SetName(phase.name);
+    }
+    end_to_end_.SetName("end_to_end");
+  }
+
+  void Add(int err, const ExecResp& resp, absl::Duration latency) {
+    AUTOLOCK(lock, &mu_);
+    end_to_end_.AddTimeAsMilliseconds(latency);
+    if (err < 0 || !resp.has_result() || resp.result().exit_status() != 0) {
+      ++num_failed_;
+      return;
+    }
+    ++num_ok_;
+    if (resp.compiler_proxy_goma_cache_hit()) {
+      ++num_cache_hit_;
+    }
+    if (resp.compiler_proxy_local_run()) {
+      ++num_local_run_;
+    }
+    if (resp.compiler_proxy_goma_error()) {
+      ++num_goma_error_;
+    }
+    num_retries_ += resp.compiler_proxy_exec_request_retry();
+    for (const auto& phase : kPhases) {
+      if ((resp.*phase.has)()) {
+        phases_[phase.name].AddTimeAsMilliseconds(
+            absl::Seconds((resp.*phase.get)()));
+      }
+    }
+  }
+
+  void Report(absl::Duration elapsed, std::ostream* os) const {
+    AUTOLOCK(lock, &mu_);
+    const int64_t num_tasks = num_ok_ + num_failed_;
+    *os << "tasks: " << num_tasks << " ok=" << num_ok_
+        << " failed=" << num_failed_ << " in " << elapsed << " ("
+        << num_tasks / absl::ToDoubleSeconds(elapsed) << " tasks/s)\n"
+        << "goma_cache_hit=" << num_cache_hit_
+        << " local_run=" << num_local_run_
+        << " goma_error=" << num_goma_error_
+        << " exec_request_retry=" << num_retries_ << "\n\n";
+    if (end_to_end_.count() > 0) {
+      *os << end_to_end_.DebugString() << "\n";
+    }
+    for (const auto& phase : kPhases) {
+      const Histogram& histogram = phases_.at(phase.name);
+      if (histogram.count() > 0) {
+        *os << histogram.DebugString() << "\n";
+      }
+    }
+  }
+
+ private:
+  mutable Lock mu_;
+  Histogram end_to_end_ ABSL_GUARDED_BY(mu_);
+  std::map<std::string, Histogram> phases_ ABSL_GUARDED_BY(mu_);
+  int64_t num_ok_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t num_failed_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t num_cache_hit_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t num_local_run_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t num_goma_error_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t num_retries_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+
+// A simulated gomacc. Runs tasks until all of them are taken.
+class Client : public PlatformThread::Delegate {
+ public:
+  Client(const std::string& socket_path,
+         const std::vector<Task>* tasks,
+         std::atomic<size_t>* next_task,
+         absl::Time start_time,
+         LoadStats* stats)
+      : ipc_(absl::make_unique<SocketChanFactory>(socket_path)),
+        tasks_(tasks),
+        next_task_(next_task),
+        start_time_(start_time),
+        stats_(stats) {}
+
+  void ThreadMain() override {
+    for (;;) {
+      const size_t i = next_task_->fetch_add(1);
+      if (i >= tasks_->size()) {
+        return;
+      }
+      const Task& task = (*tasks_)[i];
+      if (task.recorded_req.has_value() && FLAGS_replay_speed > 0) {
+        absl::SleepFor(start_time_ + task.time_offset / FLAGS_replay_speed -
+                       absl::Now());
+      }
+      ExecReq req;
+      PrepareExecReq(task, &req);
+      ExecResp resp;
+      GomaIPC::Status status;
+      const absl::Time start = absl::Now();
+      const int err = ipc_.Call("/e", &req, &resp, &status);
+      LOG_IF(WARNING, err < 0) << "task " << i << " failed: "
+                               << status.DebugString();
+      stats_->Add(err, resp, absl::Now() - start);
+    }
+  }
+
+ private:
+  GomaIPC ipc_;
+  const std::vector<Task>* tasks_;
+  std::atomic<size_t>* next_task_;
+  const absl::Time start_time_;
+  LoadStats* stats_;
+};
+
+// Starts compiler_proxy talking to the fake backend at |backend_port|.
+pid_t StartCompilerProxy(const std::string& workdir,
+                         const std::string& socket_path,
+                         int backend_port) {
+  std::vector<std::string> env = {
+      "GOMA_SERVER_HOST=127.0.0.1",
+      absl::StrCat("GOMA_SERVER_PORT=", backend_port),
+      "GOMA_USE_SSL=false",
+      "GOMA_HTTP_RPC_COMPRESSION_LEVEL=0",
+      "GOMA_USE_LOCAL=false",
+      "GOMA_ENABLE_CONTENTIONZ=true",
+      absl::StrCat("GOMA_COMPILER_PROXY_PORT=", FLAGS_compiler_proxy_port),
+      "GOMA_COMPILER_PROXY_SOCKET_NAME=" + socket_path,
+      "GOMA_TMP_DIR=" + workdir,
+      "GOMA_CACHE_DIR=" + workdir,
+      "GLOG_log_dir=" + workdir,
+      "PATH=" + GetEnv("PATH").value_or(""),
+      "HOME=" + GetEnv("HOME").value_or(""),
+      "USER=" + GetEnv("USER").value_or(""),
+  };
+  for (auto&& e : absl::StrSplit(FLAGS_compiler_proxy_env, ',',
+                                 absl::SkipEmpty())) {
+    env.emplace_back(e);
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    PLOG(ERROR) << "fork";
+    return -1;
+  }
+  if (pid == 0) {
+    std::vector<char*> envp;
+    for (auto& e : env) {
+      envp.push_back(&e[0]);
+    }
+    envp.push_back(nullptr);
+    char* argv[] = {&FLAGS_compiler_proxy[0], nullptr};
+    execve(FLAGS_compiler_proxy.c_str(), argv, envp.data());
+    PLOG(ERROR) << "execve " << FLAGS_compiler_proxy;
+    _exit(1);
+  }
+  return pid;
+}
+
+// Waits until compiler_proxy |pid| accepts requests, and returns its HTTP
+// port, or -1 on failure.
+int WaitForCompilerProxy(const std::string& socket_path, pid_t pid) {
+  GomaIPC ipc(absl::make_unique<SocketChanFactory>(socket_path));
+  const absl::Time deadline = absl::Now() + absl::Minutes(1);
+  while (absl::Now() < deadline) {
+    EmptyMessage req;
+    HttpPortResponse resp;
+    GomaIPC::Status status;
+    if (ipc.Call("/portz", &req, &resp, &status) >= 0) {
+      return resp.port();
+    }
+    int wstatus;
+    if (waitpid(pid, &wstatus, WNOHANG) == pid) {
+      LOG(ERROR) << "compiler_proxy exited: " << wstatus;
+      return -1;
+    }
+    absl::SleepFor(absl::Milliseconds(100));
+  }
+  LOG(ERROR) << "compiler_proxy was not ready in time";
+  return -1;
+}
+
+// Gets |path| from the HTTP server at localhost:|port|, and returns the
+// response body.
+std::string HttpGet(int port, const std::string& path) {
+  ScopedSocket socket_fd(socket(AF_INET, SOCK_STREAM, 0));
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sa.sin_port = htons(static_cast<u_short>(port));
+  if (!socket_fd.valid() ||
+      connect(socket_fd.get(), reinterpret_cast<sockaddr*>(&sa),
+              sizeof(sa)) < 0) {
+    PLOG(ERROR) << "failed to connect to port " << port;
+    return "";
+  }
+  const std::string request =
+      absl::StrCat("GET ", path, " HTTP/1.1\r\n",
+                   "Host: localhost\r\n",
+                   "Connection: close\r\n\r\n");
+  if (socket_fd.WriteString(request, absl::Seconds(10)) != 0) {
+    LOG(ERROR) << "failed to send request for " << path;
+    return "";
+  }
+  std::string response;
+  char buf[4096];
+  ssize_t n;
+  while ((n = socket_fd.Read(buf, sizeof(buf))) > 0) {
+    response.append(buf, n);
+  }
+  const std::string::size_type body = response.find("\r\n\r\n");
+  if (body == std::string::npos) {
+    return "";
+  }
+  return response.substr(body + 4);
+}
+
+void SaveCompilerProxyStats(int port, const std::string& workdir) {
+  for (const auto& path : {"/histogramz", "/contentionz", "/statz"}) {
+    const std::string filename =
+        file::JoinPath(workdir, absl::StrCat(path + 1, ".txt"));
+    if (WriteStringToFile(HttpGet(port, path), filename)) {
+      std::cout << "compiler_proxy " << path << ": " << filename << "\n";
+    }
+  }
+}
+
+// Runs the load test, and returns the exit status.
+int RunLoadTest() {
+  std::string workdir = FLAGS_workdir;
+  if (workdir.empty()) {
+    char tmpl[] = "/tmp/goma_loadtest.XXXXXX";
+    if (mkdtemp(tmpl) == nullptr) {
+      PLOG(FATAL) << "mkdtemp";
+    }
+    workdir = tmpl;
+  }
+  std::cout << "workdir: " << workdir << "\n";
+
+  std::vector<Task> tasks;
+  if (!FLAGS_replay.empty()) {
+    if (!ReadRecordedTasks(FLAGS_replay, &tasks)) {
+      return 1;
+    }
+  } else if (!FLAGS_compdb.empty()) {
+    if (!ReadCompilationDatabase(FLAGS_compdb, &tasks)) {
+      return 1;
+    }
+  } else if (!MakeSyntheticTasks(workdir, &tasks)) {
+    return 1;
+  }
+
+  WorkerThreadManager wm;
+  wm.Start(FLAGS_backend_threads);
+  FakeBackend::Options options;
+  options.port = FLAGS_backend_port;
+  options.num_threads = FLAGS_backend_threads;
+  options.exec_latency = absl::Milliseconds(FLAGS_exec_latency_ms);
+  options.file_latency = absl::Milliseconds(FLAGS_file_latency_ms);
+  options.cache_hit_ratio = FLAGS_cache_hit_ratio;
+  options.error_ratio = FLAGS_error_ratio;
+  options.output_size = FLAGS_output_size;
+  options.seed = FLAGS_seed;
+  FakeBackend backend(&wm, options);
+  const int backend_port = backend.Start();
+  if (backend_port < 0) {
+    return 1;
+  }
+
+  const std::string socket_path = file::JoinPath(workdir, "goma.ipc");
+  const pid_t pid = StartCompilerProxy(workdir, socket_path, backend_port);
+  const int http_port = pid < 0 ? -1 : WaitForCompilerProxy(socket_path, pid);
+  if (http_port < 0) {
+    if (pid > 0) {
+      kill(pid, SIGTERM);
+      waitpid(pid, nullptr, 0);
+    }
+    return 1;
+  }
+  std::cout << "compiler_proxy: pid=" << pid << " http://localhost:"
+            << http_port << "\n";
+
+  LoadStats stats;
+  std::atomic<size_t> next_task(0);
+  std::vector<std::unique_ptr<Client>> clients;
+  std::vector<PlatformThreadHandle> handles(FLAGS_clients);
+  const absl::Time start = absl::Now();
+  for (int i = 0; i < FLAGS_clients; ++i) {
+    clients.push_back(absl::make_unique<Client>(socket_path, &tasks,
+                                                &next_task, start, &stats));
+    PlatformThread::Create(clients.back().get(), &handles[i]);
+  }
+  for (auto& handle : handles) {
+    PlatformThread::Join(handle);
+  }
+  const absl::Duration elapsed = absl::Now() - start;
+
+  SaveCompilerProxyStats(http_port, workdir);
+  HttpGet(http_port, "/quitquitquit");
+  waitpid(pid, nullptr, 0);
+  backend.Stop();
+  wm.Finish();
+
+  stats.Report(elapsed, &std::cout);
+  const FakeBackend::Stats backend_stats = backend.GetStats();
+  std::cout << "backend: exec=" << backend_stats.exec
+            << " cache_hit=" << backend_stats.exec_cache_hit
+            << " missing_inputs=" << backend_stats.exec_missing_inputs
+            << " store_file=" << backend_stats.store_file
+            << " stored_bytes=" << backend_stats.stored_bytes
+            << " lookup_file=" << backend_stats.lookup_file
+            << " save_log=" << backend_stats.save_log
+            << " injected_errors=" << backend_stats.injected_errors
+            << " bad_requests=" << backend_stats.bad_requests << std::endl;
+  return 0;
+}
+
+}  // namespace
+
+}  // namespace devtools_goma
+
+int main(int argc, char* argv[], const char* envp[]) {
+  devtools_goma::Init(argc, argv, envp);
+  gflags::SetUsageMessage(absl::StrCat(
+      "Load test of compiler_proxy with a fake backend.\n",
+      "Usage: ", argv[0], " --compiler_proxy=<path> [options...]"));
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  devtools_goma::InitLogging(argv[0]);
+  if (FLAGS_compiler_proxy.empty() || FLAGS_clients <= 0) {
+    gflags::ShowUsageWithFlags(argv[0]);
+    exit(1);
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  return devtools_goma::RunLoadTest();
+}
@@ -24,6 +24,7 @@
 
 #if defined(__MACH__)
 #include <libproc.h>
+#include <stdlib.h>
 #include <sys/sysctl.h>
 #include <sys/proc_info.h>
 #endif
@@ -86,6 +87,11 @@ int64_t GetVirtualMemoryOfCurrentProcess() {
   return pmc.PagefileUsage;
 }
 
+bool GetSystemLoad(double* load_average, int* runnable_threads) {
+  // Windows doesn't have load average.
+  return false;
+}
+
 #elif defined(__linux__)
 
 int GetNumCPUs() {
@@ -166,6 +172,37 @@ int64_t GetVirtualMemoryOfCurrentProcess() {
   return vm_size;
 }
 
+bool GetSystemLoad(double* load_average, int* runnable_threads) {
+  // Reads /proc/loadavg
+  // e.g. "0.50 0.40 0.30 3/456 12345"
+  // The fourth column is the number of runnable threads / total threads.
+  ScopedFd fd(ScopedFd::OpenForRead("/proc/loadavg"));
+  if (!fd.valid()) {
+    PLOG(ERROR) << "Opening /proc/loadavg failed";
+    return false;
+  }
+
+  char buf[256];
+  ssize_t read_len;
+  if ((read_len = fd.Read(buf, sizeof(buf) - 1)) < 0) {
+    PLOG(ERROR) << "Reading /proc/loadavg failed";
+    return false;
+  }
+  buf[read_len] = '\0';
+
+  double avg1;
+  int runnable;
+  if (sscanf(buf, "%lf %*f %*f %d/", &avg1, &runnable) != 2) {
+    LOG(ERROR) << "Data from /proc/loadavg is not in expected form:"
+               << absl::string_view(buf, read_len);
+    return false;
+  }
+
+  *load_average = avg1;
+  *runnable_threads = runnable;
+  return true;
+}
+
 #elif defined(__MACH__)
 int GetNumCPUs() {
   static const char* kCandidates[] = {
@@ -238,6 +275,17 @@ int64_t GetVirtualMemoryOfCurrentProcess() {
   return taskinfo.pti_virtual_size;
 }
 
+bool GetSystemLoad(double* load_average, int* runnable_threads) {
+  double avg[1];
+  if (getloadavg(avg, 1) != 1) {
+    LOG(ERROR) << "getloadavg failed";
+    return false;
+  }
+  *load_average = avg[0];
+  *runnable_threads = -1;
+  return true;
+}
+
 #else
 #  error "Unknown architecture"
 #endif
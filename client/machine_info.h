@@ -28,6 +28,11 @@ int64_t GetConsumingMemoryOfCurrentProcess();
 // If failed obtaining, 0 will be returned.
 int64_t GetVirtualMemoryOfCurrentProcess();
 
+// Gets 1 minute load average and the number of runnable threads of the
+// system. |runnable_threads| will be -1 if it is not available.
+// Returns false if failed obtaining.
+bool GetSystemLoad(double* load_average, int* runnable_threads);
+
 }  // namespace devtools_goma
 
 #endif  // DEVTOOLS_GOMA_CLIENT_MACHINE_INFO_H_
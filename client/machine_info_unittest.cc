@@ -16,4 +16,19 @@ TEST(MachineInfoTest, Smoke) {
   EXPECT_NE(0, GetVirtualMemoryOfCurrentProcess());
 }
 
+#ifndef _WIN32
+TEST(MachineInfoTest, GetSystemLoad) {
+  double load_average = -1;
+  int runnable_threads = -2;
+  EXPECT_TRUE(GetSystemLoad(&load_average, &runnable_threads));
+  EXPECT_GE(load_average, 0.0);
+#ifdef __linux__
+  // At least this thread is runnable.
+  EXPECT_GE(runnable_threads, 1);
+#else
+  EXPECT_EQ(-1, runnable_threads);
+#endif
+}
+#endif
+
 }  // namespace devtools_goma
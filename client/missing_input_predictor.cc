@@ -0,0 +1,131 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "missing_input_predictor.h"
+
+#include <vector>
+
+#include "absl/time/clock.h"
+#include "autolock_timer.h"
+#include "glog/logging.h"
+#include "path.h"
+
+namespace devtools_goma {
+
+MissingInputPredictor::MissingInputPredictor(absl::Duration window)
+    : window_(window) {}
+
+bool MissingInputPredictor::ShouldPush(absl::string_view abs_filename,
+                                       const std::string& hash_key) {
+  SHA256HashValue hash_value;
+  if (!SHA256HashValue::ConvertFromHexString(hash_key, &hash_value)) {
+    return false;
+  }
+  {
+    AUTO_SHARED_LOCK(lock, &mu_);
+    if (suspicious_dirs_.empty()) {
+      return false;
+    }
+    auto found = suspicious_dirs_.find(file::Dirname(abs_filename));
+    if (found == suspicious_dirs_.end() ||
+        absl::Now() - found->second > window_) {
+      return false;
+    }
+    if (confirmed_.contains(hash_value)) {
+      return false;
+    }
+  }
+  num_pushed_inputs_.Add(1);
+  return true;
+}
+
+void MissingInputPredictor::RecordResponse(absl::string_view cwd,
+                                           const ExecReq& req,
+                                           const ExecResp& resp,
+                                           bool pushed,
+                                           absl::Duration rpc_time) {
+  num_requests_.Add(1);
+  const absl::Time now = absl::Now();
+
+  if (resp.missing_input_size() > 0) {
+    num_missing_input_responses_.Add(1);
+    missing_input_rpc_time_ms_.Add(absl::ToInt64Milliseconds(rpc_time));
+
+    absl::flat_hash_map<absl::string_view, const std::string*> hash_keys;
+    for (const auto& input : req.input()) {
+      hash_keys.emplace(input.filename(), &input.hash_key());
+    }
+    AUTO_EXCLUSIVE_LOCK(lock, &mu_);
+    PruneUnlocked(now);
+    for (const auto& filename : resp.missing_input()) {
+      const std::string abs_filename =
+          file::JoinPathRespectAbsolute(cwd, filename);
+      suspicious_dirs_[file::Dirname(abs_filename)] = now;
+      // The server may have lost it.
+      auto found = hash_keys.find(filename);
+      SHA256HashValue hash_value;
+      if (found != hash_keys.end() &&
+          SHA256HashValue::ConvertFromHexString(*found->second,
+                                                &hash_value)) {
+        confirmed_.erase(hash_value);
+      }
+    }
+    return;
+  }
+
+  if (pushed) {
+    num_saved_round_trips_.Add(1);
+    saved_rpc_time_ms_.Add(absl::ToInt64Milliseconds(rpc_time));
+  }
+
+  // Confirm hash keys of inputs in suspicious directories, so that they
+  // won't be pushed again.
+  std::vector<SHA256HashValue> confirmed;
+  {
+    AUTO_SHARED_LOCK(lock, &mu_);
+    if (suspicious_dirs_.empty()) {
+      return;
+    }
+    for (const auto& input : req.input()) {
+      const std::string abs_filename =
+          file::JoinPathRespectAbsolute(cwd, input.filename());
+      if (!suspicious_dirs_.contains(file::Dirname(abs_filename))) {
+        continue;
+      }
+      SHA256HashValue hash_value;
+      if (SHA256HashValue::ConvertFromHexString(input.hash_key(),
+                                                &hash_value) &&
+          !confirmed_.contains(hash_value)) {
+        confirmed.push_back(hash_value);
+      }
+    }
+  }
+  AUTO_EXCLUSIVE_LOCK(lock, &mu_);
+  confirmed_.insert(confirmed.begin(), confirmed.end());
+  PruneUnlocked(now);
+}
+
+void MissingInputPredictor::PruneUnlocked(absl::Time now) {
+  for (auto it = suspicious_dirs_.begin(); it != suspicious_dirs_.end();) {
+    if (now - it->second > window_) {
+      suspicious_dirs_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  if (suspicious_dirs_.empty()) {
+    confirmed_.clear();
+  }
+}
+
+void MissingInputPredictor::DumpStatsToProto(MissingInputStats* stats) const {
+  stats->set_requests(num_requests());
+  stats->set_missing_input_responses(num_missing_input_responses());
+  stats->set_missing_input_rpc_time_ms(missing_input_rpc_time_ms_.value());
+  stats->set_pushed_inputs(num_pushed_inputs());
+  stats->set_saved_round_trips(num_saved_round_trips());
+  stats->set_saved_rpc_time_ms(saved_rpc_time_ms_.value());
+}
+
+}  // namespace devtools_goma
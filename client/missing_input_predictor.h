@@ -0,0 +1,97 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DEVTOOLS_GOMA_CLIENT_MISSING_INPUT_PREDICTOR_H_
+#define DEVTOOLS_GOMA_CLIENT_MISSING_INPUT_PREDICTOR_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "atomic_stats_counter.h"
+#include "compiler_specific.h"
+#include "lib/goma_hash.h"
+#include "lockhelper.h"
+
+MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
+#include "lib/goma_data.pb.h"
+#include "lib/goma_stats.pb.h"
+MSVC_POP_WARNING()
+
+namespace devtools_goma {
+
+// MissingInputPredictor predicts inputs the server would report as
+// missing_input, so that their contents are sent in the first ExecReq
+// instead of costing another round trip.
+//
+// Missing inputs tend to come together from the same directory, e.g. files
+// of a newly synced or generated directory that the server has never seen.
+// After the server reported a missing input in a directory, other inputs in
+// the directory are predicted missing for a while, unless their hash keys
+// were confirmed in the server in this session, i.e. sent in an ExecReq
+// answered without missing inputs.
+// This class is thread-safe.
+class MissingInputPredictor {
+ public:
+  // A directory is suspicious for |window| since its last missing input.
+  explicit MissingInputPredictor(absl::Duration window);
+
+  MissingInputPredictor(const MissingInputPredictor&) = delete;
+  MissingInputPredictor& operator=(const MissingInputPredictor&) = delete;
+
+  // Returns true if the content of |abs_filename| with |hash_key| should be
+  // sent even though the server is expected to have it.
+  bool ShouldPush(absl::string_view abs_filename,
+                  const std::string& hash_key);
+
+  // Records the result of the ExecReq |req| sent from |cwd|.
+  // |pushed| is true if |req| has contents pushed by ShouldPush().
+  // |rpc_time| is the time of the call.
+  void RecordResponse(absl::string_view cwd,
+                      const ExecReq& req,
+                      const ExecResp& resp,
+                      bool pushed,
+                      absl::Duration rpc_time);
+
+  void DumpStatsToProto(MissingInputStats* stats) const;
+
+  // Stats.
+  int64_t num_requests() const { return num_requests_.value(); }
+  int64_t num_missing_input_responses() const {
+    return num_missing_input_responses_.value();
+  }
+  int64_t num_pushed_inputs() const { return num_pushed_inputs_.value(); }
+  int64_t num_saved_round_trips() const {
+    return num_saved_round_trips_.value();
+  }
+
+ private:
+  // Forgets directories not suspicious any more.
+  void PruneUnlocked(absl::Time now) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const absl::Duration window_;
+
+  mutable ReadWriteLock mu_;
+  // Directory -> time of its last missing input.
+  absl::flat_hash_map<std::string, absl::Time> suspicious_dirs_
+      ABSL_GUARDED_BY(mu_);
+  // Hash keys of inputs in suspicious directories confirmed in the server.
+  absl::flat_hash_set<SHA256HashValue> confirmed_ ABSL_GUARDED_BY(mu_);
+
+  StatsCounter num_requests_;
+  StatsCounter num_missing_input_responses_;
+  StatsCounter missing_input_rpc_time_ms_;
+  StatsCounter num_pushed_inputs_;
+  StatsCounter num_saved_round_trips_;
+  StatsCounter saved_rpc_time_ms_;
+};
+
+}  // namespace devtools_goma
+
+#endif  // DEVTOOLS_GOMA_CLIENT_MISSING_INPUT_PREDICTOR_H_
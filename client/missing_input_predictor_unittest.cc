@@ -0,0 +1,115 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "missing_input_predictor.h"
+
+#include <string>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+
+namespace devtools_goma {
+
+namespace {
+
+std::string HashKey(char c) {
+  return std::string(64, c);
+}
+
+void AddInput(const std::string& filename, const std::string& hash_key,
+              ExecReq* req) {
+  ExecReq_Input* input = req->add_input();
+  input->set_filename(filename);
+  input->set_hash_key(hash_key);
+}
+
+}  // namespace
+
+TEST(MissingInputPredictorTest, PushInSuspiciousDir) {
+  MissingInputPredictor predictor(absl::Hours(1));
+  EXPECT_FALSE(predictor.ShouldPush("/src/gen/a.h", HashKey('a')));
+
+  ExecReq req;
+  AddInput("gen/a.h", HashKey('a'), &req);
+  AddInput("/usr/include/stdio.h", HashKey('b'), &req);
+  ExecResp resp;
+  resp.add_missing_input("gen/a.h");
+  predictor.RecordResponse("/src", req, resp, false, absl::Milliseconds(10));
+  EXPECT_EQ(1, predictor.num_missing_input_responses());
+
+  // Other files in /src/gen are likely missing too.
+  EXPECT_TRUE(predictor.ShouldPush("/src/gen/a.h", HashKey('a')));
+  EXPECT_TRUE(predictor.ShouldPush("/src/gen/c.h", HashKey('c')));
+  EXPECT_FALSE(predictor.ShouldPush("/src/gen/sub/d.h", HashKey('d')));
+  EXPECT_FALSE(predictor.ShouldPush("/usr/include/stdio.h", HashKey('b')));
+  EXPECT_EQ(2, predictor.num_pushed_inputs());
+
+  // Invalid hash key is never pushed.
+  EXPECT_FALSE(predictor.ShouldPush("/src/gen/e.h", "e"));
+}
+
+TEST(MissingInputPredictorTest, ConfirmedNotPushed) {
+  MissingInputPredictor predictor(absl::Hours(1));
+  ExecReq req;
+  AddInput("gen/a.h", HashKey('a'), &req);
+  ExecResp resp;
+  resp.add_missing_input("gen/a.h");
+  predictor.RecordResponse("/src", req, resp, false, absl::Milliseconds(10));
+
+  // Retry with the content and the other file pushed.
+  ExecReq retry_req;
+  AddInput("gen/a.h", HashKey('a'), &retry_req);
+  AddInput("gen/c.h", HashKey('c'), &retry_req);
+  predictor.RecordResponse("/src", retry_req, ExecResp(), true,
+                           absl::Milliseconds(20));
+  EXPECT_EQ(1, predictor.num_saved_round_trips());
+
+  EXPECT_FALSE(predictor.ShouldPush("/src/gen/a.h", HashKey('a')));
+  EXPECT_FALSE(predictor.ShouldPush("/src/gen/c.h", HashKey('c')));
+  // Modified file.
+  EXPECT_TRUE(predictor.ShouldPush("/src/gen/c.h", HashKey('d')));
+
+  // The server lost it.
+  ExecResp lost_resp;
+  lost_resp.add_missing_input("gen/c.h");
+  predictor.RecordResponse("/src", retry_req, lost_resp, false,
+                           absl::Milliseconds(10));
+  EXPECT_FALSE(predictor.ShouldPush("/src/gen/a.h", HashKey('a')));
+  EXPECT_TRUE(predictor.ShouldPush("/src/gen/c.h", HashKey('c')));
+}
+
+TEST(MissingInputPredictorTest, Expire) {
+  MissingInputPredictor predictor(absl::ZeroDuration());
+  ExecReq req;
+  AddInput("gen/a.h", HashKey('a'), &req);
+  ExecResp resp;
+  resp.add_missing_input("gen/a.h");
+  predictor.RecordResponse("/src", req, resp, false, absl::Milliseconds(10));
+  absl::SleepFor(absl::Milliseconds(1));
+  EXPECT_FALSE(predictor.ShouldPush("/src/gen/c.h", HashKey('c')));
+}
+
+TEST(MissingInputPredictorTest, DumpStatsToProto) {
+  MissingInputPredictor predictor(absl::Hours(1));
+  ExecReq req;
+  AddInput("gen/a.h", HashKey('a'), &req);
+  ExecResp resp;
+  resp.add_missing_input("gen/a.h");
+  predictor.RecordResponse("/src", req, resp, false, absl::Milliseconds(10));
+  EXPECT_TRUE(predictor.ShouldPush("/src/gen/c.h", HashKey('c')));
+  predictor.RecordResponse("/src", req, ExecResp(), true,
+                           absl::Milliseconds(30));
+
+  MissingInputStats stats;
+  predictor.DumpStatsToProto(&stats);
+  EXPECT_EQ(2, stats.requests());
+  EXPECT_EQ(1, stats.missing_input_responses());
+  EXPECT_EQ(10, stats.missing_input_rpc_time_ms());
+  EXPECT_EQ(1, stats.pushed_inputs());
+  EXPECT_EQ(1, stats.saved_round_trips());
+  EXPECT_EQ(30, stats.saved_rpc_time_ms());
+}
+
+}  // namespace devtools_goma
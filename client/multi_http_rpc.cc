@@ -212,6 +212,8 @@ class MultiHttpRPC::MultiJob {
         stat->wait_time = http_rpc_stat_.wait_time;
         stat->resp_recv_time = http_rpc_stat_.resp_recv_time;
         stat->resp_parse_time = http_rpc_stat_.resp_parse_time;
+        stat->req_build_cpu_time = http_rpc_stat_.req_build_cpu_time;
+        stat->resp_parse_cpu_time = http_rpc_stat_.resp_parse_cpu_time;
         stat->num_retry = http_rpc_stat_.num_retry;
       }
       multi_rpc_->Done(this, i, stat, job->mutable_resp());
@@ -0,0 +1,481 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "range_downloader.h"
+
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/clock.h"
+#include "callback.h"
+#include "file_helper.h"
+#include "glog/logging.h"
+#include "http_util.h"
+#include "scoped_fd.h"
+#include "worker_thread_manager.h"
+
+namespace devtools_goma {
+
+namespace {
+
+constexpr absl::string_view kLastModified = "Last-Modified";
+constexpr size_t kHashBufSize = 64 * 1024;
+
+bool TruncateFile(const std::string& filename, int64_t size) {
+#ifndef _WIN32
+  return truncate(filename.c_str(), size) == 0;
+#else
+  ScopedFd fd(ScopedFd::OpenForRewrite(filename));
+  if (!fd.valid() || fd.Seek(size, ScopedFd::SeekAbsolute) != size) {
+    return false;
+  }
+  return SetEndOfFile(fd.handle()) != 0;
+#endif
+}
+
+bool RenameFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+  // rename fails if |to| exists on Windows.
+  remove(to.c_str());
+#endif
+  return rename(from.c_str(), to.c_str()) == 0;
+}
+
+}  // namespace
+
+int RangeDownloadState::NumRanges() const {
+  if (size <= 0 || range_size <= 0) {
+    return 0;
+  }
+  return static_cast<int>((size + range_size - 1) / range_size);
+}
+
+bool RangeDownloadState::CanResumeFrom(const RangeDownloadState& other) const {
+  return size >= 0 && range_size > 0 && !validator.empty() &&
+         size == other.size && range_size == other.range_size &&
+         validator == other.validator;
+}
+
+std::string RangeDownloadState::ToString() const {
+  std::string s = absl::StrCat("size ", size, "\n",
+                               "range_size ", range_size, "\n",
+                               "validator ", validator, "\n");
+  for (size_t i = 0; i < done.size(); ++i) {
+    if (done[i]) {
+      absl::StrAppend(&s, "done ", i, "\n");
+    }
+  }
+  return s;
+}
+
+// static
+bool RangeDownloadState::Parse(absl::string_view content,
+                               RangeDownloadState* state) {
+  *state = RangeDownloadState();
+  for (absl::string_view line :
+       absl::StrSplit(content, '\n', absl::SkipEmpty())) {
+    std::pair<absl::string_view, absl::string_view> kv =
+        absl::StrSplit(line, absl::MaxSplits(' ', 1));
+    if (kv.first == "size") {
+      if (!absl::SimpleAtoi(kv.second, &state->size) || state->size < 0) {
+        return false;
+      }
+    } else if (kv.first == "range_size") {
+      if (!absl::SimpleAtoi(kv.second, &state->range_size) ||
+          state->range_size <= 0) {
+        return false;
+      }
+    } else if (kv.first == "validator") {
+      state->validator = std::string(kv.second);
+    } else if (kv.first == "done") {
+      int index = 0;
+      if (!absl::SimpleAtoi(kv.second, &index) || index < 0 ||
+          index >= state->NumRanges()) {
+        return false;
+      }
+      state->done.resize(state->NumRanges());
+      state->done[index] = true;
+    } else {
+      return false;
+    }
+  }
+  if (state->size < 0 || state->range_size <= 0) {
+    return false;
+  }
+  state->done.resize(state->NumRanges());
+  return true;
+}
+
+RangeDownloader::RangeDownloader(HttpClient* client, WorkerThreadManager* wm,
+                                 Options options)
+    : client_(client), wm_(wm), options_(std::move(options)) {
+  CHECK_GT(options_.num_connections, 0);
+  CHECK_GT(options_.range_size, 0);
+  CHECK_GT(options_.max_tries, 0);
+}
+
+RangeDownloader::~RangeDownloader() = default;
+
+bool RangeDownloader::Run() {
+  bool whole = false;
+  if (!Start(&whole)) {
+    return false;
+  }
+  if (whole) {
+    return Finish();
+  }
+
+  int num_workers = 0;
+  {
+    AUTOLOCK(lock, &mu_);
+    num_workers = std::min<int>(options_.num_connections, pending_.size());
+  }
+  LOG(INFO) << "download " << options_.filename << " size=" << size_
+            << " ranges=" << NumRanges() << " workers=" << num_workers;
+  std::vector<std::unique_ptr<WorkerThreadRunner>> workers;
+  for (int i = 0; i < num_workers; ++i) {
+    workers.push_back(absl::make_unique<WorkerThreadRunner>(
+        wm_, FROM_HERE,
+        NewCallback(this, &RangeDownloader::RunWorker)));
+  }
+  // Hash ranges written by the previous run while downloading.
+  HashWrittenRanges();
+  for (auto& worker : workers) {
+    worker->Wait();
+  }
+  {
+    AUTOLOCK(lock, &mu_);
+    if (failed_) {
+      return false;
+    }
+  }
+  return Finish();
+}
+
+bool RangeDownloader::Fetch(int64_t offset, int64_t size,
+                            HttpClient::Status* status,
+                            std::string* header) {
+  absl::Duration backoff = client_->options().min_retry_backoff;
+  for (int i = 0; i < options_.max_tries; ++i) {
+    HttpRequest req;
+    client_->InitHttpRequest(&req, "GET", options_.path);
+    HttpFileDownloadResponse resp(part_filename(), options_.mode);
+    if (size >= 0) {
+      req.AddHeader(std::string(kRange),
+                    absl::StrCat("bytes=", offset, "-", offset + size - 1));
+      resp.SetWriteOffset(offset);
+    }
+    *status = HttpClient::Status();
+    client_->Do(&req, &resp, status);
+    if (header != nullptr) {
+      *header = std::string(resp.Header());
+    }
+    if (!status->err && status->http_return_code == 206) {
+      // Servers may send a shorter range than requested.
+      int64_t first = 0;
+      int64_t last = 0;
+      int64_t total = 0;
+      if (ParseContentRange(ExtractHeaderField(resp.Header(), kContentRange),
+                            &first, &last, &total) &&
+          total >= 0 && last + 1 != std::min(offset + size, total)) {
+        status->err = FAIL;
+        status->err_message = absl::StrCat(
+            "unexpected range for bytes=", offset, "-", offset + size - 1,
+            ": ", ExtractHeaderField(resp.Header(), kContentRange));
+        return false;
+      }
+    }
+    if (!status->err) {
+      return true;
+    }
+    if (status->http_return_code >= 400 && status->http_return_code < 500) {
+      LOG(WARNING) << "http code:" << status->http_return_code;
+      return false;
+    }
+    if (offset > 0 && status->http_return_code == 200) {
+      // The server ignored Range. Retrying won't help.
+      return false;
+    }
+    if (i + 1 < options_.max_tries) {
+      LOG(WARNING) << "fetch fail offset=" << offset << " try=" << i
+                   << " err=" << status->err
+                   << " http code:" << status->http_return_code
+                   << " " << status->err_message;
+      backoff = HttpClient::GetNextBackoff(client_->options(), backoff, true);
+      absl::SleepFor(backoff);
+    }
+  }
+  return false;
+}
+
+bool RangeDownloader::Start(bool* whole) {
+  *whole = false;
+  {
+    // Make sure the partial file exists, without truncating ranges
+    // written by the previous run.
+    ScopedFd fd(ScopedFd::OpenForAppend(part_filename(), options_.mode));
+  }
+
+  std::string header;
+  HttpClient::Status status;
+  const bool ok = Fetch(0, options_.range_size, &status, &header);
+  status_ = status;
+  if (!ok) {
+    if (status.http_return_code == 416 &&
+        ExtractHeaderField(header, kContentRange) == "bytes */0") {
+      // No range is satisfiable for empty content.
+      *whole = true;
+      SetWholeContent(0);
+      return true;
+    }
+    error_message_ = absl::StrCat("failed to fetch the first range: ",
+                                  status.err_message);
+    return false;
+  }
+  if (status.http_return_code != 206) {
+    // The server doesn't support Range, and sent the whole content.
+    LOG(INFO) << "Range is not supported. http code:"
+              << status.http_return_code;
+    *whole = true;
+    return FetchWhole();
+  }
+
+  int64_t first = 0;
+  int64_t last = 0;
+  int64_t total = 0;
+  if (!ParseContentRange(ExtractHeaderField(header, kContentRange),
+                         &first, &last, &total) ||
+      total < 0) {
+    LOG(WARNING) << "unknown content size: "
+                 << ExtractHeaderField(header, kContentRange);
+    *whole = true;
+    return FetchWhole();
+  }
+
+  size_ = total;
+  range_size_ = options_.range_size;
+  AUTOLOCK(lock, &mu_);
+  state_.size = size_;
+  state_.range_size = range_size_;
+  state_.validator = std::string(ExtractHeaderField(header, kETag));
+  if (state_.validator.empty()) {
+    state_.validator = std::string(ExtractHeaderField(header, kLastModified));
+  }
+  LoadState();
+  for (int i = 1; i < NumRanges(); ++i) {
+    if (!state_.done[i]) {
+      pending_.push_back(i);
+    }
+  }
+  return true;
+}
+
+bool RangeDownloader::FetchWhole() {
+  HttpClient::Status status;
+  if (status_.http_return_code != 200) {
+    if (!Fetch(0, -1, &status, nullptr)) {
+      status_ = status;
+      error_message_ = absl::StrCat("failed to fetch: ", status.err_message);
+      return false;
+    }
+    status_ = status;
+  }
+  ScopedFd fd(ScopedFd::OpenForRead(part_filename()));
+  size_t size = 0;
+  if (!fd.valid() || !fd.GetFileSize(&size)) {
+    error_message_ = absl::StrCat("failed to get size of ", part_filename());
+    return false;
+  }
+  SetWholeContent(size);
+  return true;
+}
+
+void RangeDownloader::SetWholeContent(int64_t size) {
+  // Handle the whole content as one range.
+  size_ = size;
+  range_size_ = std::max<int64_t>(size_, 1);
+  AUTOLOCK(lock, &mu_);
+  state_.size = size_;
+  state_.range_size = range_size_;
+  state_.done.assign(NumRanges(), true);
+}
+
+void RangeDownloader::LoadState() {
+  std::string content;
+  RangeDownloadState prev;
+  if (ReadFileToString(state_filename(), &content) &&
+      RangeDownloadState::Parse(content, &prev) &&
+      state_.CanResumeFrom(prev)) {
+    state_.done = std::move(prev.done);
+    LOG(INFO) << "resume " << options_.filename << " with "
+              << std::count(state_.done.begin(), state_.done.end(), true)
+              << " ranges";
+  } else {
+    state_.done.assign(NumRanges(), false);
+  }
+  // The first range has been written by Start().
+  if (!state_.done.empty()) {
+    state_.done[0] = true;
+  }
+  if (!WriteStringToFile(state_.ToString(), state_filename())) {
+    LOG(WARNING) << "failed to write " << state_filename()
+                 << ". download won't be resumed.";
+  }
+}
+
+void RangeDownloader::RunWorker() {
+  for (;;) {
+    int index = 0;
+    {
+      AUTOLOCK(lock, &mu_);
+      if (failed_ || pending_.empty()) {
+        return;
+      }
+      index = pending_.front();
+      pending_.pop_front();
+    }
+    HttpClient::Status status;
+    if (!Fetch(RangeOffset(index), RangeSize(index), &status, nullptr)) {
+      AUTOLOCK(lock, &mu_);
+      if (!failed_) {
+        failed_ = true;
+        status_ = status;
+        error_message_ = absl::StrCat("failed to fetch range ", index, ": ",
+                                      status.err_message);
+      }
+      return;
+    }
+    MarkDone(index);
+    HashWrittenRanges();
+  }
+}
+
+void RangeDownloader::MarkDone(int index) {
+  AUTOLOCK(lock, &mu_);
+  state_.done[index] = true;
+  if (!WriteStringToFile(state_.ToString(), state_filename())) {
+    LOG(WARNING) << "failed to write " << state_filename();
+  }
+}
+
+void RangeDownloader::HashWrittenRanges() {
+  {
+    AUTOLOCK(lock, &mu_);
+    if (hashing_) {
+      // The hashing thread will hash newly written ranges too.
+      return;
+    }
+    hashing_ = true;
+  }
+  ScopedFd fd;
+  std::unique_ptr<char[]> buf;
+  bool ok = true;
+  for (;;) {
+    int index = 0;
+    {
+      AUTOLOCK(lock, &mu_);
+      if (!ok) {
+        hash_error_ = true;
+      }
+      if (hash_error_ || num_hashed_ranges_ >= NumRanges() ||
+          !state_.done[num_hashed_ranges_]) {
+        hashing_ = false;
+        return;
+      }
+      index = num_hashed_ranges_++;
+    }
+    if (!fd.valid()) {
+      fd.reset(ScopedFd::OpenForRead(part_filename()));
+      buf.reset(new char[kHashBufSize]);
+    }
+    const int64_t offset = RangeOffset(index);
+    if (!fd.valid() || fd.Seek(offset, ScopedFd::SeekAbsolute) != offset) {
+      LOG(ERROR) << "failed to seek " << part_filename() << " to " << offset;
+      ok = false;
+      continue;
+    }
+    int64_t remaining = RangeSize(index);
+    while (remaining > 0) {
+      const ssize_t n = fd.Read(
+          buf.get(), std::min<int64_t>(remaining, kHashBufSize));
+      if (n <= 0) {
+        LOG(ERROR) << "failed to read " << part_filename() << " at "
+                   << offset + RangeSize(index) - remaining;
+        ok = false;
+        break;
+      }
+      hasher_.Update(absl::string_view(buf.get(), n));
+      remaining -= n;
+    }
+  }
+}
+
+bool RangeDownloader::Finish() {
+  HashWrittenRanges();
+  {
+    AUTOLOCK(lock, &mu_);
+    if (hash_error_ || num_hashed_ranges_ != NumRanges()) {
+      error_message_ = absl::StrCat("failed to hash ", part_filename());
+      // The partial file doesn't have the ranges the state says done
+      // (e.g. removed or truncated). Don't resume from it.
+      remove(state_filename().c_str());
+      remove(part_filename().c_str());
+      return false;
+    }
+  }
+  SHA256HashValue hash_value;
+  hasher_.Finish(&hash_value);
+  sha256_ = hash_value.ToHexString();
+  if (!options_.sha256.empty() &&
+      !absl::EqualsIgnoreCase(options_.sha256, sha256_)) {
+    error_message_ = absl::StrCat("sha256 mismatch: want=", options_.sha256,
+                                  " got=", sha256_);
+    // Don't resume from the broken content.
+    remove(state_filename().c_str());
+    remove(part_filename().c_str());
+    return false;
+  }
+  // The partial file may be longer than the content if it was written
+  // for another content before.
+  if (!TruncateFile(part_filename(), size_)) {
+    error_message_ = absl::StrCat("failed to truncate ", part_filename());
+    return false;
+  }
+  if (!RenameFile(part_filename(), options_.filename)) {
+    error_message_ = absl::StrCat("failed to rename ", part_filename(),
+                                  " to ", options_.filename);
+    return false;
+  }
+  remove(state_filename().c_str());
+  return true;
+}
+
+int RangeDownloader::NumRanges() const {
+  if (size_ <= 0) {
+    return 0;
+  }
+  return static_cast<int>((size_ + range_size_ - 1) / range_size_);
+}
+
+int64_t RangeDownloader::RangeOffset(int index) const {
+  return index * range_size_;
+}
+
+int64_t RangeDownloader::RangeSize(int index) const {
+  return std::min(range_size_, size_ - RangeOffset(index));
+}
+
+}  // namespace devtools_goma
@@ -0,0 +1,160 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DEVTOOLS_GOMA_CLIENT_RANGE_DOWNLOADER_H_
+#define DEVTOOLS_GOMA_CLIENT_RANGE_DOWNLOADER_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "basictypes.h"
+#include "http.h"
+#include "lib/goma_hash.h"
+#include "lockhelper.h"
+
+namespace devtools_goma {
+
+class WorkerThreadManager;
+
+// RangeDownloadState is the state of RangeDownloader to resume a download.
+// It is stored in a text file next to the partial file:
+//
+//   size <content size>
+//   range_size <range size>
+//   validator <ETag or Last-Modified of the content>
+//   done <range index>
+//   done <range index>
+//   ...
+//
+// The state file is rewritten when a range is written to the partial file.
+struct RangeDownloadState {
+  int64_t size = -1;
+  int64_t range_size = 0;
+  std::string validator;
+  std::vector<bool> done;
+
+  int NumRanges() const;
+
+  // Returns true if ranges in |other| can be reused for this, i.e.
+  // it is for the same content with the same ranges.
+  bool CanResumeFrom(const RangeDownloadState& other) const;
+
+  // Returns the state file content.
+  std::string ToString() const;
+
+  // Parses a state file |content|. Returns false if it is broken.
+  static bool Parse(absl::string_view content, RangeDownloadState* state);
+};
+
+// RangeDownloader downloads content to a file with parallel HTTP Range
+// requests over HttpClient.
+//
+// It writes to |filename|.part as data is received, and records written
+// ranges in |filename|.part.state, so that the next run resumes from them
+// if the server reports the same content. SHA-256 is computed over the
+// written prefix of the file while later ranges are being downloaded.
+// When all ranges are written and SHA-256 matches, the partial file is
+// renamed to |filename|.
+//
+// If the server doesn't support Range, it downloads the content with
+// a single request.
+class RangeDownloader {
+ public:
+  struct Options {
+    // Request path, relative to the URL of HttpClient options.
+    std::string path;
+    std::string filename;
+    int mode = 0644;
+    // Number of ranges downloaded at the same time.
+    int num_connections = 4;
+    int64_t range_size = 8 * 1024 * 1024;
+    // Number of tries for each request.
+    int max_tries = 5;
+    // Expected SHA-256 in hex. Not verified if empty.
+    std::string sha256;
+  };
+
+  // |client| and |wm| must outlive this.
+  RangeDownloader(HttpClient* client, WorkerThreadManager* wm,
+                  Options options);
+  ~RangeDownloader();
+
+  // Downloads the content. It must be called on a worker thread of |wm|,
+  // and blocks until the download finishes.
+  // Returns true on success.
+  bool Run();
+
+  // Status of the failed request, or the first request on success.
+  const HttpClient::Status& status() const { return status_; }
+  const std::string& error_message() const { return error_message_; }
+  // SHA-256 of the downloaded content in hex.
+  const std::string& sha256() const { return sha256_; }
+
+  std::string part_filename() const { return options_.filename + ".part"; }
+  std::string state_filename() const {
+    return options_.filename + ".part.state";
+  }
+
+ private:
+  // Fetches [offset, offset + size) into the partial file.
+  // If |size| is negative, fetches the whole content without Range.
+  // |header| is set to the response header if it is not nullptr.
+  bool Fetch(int64_t offset, int64_t size, HttpClient::Status* status,
+             std::string* header);
+
+  // Fetches the first range, and prepares ranges to download.
+  // Returns false on error. Sets |*whole| if the server responded with
+  // the whole content.
+  bool Start(bool* whole);
+  bool FetchWhole();
+  // Sets up a single range of |size| written in the partial file.
+  void SetWholeContent(int64_t size);
+  void LoadState() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  void RunWorker();
+  void MarkDone(int index);
+  // Hashes ranges written after the hashed prefix of the partial file.
+  void HashWrittenRanges();
+  bool Finish();
+
+  int NumRanges() const;
+  int64_t RangeOffset(int index) const;
+  int64_t RangeSize(int index) const;
+
+  HttpClient* client_;
+  WorkerThreadManager* wm_;
+  const Options options_;
+
+  // Content size and range size, fixed by Start().
+  int64_t size_ = -1;
+  int64_t range_size_ = 0;
+
+  mutable Lock mu_;
+  RangeDownloadState state_ ABSL_GUARDED_BY(mu_);
+  std::deque<int> pending_ ABSL_GUARDED_BY(mu_);
+  bool failed_ ABSL_GUARDED_BY(mu_) = false;
+  // Ranges are hashed in order by one thread at a time. |hasher_| is only
+  // used by the thread that set |hashing_|.
+  bool hashing_ ABSL_GUARDED_BY(mu_) = false;
+  int num_hashed_ranges_ ABSL_GUARDED_BY(mu_) = 0;
+  bool hash_error_ ABSL_GUARDED_BY(mu_) = false;
+  SHA256Hasher hasher_;
+
+  // Set on failure while workers are running under |mu_|, or by the thread
+  // calling Run() otherwise.
+  HttpClient::Status status_;
+  std::string error_message_;
+  std::string sha256_;
+
+  DISALLOW_COPY_AND_ASSIGN(RangeDownloader);
+};
+
+}  // namespace devtools_goma
+
+#endif  // DEVTOOLS_GOMA_CLIENT_RANGE_DOWNLOADER_H_
@@ -0,0 +1,419 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "range_downloader.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/match.h"
+#include "absl/strings/strip.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "callback.h"
+#include "file_helper.h"
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+#include "http_util.h"
+#include "lib/goma_hash.h"
+#include "path.h"
+#include "scoped_fd.h"
+#include "scoped_tmp_file.h"
+#include "worker_thread_manager.h"
+
+namespace devtools_goma {
+
+namespace {
+
+// RangeServer is an HTTP server on localhost that serves |content|
+// with or without Range support.
+class RangeServer {
+ public:
+  RangeServer(std::string content, bool support_range)
+      : content_(std::move(content)), support_range_(support_range) {
+    listen_fd_.reset(socket(AF_INET, SOCK_STREAM, 0));
+    CHECK(listen_fd_.valid());
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    CHECK_EQ(0, bind(listen_fd_.get(), reinterpret_cast<sockaddr*>(&addr),
+                     sizeof(addr)));
+    CHECK_EQ(0, listen(listen_fd_.get(), 16));
+    socklen_t len = sizeof(addr);
+    CHECK_EQ(0, getsockname(listen_fd_.get(),
+                            reinterpret_cast<sockaddr*>(&addr), &len));
+    port_ = ntohs(addr.sin_port);
+    accept_thread_ = std::thread(&RangeServer::AcceptLoop, this);
+  }
+
+  ~RangeServer() {
+    shutdown(listen_fd_.get(), SHUT_RDWR);
+    accept_thread_.join();
+    for (auto& t : conn_threads_) {
+      t.join();
+    }
+  }
+
+  int port() const { return port_; }
+
+  // Requested Range header values. Empty for requests without Range.
+  std::vector<std::string> ranges() const {
+    AUTOLOCK(lock, &mu_);
+    return ranges_;
+  }
+
+ private:
+  void AcceptLoop() {
+    for (;;) {
+      int fd = accept(listen_fd_.get(), nullptr, nullptr);
+      if (fd < 0) {
+        return;
+      }
+      conn_threads_.emplace_back(&RangeServer::Serve, this, fd);
+    }
+  }
+
+  void Serve(int fd) {
+    ScopedSocket sock(fd);
+    std::string buf;
+    char tmp[4096];
+    for (;;) {
+      size_t end;
+      while ((end = buf.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t n = sock.Read(tmp, sizeof(tmp));
+        if (n <= 0) {
+          return;
+        }
+        buf.append(tmp, n);
+      }
+      const std::string header = buf.substr(0, end + 4);
+      buf.erase(0, end + 4);
+      const std::string range(ExtractHeaderField(header, kRange));
+      {
+        AUTOLOCK(lock, &mu_);
+        ranges_.push_back(range);
+      }
+      if (sock.WriteString(Response(range), absl::Seconds(10)) != OK) {
+        return;
+      }
+    }
+  }
+
+  std::string Response(absl::string_view range) const {
+    int64_t first = 0;
+    int64_t last = 0;
+    if (support_range_ && absl::ConsumePrefix(&range, "bytes=")) {
+      const size_t dash = range.find('-');
+      CHECK(absl::SimpleAtoi(range.substr(0, dash), &first));
+      CHECK(absl::SimpleAtoi(range.substr(dash + 1), &last));
+      const int64_t size = content_.size();
+      if (first >= size) {
+        return absl::StrCat("HTTP/1.1 416 Range Not Satisfiable\r\n",
+                            "Content-Range: bytes */", size, "\r\n",
+                            "Content-Length: 0\r\n\r\n");
+      }
+      last = std::min(last, size - 1);
+      return absl::StrCat("HTTP/1.1 206 Partial Content\r\n",
+                          "ETag: \"v1\"\r\n",
+                          "Content-Range: bytes ", first, "-", last, "/",
+                          size, "\r\n",
+                          "Content-Length: ", last - first + 1, "\r\n\r\n",
+                          content_.substr(first, last - first + 1));
+    }
+    return absl::StrCat("HTTP/1.1 200 OK\r\n",
+                        "Content-Length: ", content_.size(), "\r\n\r\n",
+                        content_);
+  }
+
+  const std::string content_;
+  const bool support_range_;
+  ScopedSocket listen_fd_;
+  int port_ = 0;
+  std::thread accept_thread_;
+  std::vector<std::thread> conn_threads_;
+
+  mutable Lock mu_;
+  std::vector<std::string> ranges_ ABSL_GUARDED_BY(mu_);
+};
+
+std::string TestContent(size_t size) {
+  std::string content(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    content[i] = static_cast<char>((i * 7 + i / 251) & 0xff);
+  }
+  return content;
+}
+
+}  // namespace
+
+TEST(RangeDownloadStateTest, ParseAndToString) {
+  RangeDownloadState state;
+  state.size = 2500;
+  state.range_size = 1000;
+  state.validator = "W/\"a b\"";
+  state.done = {true, false, true};
+  EXPECT_EQ(3, state.NumRanges());
+  const std::string content = state.ToString();
+  EXPECT_EQ(
+      "size 2500\n"
+      "range_size 1000\n"
+      "validator W/\"a b\"\n"
+      "done 0\n"
+      "done 2\n",
+      content);
+
+  RangeDownloadState parsed;
+  ASSERT_TRUE(RangeDownloadState::Parse(content, &parsed));
+  EXPECT_EQ(state.size, parsed.size);
+  EXPECT_EQ(state.range_size, parsed.range_size);
+  EXPECT_EQ(state.validator, parsed.validator);
+  EXPECT_EQ(state.done, parsed.done);
+  EXPECT_TRUE(state.CanResumeFrom(parsed));
+}
+
+TEST(RangeDownloadStateTest, ParseBroken) {
+  RangeDownloadState state;
+  EXPECT_FALSE(RangeDownloadState::Parse("", &state));
+  EXPECT_FALSE(RangeDownloadState::Parse("size 10\n", &state));
+  EXPECT_FALSE(RangeDownloadState::Parse("size 10\nrange_size x\n", &state));
+  EXPECT_FALSE(RangeDownloadState::Parse(
+      "size 10\nrange_size 5\ndone 2\n", &state));
+  EXPECT_FALSE(RangeDownloadState::Parse(
+      "size 10\nrange_size 5\nfoo bar\n", &state));
+}
+
+TEST(RangeDownloadStateTest, CanResumeFrom) {
+  RangeDownloadState state;
+  state.size = 10;
+  state.range_size = 5;
+  state.validator = "\"v1\"";
+
+  RangeDownloadState other = state;
+  EXPECT_TRUE(state.CanResumeFrom(other));
+  other.validator = "\"v2\"";
+  EXPECT_FALSE(state.CanResumeFrom(other));
+  other = state;
+  other.range_size = 4;
+  EXPECT_FALSE(state.CanResumeFrom(other));
+  other = state;
+  other.size = 11;
+  EXPECT_FALSE(state.CanResumeFrom(other));
+
+  // Content can't be identified without validator.
+  state.validator.clear();
+  other = state;
+  EXPECT_FALSE(state.CanResumeFrom(other));
+}
+
+class RangeDownloaderTest : public testing::Test {
+ protected:
+  static constexpr int kNumConnections = 3;
+
+  void SetUp() override {
+    tmpdir_ = absl::make_unique<ScopedTmpDir>("range_downloader_unittest");
+    ASSERT_TRUE(tmpdir_->valid());
+    filename_ = file::JoinPath(tmpdir_->dirname(), "out");
+    wm_ = absl::make_unique<WorkerThreadManager>();
+    wm_->Start(kNumConnections + 1);
+  }
+
+  void TearDown() override {
+    wm_->Finish();
+    wm_.reset();
+  }
+
+  RangeDownloader::Options NewOptions(int64_t range_size) const {
+    RangeDownloader::Options options;
+    options.filename = filename_;
+    options.num_connections = kNumConnections;
+    options.range_size = range_size;
+    options.max_tries = 1;
+    return options;
+  }
+
+  // Runs |options| against |server|. Returns true on success.
+  bool Download(const RangeServer& server,
+                const RangeDownloader::Options& options,
+                std::string* sha256) {
+    HttpClient::Options http_options;
+    CHECK(http_options.InitFromURL(
+        absl::StrCat("http://127.0.0.1:", server.port(), "/")));
+    HttpClient client(HttpClient::NewSocketFactoryFromOptions(http_options),
+                      nullptr, http_options, wm_.get());
+    RangeDownloader downloader(&client, wm_.get(), options);
+    bool ok = false;
+    WorkerThreadRunner runner(
+        wm_.get(), FROM_HERE,
+        NewCallback(this, &RangeDownloaderTest::RunDownloader, &downloader,
+                    &ok));
+    runner.Wait();
+    client.WaitNoActive();
+    if (!ok) {
+      LOG(INFO) << downloader.error_message();
+    }
+    *sha256 = downloader.sha256();
+    return ok;
+  }
+
+  void RunDownloader(RangeDownloader* downloader, bool* ok) {
+    *ok = downloader->Run();
+  }
+
+  bool FileExists(const std::string& filename) const {
+    return ScopedFd(ScopedFd::OpenForRead(filename)).valid();
+  }
+
+  std::unique_ptr<ScopedTmpDir> tmpdir_;
+  std::string filename_;
+  std::unique_ptr<WorkerThreadManager> wm_;
+};
+
+TEST_F(RangeDownloaderTest, Download) {
+  const std::string content = TestContent(10500);
+  std::string want_sha256;
+  ComputeDataHashKey(content, &want_sha256);
+  RangeServer server(content, true);
+
+  RangeDownloader::Options options = NewOptions(1000);
+  options.sha256 = want_sha256;
+  std::string sha256;
+  ASSERT_TRUE(Download(server, options, &sha256));
+  EXPECT_EQ(want_sha256, sha256);
+
+  std::string got;
+  ASSERT_TRUE(ReadFileToString(filename_, &got));
+  EXPECT_EQ(content, got);
+  EXPECT_FALSE(FileExists(filename_ + ".part"));
+  EXPECT_FALSE(FileExists(filename_ + ".part.state"));
+  EXPECT_EQ(11U, server.ranges().size());
+}
+
+TEST_F(RangeDownloaderTest, Resume) {
+  const std::string content = TestContent(10500);
+  std::string want_sha256;
+  ComputeDataHashKey(content, &want_sha256);
+  RangeServer server(content, true);
+
+  // The previous run wrote ranges 0, 1, 2 and 4. Range 3 has garbage.
+  // The partial file is longer than the content.
+  std::string part = content.substr(0, 5000) + std::string(6000, 'x');
+  part.replace(3000, 1000, 1000, 'y');
+  ASSERT_TRUE(WriteStringToFile(part, filename_ + ".part"));
+  ASSERT_TRUE(WriteStringToFile(
+      "size 10500\nrange_size 1000\nvalidator \"v1\"\n"
+      "done 0\ndone 1\ndone 2\ndone 4\n",
+      filename_ + ".part.state"));
+
+  RangeDownloader::Options options = NewOptions(1000);
+  options.sha256 = want_sha256;
+  std::string sha256;
+  ASSERT_TRUE(Download(server, options, &sha256));
+
+  std::string got;
+  ASSERT_TRUE(ReadFileToString(filename_, &got));
+  EXPECT_EQ(content, got);
+  const std::vector<std::string> ranges = server.ranges();
+  // The first range and ranges 3, 5, ..., 10.
+  EXPECT_EQ(8U, ranges.size());
+  for (const auto& range : ranges) {
+    EXPECT_NE("bytes=1000-1999", range);
+    EXPECT_NE("bytes=2000-2999", range);
+    EXPECT_NE("bytes=4000-4999", range);
+  }
+}
+
+TEST_F(RangeDownloaderTest, NotResumeTruncatedPart) {
+  const std::string content = TestContent(3000);
+  RangeServer server(content, true);
+
+  // The state says all ranges are done, but the partial file was truncated.
+  ASSERT_TRUE(WriteStringToFile(content.substr(0, 1500),
+                                filename_ + ".part"));
+  ASSERT_TRUE(WriteStringToFile(
+      "size 3000\nrange_size 1000\nvalidator \"v1\"\n"
+      "done 0\ndone 1\ndone 2\n",
+      filename_ + ".part.state"));
+
+  std::string sha256;
+  EXPECT_FALSE(Download(server, NewOptions(1000), &sha256));
+  EXPECT_FALSE(FileExists(filename_ + ".part"));
+  EXPECT_FALSE(FileExists(filename_ + ".part.state"));
+
+  // Next run downloads from scratch.
+  ASSERT_TRUE(Download(server, NewOptions(1000), &sha256));
+  std::string got;
+  ASSERT_TRUE(ReadFileToString(filename_, &got));
+  EXPECT_EQ(content, got);
+}
+
+TEST_F(RangeDownloaderTest, NotResumeDifferentContent) {
+  const std::string content = TestContent(3000);
+  RangeServer server(content, true);
+
+  ASSERT_TRUE(WriteStringToFile(std::string(3000, 'x'),
+                                filename_ + ".part"));
+  ASSERT_TRUE(WriteStringToFile(
+      "size 3000\nrange_size 1000\nvalidator \"v0\"\ndone 1\ndone 2\n",
+      filename_ + ".part.state"));
+
+  std::string sha256;
+  ASSERT_TRUE(Download(server, NewOptions(1000), &sha256));
+  std::string got;
+  ASSERT_TRUE(ReadFileToString(filename_, &got));
+  EXPECT_EQ(content, got);
+  EXPECT_EQ(3U, server.ranges().size());
+}
+
+TEST_F(RangeDownloaderTest, RangeNotSupported) {
+  const std::string content = TestContent(5000);
+  std::string want_sha256;
+  ComputeDataHashKey(content, &want_sha256);
+  RangeServer server(content, false);
+
+  std::string sha256;
+  ASSERT_TRUE(Download(server, NewOptions(1000), &sha256));
+  EXPECT_EQ(want_sha256, sha256);
+  std::string got;
+  ASSERT_TRUE(ReadFileToString(filename_, &got));
+  EXPECT_EQ(content, got);
+  EXPECT_EQ(1U, server.ranges().size());
+}
+
+TEST_F(RangeDownloaderTest, EmptyContent) {
+  RangeServer server("", true);
+
+  std::string sha256;
+  ASSERT_TRUE(Download(server, NewOptions(1000), &sha256));
+  std::string got = "x";
+  ASSERT_TRUE(ReadFileToString(filename_, &got));
+  EXPECT_EQ("", got);
+  std::string want_sha256;
+  ComputeDataHashKey("", &want_sha256);
+  EXPECT_EQ(want_sha256, sha256);
+}
+
+TEST_F(RangeDownloaderTest, Sha256Mismatch) {
+  const std::string content = TestContent(2500);
+  RangeServer server(content, true);
+
+  RangeDownloader::Options options = NewOptions(1000);
+  options.sha256 = std::string(64, '0');
+  std::string sha256;
+  EXPECT_FALSE(Download(server, options, &sha256));
+  EXPECT_FALSE(FileExists(filename_));
+  EXPECT_FALSE(FileExists(filename_ + ".part"));
+  EXPECT_FALSE(FileExists(filename_ + ".part.state"));
+}
+
+}  // namespace devtools_goma
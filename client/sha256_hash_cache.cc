@@ -4,11 +4,24 @@
 
 #include "sha256_hash_cache.h"
 
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
+
+#include <memory>
+
 #include "absl/base/call_once.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
 #include "client/autolock_timer.h"
 #include "glog/logging.h"
 #include "lib/goma_hash.h"
 
+#ifdef __linux__
+#include "client/binutils/elf_parser.h"
+#include "lib/path_util.h"
+#endif
+
 namespace devtools_goma {
 
 namespace {
@@ -26,12 +39,34 @@ bool SHA256HashCache::GetHashFromCacheOrFile(const std::string& path,
     return false;
   }
 
+  bool has_cache = false;
   {
     AUTO_SHARED_LOCK(lock, &mu_);
     const auto& it = cache_.find(path);
-    if (it != cache_.end() && !filestat.CanBeNewerThan(it->second.first)) {
-      *hash = it->second.second;
+    if (it != cache_.end()) {
+      if (!filestat.CanBeNewerThan(it->second.filestat)) {
+        *hash = it->second.hash;
+        hit_.Add(1);
+        return true;
+      }
+      has_cache = !it->second.identity.empty();
+    }
+  }
+
+  const std::string identity = GetBinaryIdentity(path);
+  if (has_cache && !identity.empty()) {
+    // filestat is updated (e.g. touched), but it is the same binary.
+    // Reuse the hash and refresh filestat so that following calls won't
+    // need to read the identity again.
+    AUTO_EXCLUSIVE_LOCK(lock, &mu_);
+    auto it = cache_.find(path);
+    if (it != cache_.end() && it->second.identity == identity) {
+      *hash = it->second.hash;
+      if (!filestat.CanBeStale()) {
+        it->second.filestat = filestat;
+      }
       hit_.Add(1);
+      identity_hit_.Add(1);
       return true;
     }
   }
@@ -45,10 +80,48 @@ bool SHA256HashCache::GetHashFromCacheOrFile(const std::string& path,
   }
 
   AUTO_EXCLUSIVE_LOCK(lock, &mu_);
-  cache_[path] = std::make_pair(filestat, *hash);
+  cache_[path] = ValueT{filestat, identity, *hash};
   return true;
 }
 
+// static
+std::string SHA256HashCache::GetBinaryIdentity(const std::string& path) {
+#ifdef __linux__
+  if (!IsPosixAbsolutePath(path)) {
+    return std::string();
+  }
+  // Check stat before parsing ELF so that non regular files are not opened.
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+    return std::string();
+  }
+  if (!ElfParser::IsElf(path)) {
+    return std::string();
+  }
+  std::unique_ptr<ElfParser> parser = ElfParser::NewElfParser(path);
+  if (parser == nullptr) {
+    return std::string();
+  }
+  std::string build_id;
+  if (!parser->ReadBuildId(&build_id) || build_id.empty()) {
+    VLOG(1) << "no build-id: " << path;
+    return std::string();
+  }
+  struct stat after_st;
+  if (stat(path.c_str(), &after_st) != 0 || after_st.st_ino != st.st_ino ||
+      after_st.st_size != st.st_size) {
+    // replaced while reading build-id.
+    return std::string();
+  }
+  return absl::StrCat(absl::BytesToHexString(build_id), ":", st.st_size, ":",
+                      st.st_dev, ":", st.st_ino);
+#else
+  // Binary identity is read only from ELF, so non-ELF platforms always
+  // hash the binary when its filestat is changed.
+  return std::string();
+#endif
+}
+
 // static
 SHA256HashCache* SHA256HashCache::instance() {
   absl::call_once(g_init_once, SHA256HashCache::Init);
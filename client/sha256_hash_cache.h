@@ -23,13 +23,24 @@ class SHA256HashCache {
 
   // If |path| exsts in |sha256_cache| and filestat is not updated,
   // the value is returned.
+  // If filestat is updated but |path| is an ELF binary whose identity
+  // (build-id, size and inode) is unchanged, the cached value is also
+  // returned, since toolchain binaries are often touched without changing
+  // their content.
   // Otherwise, calculate sha256 hash from |path|, and put the result
   // to |sha256_cache| with filestat.
   // Returns false if calculating sha256 hash from |path| failed.
   bool GetHashFromCacheOrFile(const std::string& path, std::string* hash);
 
+  // Returns identity of |path| made from ELF NT_GNU_BUILD_ID, file size and
+  // inode. Returns empty string if |path| is not an ELF binary with build-id.
+  static std::string GetBinaryIdentity(const std::string& path);
+
   int64_t total() const { return total_.value(); }
   int64_t hit() const { return hit_.value(); }
+  // number of hits by binary identity after filestat was updated.
+  // This is included in hit().
+  int64_t identity_hit() const { return identity_hit_.value(); }
 
  private:
   SHA256HashCache() = default;
@@ -42,9 +53,14 @@ class SHA256HashCache {
 
   static SHA256HashCache* instance_;
 
-  using ValueT = std::pair<FileStat, std::string>;
+  struct ValueT {
+    FileStat filestat;
+    // empty if the file is not an ELF binary with build-id.
+    std::string identity;
+    std::string hash;
+  };
   ReadWriteLock mu_;
-  // |filepath| -> (filestat, hash of file)
+  // |filepath| -> (filestat, binary identity, hash of file)
   // We suppose the size of the hash map is quite small.
   // If it is not true, I suggest to use LinkedUnorderedMap instead.
   absl::flat_hash_map<std::string, ValueT> cache_ ABSL_GUARDED_BY(mu_);
@@ -52,6 +68,7 @@ class SHA256HashCache {
   // counter for test.
   StatsCounter total_;
   StatsCounter hit_;
+  StatsCounter identity_hit_;
 };
 
 }  // namespace devtools_goma
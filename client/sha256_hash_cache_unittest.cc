@@ -6,9 +6,11 @@
 
 #include <gtest/gtest.h>
 
+#include "absl/strings/match.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "autolock_timer.h"
+#include "lib/file_helper.h"
 #include "unittest_util.h"
 
 namespace devtools_goma {
@@ -55,4 +57,51 @@ TEST_F(SHA256HashCacheTest, BasicTest) {
   EXPECT_EQ(1, cache_.hit());
 }
 
+#ifdef __linux__
+TEST_F(SHA256HashCacheTest, BinaryIdentity) {
+  TmpdirUtil tmpdir("sha256_hash_cache");
+
+  std::string content;
+  ASSERT_TRUE(ReadFileToString(GetTestFilePath("libdl.so"), &content));
+  tmpdir.CreateTmpFile("libdl.so", content);
+  const std::string& libdl = tmpdir.FullPath("libdl.so");
+  UpdateMtime(libdl, absl::Now() - absl::Seconds(10));
+
+  const std::string identity = SHA256HashCache::GetBinaryIdentity(libdl);
+  EXPECT_TRUE(absl::StartsWith(identity,
+                               "89905a355a901ba71187630c6c317009c0a0455a:"))
+      << identity;
+
+  std::string hash;
+  EXPECT_TRUE(cache_.GetHashFromCacheOrFile(libdl, &hash));
+  EXPECT_EQ(0, cache_.hit());
+
+  // touched, but the same binary.
+  UpdateMtime(libdl, absl::Now() - absl::Seconds(5));
+  std::string touched_hash;
+  EXPECT_TRUE(cache_.GetHashFromCacheOrFile(libdl, &touched_hash));
+  EXPECT_EQ(hash, touched_hash);
+  EXPECT_EQ(1, cache_.hit());
+  EXPECT_EQ(1, cache_.identity_hit());
+
+  // filestat is refreshed by the identity hit.
+  EXPECT_TRUE(cache_.GetHashFromCacheOrFile(libdl, &touched_hash));
+  EXPECT_EQ(2, cache_.hit());
+  EXPECT_EQ(1, cache_.identity_hit());
+
+  // content changed.
+  ASSERT_TRUE(WriteStringToFile(content + "x", libdl));
+  UpdateMtime(libdl, absl::Now() - absl::Seconds(3));
+  std::string modified_hash;
+  EXPECT_TRUE(cache_.GetHashFromCacheOrFile(libdl, &modified_hash));
+  EXPECT_NE(hash, modified_hash);
+  EXPECT_EQ(2, cache_.hit());
+  EXPECT_EQ(1, cache_.identity_hit());
+
+  // not ELF.
+  tmpdir.CreateTmpFile("script", "#!/bin/sh\n");
+  EXPECT_EQ("", SHA256HashCache::GetBinaryIdentity(tmpdir.FullPath("script")));
+}
+#endif
+
 }  // namespace devtools_goma
@@ -4,7 +4,10 @@
 
 #include "simple_timer.h"
 
-// SimpleTimer::Start() and SimpleTimer::GetInNanoSeconds() are
+#include "glog/logging.h"
+
+// SimpleTimer::Start(), SimpleTimer::GetInNanoSeconds() and
+// ThreadCpuTimer::GetThreadCpuTimeInNanoSeconds() are
 // platform specific. See simple_timer_*.cc.
 
 namespace devtools_goma {
@@ -13,4 +16,17 @@ absl::Duration SimpleTimer::GetDuration() const {
   return absl::Nanoseconds(GetInNanoSeconds());
 }
 
+absl::Duration ThreadCpuTimer::GetDuration() const {
+  int64_t end_time = GetThreadCpuTimeInNanoSeconds();
+  DCHECK_LE(start_time_, end_time);
+  if (end_time < start_time_) {
+    // e.g. Start() and GetDuration() are called on different threads.
+    LOG(ERROR) << "ThreadCpuTimer is not monotonic:"
+               << " start_time=" << start_time_
+               << " end_time=" << end_time;
+    return absl::ZeroDuration();
+  }
+  return absl::Nanoseconds(end_time - start_time_);
+}
+
 }  // namespace devtools_goma
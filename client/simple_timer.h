@@ -51,6 +51,25 @@ class SimpleTimer {
 #endif
 };
 
+// ThreadCpuTimer measures CPU time consumed by the current thread.
+// Start() and GetDuration() must be called on the same thread.
+class ThreadCpuTimer {
+ public:
+  ThreadCpuTimer() { Start(); }
+
+  void Start() { start_time_ = GetThreadCpuTimeInNanoSeconds(); }
+
+  // Returns CPU time consumed by the current thread since Start().
+  absl::Duration GetDuration() const;
+
+ private:
+  // Returns user and system CPU time of the current thread in nanoseconds.
+  // Platform specific. See simple_timer_*.cc.
+  static int64_t GetThreadCpuTimeInNanoSeconds();
+
+  int64_t start_time_;
+};
+
 }  // namespace devtools_goma
 
 #endif  // DEVTOOLS_GOMA_CLIENT_SIMPLE_TIMER_H_
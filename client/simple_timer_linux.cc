@@ -36,4 +36,14 @@ int64_t SimpleTimer::GetInNanoSeconds() const {
   return static_cast<int64_t>(end_time_int - start_time_int);
 }
 
+// static
+int64_t ThreadCpuTimer::GetThreadCpuTimeInNanoSeconds() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    PLOG(ERROR) << "clock_gettime(CLOCK_THREAD_CPUTIME_ID)";
+    return 0;
+  }
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 }  // namespace devtools_goma
@@ -5,6 +5,7 @@
 #include "simple_timer.h"
 
 #include <mach/mach_time.h>
+#include <time.h>
 
 #include <type_traits>
 
@@ -57,4 +58,10 @@ int64_t SimpleTimer::GetInNanoSeconds() const {
   return MachToNanoSec(end_time - start_time_);
 }
 
+// static
+int64_t ThreadCpuTimer::GetThreadCpuTimeInNanoSeconds() {
+  // available since macOS 10.12.
+  return static_cast<int64_t>(clock_gettime_nsec_np(CLOCK_THREAD_CPUTIME_ID));
+}
+
 }  // namespace devtools_goma
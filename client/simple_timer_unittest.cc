@@ -6,6 +6,8 @@
 
 #include <gtest/gtest.h>
 
+#include "absl/time/clock.h"
+
 namespace devtools_goma {
 
 // Smoke test to ensure SimpleTimer does not return a negative value.
@@ -22,4 +24,29 @@ TEST(SimpleTimer, Smoke) {
   }
 }
 
+TEST(ThreadCpuTimer, Smoke) {
+  ThreadCpuTimer timer;
+  absl::Duration prev = timer.GetDuration();
+  EXPECT_GE(prev, absl::ZeroDuration());
+
+  // Consume CPU until the timer advances.
+  volatile uint64_t x = 0;
+  absl::Duration t = prev;
+  for (int i = 0; i < 1000 && t == prev; ++i) {
+    for (int j = 0; j < 100000; ++j) {
+      x = x + j;
+    }
+    t = timer.GetDuration();
+  }
+  EXPECT_GT(t, prev);
+}
+
+TEST(ThreadCpuTimer, NotCountSleep) {
+  ThreadCpuTimer cpu_timer;
+  SimpleTimer wall_timer(SimpleTimer::START);
+  absl::SleepFor(absl::Milliseconds(100));
+  EXPECT_GE(wall_timer.GetDuration(), absl::Milliseconds(100));
+  EXPECT_LT(cpu_timer.GetDuration(), absl::Milliseconds(50));
+}
+
 }  // namespace devtools_goma
@@ -35,4 +35,21 @@ int64_t SimpleTimer::GetInNanoSeconds() const {
   return diff;
 }
 
+// static
+int64_t ThreadCpuTimer::GetThreadCpuTimeInNanoSeconds() {
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+  if (!::GetThreadTimes(::GetCurrentThread(), &creation_time, &exit_time,
+                        &kernel_time, &user_time)) {
+    LOG(ERROR) << "GetThreadTimes failed: " << ::GetLastError();
+    return 0;
+  }
+  ULARGE_INTEGER kernel, user;
+  kernel.LowPart = kernel_time.dwLowDateTime;
+  kernel.HighPart = kernel_time.dwHighDateTime;
+  user.LowPart = user_time.dwLowDateTime;
+  user.HighPart = user_time.dwHighDateTime;
+  // FILETIME is in 100 nanoseconds.
+  return static_cast<int64_t>((kernel.QuadPart + user.QuadPart) * 100);
+}
+
 }  // namespace devtools_goma
@@ -85,6 +85,14 @@ class Spawner {
   // Note: this feature only works on SpawnerPosix.
   void SetUmask(int32_t umask) { umask_ = umask; }
 
+  // If |filename| is not empty, the process is moved to the cgroup by
+  // writing to |filename| (cgroup.procs of a cgroup v2 directory) before
+  // exec. The process runs in the current cgroup if it fails.
+  // Note: this feature only works on SpawnerPosix.
+  void SetCgroupProcsFile(const std::string& filename) {
+    cgroup_procs_filename_ = filename;
+  }
+
   // Spawns a child process.
   // On Success,
   // * returns spawned process id in SpawnerWin.
@@ -124,16 +132,25 @@ class Spawner {
   // Returns -1 if this info is not available.
   virtual int64_t ChildMemKb() const = 0;
 
+  // Returns the user and system CPU time used during the execution.
+  // Returns -1 if this info is not available.
+  virtual int64_t ChildCpuTimeUs() const = 0;
+
   // Returns the signal that caused the child process to terminate.
   // (Only meaningful for SpawnerPosix).
   virtual int ChildTermSignal() const = 0;
 
+  // Returns true if the process was moved to the cgroup given by
+  // SetCgroupProcsFile. (Only meaningful for SpawnerPosix).
+  virtual bool ChildInCgroup() const = 0;
+
  protected:
   Spawner() :
       console_output_(NULL), detach_(false), keep_env_(false), umask_(-1),
       console_output_option_(MERGE_STDOUT_STDERR) {}
 
   std::string stdin_filename_, stdout_filename_, stderr_filename_;
+  std::string cgroup_procs_filename_;
   std::string* console_output_;
   bool detach_;
   bool keep_env_;
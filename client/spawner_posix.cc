@@ -47,6 +47,8 @@ struct SubprocExit {
   // status of spawned process.
   int status;
   struct rusage ru;
+  // non-zero if the spawned process ran in the requested cgroup.
+  int in_cgroup;
 };
 
 void __attribute__((__noreturn__)) SubprocExitReport(
@@ -70,7 +72,9 @@ SpawnerPosix::SpawnerPosix()
       sent_sig_(0),
       status_(kInvalidProcessStatus),
       process_mem_kb_(-1),
-      signal_(0) {}
+      process_cpu_time_us_(-1),
+      signal_(0),
+      in_cgroup_(false) {}
 
 SpawnerPosix::~SpawnerPosix() {
   if (!console_out_file_.empty())
@@ -282,6 +286,17 @@ int SpawnerPosix::Run(const std::string& cmd,
       SubprocExitReport(child_exit_fd.fd(), se, 1);
     }
 
+    // Move this monitor process to the cgroup, so that the spawned process
+    // and its descendants are accounted there. Writing "0" to cgroup.procs
+    // moves the writing process. Run in the current cgroup on failure.
+    if (!cgroup_procs_filename_.empty()) {
+      int cgroup_fd = open(cgroup_procs_filename_.c_str(), O_WRONLY);
+      if (cgroup_fd >= 0) {
+        se.in_cgroup = write(cgroup_fd, "0", 1) == 1;
+        close(cgroup_fd);
+      }
+    }
+
     pid_t prog_pid = Spawner::kInvalidPid;
     // TODO: use POSIX_SPAWN_USEVFORK (_GNU_SOURCE).
     if (posix_spawn(
@@ -458,6 +473,10 @@ SpawnerPosix::ProcessStatus SpawnerPosix::Wait(WaitPolicy wait_policy) {
                      << se.last_errno << "]";
       }
       process_mem_kb_ = se.ru.ru_maxrss;
+      in_cgroup_ = se.in_cgroup != 0;
+      process_cpu_time_us_ =
+          absl::ToInt64Microseconds(absl::DurationFromTimeval(se.ru.ru_utime) +
+                                    absl::DurationFromTimeval(se.ru.ru_stime));
       if (se.status != kInvalidProcessStatus) {
         if (WIFSIGNALED(se.status)) {
           signal_ = WTERMSIG(se.status);
@@ -35,7 +35,9 @@ class SpawnerPosix : public Spawner {
   void SetSignaled() override { is_signaled_ = true; }
   int ChildStatus() const override { return status_; }
   int64_t ChildMemKb() const override { return process_mem_kb_; }
+  int64_t ChildCpuTimeUs() const override { return process_cpu_time_us_; }
   int ChildTermSignal() const override { return signal_; }
+  bool ChildInCgroup() const override { return in_cgroup_; }
   int prog_pid() const { return prog_pid_; }
   int monitor_pid() const { return monitor_pid_; }
 
@@ -53,7 +55,9 @@ class SpawnerPosix : public Spawner {
 
   int status_;
   int64_t process_mem_kb_;
+  int64_t process_cpu_time_us_;
   int signal_;
+  bool in_cgroup_;
 
   std::string console_out_file_;
 
@@ -6,7 +6,9 @@
 
 #include <unistd.h>
 
+#include "file_helper.h"
 #include "gtest/gtest.h"
+#include "scoped_tmp_file.h"
 
 namespace devtools_goma {
 
@@ -31,6 +33,8 @@ TEST(SpawnerPosix, RunTrueTest) {
   EXPECT_FALSE(spawner.IsChildRunning());
   EXPECT_FALSE(spawner.IsSignaled());
   EXPECT_EQ(0, spawner.ChildStatus());
+  EXPECT_GE(spawner.ChildCpuTimeUs(), 0);
+  EXPECT_FALSE(spawner.ChildInCgroup());
 }
 
 TEST(SpawnerPosix, RunFalseTest) {
@@ -112,6 +116,49 @@ TEST(SpawnerPosix, RunKillWaitTest) {
   EXPECT_EQ(SIGINT, spawner.ChildTermSignal());
 }
 
+TEST(SpawnerPosix, RunCgroupTest) {
+  // Emulates cgroup.procs with a normal file.
+  ScopedTmpFile procs("spawner_posix_unittest");
+  ASSERT_TRUE(procs.valid());
+  ASSERT_TRUE(procs.Close());
+
+  SpawnerPosix spawner;
+#ifdef __MACH__
+  const std::vector<std::string> args{"/usr/bin/true"};
+#else
+  const std::vector<std::string> args{"/bin/true"};
+#endif
+  const std::vector<std::string> envs;
+  spawner.SetCgroupProcsFile(procs.filename());
+  EXPECT_NE(Spawner::kInvalidPid, spawner.Run(args[0], args, envs, "."));
+  EXPECT_EQ(Spawner::ProcessStatus::EXITED,
+            spawner.Wait(Spawner::WAIT_INFINITE));
+  EXPECT_EQ(0, spawner.ChildStatus());
+  EXPECT_TRUE(spawner.ChildInCgroup());
+
+  // The monitor process moves itself by writing "0".
+  std::string content;
+  ASSERT_TRUE(ReadFileToString(procs.filename(), &content));
+  EXPECT_EQ("0", content);
+}
+
+TEST(SpawnerPosix, RunCgroupMissingTest) {
+  SpawnerPosix spawner;
+#ifdef __MACH__
+  const std::vector<std::string> args{"/usr/bin/true"};
+#else
+  const std::vector<std::string> args{"/bin/true"};
+#endif
+  const std::vector<std::string> envs;
+  // Runs in the current cgroup.
+  spawner.SetCgroupProcsFile("/path/should/not/exist/cgroup.procs");
+  EXPECT_NE(Spawner::kInvalidPid, spawner.Run(args[0], args, envs, "."));
+  EXPECT_EQ(Spawner::ProcessStatus::EXITED,
+            spawner.Wait(Spawner::WAIT_INFINITE));
+  EXPECT_EQ(0, spawner.ChildStatus());
+  EXPECT_FALSE(spawner.ChildInCgroup());
+}
+
 TEST(SpawnerPosix, RunDetachTest) {
   SpawnerPosix spawner;
   const std::vector<std::string> args{"/bin/sleep", "10"};
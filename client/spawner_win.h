@@ -47,6 +47,9 @@ class SpawnerWin : public Spawner {
       return -1;
     return static_cast<int64_t>(process_mem_bytes_) / 1024;
   }
+  // Not supported yet.
+  int64_t ChildCpuTimeUs() const override { return -1; }
+  bool ChildInCgroup() const override { return false; }
 
   static void Setup();
   static void TearDown();
@@ -62,7 +62,8 @@ std::string SubProcessController::Options::DebugString() const {
   ss << " max_subprocs=" << max_subprocs
      << " max_subprocs_low_priority=" << max_subprocs_low_priority
      << " max_subprocs_heavy_weight=" << max_subprocs_heavy_weight
-     << " dont_kill_subprocess=" << dont_kill_subprocess;
+     << " dont_kill_subprocess=" << dont_kill_subprocess
+     << " cgroup={" << cgroup.DebugString() << "}";
   return ss.str();
 }
 
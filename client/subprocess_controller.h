@@ -11,6 +11,7 @@
 #include <string>
 
 #include "basictypes.h"
+#include "cgroup.h"
 #include "scoped_fd.h"
 
 #ifdef _WIN32
@@ -60,6 +61,8 @@ class SubProcessController {
     int max_subprocs_low_priority;
     int max_subprocs_heavy_weight;
     bool dont_kill_subprocess;
+    // Linux only.
+    CgroupTree::Options cgroup;
 
     std::string DebugString() const;
   };
@@ -9,6 +9,7 @@
 #include <memory>
 #include <set>
 #include <utility>
+#include <vector>
 
 #ifndef _WIN32
 #include <errno.h>
@@ -17,6 +18,9 @@
 #include <sys/select.h>
 #include <unistd.h>
 #endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
@@ -62,6 +66,36 @@ void SigChldAction(int signo ALLOW_UNUSED,
   if (write(g_signal_fd, siginfo, sizeof(siginfo_t)) != sizeof(siginfo_t))
     abort();
 }
+
+// Returns pidfd of |pid|, which gets readable when |pid| terminates.
+// Returns -1 if pidfd is not supported.
+// Since SIGCHLD may be coalesced, we need to poll subprocesses without pidfd.
+static int OpenPidFd(pid_t pid) {
+#if defined(__linux__) && defined(SYS_pidfd_open)
+  static bool pidfd_unsupported = false;
+  if (pidfd_unsupported) {
+    return -1;
+  }
+  int fd = syscall(SYS_pidfd_open, pid, 0);
+  if (fd < 0) {
+    if (errno == ENOSYS) {
+      LOG(INFO) << "pidfd_open is not supported. use polling.";
+      pidfd_unsupported = true;
+    } else {
+      PLOG(WARNING) << "pidfd_open failed pid=" << pid;
+    }
+    return -1;
+  }
+  if (fd >= FD_SETSIZE) {
+    LOG(WARNING) << "pidfd is too large for select. fd=" << fd;
+    close(fd);
+    return -1;
+  }
+  return fd;
+#else
+  return -1;
+#endif
+}
 #endif
 
 SubProcessControllerServer::SubProcessControllerServer(
@@ -77,6 +111,8 @@ SubProcessControllerServer::SubProcessControllerServer(
             << " " << options_.DebugString();
 #ifdef _WIN32
   SpawnerWin::Setup();
+#else
+  cgroup_ = CgroupTree::Create(options_.cgroup);
 #endif
 }
 
@@ -135,11 +171,25 @@ bool SubProcessControllerServer::Loop() {
 #ifndef _WIN32
     FD_SET(signal_fd_.fd(), &read_fd);
     max_fd = std::max(max_fd, signal_fd_.fd());
+    // (id, pidfd) pairs in read_fd. DoRead may close a pidfd and a new
+    // pidfd of another subprocess may reuse the fd number, so results of
+    // select must be checked against these, not against pidfds_.
+    std::vector<std::pair<int, int>> selected_pidfds;
+    selected_pidfds.reserve(pidfds_.size());
+    for (const auto& iter : pidfds_) {
+      FD_SET(iter.second.fd(), &read_fd);
+      max_fd = std::max(max_fd, iter.second.fd());
+      selected_pidfds.emplace_back(iter.first, iter.second.fd());
+    }
 #endif
+    // No need to wake up periodically if termination of all subprocesses
+    // will be notified by pidfd.
+    const bool needs_polling = NeedsPolling();
     struct timeval tv;
     tv.tv_sec = timeout_millisec_ / 1000;
     tv.tv_usec = (timeout_millisec_ - (tv.tv_sec * 1000)) * 1000;
-    int r = select(max_fd + 1, &read_fd, &write_fd, nullptr, &tv);
+    int r = select(max_fd + 1, &read_fd, &write_fd, nullptr,
+                   needs_polling ? &tv : nullptr);
     if (r < 0) {
       if (errno == EINTR || errno == EAGAIN)
         continue;
@@ -165,6 +215,11 @@ bool SubProcessControllerServer::Loop() {
       DoRead();
     }
 #ifndef _WIN32
+    for (const auto& iter : selected_pidfds) {
+      if (FD_ISSET(iter.second, &read_fd)) {
+        DoPidFd(iter.first, iter.second);
+      }
+    }
     if (FD_ISSET(signal_fd_.fd(), &read_fd)) {
       DoSignal();
     }
@@ -193,6 +248,9 @@ bool SubProcessControllerServer::Loop() {
   }
   FlushLogFiles();
   subprocs_.clear();
+#ifndef _WIN32
+  pidfds_.clear();
+#endif
   return shutdowned_;
 }
 
@@ -209,7 +267,12 @@ void SubProcessControllerServer::Register(std::unique_ptr<SubProcessReq> req) {
   VLOG(1) << "id=" << req->id() << " Kill? " << req->trace_id()
           << " prog=" << req->prog()
           << " dont_kill=" << dont_kill;
-  SubProcessImpl* s = new SubProcessImpl(*req, dont_kill);
+#ifndef _WIN32
+  CgroupTree* cgroup = cgroup_.get();
+#else
+  CgroupTree* cgroup = nullptr;
+#endif
+  SubProcessImpl* s = new SubProcessImpl(*req, dont_kill, cgroup);
   CHECK(subprocs_.insert(std::make_pair(req->id(), s)).second);
   TrySpawnSubProcess();
 }
@@ -311,6 +374,9 @@ void SubProcessControllerServer::Terminated(
       << " status=" << terminated->status();
 
   subprocs_.erase(terminated->id());
+#ifndef _WIN32
+  pidfds_.erase(terminated->id());
+#endif
   SendNotify(SubProcessController::TERMINATED, *terminated);
 
   TrySpawnSubProcess();
@@ -403,6 +469,11 @@ void SubProcessControllerServer::TrySpawnSubProcess() {
     return;
   }
   std::unique_ptr<SubProcessStarted> started(candidate->Spawn());
+#ifndef _WIN32
+  if (candidate->state() == SubProcessState::RUN) {
+    WatchSubProcess(candidate);
+  }
+#endif
   if (started != nullptr) {
     Started(std::move(started));
     return;
@@ -529,14 +600,53 @@ void SubProcessControllerServer::DoSignal() {
   for (const auto& iter : subprocs_) {
     SubProcessImpl* s = iter.second.get();
     if (s->started().pid() == si.si_pid) {
+      if (pidfds_.count(iter.first) > 0) {
+        // pidfd will get readable, or has already been handled.
+        return;
+      }
       s->Signaled(si.si_status);
       timeout_millisec_ = kWaitIntervalMilliSec;
       return;
     }
   }
-  LOG(WARNING) << "no subprocess found for pid:" << si.si_pid;
+  VLOG(1) << "no subprocess found for pid:" << si.si_pid
+          << " (maybe already terminated by pidfd?)";
   timeout_millisec_ = kIdleIntervalMilliSec;
 }
+
+void SubProcessControllerServer::WatchSubProcess(SubProcessImpl* s) {
+  ScopedFd pidfd(OpenPidFd(s->started().pid()));
+  if (!pidfd.valid()) {
+    return;
+  }
+  pidfds_[s->req().id()] = std::move(pidfd);
+}
+
+void SubProcessControllerServer::DoPidFd(int id, int pidfd) {
+  VLOG(1) << "id=" << id << " DoPidFd fd=" << pidfd;
+  auto found_pidfd = pidfds_.find(id);
+  if (found_pidfd == pidfds_.end() || found_pidfd->second.fd() != pidfd) {
+    // |id| has already been terminated, e.g. by Kill in DoRead.
+    VLOG(1) << "id=" << id << " pidfd has already been closed";
+    return;
+  }
+  auto found = subprocs_.find(id);
+  if (found == subprocs_.end()) {
+    pidfds_.erase(found_pidfd);
+    return;
+  }
+  SubProcessImpl* s = found->second.get();
+  std::unique_ptr<SubProcessTerminated> terminated(
+      s->Wait(s->state() == SubProcessState::SIGNALED));
+  if (terminated != nullptr) {
+    Terminated(std::move(terminated));
+    return;
+  }
+  // Should not happen, but fall back to polling not to busy loop.
+  LOG(WARNING) << "id=" << id << " pidfd is readable but still running"
+               << " pid=" << s->started().pid();
+  pidfds_.erase(id);
+}
 #endif
 
 void SubProcessControllerServer::DoTimeout() {
@@ -568,4 +678,24 @@ void SubProcessControllerServer::DoTimeout() {
     timeout_millisec_ = kIdleIntervalMilliSec;
 }
 
+bool SubProcessControllerServer::NeedsPolling() const {
+  for (const auto& iter : subprocs_) {
+    const SubProcessImpl* s = iter.second.get();
+    if (s->started().pid() == SubProcessState::kInvalidPid) {
+      continue;
+    }
+    if (s->state() == SubProcessState::SIGNALED) {
+      return true;
+    }
+#ifndef _WIN32
+    if (pidfds_.count(iter.first) == 0) {
+      return true;
+    }
+#else
+    return true;
+#endif
+  }
+  return false;
+}
+
 }  // namespace devtools_goma
@@ -63,13 +63,29 @@ class SubProcessControllerServer: public SubProcessController {
   void SetupSigchldHandler();
 
   void DoSignal();
+
+  // Watches termination of the spawned |s| with pidfd if available.
+  void WatchSubProcess(SubProcessImpl* s);
+  // Called when |pidfd| of subprocess |id| gets readable.
+  // Does nothing if |pidfd| is no longer the pidfd of |id|.
+  void DoPidFd(int id, int pidfd);
 #endif
   void DoTimeout();
 
+  // Returns true if some subprocess needs to be checked in DoTimeout,
+  // i.e. its termination would not be notified by pidfd.
+  bool NeedsPolling() const;
+
+#ifndef _WIN32
+  // Declared before |subprocs_|, which refer to it until destructed.
+  std::unique_ptr<CgroupTree> cgroup_;
+#endif
   std::map<int, std::unique_ptr<SubProcessImpl>> subprocs_;
   ScopedSocket sock_fd_;
 #ifndef _WIN32
   ScopedFd signal_fd_;
+  // pidfd of running subprocesses, keyed by subprocess id.
+  std::map<int, ScopedFd> pidfds_;
 #endif
   int timeout_millisec_;
   SubProcessController::Options options_;
@@ -0,0 +1,194 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "subprocess_controller_server.h"
+
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "absl/time/time.h"
+#include "client/subprocess.pb.h"
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+#include "scoped_fd.h"
+
+namespace devtools_goma {
+
+namespace {
+
+#ifdef __MACH__
+constexpr char kTruePath[] = "/usr/bin/true";
+#else
+constexpr char kTruePath[] = "/bin/true";
+#endif
+constexpr char kSleepPath[] = "/bin/sleep";
+
+// Termination should be notified well before the idle polling interval
+// (500ms) of SubProcessControllerServer.
+constexpr absl::Duration kNotifyTimeout = absl::Milliseconds(250);
+
+bool IsPidFdSupported() {
+#ifdef SYS_pidfd_open
+  int fd = syscall(SYS_pidfd_open, getpid(), 0);
+  if (fd < 0) {
+    return false;
+  }
+  close(fd);
+  return true;
+#else
+  return false;
+#endif
+}
+
+}  // namespace
+
+// Runs SubProcessControllerServer in a child process, and talks with it
+// as SubProcessControllerClient does.
+// While a subprocess is watched by pidfd, the server neither polls it nor
+// reaps it on SIGCHLD, so its termination is notified only by pidfd.
+class SubProcessControllerServerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    int sockfd[2];
+    PCHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sockfd) == 0);
+    server_pid_ = fork();
+    PCHECK(server_pid_ >= 0);
+    if (server_pid_ == 0) {
+      close(sockfd[1]);
+      SubProcessController::Options options;
+      SubProcessControllerServer server(sockfd[0], options);
+      server.Loop();
+      _exit(0);
+    }
+    close(sockfd[0]);
+    sock_.reset(sockfd[1]);
+  }
+
+  void TearDown() override {
+    // The server stops once the socket is closed.
+    sock_.reset(-1);
+    int status = 0;
+    PCHECK(waitpid(server_pid_, &status, 0) == server_pid_);
+  }
+
+  void Send(int op, const google::protobuf::Message& message) {
+    std::string payload;
+    message.SerializeToString(&payload);
+    int len = payload.size();
+    std::string msg(sizeof(int) * 2, '\0');
+    memcpy(&msg[0], &op, sizeof(int));
+    memcpy(&msg[sizeof(int)], &len, sizeof(int));
+    msg += payload;
+    ASSERT_EQ(static_cast<ssize_t>(msg.size()),
+              sock_.Write(msg.data(), msg.size()));
+  }
+
+  // Reads a message from the server, and returns its op.
+  int Receive(std::string* payload) {
+    int header[2];
+    if (!ReadAll(reinterpret_cast<char*>(header), sizeof(header))) {
+      return SubProcessController::CLOSED;
+    }
+    payload->resize(header[1]);
+    if (!ReadAll(&(*payload)[0], payload->size())) {
+      return SubProcessController::CLOSED;
+    }
+    return header[0];
+  }
+
+  // Registers and runs |argv| as subprocess |id|, and waits for it started.
+  void Start(int id, const std::vector<std::string>& argv) {
+    SubProcessReq req;
+    req.set_id(id);
+    req.set_trace_id("test");
+    req.set_prog(argv[0]);
+    for (const auto& arg : argv) {
+      req.add_argv(arg);
+    }
+    req.set_cwd("/");
+    req.set_weight(SubProcessReq::LIGHT_WEIGHT);
+    Send(SubProcessController::REGISTER, req);
+
+    std::string payload;
+    ASSERT_EQ(SubProcessController::STARTED, Receive(&payload));
+    SubProcessStarted started;
+    ASSERT_TRUE(started.ParseFromString(payload));
+    EXPECT_EQ(id, started.id());
+    EXPECT_GT(started.pid(), 0);
+  }
+
+  // Waits for termination of subprocess |id|.
+  // Returns false if it is not notified in |timeout|.
+  bool WaitTerminated(int id,
+                      absl::Duration timeout,
+                      SubProcessTerminated* terminated) {
+    struct timeval tv = absl::ToTimeval(timeout);
+    fd_set read_fd;
+    FD_ZERO(&read_fd);
+    FD_SET(sock_.get(), &read_fd);
+    if (select(sock_.get() + 1, &read_fd, nullptr, nullptr, &tv) <= 0) {
+      return false;
+    }
+    std::string payload;
+    if (Receive(&payload) != SubProcessController::TERMINATED) {
+      return false;
+    }
+    if (!terminated->ParseFromString(payload)) {
+      return false;
+    }
+    EXPECT_EQ(id, terminated->id());
+    return true;
+  }
+
+  bool ReadAll(char* buf, size_t size) {
+    while (size > 0) {
+      ssize_t r = sock_.Read(buf, size);
+      if (r <= 0) {
+        return false;
+      }
+      buf += r;
+      size -= r;
+    }
+    return true;
+  }
+
+  pid_t server_pid_ = -1;
+  ScopedSocket sock_;
+};
+
+TEST_F(SubProcessControllerServerTest, NotifyFinishedByPidFd) {
+  if (!IsPidFdSupported()) {
+    GTEST_SKIP() << "pidfd_open is not supported";
+  }
+  Start(1, {kTruePath});
+
+  SubProcessTerminated terminated;
+  EXPECT_TRUE(WaitTerminated(1, kNotifyTimeout, &terminated));
+  EXPECT_EQ(0, terminated.status());
+}
+
+TEST_F(SubProcessControllerServerTest, NotifyKilledByPidFd) {
+  if (!IsPidFdSupported()) {
+    GTEST_SKIP() << "pidfd_open is not supported";
+  }
+  Start(1, {kSleepPath, "100"});
+
+  SubProcessTerminated terminated;
+  EXPECT_FALSE(WaitTerminated(1, kNotifyTimeout, &terminated));
+
+  SubProcessKill kill;
+  kill.set_id(1);
+  Send(SubProcessController::KILL, kill);
+  EXPECT_TRUE(WaitTerminated(1, kNotifyTimeout, &terminated));
+  EXPECT_NE(0, terminated.status());
+}
+
+}  // namespace devtools_goma
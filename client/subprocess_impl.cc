@@ -12,6 +12,8 @@
 #include "glog/stl_logging.h"
 #include "time_util.h"
 #ifndef _WIN32
+#include "cgroup.h"
+#include "path.h"
 #include "spawner_posix.h"
 #else
 #include "spawner_win.h"
@@ -20,10 +22,12 @@
 namespace devtools_goma {
 
 SubProcessImpl::SubProcessImpl(const SubProcessReq& req,
-                               bool dont_kill_subprocess)
+                               bool dont_kill_subprocess,
+                               CgroupTree* cgroup)
     : state_(SubProcessState::PENDING),
       spawner_(new PlatformSpawner),
-      kill_subprocess_(!dont_kill_subprocess) {
+      kill_subprocess_(!dont_kill_subprocess),
+      cgroup_(cgroup) {
   VLOG(1) << "new SubProcessImpl " << req.id()
           << " " << req.trace_id();
   req_ = req;
@@ -34,6 +38,12 @@ SubProcessImpl::~SubProcessImpl() {
   VLOG(1) << "delete SubProcessImpl " << req_.id()
           << " " << req_.trace_id();
   VLOG(2) << "delete " << req_.DebugString();
+#ifndef _WIN32
+  if (!cgroup_dir_.empty()) {
+    // e.g. failed to spawn.
+    cgroup_->RemoveTaskCgroup(cgroup_dir_);
+  }
+#endif
 }
 
 SubProcessStarted* SubProcessImpl::Spawn() {
@@ -61,6 +71,21 @@ SubProcessStarted* SubProcessImpl::Spawn() {
   if (req_.has_umask()) {
     spawner_->SetUmask(req_.umask());
   }
+#ifndef _WIN32
+  if (cgroup_ != nullptr && !req_.detach()) {
+    CgroupTree::Class cls = CgroupTree::kNormal;
+    if (req_.verify_output()) {
+      cls = CgroupTree::kVerify;
+    } else if (req_.priority() == SubProcessReq::LOW_PRIORITY) {
+      cls = CgroupTree::kLowPriority;
+    }
+    cgroup_dir_ = cgroup_->CreateTaskCgroup(cls, req_.id());
+    if (!cgroup_dir_.empty()) {
+      spawner_->SetCgroupProcsFile(
+          file::JoinPath(cgroup_dir_, "cgroup.procs"));
+    }
+  }
+#endif
   VLOG(1) << "id=" << req_.id()
           << " to_spawn " << req_.trace_id()
           << " prog=" << req_.prog()
@@ -135,6 +160,28 @@ std::unique_ptr<SubProcessTerminated> SubProcessImpl::Wait(bool need_kill) {
   terminated_.set_status(spawner_->ChildStatus());
   if (spawner_->ChildMemKb() > 0)
     terminated_.set_mem_kb(spawner_->ChildMemKb());
+  if (spawner_->ChildCpuTimeUs() >= 0)
+    terminated_.set_cpu_time_us(spawner_->ChildCpuTimeUs());
+#ifndef _WIN32
+  if (!cgroup_dir_.empty()) {
+    // The cgroup also counts descendants that were not waited for.
+    // If the process could not join the cgroup, it is empty, so keep
+    // rusage of the spawner.
+    if (spawner_->ChildInCgroup()) {
+      CgroupStats stats;
+      CgroupTree::ReadStats(cgroup_dir_, &stats);
+      if (stats.cpu_usage_us >= 0)
+        terminated_.set_cpu_time_us(stats.cpu_usage_us);
+      if (stats.memory_peak_kb > 0)
+        terminated_.set_memory_peak_kb(stats.memory_peak_kb);
+      if (stats.memory_anon_peak_kb >= 0)
+        terminated_.set_memory_anon_peak_kb(stats.memory_anon_peak_kb);
+    }
+    // The monitor process has been reaped here.
+    cgroup_->RemoveTaskCgroup(cgroup_dir_);
+    cgroup_dir_.clear();
+  }
+#endif
   if (spawner_->ChildTermSignal() != 0)
     terminated_.set_term_signal(spawner_->ChildTermSignal());
   terminated_.set_run_ms(DurationToIntMs(timer_.GetDuration()));
@@ -7,6 +7,7 @@
 #define DEVTOOLS_GOMA_CLIENT_SUBPROCESS_IMPL_H_
 
 #include <memory>
+#include <string>
 
 #include "basictypes.h"
 #include "compiler_specific.h"
@@ -19,11 +20,18 @@ MSVC_POP_WARNING()
 
 namespace devtools_goma {
 
+class CgroupTree;
+
 // A SubProcessImpl is associated with a single subprocess.
 // It is created and owned by SubProcessControllerServer.
 class SubProcessImpl {
  public:
-  SubProcessImpl(const SubProcessReq& req, bool dont_kill_subprocess);
+  // If |cgroup| is not nullptr, the subprocess runs in its own cgroup
+  // under |cgroup|, and its usage is reported in SubProcessTerminated.
+  // |cgroup| must outlive this object.
+  SubProcessImpl(const SubProcessReq& req,
+                 bool dont_kill_subprocess,
+                 CgroupTree* cgroup);
   ~SubProcessImpl();
 
   SubProcessState::State state() const { return state_; }
@@ -56,6 +64,9 @@ class SubProcessImpl {
   std::unique_ptr<Spawner> spawner_;
   SimpleTimer timer_;
   bool kill_subprocess_;
+  CgroupTree* cgroup_;
+  // Directory of the cgroup for this subprocess, or empty if not used.
+  std::string cgroup_dir_;
 
   DISALLOW_COPY_AND_ASSIGN(SubProcessImpl);
 };
@@ -84,6 +84,7 @@ void InputFileTask::Run(CompileTask* task, OneshotClosure* closure) {
     }
   }
 
+  ThreadCpuTimer cpu_timer;
   if (missed_content_) {
     LOG(INFO) << task->trace_id() << " (" << num_tasks() << " tasks)"
               << " input " << filename_ << " [missed content]";
@@ -190,6 +191,13 @@ void InputFileTask::Run(CompileTask* task, OneshotClosure* closure) {
     VLOG(1) << task->trace_id() << " (" << num_tasks() << " tasks)"
             << " clear task by filename" << filename_;
   }
+  // Uploads in side channel are done in http threads, while this thread
+  // runs other closures in HttpClient::Wait.
+  const HttpClient::Status& http_status = blob_uploader_->http_status();
+  run_task_ = task;
+  cpu_time_ = cpu_timer.GetDuration() - http_status.wait_cpu_time +
+              http_status.req_build_cpu_time + http_status.resp_parse_cpu_time;
+
   std::vector<std::pair<WorkerThread::ThreadId, OneshotClosure*>> callbacks;
 
   {
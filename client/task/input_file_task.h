@@ -50,6 +50,12 @@ class InputFileTask {
   bool need_hash_only() const { return need_hash_only_; }
   const absl::optional<absl::Time>& mtime() const { return file_stat_.mtime; }
   const SimpleTimer& timer() const { return timer_; }
+  // Returns CPU time of the thread that ran Run() if |task| ran it.
+  // Returns zero for other tasks sharing this InputFileTask, so that the
+  // CPU time is not counted more than once.
+  absl::Duration CpuTimeForTask(const CompileTask* task) const {
+    return task == run_task_ ? cpu_time_ : absl::ZeroDuration();
+  }
   ssize_t file_size() const { return file_stat_.size; }
   const std::string& old_hash_key() const { return old_hash_key_; }
   const std::string& hash_key() const { return blob_uploader_->hash_key(); }
@@ -129,6 +135,11 @@ class InputFileTask {
 
   SimpleTimer timer_;
 
+  // The task that ran Run(), and CPU time of the thread in Run() excluding
+  // HttpClient::Wait, and of the http threads for the upload RPCs.
+  const CompileTask* run_task_ = nullptr;
+  absl::Duration cpu_time_;
+
   // true if goma file ops is succeeded.
   bool success_;
 
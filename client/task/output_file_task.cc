@@ -39,6 +39,7 @@ OutputFileTask::~OutputFileTask() {
 
 void OutputFileTask::Run(OneshotClosure* closure) {
   VLOG(1) << task_->trace_id() << " output " << info_->filename;
+  ThreadCpuTimer cpu_timer;
   success_ = blob_downloader_->Download(output_, info_);
   if (success_) {
     // TODO: fix to support cas digest.
@@ -48,6 +49,11 @@ void OutputFileTask::Run(OneshotClosure* closure) {
                  << (task_->cache_hit() ? "cached" : "no-cached")
                  << " output file failed:" << info_->filename;
   }
+  // Downloads are done in http threads, while this thread runs other
+  // closures in HttpClient::Wait.
+  const HttpClient::Status& http_status = blob_downloader_->http_status();
+  cpu_time_ = cpu_timer.GetDuration() - http_status.wait_cpu_time +
+              http_status.req_build_cpu_time + http_status.resp_parse_cpu_time;
   wm_->RunClosureInThread(FROM_HERE, thread_id_, closure,
                           WorkerThread::PRIORITY_LOW);
 }
@@ -38,6 +38,9 @@ class OutputFileTask {
   CompileTask* task() const { return task_; }
   const ExecResult_Output& output() const { return output_; }
   const SimpleTimer& timer() const { return timer_; }
+  // CPU time of the thread that ran Run(), excluding HttpClient::Wait,
+  // and of the http threads for the download RPCs.
+  absl::Duration cpu_time() const { return cpu_time_; }
   bool success() const { return success_; }
   bool IsInMemory() const;
 
@@ -60,6 +63,7 @@ class OutputFileTask {
   size_t output_size_;
   OutputFileInfo* info_;
   SimpleTimer timer_;
+  absl::Duration cpu_time_;
   bool success_;
 };
 
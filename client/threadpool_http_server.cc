@@ -1159,6 +1159,11 @@ void ThreadpoolHttpServer::RemoveAccept(SocketType socket_type) {
   cond_.Broadcast();
 }
 
+bool ThreadpoolHttpServer::port_ready() const {
+  AUTOLOCK(lock, &mu_);
+  return port_ready_;
+}
+
 void ThreadpoolHttpServer::WaitPortReady() {
   AUTOLOCK(lock, &mu_);
   while (!port_ready_) {
@@ -196,6 +196,9 @@ class ThreadpoolHttpServer {
 
   int port() const { return port_; }
 
+  // Returns true once Loop() is listening on port().
+  bool port_ready() const;
+
   const std::string& un_socket_name() const { return un_socket_name_; }
 
   // Registers idle closure.  closure must be permanent callback.
@@ -0,0 +1,125 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "upload_scheduler.h"
+
+#include <algorithm>
+
+#include "autolock_timer.h"
+#include "glog/logging.h"
+
+namespace devtools_goma {
+
+UploadScheduler::UploadScheduler(size_t max_bytes_in_flight,
+                                 absl::Duration max_queue_wait)
+    : max_bytes_in_flight_(max_bytes_in_flight),
+      max_queue_wait_(max_queue_wait) {}
+
+void UploadScheduler::Acquire(size_t size, OneshotClosure* start) {
+  std::vector<OneshotClosure*> starts;
+  {
+    AUTOLOCK(lock, &mu_);
+    ++num_uploads_;
+    if (by_size_.empty() && FitsUnlocked(size)) {
+      AdmitUnlocked(size);
+      starts.push_back(start);
+    } else {
+      const absl::Time now = absl::Now();
+      const uint64_t seq = next_seq_++;
+      by_size_.emplace(size, seq);
+      by_arrival_.emplace(seq, Waiter{size, now, start});
+      ++num_waited_;
+      // |start| may be smaller than the ones already waiting.
+      starts = DispatchUnlocked(now);
+    }
+  }
+  for (auto* closure : starts) {
+    closure->Run();
+  }
+}
+
+void UploadScheduler::Release(size_t size) {
+  std::vector<OneshotClosure*> starts;
+  {
+    AUTOLOCK(lock, &mu_);
+    DCHECK_GE(bytes_in_flight_, size);
+    bytes_in_flight_ -= size;
+    if (!by_size_.empty()) {
+      starts = DispatchUnlocked(absl::Now());
+    }
+  }
+  for (auto* closure : starts) {
+    closure->Run();
+  }
+}
+
+size_t UploadScheduler::bytes_in_flight() const {
+  AUTOLOCK(lock, &mu_);
+  return bytes_in_flight_;
+}
+
+size_t UploadScheduler::num_queued() const {
+  AUTOLOCK(lock, &mu_);
+  return by_size_.size();
+}
+
+void UploadScheduler::DumpStatsToProto(UploadSchedulerStats* stats) const {
+  AUTOLOCK(lock, &mu_);
+  stats->set_max_bytes_in_flight(max_bytes_in_flight_);
+  stats->set_bytes_in_flight(bytes_in_flight_);
+  stats->set_max_bytes_in_flight_seen(max_bytes_in_flight_seen_);
+  stats->set_queued(by_size_.size());
+  stats->set_uploads(num_uploads_);
+  stats->set_waited(num_waited_);
+  stats->set_aged(num_aged_);
+  stats->set_total_queue_wait_ms(absl::ToInt64Milliseconds(total_queue_wait_));
+  stats->set_max_queue_wait_ms(absl::ToInt64Milliseconds(max_queue_wait_seen_));
+}
+
+std::vector<OneshotClosure*> UploadScheduler::DispatchUnlocked(
+    absl::Time now) {
+  std::vector<OneshotClosure*> starts;
+  while (!by_size_.empty()) {
+    uint64_t seq = by_size_.begin()->second;
+    const auto& oldest = *by_arrival_.begin();
+    const bool aged = oldest.first != seq &&
+                      now - oldest.second.enqueue_time >= max_queue_wait_;
+    if (aged) {
+      // Don't let smaller uploads pass it any more, even if it means
+      // waiting for the budget to drain.
+      seq = oldest.first;
+    }
+    auto found = by_arrival_.find(seq);
+    const Waiter waiter = found->second;
+    if (!FitsUnlocked(waiter.size)) {
+      break;
+    }
+    if (aged) {
+      ++num_aged_;
+    }
+    by_size_.erase(std::make_pair(waiter.size, seq));
+    by_arrival_.erase(found);
+    AdmitUnlocked(waiter.size);
+    const absl::Duration wait = now - waiter.enqueue_time;
+    VLOG(2) << "upload size=" << waiter.size << " waited " << wait;
+    total_queue_wait_ += wait;
+    max_queue_wait_seen_ = std::max(max_queue_wait_seen_, wait);
+    starts.push_back(waiter.start);
+  }
+  return starts;
+}
+
+void UploadScheduler::AdmitUnlocked(size_t size) {
+  bytes_in_flight_ += size;
+  max_bytes_in_flight_seen_ =
+      std::max(max_bytes_in_flight_seen_, bytes_in_flight_);
+}
+
+bool UploadScheduler::FitsUnlocked(size_t size) const {
+  // Always let one upload go, however large it is.
+  return bytes_in_flight_ == 0 ||
+         bytes_in_flight_ + size <= max_bytes_in_flight_;
+}
+
+}  // namespace devtools_goma
@@ -0,0 +1,97 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DEVTOOLS_GOMA_CLIENT_UPLOAD_SCHEDULER_H_
+#define DEVTOOLS_GOMA_CLIENT_UPLOAD_SCHEDULER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/time/time.h"
+#include "callback.h"
+#include "compiler_specific.h"
+#include "lockhelper.h"
+
+MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
+#include "lib/goma_stats.pb.h"
+MSVC_POP_WARNING()
+
+namespace devtools_goma {
+
+// UploadScheduler limits the number of bytes being uploaded to the goma
+// server at once, so that a few large uploads don't fill the uplink while
+// small uploads that compiles are waiting for are stuck behind them.
+//
+// When the budget is used up, uploads wait in a queue and are started
+// shortest first. Admission never blocks: a queued upload is started by a
+// closure, run by the thread that releases enough budget. An upload that
+// has waited for |max_queue_wait| or more is started before any other,
+// even if it is large, so it won't starve.
+// An upload larger than the budget is started when nothing else is in
+// flight.
+//
+// This class is thread-safe.
+class UploadScheduler {
+ public:
+  UploadScheduler(size_t max_bytes_in_flight, absl::Duration max_queue_wait);
+
+  UploadScheduler(const UploadScheduler&) = delete;
+  UploadScheduler& operator=(const UploadScheduler&) = delete;
+
+  // Runs |start| once an upload of |size| bytes can be started, either
+  // before returning or later in Release() called on another thread.
+  // |start| must not block. Release(|size|) must be called when the upload
+  // has finished.
+  void Acquire(size_t size, OneshotClosure* start);
+  void Release(size_t size);
+
+  size_t max_bytes_in_flight() const { return max_bytes_in_flight_; }
+  size_t bytes_in_flight() const;
+  size_t num_queued() const;
+
+  void DumpStatsToProto(UploadSchedulerStats* stats) const;
+
+ private:
+  struct Waiter {
+    size_t size;
+    absl::Time enqueue_time;
+    OneshotClosure* start;
+  };
+
+  // Admits queued uploads while the budget allows, and returns closures to
+  // start them. They must be run after |mu_| is released.
+  std::vector<OneshotClosure*> DispatchUnlocked(absl::Time now)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void AdmitUnlocked(size_t size) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  bool FitsUnlocked(size_t size) const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const size_t max_bytes_in_flight_;
+  const absl::Duration max_queue_wait_;
+
+  mutable Lock mu_;
+  size_t bytes_in_flight_ ABSL_GUARDED_BY(mu_) = 0;
+  uint64_t next_seq_ ABSL_GUARDED_BY(mu_) = 0;
+  // (size, seq) of waiters, i.e. shortest first.
+  std::set<std::pair<size_t, uint64_t>> by_size_ ABSL_GUARDED_BY(mu_);
+  // Waiters by seq, i.e. oldest first.
+  std::map<uint64_t, Waiter> by_arrival_ ABSL_GUARDED_BY(mu_);
+
+  // Stats.
+  size_t max_bytes_in_flight_seen_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t num_uploads_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t num_waited_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t num_aged_ ABSL_GUARDED_BY(mu_) = 0;
+  absl::Duration total_queue_wait_ ABSL_GUARDED_BY(mu_);
+  absl::Duration max_queue_wait_seen_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace devtools_goma
+
+#endif  // DEVTOOLS_GOMA_CLIENT_UPLOAD_SCHEDULER_H_
@@ -0,0 +1,125 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "upload_scheduler.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "callback.h"
+#include "gtest/gtest.h"
+
+namespace devtools_goma {
+
+namespace {
+
+// Uploads record the order they were started in, and finish immediately.
+class UploadLog {
+ public:
+  explicit UploadLog(UploadScheduler* scheduler) : scheduler_(scheduler) {}
+
+  OneshotClosure* NewStart(size_t size) {
+    return NewCallback(this, &UploadLog::Start, size);
+  }
+
+  const std::vector<size_t>& sizes() const { return sizes_; }
+
+ private:
+  void Start(size_t size) {
+    sizes_.push_back(size);
+    scheduler_->Release(size);
+  }
+
+  UploadScheduler* scheduler_;
+  std::vector<size_t> sizes_;
+};
+
+void Noop() {}
+
+// Queues uploads of |sizes| in order while the whole budget is used by
+// another upload, then releases it, and returns the order uploads started.
+std::vector<size_t> ReplayQueue(UploadScheduler* scheduler,
+                                const std::vector<size_t>& sizes) {
+  UploadLog log(scheduler);
+  scheduler->Acquire(scheduler->max_bytes_in_flight(), NewCallback(&Noop));
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    scheduler->Acquire(sizes[i], log.NewStart(sizes[i]));
+    EXPECT_EQ(i + 1, scheduler->num_queued());
+  }
+  EXPECT_TRUE(log.sizes().empty());
+  scheduler->Release(scheduler->max_bytes_in_flight());
+  EXPECT_EQ(0U, scheduler->num_queued());
+  return log.sizes();
+}
+
+}  // namespace
+
+TEST(UploadSchedulerTest, Basic) {
+  UploadScheduler scheduler(100, absl::Seconds(10));
+  UploadLog log(&scheduler);
+  scheduler.Acquire(30, NewCallback(&Noop));
+  scheduler.Acquire(70, NewCallback(&Noop));
+  EXPECT_EQ(100U, scheduler.bytes_in_flight());
+
+  // Started in Release() of the upload making room.
+  scheduler.Acquire(20, log.NewStart(20));
+  EXPECT_EQ(1U, scheduler.num_queued());
+  scheduler.Release(30);
+  EXPECT_EQ(std::vector<size_t>({20}), log.sizes());
+  scheduler.Release(70);
+  EXPECT_EQ(0U, scheduler.bytes_in_flight());
+
+  // Larger than the budget, but nothing else is in flight.
+  scheduler.Acquire(1000, log.NewStart(1000));
+  EXPECT_EQ(std::vector<size_t>({20, 1000}), log.sizes());
+  EXPECT_EQ(0U, scheduler.bytes_in_flight());
+
+  UploadSchedulerStats stats;
+  scheduler.DumpStatsToProto(&stats);
+  EXPECT_EQ(100, stats.max_bytes_in_flight());
+  EXPECT_EQ(0, stats.bytes_in_flight());
+  EXPECT_EQ(1000, stats.max_bytes_in_flight_seen());
+  EXPECT_EQ(0, stats.queued());
+  EXPECT_EQ(4, stats.uploads());
+  EXPECT_EQ(1, stats.waited());
+}
+
+TEST(UploadSchedulerTest, ShortestFirst) {
+  // Each upload takes more than half of the budget, so they go one by one.
+  UploadScheduler scheduler(100, absl::InfiniteDuration());
+  EXPECT_EQ(std::vector<size_t>({60, 70, 90, 1000}),
+            ReplayQueue(&scheduler, {1000, 90, 60, 70}));
+
+  UploadSchedulerStats stats;
+  scheduler.DumpStatsToProto(&stats);
+  EXPECT_EQ(0, stats.bytes_in_flight());
+  EXPECT_EQ(5, stats.uploads());
+  EXPECT_EQ(4, stats.waited());
+  EXPECT_EQ(0, stats.aged());
+}
+
+TEST(UploadSchedulerTest, SmallUploadsShareBudget) {
+  UploadScheduler scheduler(100, absl::InfiniteDuration());
+  std::vector<size_t> sizes = ReplayQueue(&scheduler, {10, 20, 30, 40});
+  std::sort(sizes.begin(), sizes.end());
+  EXPECT_EQ(std::vector<size_t>({10, 20, 30, 40}), sizes);
+
+  UploadSchedulerStats stats;
+  scheduler.DumpStatsToProto(&stats);
+  EXPECT_EQ(100, stats.max_bytes_in_flight_seen());
+}
+
+TEST(UploadSchedulerTest, Aging) {
+  // Every queued upload is old enough to go first, so uploads start in
+  // arrival order.
+  UploadScheduler scheduler(100, absl::ZeroDuration());
+  EXPECT_EQ(std::vector<size_t>({1000, 90, 60, 70}),
+            ReplayQueue(&scheduler, {1000, 90, 60, 70}));
+
+  UploadSchedulerStats stats;
+  scheduler.DumpStatsToProto(&stats);
+  EXPECT_EQ(2, stats.aged());
+}
+
+}  // namespace devtools_goma
@@ -5,10 +5,17 @@
 #ifndef DEVTOOLS_GOMA_CLIENT_VALUE_ID_TABLE_H_
 #define DEVTOOLS_GOMA_CLIENT_VALUE_ID_TABLE_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <vector>
 
 #include "absl/base/thread_annotations.h"
-#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
+#include "absl/numeric/bits.h"
 #include "autolock_timer.h"
 #include "glog/logging.h"
 
@@ -18,50 +25,357 @@ namespace devtools_goma {
 // have multiple instances of the same value and that can be used to reduce
 // memory usage by using issued IDs instead of holding multiple instances of the
 // same value in memory. This class is thread-safe.
-template <typename T>
+//
+// The table is append-only: lookups (ID -> value and value -> ID) never take
+// a lock, and only insertions are serialized with each other.
+// Clear() frees the cleared values once no lookup is reading them, so
+// lookups return a copy of the value rather than a reference.
+template <typename T, typename Hash = absl::Hash<T>>
 class ValueIDTable {
  public:
   using Id = int;
 
+  static constexpr Id kInvalidId = -1;
+
+  ValueIDTable() {
+    AUTOLOCK(lock, &mu_);
+    current_gen_ = NewGeneration();
+    current_.store(current_gen_.get(), std::memory_order_seq_cst);
+  }
+
+  ValueIDTable(const ValueIDTable&) = delete;
+  ValueIDTable& operator=(const ValueIDTable&) = delete;
+
   // GetId returns the ID of given |value|. If |value| is not stored, new ID is
   // returned.
-  Id GetId(const T& value) ABSL_LOCKS_EXCLUDED(&mu_) {
+  Id GetId(const T& value) ABSL_LOCKS_EXCLUDED(mu_) {
+    const size_t hash = Hash()(value);
     {
-      AUTO_SHARED_LOCK(lock, &mu_);
-      auto v = map_to_id_.find(value);
-      if (v != map_to_id_.end()) {
-        return v->second;
+      ReaderScope reader(this);
+      Id id = FindIn(*reader.generation(), value, hash);
+      if (id != kInvalidId) {
+        return id;
       }
     }
 
-    AUTO_EXCLUSIVE_LOCK(lock, &mu_);
-    auto v = map_to_id_.try_emplace(value, values_.size());
-    if (v.second) {
-      values_.push_back(value);
+    AUTOLOCK(lock, &mu_);
+    Generation* gen = current_gen_.get();
+    Id id = FindIn(*gen, value, hash);
+    if (id != kInvalidId) {
+      return id;
+    }
+    id = gen->next_id;
+    InsertUnlocked(gen, value, hash, id);
+    MaybeFreeRetiredUnlocked();
+    return id;
+  }
+
+  // InsertWithId stores |value| with the given |id|, e.g. when restoring a
+  // table from disk. Returns false if |id| is negative, or if either |id| or
+  // |value| is already stored with a different counterpart. Later IDs issued
+  // by GetId() are larger than any ID inserted here.
+  bool InsertWithId(const T& value, Id id) ABSL_LOCKS_EXCLUDED(mu_) {
+    if (id < 0 || id >= kMaxId) {
+      return false;
+    }
+    const size_t hash = Hash()(value);
+
+    AUTOLOCK(lock, &mu_);
+    Generation* gen = current_gen_.get();
+    const Id stored_id = FindIn(*gen, value, hash);
+    if (stored_id != kInvalidId) {
+      return stored_id == id;
     }
-    return v.first->second;
+    if (LookupIn(*gen, id) != nullptr) {
+      return false;
+    }
+    InsertUnlocked(gen, value, hash, id);
+    MaybeFreeRetiredUnlocked();
+    return true;
+  }
+
+  // FindId returns the ID of given |value|, or kInvalidId if |value| is not
+  // stored.
+  Id FindId(const T& value) const {
+    ReaderScope reader(this);
+    return FindIn(*reader.generation(), value, Hash()(value));
+  }
+
+  // GetValue returns a copy of the corresponding value for the given ID.
+  // |id| must have been issued.
+  T GetValue(const Id id) const {
+    T value;
+    const bool found = CopyValue(id, &value);
+    DCHECK(found) << id;
+    return value;
   }
 
-  // GetValue returns the corresponding value for the given ID.
-  T GetValue(const Id id) const ABSL_LOCKS_EXCLUDED(&mu_) {
-    AUTO_SHARED_LOCK(lock, &mu_);
-    DCHECK_LT(id, values_.size());
-    return values_[id];
+  // CopyValue copies the corresponding value for the given ID to |value|.
+  // Returns false if |id| has not been issued.
+  bool CopyValue(const Id id, T* value) const {
+    ReaderScope reader(this);
+    const T* stored = LookupIn(*reader.generation(), id);
+    if (stored == nullptr) {
+      return false;
+    }
+    *value = *stored;
+    return true;
+  }
+
+  // Size returns the number of stored values.
+  size_t Size() const {
+    ReaderScope reader(this);
+    return reader.generation()->size.load(std::memory_order_acquire);
   }
 
   // Clear removes all elements from ValueIDTable.
-  void Clear() ABSL_LOCKS_EXCLUDED(&mu_) {
-    AUTO_EXCLUSIVE_LOCK(lock, &mu_);
-    values_.clear();
-    map_to_id_.clear();
+  // Storage of removed elements is released as soon as no concurrent lookup
+  // is reading it; otherwise by a later insertion or Clear().
+  void Clear() ABSL_LOCKS_EXCLUDED(mu_) {
+    AUTOLOCK(lock, &mu_);
+    retired_.push_back(std::move(current_gen_));
+    current_gen_ = NewGeneration();
+    current_.store(current_gen_.get(), std::memory_order_seq_cst);
+    MaybeFreeRetiredUnlocked();
+  }
+
+  // Returns the number of cleared generations not freed yet.
+  size_t NumRetiredForTest() const ABSL_LOCKS_EXCLUDED(mu_) {
+    AUTOLOCK(lock, &mu_);
+    return retired_.size();
   }
 
  private:
-  mutable ReadWriteLock mu_;
-  std::vector<T> values_ ABSL_GUARDED_BY(mu_);
-  absl::flat_hash_map<T, Id> map_to_id_ ABSL_GUARDED_BY(mu_);
+  // ID -> value slots are kept in segments whose size doubles, so that
+  // a segment never moves once it is published. Segment k holds
+  // kFirstSegmentSize << k slots.
+  static constexpr int kFirstSegmentBits = 6;
+  static constexpr size_t kFirstSegmentSize = size_t{1} << kFirstSegmentBits;
+  static constexpr int kNumSegments = 31 - kFirstSegmentBits;
+  static constexpr Id kMaxId = static_cast<Id>(
+      kFirstSegmentSize * ((uint64_t{1} << kNumSegments) - 1));
+  static constexpr size_t kInitialIndexCapacity = 64;
+
+  static constexpr size_t kNumReaderStripes = 16;
+
+  using Slot = std::atomic<const T*>;
+
+  // Open addressing hash index for value -> ID lookup. Each entry packs
+  // the upper 32 bits of the hash (to skip most value comparisons) and
+  // ID + 1; 0 means an empty entry. An index is never modified except for
+  // filling empty entries; it is replaced by a larger copy when it gets
+  // half full.
+  struct Index {
+    explicit Index(size_t capacity)
+        : mask(capacity - 1), entries(new std::atomic<uint64_t>[capacity]) {
+      DCHECK(absl::has_single_bit(capacity)) << capacity;
+      for (size_t i = 0; i < capacity; ++i) {
+        entries[i].store(0, std::memory_order_relaxed);
+      }
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    const size_t mask;
+    std::unique_ptr<std::atomic<uint64_t>[]> entries;
+  };
+
+  // Generation holds everything Clear() drops at once.
+  struct Generation {
+    Generation() {
+      for (auto& segment : segments) {
+        segment.store(nullptr, std::memory_order_relaxed);
+      }
+    }
+
+    std::atomic<Slot*> segments[kNumSegments];
+    std::atomic<const Index*> index{nullptr};
+    std::atomic<size_t> size{0};
+
+    // Below are only accessed by writers holding |mu_|.
+    // std::deque::push_back never moves existing elements.
+    std::deque<T> values;
+    std::vector<std::unique_ptr<Slot[]>> segment_storage;
+    // The last one is the current |index|. Older ones are kept alive for
+    // readers that may still probe them.
+    std::vector<std::unique_ptr<Index>> indexes;
+    size_t num_index_entries = 0;
+    Id next_id = 0;
+  };
+
+  // Number of lookups in progress. Striped to avoid contention among
+  // readers on different threads.
+  struct alignas(64) ReaderStripe {
+    std::atomic<int> count{0};
+  };
+
+  // ReaderScope marks a lookup in progress during its lifetime, and gives
+  // the current generation, which Clear() won't free until the scope ends.
+  // The counter is incremented before current_ is loaded, and Clear()
+  // checks counters after storing new current_ (both seq_cst), so a reader
+  // not counted by Clear() never sees the retired generation.
+  class ReaderScope {
+   public:
+    explicit ReaderScope(const ValueIDTable* table)
+        : count_(&table->readers_[StripeIndex()].count) {
+      count_->fetch_add(1, std::memory_order_seq_cst);
+      generation_ = table->current_.load(std::memory_order_seq_cst);
+    }
+    ~ReaderScope() { count_->fetch_sub(1, std::memory_order_release); }
+
+    ReaderScope(const ReaderScope&) = delete;
+    ReaderScope& operator=(const ReaderScope&) = delete;
+
+    const Generation* generation() const { return generation_; }
+
+   private:
+    static size_t StripeIndex() {
+      static std::atomic<size_t> next_index{0};
+      thread_local size_t index =
+          next_index.fetch_add(1, std::memory_order_relaxed) %
+          kNumReaderStripes;
+      return index;
+    }
+
+    std::atomic<int>* count_;
+    const Generation* generation_;
+  };
+
+  static void LocateSlot(Id id, int* segment, size_t* offset) {
+    const uint64_t n = (static_cast<uint64_t>(id) >> kFirstSegmentBits) + 1;
+    *segment = static_cast<int>(absl::bit_width(n)) - 1;
+    *offset = static_cast<size_t>(id) -
+              kFirstSegmentSize * ((size_t{1} << *segment) - 1);
+  }
+
+  static uint64_t EncodeEntry(size_t hash, Id id) {
+    return (static_cast<uint64_t>(hash) & 0xffffffff00000000ULL) |
+           static_cast<uint64_t>(id + 1);
+  }
+
+  static const T* LookupIn(const Generation& gen, Id id) {
+    if (id < 0 || id >= kMaxId) {
+      return nullptr;
+    }
+    int segment;
+    size_t offset;
+    LocateSlot(id, &segment, &offset);
+    const Slot* slots = gen.segments[segment].load(std::memory_order_acquire);
+    if (slots == nullptr) {
+      return nullptr;
+    }
+    return slots[offset].load(std::memory_order_acquire);
+  }
+
+  static Id FindIn(const Generation& gen, const T& value, size_t hash) {
+    const Index* index = gen.index.load(std::memory_order_acquire);
+    const uint64_t tag = EncodeEntry(hash, -1);
+    for (size_t pos = hash & index->mask;; pos = (pos + 1) & index->mask) {
+      const uint64_t entry =
+          index->entries[pos].load(std::memory_order_acquire);
+      if (entry == 0) {
+        return kInvalidId;
+      }
+      if ((entry ^ tag) >> 32 != 0) {
+        continue;
+      }
+      const Id id = static_cast<Id>(entry & 0xffffffffULL) - 1;
+      const T* stored = LookupIn(gen, id);
+      if (stored != nullptr && *stored == value) {
+        return id;
+      }
+    }
+  }
+
+  static void AddEntry(const Index* index, uint64_t entry, size_t hash) {
+    for (size_t pos = hash & index->mask;; pos = (pos + 1) & index->mask) {
+      if (index->entries[pos].load(std::memory_order_relaxed) == 0) {
+        index->entries[pos].store(entry, std::memory_order_release);
+        return;
+      }
+    }
+  }
+
+  static std::unique_ptr<Generation> NewGeneration() {
+    std::unique_ptr<Generation> gen(new Generation);
+    gen->indexes.emplace_back(new Index(kInitialIndexCapacity));
+    gen->index.store(gen->indexes.back().get(), std::memory_order_relaxed);
+    return gen;
+  }
+
+  // Frees retired generations if no lookup is in progress.
+  void MaybeFreeRetiredUnlocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (retired_.empty()) {
+      return;
+    }
+    for (const auto& stripe : readers_) {
+      if (stripe.count.load(std::memory_order_seq_cst) != 0) {
+        return;
+      }
+    }
+    retired_.clear();
+  }
+
+  void InsertUnlocked(Generation* gen, const T& value, size_t hash, Id id)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    CHECK_GE(id, 0);
+    CHECK_LT(id, kMaxId);
+
+    gen->values.push_back(value);
+    int segment;
+    size_t offset;
+    LocateSlot(id, &segment, &offset);
+    Slot* slots = gen->segments[segment].load(std::memory_order_relaxed);
+    if (slots == nullptr) {
+      const size_t segment_size = kFirstSegmentSize << segment;
+      gen->segment_storage.emplace_back(new Slot[segment_size]);
+      slots = gen->segment_storage.back().get();
+      for (size_t i = 0; i < segment_size; ++i) {
+        slots[i].store(nullptr, std::memory_order_relaxed);
+      }
+      gen->segments[segment].store(slots, std::memory_order_release);
+    }
+    slots[offset].store(&gen->values.back(), std::memory_order_release);
+
+    const Index* index = gen->indexes.back().get();
+    if ((gen->num_index_entries + 1) * 2 > index->capacity()) {
+      std::unique_ptr<Index> grown(new Index(index->capacity() * 2));
+      for (size_t i = 0; i < index->capacity(); ++i) {
+        const uint64_t entry =
+            index->entries[i].load(std::memory_order_relaxed);
+        if (entry == 0) {
+          continue;
+        }
+        const Id stored_id = static_cast<Id>(entry & 0xffffffffULL) - 1;
+        AddEntry(grown.get(), entry, Hash()(*LookupIn(*gen, stored_id)));
+      }
+      index = grown.get();
+      gen->indexes.push_back(std::move(grown));
+    }
+    AddEntry(index, EncodeEntry(hash, id), hash);
+    // Publish the grown index only after the new entry is in it, so readers
+    // switching to it never miss a value they could find in the old one.
+    gen->index.store(index, std::memory_order_release);
+    ++gen->num_index_entries;
+
+    if (id >= gen->next_id) {
+      gen->next_id = id + 1;
+    }
+    gen->size.store(gen->values.size(), std::memory_order_release);
+  }
+
+  // Serializes writers. Readers don't take any lock.
+  mutable Lock mu_;
+  std::atomic<Generation*> current_{nullptr};
+  std::unique_ptr<Generation> current_gen_ ABSL_GUARDED_BY(mu_);
+  // Generations dropped by Clear() that lookups might still read.
+  std::vector<std::unique_ptr<Generation>> retired_ ABSL_GUARDED_BY(mu_);
+  mutable ReaderStripe readers_[kNumReaderStripes];
 };
 
+template <typename T, typename Hash>
+constexpr typename ValueIDTable<T, Hash>::Id ValueIDTable<T, Hash>::kInvalidId;
+
 }  // namespace devtools_goma
 
 #endif  // DEVTOOLS_GOMA_CLIENT_VALUE_ID_TABLE_H_
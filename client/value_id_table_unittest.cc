@@ -4,8 +4,15 @@
 
 #include "value_id_table.h"
 
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <gtest/gtest.h>
 
+#include "absl/strings/str_cat.h"
+#include "platform_thread.h"
+
 namespace devtools_goma {
 
 TEST(ValueIDTableTest, Basic) {
@@ -34,4 +41,153 @@ TEST(ValueIDTableTest, Basic) {
   EXPECT_EQ(table.GetValue(id2), 18);
 }
 
+TEST(ValueIDTableTest, ClearFreesOldValues) {
+  ValueIDTable<std::string> table;
+
+  for (int i = 0; i < 10; ++i) {
+    table.GetId(absl::StrCat("value", i));
+    table.Clear();
+    // No lookup is in progress, so the cleared values are freed at once.
+    EXPECT_EQ(0U, table.NumRetiredForTest());
+  }
+  EXPECT_EQ(0U, table.Size());
+  EXPECT_EQ(ValueIDTable<std::string>::kInvalidId, table.FindId("value0"));
+}
+
+TEST(ValueIDTableTest, FindWithoutInsert) {
+  ValueIDTable<std::string> table;
+
+  std::string value;
+  EXPECT_EQ(ValueIDTable<std::string>::kInvalidId, table.FindId("a"));
+  EXPECT_FALSE(table.CopyValue(0, &value));
+  EXPECT_EQ(0U, table.Size());
+
+  auto id = table.GetId("a");
+  EXPECT_EQ(id, table.FindId("a"));
+  ASSERT_TRUE(table.CopyValue(id, &value));
+  EXPECT_EQ("a", value);
+  EXPECT_FALSE(table.CopyValue(id + 1, &value));
+  EXPECT_FALSE(table.CopyValue(-1, &value));
+  EXPECT_EQ(1U, table.Size());
+}
+
+TEST(ValueIDTableTest, InsertWithId) {
+  ValueIDTable<std::string> table;
+
+  EXPECT_TRUE(table.InsertWithId("a", 3));
+  EXPECT_TRUE(table.InsertWithId("b", 100));
+  // Same pair can be inserted again.
+  EXPECT_TRUE(table.InsertWithId("a", 3));
+  // Conflicting id or value.
+  EXPECT_FALSE(table.InsertWithId("a", 4));
+  EXPECT_FALSE(table.InsertWithId("c", 100));
+  EXPECT_FALSE(table.InsertWithId("c", -1));
+
+  EXPECT_EQ(3, table.FindId("a"));
+  EXPECT_EQ(100, table.FindId("b"));
+  EXPECT_EQ("a", table.GetValue(3));
+  EXPECT_EQ("b", table.GetValue(100));
+  std::string value;
+  EXPECT_FALSE(table.CopyValue(0, &value));
+  EXPECT_EQ(2U, table.Size());
+
+  // New id is larger than any inserted id.
+  EXPECT_EQ(101, table.GetId("c"));
+}
+
+TEST(ValueIDTableTest, ManyValues) {
+  ValueIDTable<std::string> table;
+  constexpr int kNumValues = 100000;
+
+  for (int i = 0; i < kNumValues; ++i) {
+    EXPECT_EQ(i, table.GetId(absl::StrCat("value", i)));
+  }
+  EXPECT_EQ(static_cast<size_t>(kNumValues), table.Size());
+
+  for (int i = 0; i < kNumValues; ++i) {
+    const std::string value = absl::StrCat("value", i);
+    EXPECT_EQ(i, table.FindId(value));
+    EXPECT_EQ(value, table.GetValue(i));
+  }
+}
+
+namespace {
+
+class GetIdThread : public PlatformThread::Delegate {
+ public:
+  GetIdThread(ValueIDTable<std::string>* table, int num_values)
+      : table_(table), num_values_(num_values), ids_(num_values) {}
+
+  void ThreadMain() override {
+    for (int i = 0; i < num_values_; ++i) {
+      ids_[i] = table_->GetId(absl::StrCat("value", i));
+      std::string value;
+      if (!table_->CopyValue(ids_[i], &value) ||
+          value != absl::StrCat("value", i)) {
+        ids_[i] = ValueIDTable<std::string>::kInvalidId;
+      }
+    }
+  }
+
+  const std::vector<ValueIDTable<std::string>::Id>& ids() const {
+    return ids_;
+  }
+
+ private:
+  ValueIDTable<std::string>* table_;
+  const int num_values_;
+  std::vector<ValueIDTable<std::string>::Id> ids_;
+};
+
+}  // namespace
+
+TEST(ValueIDTableTest, ConcurrentGetId) {
+  constexpr int kNumThreads = 8;
+  constexpr int kNumValues = 10000;
+  ValueIDTable<std::string> table;
+
+  std::vector<std::unique_ptr<GetIdThread>> threads;
+  std::vector<PlatformThreadHandle> handles(kNumThreads);
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back(new GetIdThread(&table, kNumValues));
+    PlatformThread::Create(threads.back().get(), &handles[i]);
+  }
+  for (int i = 0; i < kNumThreads; ++i) {
+    PlatformThread::Join(handles[i]);
+  }
+
+  EXPECT_EQ(static_cast<size_t>(kNumValues), table.Size());
+  for (const auto& thread : threads) {
+    EXPECT_EQ(threads[0]->ids(), thread->ids());
+  }
+  for (int i = 0; i < kNumValues; ++i) {
+    EXPECT_NE(ValueIDTable<std::string>::kInvalidId, threads[0]->ids()[i]);
+  }
+}
+
+TEST(ValueIDTableTest, ConcurrentClear) {
+  constexpr int kNumThreads = 4;
+  constexpr int kNumValues = 10000;
+  ValueIDTable<std::string> table;
+
+  std::vector<std::unique_ptr<GetIdThread>> threads;
+  std::vector<PlatformThreadHandle> handles(kNumThreads);
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back(new GetIdThread(&table, kNumValues));
+    PlatformThread::Create(threads.back().get(), &handles[i]);
+  }
+  for (int i = 0; i < 100; ++i) {
+    table.Clear();
+  }
+  for (int i = 0; i < kNumThreads; ++i) {
+    PlatformThread::Join(handles[i]);
+  }
+
+  // Generations retired while lookups were running are freed by the next
+  // Clear() without readers.
+  table.Clear();
+  EXPECT_EQ(0U, table.NumRetiredForTest());
+  EXPECT_EQ(0U, table.Size());
+}
+
 }  // namespace devtools_goma
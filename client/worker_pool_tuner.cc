@@ -0,0 +1,118 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "worker_pool_tuner.h"
+
+#include <algorithm>
+
+#include "glog/logging.h"
+
+namespace devtools_goma {
+
+constexpr absl::Duration WorkerPoolTuner::kGrowQueueWait;
+constexpr absl::Duration WorkerPoolTuner::kIdleQueueWait;
+constexpr int WorkerPoolTuner::kIdleSamplesToShrink;
+
+WorkerPoolTuner::WorkerPoolTuner(int min_threads,
+                                 int max_threads,
+                                 int num_cpus)
+    : min_threads_(std::max(1, min_threads)),
+      max_threads_(std::max(min_threads_, max_threads)),
+      num_cpus_(num_cpus),
+      active_threads_(max_threads_),
+      lowest_active_threads_(max_threads_) {}
+
+bool WorkerPoolTuner::IsCpuSaturated(const Sample& sample) const {
+  if (num_cpus_ <= 0) {
+    return false;
+  }
+  // runnable_threads is a snapshot, so it is preferred to load average,
+  // which follows the change too slowly for build phases.
+  double load = sample.runnable_threads;
+  if (load < 0) {
+    load = sample.load_average;
+  }
+  if (load <= num_cpus_) {
+    return false;
+  }
+  // Busy threads of this pool are also counted in |load|. CPU is saturated
+  // when the others need more CPUs than those left for |min_threads_|.
+  return load - sample.busy_threads > num_cpus_ - min_threads_;
+}
+
+WorkerPoolTuner::Decision WorkerPoolTuner::Update(const Sample& sample) {
+  last_sample_ = sample;
+
+  const bool idle =
+      sample.pendings == 0 && sample.queue_wait < kIdleQueueWait;
+  if (idle) {
+    ++num_idle_samples_;
+  } else {
+    num_idle_samples_ = 0;
+  }
+
+  if (IsCpuSaturated(sample)) {
+    // Other processes (e.g. local compiles) compete for CPU. Adding threads
+    // won't make closures run faster, so give CPU back to them.
+    if (active_threads_ > min_threads_) {
+      --active_threads_;
+      lowest_active_threads_ =
+          std::min(lowest_active_threads_, active_threads_);
+      ++num_shrink_cpu_;
+      return kShrinkCpu;
+    }
+    return kHold;
+  }
+
+  if (sample.pendings > 0 && sample.queue_wait >= kGrowQueueWait &&
+      active_threads_ < max_threads_) {
+    // Grow faster than shrink, since waiting closures block compiles.
+    const int step = std::max(1, active_threads_ / 4);
+    active_threads_ = std::min(max_threads_, active_threads_ + step);
+    ++num_grow_;
+    return kGrow;
+  }
+
+  if (num_idle_samples_ >= kIdleSamplesToShrink &&
+      active_threads_ > min_threads_) {
+    --active_threads_;
+    lowest_active_threads_ = std::min(lowest_active_threads_, active_threads_);
+    num_idle_samples_ = 0;
+    ++num_shrink_idle_;
+    return kShrinkIdle;
+  }
+  return kHold;
+}
+
+void WorkerPoolTuner::DumpStatsToProto(AdaptivePoolStats* stats) const {
+  stats->set_min_threads(min_threads_);
+  stats->set_max_threads(max_threads_);
+  stats->set_active_threads(active_threads_);
+  stats->set_lowest_active_threads(lowest_active_threads_);
+  stats->set_grow(num_grow_);
+  stats->set_shrink_idle(num_shrink_idle_);
+  stats->set_shrink_cpu(num_shrink_cpu_);
+  stats->set_last_queue_wait_us(
+      absl::ToInt64Microseconds(last_sample_.queue_wait));
+  stats->set_last_pendings(last_sample_.pendings);
+  stats->set_last_runnable_threads(last_sample_.runnable_threads);
+  stats->set_last_load_average(last_sample_.load_average);
+}
+
+/* static */
+const char* WorkerPoolTuner::DecisionName(Decision decision) {
+  switch (decision) {
+    case kHold:
+      return "hold";
+    case kGrow:
+      return "grow";
+    case kShrinkIdle:
+      return "shrink_idle";
+    case kShrinkCpu:
+      return "shrink_cpu";
+  }
+  return "unknown";
+}
+
+}  // namespace devtools_goma
@@ -0,0 +1,94 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DEVTOOLS_GOMA_CLIENT_WORKER_POOL_TUNER_H_
+#define DEVTOOLS_GOMA_CLIENT_WORKER_POOL_TUNER_H_
+
+#include <stdint.h>
+
+#include "absl/time/time.h"
+#include "basictypes.h"
+#include "compiler_specific.h"
+
+MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
+#include "lib/goma_stats.pb.h"
+MSVC_POP_WARNING()
+
+namespace devtools_goma {
+
+// WorkerPoolTuner decides the number of active threads of a worker pool
+// from periodic samples of the pool and the machine.
+//
+// The pool grows while closures wait in its queues and CPU has room.
+// It shrinks when it has been idle for a while, or when other threads of
+// the machine (e.g. local compiles) need more CPUs than those left for
+// |min_threads|, down to |min_threads|.
+// It starts with |max_threads| active.
+//
+// This class is thread-unsafe.
+class WorkerPoolTuner {
+ public:
+  struct Sample {
+    // Number of closures waiting in the pool.
+    int64_t pendings = 0;
+    // Number of threads of the pool running a closure now.
+    int busy_threads = 0;
+    // Average time closures waited in the queue since the last sample.
+    absl::Duration queue_wait;
+    // Number of runnable threads of the machine. -1 if unknown.
+    int runnable_threads = -1;
+    // 1 minute load average of the machine. negative if unknown.
+    double load_average = -1.0;
+  };
+
+  enum Decision {
+    kHold,
+    kGrow,
+    kShrinkIdle,
+    kShrinkCpu,
+  };
+
+  // The pool grows if closures waited this long or more in the queue.
+  static constexpr absl::Duration kGrowQueueWait = absl::Milliseconds(10);
+  // The pool is idle if closures waited less than this.
+  static constexpr absl::Duration kIdleQueueWait = absl::Milliseconds(1);
+  // Number of consecutive idle samples to shrink the pool.
+  static constexpr int kIdleSamplesToShrink = 3;
+
+  // |num_cpus| <= 0 means unknown, and CPU load is not considered.
+  WorkerPoolTuner(int min_threads, int max_threads, int num_cpus);
+
+  // Updates active_threads() from |sample|, and returns the decision.
+  Decision Update(const Sample& sample);
+
+  int min_threads() const { return min_threads_; }
+  int max_threads() const { return max_threads_; }
+  int active_threads() const { return active_threads_; }
+
+  void DumpStatsToProto(AdaptivePoolStats* stats) const;
+
+  static const char* DecisionName(Decision decision);
+
+ private:
+  bool IsCpuSaturated(const Sample& sample) const;
+
+  const int min_threads_;
+  const int max_threads_;
+  const int num_cpus_;
+
+  int active_threads_;
+  int lowest_active_threads_;
+  int num_idle_samples_ = 0;
+
+  int64_t num_grow_ = 0;
+  int64_t num_shrink_idle_ = 0;
+  int64_t num_shrink_cpu_ = 0;
+  Sample last_sample_;
+
+  DISALLOW_COPY_AND_ASSIGN(WorkerPoolTuner);
+};
+
+}  // namespace devtools_goma
+
+#endif  // DEVTOOLS_GOMA_CLIENT_WORKER_POOL_TUNER_H_
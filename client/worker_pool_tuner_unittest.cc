@@ -0,0 +1,127 @@
+// Copyright 2022 The Goma Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "worker_pool_tuner.h"
+
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+
+namespace devtools_goma {
+
+namespace {
+
+WorkerPoolTuner::Sample BusySample(int64_t pendings) {
+  WorkerPoolTuner::Sample sample;
+  sample.pendings = pendings;
+  sample.queue_wait = absl::Milliseconds(50);
+  sample.runnable_threads = 2;
+  return sample;
+}
+
+WorkerPoolTuner::Sample IdleSample() {
+  WorkerPoolTuner::Sample sample;
+  sample.runnable_threads = 1;
+  return sample;
+}
+
+}  // namespace
+
+TEST(WorkerPoolTunerTest, ShrinkWhenIdle) {
+  WorkerPoolTuner tuner(2, 8, 16);
+  EXPECT_EQ(8, tuner.active_threads());
+
+  for (int i = 1; i < WorkerPoolTuner::kIdleSamplesToShrink; ++i) {
+    EXPECT_EQ(WorkerPoolTuner::kHold, tuner.Update(IdleSample()));
+  }
+  EXPECT_EQ(WorkerPoolTuner::kShrinkIdle, tuner.Update(IdleSample()));
+  EXPECT_EQ(7, tuner.active_threads());
+
+  // A busy sample resets idle samples.
+  for (int i = 1; i < WorkerPoolTuner::kIdleSamplesToShrink; ++i) {
+    EXPECT_EQ(WorkerPoolTuner::kHold, tuner.Update(IdleSample()));
+  }
+  WorkerPoolTuner::Sample sample = BusySample(1);
+  sample.queue_wait = absl::Milliseconds(5);
+  EXPECT_EQ(WorkerPoolTuner::kHold, tuner.Update(sample));
+  EXPECT_EQ(WorkerPoolTuner::kHold, tuner.Update(IdleSample()));
+  EXPECT_EQ(7, tuner.active_threads());
+
+  for (int i = 0; i < 100; ++i) {
+    tuner.Update(IdleSample());
+  }
+  EXPECT_EQ(2, tuner.active_threads());
+}
+
+TEST(WorkerPoolTunerTest, GrowWhenWaiting) {
+  WorkerPoolTuner tuner(1, 10, 16);
+  for (int i = 0; i < 100; ++i) {
+    tuner.Update(IdleSample());
+  }
+  ASSERT_EQ(1, tuner.active_threads());
+
+  EXPECT_EQ(WorkerPoolTuner::kGrow, tuner.Update(BusySample(4)));
+  EXPECT_EQ(2, tuner.active_threads());
+  // Grows by a quarter of active threads, at least 1.
+  for (int i = 0; i < 3; ++i) {
+    tuner.Update(BusySample(4));
+  }
+  EXPECT_EQ(5, tuner.active_threads());
+  for (int i = 0; i < 100; ++i) {
+    tuner.Update(BusySample(4));
+  }
+  EXPECT_EQ(10, tuner.active_threads());
+  EXPECT_EQ(WorkerPoolTuner::kHold, tuner.Update(BusySample(4)));
+
+  // No pendings, no need to grow.
+  WorkerPoolTuner idle_tuner(1, 10, 16);
+  for (int i = 0; i < 100; ++i) {
+    idle_tuner.Update(IdleSample());
+  }
+  WorkerPoolTuner::Sample sample = BusySample(0);
+  EXPECT_EQ(WorkerPoolTuner::kHold, idle_tuner.Update(sample));
+  EXPECT_EQ(1, idle_tuner.active_threads());
+}
+
+TEST(WorkerPoolTunerTest, ShrinkWhenCpuSaturated) {
+  WorkerPoolTuner tuner(2, 4, 8);
+
+  // This pool's busy threads alone don't saturate CPU.
+  WorkerPoolTuner::Sample sample = BusySample(4);
+  sample.runnable_threads = 10;
+  sample.busy_threads = 4;
+  EXPECT_EQ(WorkerPoolTuner::kHold, tuner.Update(sample));
+  EXPECT_EQ(4, tuner.active_threads());
+
+  // Local compiles use CPUs.
+  sample.runnable_threads = 12;
+  sample.busy_threads = 4;
+  EXPECT_EQ(WorkerPoolTuner::kShrinkCpu, tuner.Update(sample));
+  EXPECT_EQ(3, tuner.active_threads());
+  EXPECT_EQ(WorkerPoolTuner::kShrinkCpu, tuner.Update(sample));
+  EXPECT_EQ(2, tuner.active_threads());
+  EXPECT_EQ(WorkerPoolTuner::kHold, tuner.Update(sample));
+  EXPECT_EQ(2, tuner.active_threads());
+
+  // Falls back to load average.
+  sample.runnable_threads = -1;
+  sample.load_average = 3.0;
+  EXPECT_EQ(WorkerPoolTuner::kGrow, tuner.Update(sample));
+  EXPECT_EQ(3, tuner.active_threads());
+
+  AdaptivePoolStats stats;
+  tuner.DumpStatsToProto(&stats);
+  EXPECT_EQ(2, stats.min_threads());
+  EXPECT_EQ(4, stats.max_threads());
+  EXPECT_EQ(3, stats.active_threads());
+  EXPECT_EQ(2, stats.lowest_active_threads());
+  EXPECT_EQ(1, stats.grow());
+  EXPECT_EQ(0, stats.shrink_idle());
+  EXPECT_EQ(2, stats.shrink_cpu());
+  EXPECT_EQ(50000, stats.last_queue_wait_us());
+  EXPECT_EQ(4, stats.last_pendings());
+  EXPECT_EQ(-1, stats.last_runnable_threads());
+  EXPECT_EQ(3.0, stats.last_load_average());
+}
+
+}  // namespace devtools_goma
@@ -237,6 +237,8 @@ WorkerThread::WorkerThread(int pool, std::string name)
     max_queuelen_[priority] = 0;
     max_wait_time_[priority] = absl::ZeroDuration();
   }
+  total_wait_time_ = absl::ZeroDuration();
+  num_dequeued_ = 0;
 }
 
 WorkerThread::~WorkerThread() {
@@ -477,6 +479,13 @@ size_t WorkerThread::pendings() const {
   return n;
 }
 
+void WorkerThread::GetQueueWaitStats(absl::Duration* total_wait_time,
+                                     int64_t* num_dequeued) const {
+  AUTOLOCK(lock, &mu_);
+  *total_wait_time = total_wait_time_;
+  *num_dequeued = num_dequeued_;
+}
+
 bool WorkerThread::IsIdle() const {
   AUTOLOCK(lock, &mu_);
   return !current_closure_data_ && descriptors_.size() == 0;
@@ -680,6 +689,8 @@ WorkerThread::ClosureData WorkerThread::GetClosure(Priority priority) {
   if (wait_time > max_wait_time_[priority]) {
     max_wait_time_[priority] = wait_time;
   }
+  total_wait_time_ += wait_time;
+  ++num_dequeued_;
   if (wait_time > absl::Minutes(1)) {
     LOG(WARNING) << id() << " too long in pending queue "
                  << Priority_Name(priority) << " " << wait_time
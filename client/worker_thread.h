@@ -192,6 +192,11 @@ class WorkerThread : public PlatformThread::Delegate {
   size_t load() const ABSL_LOCKS_EXCLUDED(mu_);
   size_t pendings() const ABSL_LOCKS_EXCLUDED(mu_);
 
+  // Gets the sum of time closures waited in pending queues, and the number
+  // of closures taken from the queues, since the thread started.
+  void GetQueueWaitStats(absl::Duration* total_wait_time,
+                         int64_t* num_dequeued) const ABSL_LOCKS_EXCLUDED(mu_);
+
   bool IsIdle() const ABSL_LOCKS_EXCLUDED(mu_);
   std::string DebugString() const ABSL_LOCKS_EXCLUDED(mu_);
 
@@ -287,6 +292,8 @@ class WorkerThread : public PlatformThread::Delegate {
   std::deque<ClosureData> pendings_[NUM_PRIORITIES] ABSL_GUARDED_BY(mu_);
   int max_queuelen_[NUM_PRIORITIES] ABSL_GUARDED_BY(mu_);
   absl::Duration max_wait_time_[NUM_PRIORITIES] ABSL_GUARDED_BY(mu_);
+  absl::Duration total_wait_time_ ABSL_GUARDED_BY(mu_);
+  int64_t num_dequeued_ ABSL_GUARDED_BY(mu_);
 
   // delayed_pendings_ and periodic_closures_ are handled in PRIORITY_IMMEDIATE
   DelayedClosureQueue delayed_pendings_ ABSL_GUARDED_BY(mu_);
@@ -9,9 +9,11 @@
 #include <limits.h>
 #endif  // _WIN32
 
+#include <algorithm>
 #include <queue>
 #include <sstream>
 
+#include "absl/memory/memory.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "autolock_timer.h"
@@ -19,8 +21,10 @@
 #include "compiler_specific.h"
 #include "descriptor_poller.h"
 #include "glog/logging.h"
+#include "machine_info.h"
 #include "simple_timer.h"
 #include "socket_descriptor.h"
+#include "worker_pool_tuner.h"
 #include "worker_thread.h"
 
 #ifdef _WIN32
@@ -46,6 +50,53 @@ static void DontCallForkInWorkerThreadManager() {
 }
 #endif
 
+struct WorkerThreadManager::AdaptivePool {
+  AdaptivePool(int min_threads, int max_threads, absl::Duration tune_period)
+      : tuner(min_threads, max_threads, GetNumCPUs()),
+        tune_period(tune_period) {}
+
+  // Selects the least loaded worker among active workers.
+  WorkerThread* SelectWorker() {
+    const size_t num_active =
+        std::min<size_t>(tuner.active_threads(), workers.size());
+    WorkerThread* candidate_worker = nullptr;
+    size_t min_load = INT_MAX;
+    for (size_t i = 0; i < num_active; ++i) {
+      WorkerThread* worker = workers[(next_index + i) % num_active];
+      if (!worker) continue;
+      if (worker == GetCurrentWorker() && worker->pendings() == 0) {
+        candidate_worker = worker;
+        break;
+      }
+      size_t load = worker->load();
+      if (load == 0) {
+        candidate_worker = worker;
+        break;
+      }
+      if (load < min_load) {
+        min_load = load;
+        candidate_worker = worker;
+      }
+    }
+    if (num_active > 0) {
+      next_index = (next_index + 1) % num_active;
+    }
+    return candidate_worker;
+  }
+
+  // All workers of the pool. Only first tuner.active_threads() workers get
+  // new closures.
+  std::vector<WorkerThread*> workers;
+  size_t next_index = 0;
+  WorkerPoolTuner tuner;
+  const absl::Duration tune_period;
+  PeriodicClosureId periodic_closure_id = kInvalidPeriodicClosureId;
+
+  // queue wait stats of workers at the last tuning.
+  absl::Duration last_total_wait_time;
+  int64_t last_num_dequeued = 0;
+};
+
 WorkerThreadManager::WorkerThreadManager()
     : next_worker_index_(0),
       next_pool_(kFreePool + 1),
@@ -95,6 +146,102 @@ int WorkerThreadManager::StartPool(int num_threads, const std::string& name) {
   return pool;
 }
 
+int WorkerThreadManager::StartAdaptivePool(int min_threads,
+                                           int max_threads,
+                                           absl::Duration tune_period,
+                                           const std::string& name) {
+  int pool;
+  {
+    AUTO_EXCLUSIVE_LOCK(lock, &mu_);
+    CHECK(GetCurrentWorker() == nullptr);
+    pool = next_pool_++;
+    auto adaptive_pool =
+        absl::make_unique<AdaptivePool>(min_threads, max_threads, tune_period);
+    for (int i = 0; i < adaptive_pool->tuner.max_threads(); ++i) {
+      WorkerThread* worker = new WorkerThread(pool, name);
+      worker->Start();
+      workers_.push_back(worker);
+      adaptive_pool->workers.push_back(worker);
+    }
+    LOG(INFO) << "adaptive pool " << pool << " " << name
+              << " min_threads=" << adaptive_pool->tuner.min_threads()
+              << " max_threads=" << adaptive_pool->tuner.max_threads()
+              << " tune_period=" << tune_period;
+    adaptive_pools_.emplace(pool, std::move(adaptive_pool));
+  }
+  PeriodicClosureId id = RegisterPeriodicClosure(
+      FROM_HERE, tune_period,
+      NewPermanentCallback(this, &WorkerThreadManager::TuneAdaptivePool, pool));
+  AUTO_EXCLUSIVE_LOCK(lock, &mu_);
+  adaptive_pools_[pool]->periodic_closure_id = id;
+  return pool;
+}
+
+bool WorkerThreadManager::DumpAdaptivePoolStatsToProto(
+    int pool, AdaptivePoolStats* stats) const {
+  AUTO_SHARED_LOCK(lock, &mu_);
+  const auto found = adaptive_pools_.find(pool);
+  if (found == adaptive_pools_.end()) {
+    return false;
+  }
+  found->second->tuner.DumpStatsToProto(stats);
+  return true;
+}
+
+void WorkerThreadManager::TuneAdaptivePool(int pool) {
+  WorkerPoolTuner::Sample sample;
+  if (!GetSystemLoad(&sample.load_average, &sample.runnable_threads)) {
+    sample.load_average = -1.0;
+    sample.runnable_threads = -1;
+  }
+
+  AUTO_EXCLUSIVE_LOCK(lock, &mu_);
+  const auto found = adaptive_pools_.find(pool);
+  if (found == adaptive_pools_.end()) {
+    return;
+  }
+  AdaptivePool* adaptive_pool = found->second.get();
+  absl::Duration total_wait_time;
+  int64_t num_dequeued = 0;
+  for (const auto* worker : adaptive_pool->workers) {
+    if (!worker) continue;
+    sample.pendings += worker->pendings();
+    if (!worker->IsIdle()) {
+      ++sample.busy_threads;
+    }
+    absl::Duration wait_time;
+    int64_t n;
+    worker->GetQueueWaitStats(&wait_time, &n);
+    total_wait_time += wait_time;
+    num_dequeued += n;
+  }
+  const int64_t num_dequeued_in_period =
+      num_dequeued - adaptive_pool->last_num_dequeued;
+  if (num_dequeued_in_period > 0) {
+    sample.queue_wait =
+        (total_wait_time - adaptive_pool->last_total_wait_time) /
+        num_dequeued_in_period;
+  } else if (sample.pendings > 0) {
+    // Nothing was taken from the queues while closures are waiting.
+    sample.queue_wait = adaptive_pool->tune_period;
+  }
+  adaptive_pool->last_total_wait_time = total_wait_time;
+  adaptive_pool->last_num_dequeued = num_dequeued;
+
+  const int old_active_threads = adaptive_pool->tuner.active_threads();
+  WorkerPoolTuner::Decision decision = adaptive_pool->tuner.Update(sample);
+  LOG_IF(INFO, decision != WorkerPoolTuner::kHold)
+      << "adaptive pool " << pool << " "
+      << WorkerPoolTuner::DecisionName(decision)
+      << " active_threads=" << old_active_threads << "->"
+      << adaptive_pool->tuner.active_threads()
+      << " pendings=" << sample.pendings
+      << " busy_threads=" << sample.busy_threads
+      << " queue_wait=" << sample.queue_wait
+      << " runnable_threads=" << sample.runnable_threads
+      << " load_average=" << sample.load_average;
+}
+
 void WorkerThreadManager::NewThread(OneshotClosure* callback,
                                     const std::string& name) {
   AUTO_EXCLUSIVE_LOCK(lock, &mu_);
@@ -124,6 +271,21 @@ void WorkerThreadManager::Shutdown() {
 
 void WorkerThreadManager::Finish() {
   LOG(INFO) << "Finish";
+  // Unregister tuning closures first, since they take |mu_| on alarm worker.
+  std::vector<PeriodicClosureId> tune_closure_ids;
+  {
+    AUTO_EXCLUSIVE_LOCK(lock, &mu_);
+    for (auto& it : adaptive_pools_) {
+      if (it.second->periodic_closure_id != kInvalidPeriodicClosureId) {
+        tune_closure_ids.push_back(it.second->periodic_closure_id);
+        it.second->periodic_closure_id = kInvalidPeriodicClosureId;
+      }
+    }
+  }
+  for (const auto& id : tune_closure_ids) {
+    UnregisterPeriodicClosure(id);
+  }
+
   AUTO_EXCLUSIVE_LOCK(lock, &mu_);
   CHECK(GetCurrentWorker() == nullptr);
   if (alarm_worker_ != nullptr)
@@ -148,6 +310,10 @@ void WorkerThreadManager::Finish() {
       *iter = nullptr;
     }
   }
+  // Adaptive pools refer to the deleted workers.
+  for (auto& it : adaptive_pools_) {
+    it.second->workers.clear();
+  }
 }
 
 WorkerThread::ThreadId WorkerThreadManager::GetCurrentThreadId() {
@@ -246,30 +412,36 @@ void WorkerThreadManager::RunClosureInPool(
   WorkerThread* candidate_worker = nullptr;
   {
     AUTO_EXCLUSIVE_LOCK(lock, &mu_);  // updates |next_worker_index_|.
-    size_t min_load = INT_MAX;
-    size_t i;
-    for (i = next_worker_index_;
-         i < next_worker_index_ + workers_.size();
-         ++i) {
-      WorkerThread* worker = workers_[i % workers_.size()];
-      if (!worker) continue;
-      if (worker->pool() != pool) continue;
-      if (worker == GetCurrentWorker() && worker->pendings() == 0) {
-        candidate_worker = worker;
-        break;
-      }
-      size_t load = worker->load();
-      if (load == 0) {
-        candidate_worker = worker;
-        break;
-      }
-      if (load < min_load) {
-        min_load = load;
-        candidate_worker = worker;
+    const auto found = adaptive_pools_.find(pool);
+    if (found != adaptive_pools_.end()) {
+      candidate_worker = found->second->SelectWorker();
+      CHECK(candidate_worker);
+    } else {
+      size_t min_load = INT_MAX;
+      size_t i;
+      for (i = next_worker_index_;
+           i < next_worker_index_ + workers_.size();
+           ++i) {
+        WorkerThread* worker = workers_[i % workers_.size()];
+        if (!worker) continue;
+        if (worker->pool() != pool) continue;
+        if (worker == GetCurrentWorker() && worker->pendings() == 0) {
+          candidate_worker = worker;
+          break;
+        }
+        size_t load = worker->load();
+        if (load == 0) {
+          candidate_worker = worker;
+          break;
+        }
+        if (load < min_load) {
+          min_load = load;
+          candidate_worker = worker;
+        }
       }
+      CHECK(candidate_worker);
+      next_worker_index_ = (i + 1) % workers_.size();
     }
-    CHECK(candidate_worker);
-    next_worker_index_ = (i + 1) % workers_.size();
   }
   return candidate_worker->RunClosure(location, closure, priority);
 }
@@ -10,12 +10,18 @@
 #include <string>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/time/time.h"
 #include "basictypes.h"
+#include "compiler_specific.h"
 #include "lockhelper.h"
 #include "platform_thread.h"
 #include "worker_thread.h"
 
+MSVC_PUSH_DISABLE_WARNING_FOR_PROTO()
+#include "lib/goma_stats.pb.h"
+MSVC_POP_WARNING()
+
 namespace devtools_goma {
 
 class Closure;
@@ -52,6 +58,22 @@ class WorkerThreadManager {
   int StartPool(int num_threads, const std::string& name)
       ABSL_LOCKS_EXCLUDED(mu_);
 
+  // Starts pool of max_threads, whose number of active threads is tuned
+  // between min_threads and max_threads every |tune_period|, from queue wait
+  // of the pool and CPU load of the machine. See WorkerPoolTuner.
+  // Inactive threads finish closures already queued, but don't get new ones.
+  // Returns pool id that can be used for RunClosureInPool().
+  // Must be called after Start(). Can't be called on a worker thread.
+  int StartAdaptivePool(int min_threads,
+                        int max_threads,
+                        absl::Duration tune_period,
+                        const std::string& name) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Stores stats of adaptive |pool| into |stats|.
+  // Returns false if |pool| is not an adaptive pool.
+  bool DumpAdaptivePoolStatsToProto(int pool, AdaptivePoolStats* stats) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
   // Starts new dedicated worker thread.
   void NewThread(OneshotClosure* closure, const std::string& name)
       ABSL_LOCKS_EXCLUDED(mu_);
@@ -127,12 +149,17 @@ class WorkerThreadManager {
 
  private:
   friend class WorkerThreadManagerTest;
+  struct AdaptivePool;
   struct Periodic;
 
   static void RegisterPeriodicClosureOnAlarmer(
       WorkerThread* alarmer, PeriodicClosureId id, const char* location,
       absl::Duration period, std::unique_ptr<PermanentClosure> closure);
 
+  // Tunes the number of active threads of adaptive |pool|.
+  // Runs on alarm worker periodically.
+  void TuneAdaptivePool(int pool) ABSL_LOCKS_EXCLUDED(mu_);
+
   WorkerThread* GetWorker(ThreadId id) ABSL_LOCKS_EXCLUDED(mu_);
   WorkerThread* GetWorkerUnlocked(ThreadId id) ABSL_SHARED_LOCKS_REQUIRED(mu_);
   static WorkerThread* GetCurrentWorker();
@@ -144,6 +171,9 @@ class WorkerThreadManager {
   std::vector<WorkerThread*> workers_ ABSL_GUARDED_BY(mu_);
   size_t next_worker_index_ ABSL_GUARDED_BY(mu_);
   int next_pool_ ABSL_GUARDED_BY(mu_);
+  // pool id -> adaptive pool.
+  absl::flat_hash_map<int, std::unique_ptr<AdaptivePool>> adaptive_pools_
+      ABSL_GUARDED_BY(mu_);
 
   WorkerThread* alarm_worker_;
 
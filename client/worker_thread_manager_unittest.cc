@@ -420,6 +420,10 @@ class WorkerThreadManagerTest : public ::testing::Test {
     return periodic_counter_;
   }
 
+  void TuneAdaptivePool(int pool) {
+    wm_->TuneAdaptivePool(pool);
+  }
+
   std::unique_ptr<WorkerThreadManager> wm_;
   mutable Lock mu_;
 
@@ -514,6 +518,51 @@ TEST_F(WorkerThreadManagerTest, RunClosureInPool) {
   wm_->Finish();
 }
 
+TEST_F(WorkerThreadManagerTest, RunClosureInAdaptivePool) {
+  wm_->Start(1);
+  // Long tune period so that the test tunes the pool by itself.
+  int pool = wm_->StartAdaptivePool(1, 3, absl::Hours(1), "test");
+  EXPECT_NE(pool, WorkerThreadManager::kAlarmPool);
+  EXPECT_NE(pool, WorkerThreadManager::kFreePool);
+  EXPECT_EQ(4U, wm_->num_threads());
+
+  AdaptivePoolStats stats;
+  EXPECT_FALSE(wm_->DumpAdaptivePoolStatsToProto(
+      WorkerThreadManager::kFreePool, &stats));
+  ASSERT_TRUE(wm_->DumpAdaptivePoolStatsToProto(pool, &stats));
+  EXPECT_EQ(1, stats.min_threads());
+  EXPECT_EQ(3, stats.max_threads());
+  EXPECT_EQ(3, stats.active_threads());
+
+  // The pool is idle, so it shrinks to min_threads.
+  for (int i = 0; i < 10; ++i) {
+    TuneAdaptivePool(pool);
+  }
+  ASSERT_TRUE(wm_->DumpAdaptivePoolStatsToProto(pool, &stats));
+  EXPECT_EQ(1, stats.active_threads());
+  EXPECT_EQ(1, stats.lowest_active_threads());
+  EXPECT_EQ(2, stats.shrink_idle() + stats.shrink_cpu());
+
+  wm_->RunClosureInPool(FROM_HERE, pool, NewTestRun(),
+                        WorkerThread::PRIORITY_LOW);
+  WaitTestRun();
+  WorkerThread::ThreadId pool_id = test_threadid();
+  Reset();
+  // Only the active thread gets closures.
+  const int kNumTestThreadHandle = 100;
+  for (int i = 0; i < kNumTestThreadHandle; ++i) {
+    wm_->RunClosureInPool(FROM_HERE, pool, NewTestThreadId(pool_id),
+                          WorkerThread::PRIORITY_LOW);
+  }
+  WaitTestThreadHandle(kNumTestThreadHandle);
+  wm_->Finish();
+
+  // Stats don't touch the finished workers.
+  TuneAdaptivePool(pool);
+  ASSERT_TRUE(wm_->DumpAdaptivePoolStatsToProto(pool, &stats));
+  EXPECT_EQ(0, stats.last_pendings());
+}
+
 TEST_F(WorkerThreadManagerTest, PeriodicClosure) {
   wm_->Start(1);
   SimpleTimer timer;
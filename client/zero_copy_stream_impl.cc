@@ -67,6 +67,28 @@ int ScopedFdInputStream::CopyingScopedFdInputStream::Skip(int count) {
   return CopyingInputStream::Skip(count);
 }
 
+ScopedFdOutputStream::ScopedFdOutputStream(ScopedFd fd)
+    : copying_output_(std::move(fd)),
+      impl_(&copying_output_, /*block_size=*/-1) {}
+
+ScopedFdOutputStream::CopyingScopedFdOutputStream::CopyingScopedFdOutputStream(
+    ScopedFd fd)
+    : fd_(std::move(fd)) {}
+
+bool ScopedFdOutputStream::CopyingScopedFdOutputStream::Write(
+    const void* buffer, int size) {
+  const char* p = static_cast<const char*>(buffer);
+  while (size > 0) {
+    ssize_t n = fd_.Write(p, size);
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
 ChainedInputStream::ChainedInputStream(
     std::vector<std::unique_ptr<google::protobuf::io::ZeroCopyInputStream>>
         streams)
@@ -79,6 +79,41 @@ class ScopedFdInputStream : public google::protobuf::io::ZeroCopyInputStream {
   google::protobuf::io::CopyingInputStreamAdaptor impl_;
 };
 
+// ScopedFdOutputStream writes to the file of ScopedFd with buffering.
+// Call Flush() to write buffered data before destruction.
+class ScopedFdOutputStream
+    : public google::protobuf::io::ZeroCopyOutputStream {
+ public:
+  explicit ScopedFdOutputStream(ScopedFd fd);
+  ~ScopedFdOutputStream() override = default;
+
+  bool Next(void** data, int* size) override {
+    return impl_.Next(data, size);
+  }
+  void BackUp(int count) override { impl_.BackUp(count); }
+  google::protobuf::int64 ByteCount() const override {
+    return impl_.ByteCount();
+  }
+
+  // Writes buffered data to the file.
+  bool Flush() { return impl_.Flush(); }
+
+ private:
+  class CopyingScopedFdOutputStream
+      : public google::protobuf::io::CopyingOutputStream {
+   public:
+    explicit CopyingScopedFdOutputStream(ScopedFd fd);
+    ~CopyingScopedFdOutputStream() override = default;
+
+    bool Write(const void* buffer, int size) override;
+
+   private:
+    ScopedFd fd_;
+  };
+  CopyingScopedFdOutputStream copying_output_;
+  google::protobuf::io::CopyingOutputStreamAdaptor impl_;
+};
+
 // ChainedInputStream is similar to ContatinatingInputStream,
 // but it owns all underlying input streams.
 class ChainedInputStream : public google::protobuf::io::ZeroCopyInputStream {
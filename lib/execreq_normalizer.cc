@@ -5,6 +5,7 @@
 
 #include "lib/execreq_normalizer.h"
 
+#include <algorithm>
 #include <utility>
 #include <vector>
 
@@ -18,7 +19,6 @@
 #include "lib/compiler_flags.h"
 #include "lib/path_resolver.h"
 #include "lib/path_util.h"
-using google::protobuf::RepeatedPtrField;
 using ::absl::StrCat;
 
 namespace devtools_goma {
@@ -189,19 +189,23 @@ void ConfigurableExecReqNormalizer::NormalizeExecReqArgs(
       << "compiler specific one.";
 }
 
-void ConfigurableExecReqNormalizer::NormalizeExecReqPathnamesInInput(
+void ConfigurableExecReqNormalizer::NormalizeExecReqInputs(
     int keep_pathnames_in_input,
     const std::map<std::string, std::string>& debug_prefix_map,
     const std::string& debug_prefix_map_signature,
     ExecReq* req) const {
-  if (keep_pathnames_in_input & kAsIs) {
-    return;
-  }
+  // Reordering needs cwd and filename in ExecReq_Input.
+  // So, do before rewriting pathnames and cwd.
+  NormalizeExecReqInputOrderForCacheKey(req);
 
+  const bool keep_as_is = keep_pathnames_in_input & kAsIs;
   bool is_rewritten_debug_prefix_map = false;
   bool is_rewritten_cwd = false;
-  bool is_removed = false;
   for (auto& input : *req->mutable_input()) {
+    input.clear_content();
+    if (keep_as_is) {
+      continue;
+    }
     if (keep_pathnames_in_input & kNormalizeWithDebugPrefixMap) {
       RewritePathWithDebugPrefixMap(debug_prefix_map, input.mutable_filename());
       is_rewritten_debug_prefix_map = true;
@@ -223,41 +227,72 @@ void ConfigurableExecReqNormalizer::NormalizeExecReqPathnamesInInput(
   if (is_rewritten_cwd) {
     normalized_spec->mutable_comment()->append(" pathnames_in_input:cwd");
   }
-  if (is_removed) {
-    normalized_spec->mutable_comment()->append(" pathnames_in_input:removed");
-  }
 }
 
-void ConfigurableExecReqNormalizer::NormalizeExecReqCwd(
+void ConfigurableExecReqNormalizer::NormalizeExecReqCwdAndEnvs(
     int keep_cwd,
     const absl::optional<std::string>& new_cwd,
     const std::map<std::string, std::string>& debug_prefix_map,
     const std::string& debug_prefix_map_signature,
     ExecReq* req) const {
-  if (keep_cwd & kAsIs) {
-    return;
-  }
-
-  bool is_rewritten = false;
-  bool is_removed = false;
-  bool is_replaced = false;
-
   static const char kPwd[] = "PWD=";
+  static const char kDeveloperDir[] = "DEVELOPER_DIR=";
 
-  if (!(keep_cwd & (kNormalizeWithCwd | kNormalizeWithDebugPrefixMap)) &&
+  const bool normalize_cwd = !(keep_cwd & kAsIs);
+  const bool with_debug_prefix_map = keep_cwd & kNormalizeWithDebugPrefixMap;
+
+  if (normalize_cwd &&
+      !(keep_cwd & (kNormalizeWithCwd | kNormalizeWithDebugPrefixMap)) &&
       req->has_original_cwd()) {
     LOG(WARNING) << req->requester_info().compiler_proxy_id()
                  << ": do not normalize with cwd or debug prefix map, but "
                     "original_cwd is set";
   }
 
-  if (keep_cwd & kNormalizeWithDebugPrefixMap) {
-    // If there is PWD= in env, replace cwd with content of PWD=.
-    for (const auto& env_var : req->env()) {
-      if (absl::StartsWith(env_var, kPwd)) {
-        *req->mutable_cwd() = env_var.substr(strlen(kPwd));
-        break;
+  // Drop DEVELOPER_DIR, and rewrite or drop PWD in place. Kept entries are
+  // moved forward by swapping pointers, so strings are not copied.
+  // If there is PWD= in env, cwd is replaced with content of the first one
+  // when normalizing with debug prefix map.
+  absl::optional<std::string> pwd;
+  bool is_rewritten = false;
+  bool is_removed = false;
+  auto* envs = req->mutable_env();
+  int num_kept = 0;
+  for (int i = 0; i < envs->size(); ++i) {
+    std::string* env_var = envs->Mutable(i);
+    if (absl::StartsWith(*env_var, kDeveloperDir)) {
+      continue;
+    }
+    if (normalize_cwd && absl::StartsWith(*env_var, kPwd)) {
+      if (!with_debug_prefix_map) {
+        is_removed = true;
+        continue;
       }
+      std::string path = env_var->substr(strlen(kPwd));
+      if (!pwd) {
+        pwd = path;
+      }
+      RewritePathWithDebugPrefixMap(debug_prefix_map, &path);
+      *env_var = StrCat(kPwd, path);
+      is_rewritten = true;
+    }
+    if (num_kept != i) {
+      envs->SwapElements(num_kept, i);
+    }
+    ++num_kept;
+  }
+  if (num_kept < envs->size()) {
+    envs->DeleteSubrange(num_kept, envs->size() - num_kept);
+  }
+
+  if (!normalize_cwd) {
+    return;
+  }
+
+  bool is_replaced = false;
+  if (with_debug_prefix_map) {
+    if (pwd) {
+      *req->mutable_cwd() = std::move(*pwd);
     }
 
     if (new_cwd) {
@@ -280,25 +315,6 @@ void ConfigurableExecReqNormalizer::NormalizeExecReqCwd(
     is_removed = true;
   }
 
-  // Drop PWD from env.
-  auto it = req->mutable_env()->begin();
-  while (it != req->mutable_env()->end()) {
-    if (absl::StartsWith(*it, kPwd)) {
-      if (keep_cwd & kNormalizeWithDebugPrefixMap) {
-        std::string path = it->substr(strlen(kPwd));
-        RewritePathWithDebugPrefixMap(debug_prefix_map, &path);
-        *it = StrCat(kPwd, path);
-        is_rewritten = true;
-        ++it;
-      } else {
-        it = req->mutable_env()->erase(it);
-        is_removed = true;
-      }
-    } else {
-      ++it;
-    }
-  }
-
   CommandSpec* normalized_spec = req->mutable_command_spec();
   if (is_rewritten) {
     normalized_spec->mutable_comment()->append(" cwd:" +
@@ -320,24 +336,6 @@ void ConfigurableExecReqNormalizer::NormalizeExecReqSubprograms(
   }
 }
 
-void ConfigurableExecReqNormalizer::NormalizeExecReqEnvs(ExecReq* req) const {
-  std::vector<std::string> new_env;
-  bool changed = false;
-  for (const auto& env_var : req->env()) {
-    if (absl::StartsWith(env_var, "DEVELOPER_DIR=")) {
-      changed = true;
-      continue;
-    }
-    new_env.push_back(env_var);
-  }
-  if (changed) {
-    req->clear_env();
-    for (auto&& env_var : new_env) {
-      req->add_env(std::move(env_var));
-    }
-  }
-}
-
 void ConfigurableExecReqNormalizer::NormalizeExecReqOutputFilesAndDirs(
     ExecReq* req) const {
   // Just sort.
@@ -369,34 +367,14 @@ void ConfigurableExecReqNormalizer::NormalizeExecReqOutputFilesAndDirs(
 // See also b/11455957
 void ConfigurableExecReqNormalizer::NormalizeExecReqInputOrderForCacheKey(
     ExecReq* req) const {
-  std::vector<const ExecReq_Input*> inputs_in_cwd;
-  std::vector<const ExecReq_Input*> inputs_not_in_cwd;
-
-  inputs_in_cwd.reserve(req->input_size());
-  inputs_not_in_cwd.reserve(req->input_size());
-
-  for (const auto& input : req->input()) {
-    if (absl::StartsWith(input.filename(), req->cwd())) {
-      inputs_in_cwd.push_back(&input);
-    } else {
-      inputs_not_in_cwd.push_back(&input);
-    }
-  }
-
-  RepeatedPtrField<ExecReq_Input> new_inputs;
-  new_inputs.Reserve(req->input_size());
-
   // Inputs whose filename starting with cwd come first.
-  for (const auto& input : inputs_in_cwd) {
-    *new_inputs.Add() = *input;
-  }
-  for (const auto& input : inputs_not_in_cwd) {
-    *new_inputs.Add() = *input;
-  }
-
-  DCHECK_EQ(new_inputs.size(), req->input_size());
-
-  req->mutable_input()->Swap(&new_inputs);
+  // This moves element pointers only, and does not copy ExecReq_Input.
+  const std::string& cwd = req->cwd();
+  std::stable_partition(req->mutable_input()->pointer_begin(),
+                        req->mutable_input()->pointer_end(),
+                        [&cwd](const ExecReq_Input* input) {
+                          return absl::StartsWith(input->filename(), cwd);
+                        });
 }
 
 void ConfigurableExecReqNormalizer::NormalizeForCacheKey(
@@ -410,10 +388,6 @@ void ConfigurableExecReqNormalizer::NormalizeForCacheKey(
   req->clear_cache_policy();
   req->clear_requester_env();
 
-  for (auto& input : *req->mutable_input()) {
-    input.clear_content();
-  }
-
   req->mutable_command_spec()->clear_local_compiler_path();
   const std::string& command_name = req->command_spec().name();
   LOG_IF(ERROR, command_name.empty())
@@ -459,17 +433,14 @@ void ConfigurableExecReqNormalizer::NormalizeForCacheKey(
                                     debug_prefix_map_signature, req);
   NormalizeExecReqArgs(config.keep_args, args, normalize_weak_relative_for_arg,
                        debug_prefix_map, debug_prefix_map_signature, req);
-  // This method needs cwd and filename in ExecReq_Input.
-  // So, do before processing keep_pathnames and keep_cwd.
-  NormalizeExecReqInputOrderForCacheKey(req);
-  NormalizeExecReqPathnamesInInput(config.keep_pathnames_in_input,
-                                   debug_prefix_map, debug_prefix_map_signature,
-                                   req);
-  NormalizeExecReqCwd(config.keep_cwd, config.new_cwd, debug_prefix_map,
-                      debug_prefix_map_signature, req);
+  // This method needs cwd, so do before processing keep_cwd.
+  NormalizeExecReqInputs(config.keep_pathnames_in_input, debug_prefix_map,
+                         debug_prefix_map_signature, req);
+  NormalizeExecReqCwdAndEnvs(config.keep_cwd, config.new_cwd,
+                             debug_prefix_map, debug_prefix_map_signature,
+                             req);
 
   NormalizeExecReqSubprograms(req);
-  NormalizeExecReqEnvs(req);
   NormalizeExecReqOutputFilesAndDirs(req);
 }
 
@@ -107,12 +107,15 @@ class ConfigurableExecReqNormalizer : public ExecReqNormalizer {
   // So, do before processing keep_pathnames and keep_cwd.
   void NormalizeExecReqInputOrderForCacheKey(ExecReq* req) const;
 
-  void NormalizeExecReqPathnamesInInput(
+  // Reorders inputs, clears their contents, and normalizes their pathnames
+  // in one pass over inputs.
+  void NormalizeExecReqInputs(
       int keep_pathnames_in_input,
       const std::map<std::string, std::string>& debug_prefix_map,
       const std::string& debug_prefix_map_signature,
       ExecReq* req) const;
-  void NormalizeExecReqCwd(
+  // Normalizes cwd, and PWD and DEVELOPER_DIR in env in one pass over env.
+  void NormalizeExecReqCwdAndEnvs(
       int keep_cwd,
       const absl::optional<std::string>& new_cwd,
       const std::map<std::string, std::string>& debug_prefix_map,
@@ -120,7 +123,6 @@ class ConfigurableExecReqNormalizer : public ExecReqNormalizer {
       ExecReq* req) const;
 
   void NormalizeExecReqSubprograms(ExecReq* req) const;
-  void NormalizeExecReqEnvs(ExecReq* req) const;
   void NormalizeExecReqOutputFilesAndDirs(ExecReq* req) const;
 };
 
@@ -94,4 +94,46 @@ TEST(ExecReqNormalizerTest, HasAmbiguityInDebugPrefixMap) {
       })));
 }
 
+TEST(ExecReqNormalizerTest, AsIsNormalizerInputsAndEnvs) {
+  ExecReq req;
+  req.mutable_command_spec()->set_name("clang");
+  req.add_arg("/usr/bin/clang");
+  req.set_cwd("/home/alice/build");
+  req.add_env("DEVELOPER_DIR=/Applications/Xcode.app");
+  req.add_env("PWD=/home/alice/build");
+  req.add_env("LANG=C");
+  for (const char* filename :
+       {"/usr/include/stdio.h", "/home/alice/build/gen.h",
+        "/home/alice/src/main.cc", "/home/alice/build/main.h"}) {
+    ExecReq_Input* input = req.add_input();
+    input->set_filename(filename);
+    input->mutable_content()->set_content("content");
+  }
+  const ExecReq_Input* gen_h = &req.input(1);
+  const ExecReq_Input* main_h = &req.input(3);
+
+  AsIsExecReqNormalizer normalizer;
+  normalizer.NormalizeForCacheKey(0, true, false, std::vector<std::string>(),
+                                  std::map<std::string, std::string>(), &req);
+
+  EXPECT_EQ("clang", req.arg(0));
+  EXPECT_EQ("/home/alice/build", req.cwd());
+  ASSERT_EQ(2, req.env_size());
+  EXPECT_EQ("PWD=/home/alice/build", req.env(0));
+  EXPECT_EQ("LANG=C", req.env(1));
+
+  // Inputs under cwd come first, keeping relative order.
+  ASSERT_EQ(4, req.input_size());
+  EXPECT_EQ("/home/alice/build/gen.h", req.input(0).filename());
+  EXPECT_EQ("/home/alice/build/main.h", req.input(1).filename());
+  EXPECT_EQ("/usr/include/stdio.h", req.input(2).filename());
+  EXPECT_EQ("/home/alice/src/main.cc", req.input(3).filename());
+  // Inputs are moved, not copied.
+  EXPECT_EQ(gen_h, &req.input(0));
+  EXPECT_EQ(main_h, &req.input(1));
+  for (const auto& input : req.input()) {
+    EXPECT_FALSE(input.has_content()) << input.filename();
+  }
+}
+
 }  // namespace devtools_goma
@@ -6,13 +6,19 @@
 
 #ifndef _WIN32
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #else
 #include <shlobj.h>
 #endif
 
+#include <stdio.h>
+
+#include <algorithm>
 #include <stack>
 
+#include "absl/strings/str_cat.h"
 #include "glog/logging.h"
 #include "lib/scoped_fd.h"
 
@@ -176,8 +182,77 @@ class StringOutputImpl : public FileDataOutput {
   size_t size_;
 };
 
+#ifdef __linux__
+// Returns true if an unnamed file can be linked by its /proc/self/fd path.
+// linkat(2) with AT_EMPTY_PATH would need CAP_DAC_READ_SEARCH.
+bool CanLinkUnnamedFile() {
+  static const bool can_link = access("/proc/self/fd", X_OK) == 0;
+  return can_link;
+}
+
+int OpenUnnamedFile(const std::string& filename, int mode) {
+  std::string dirname = ".";
+  size_t last_slash = filename.rfind('/');
+  if (last_slash == 0) {
+    dirname = "/";
+  } else if (last_slash != std::string::npos) {
+    dirname = filename.substr(0, last_slash);
+  }
+  return open(dirname.c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, mode);
+}
+#endif
+
 }  // anonymous namespace
 
+#ifdef __linux__
+// UnnamedFileOutputImpl writes in fd of PendingFileOutput.
+// It doesn't take ownership of fd.
+class PendingFileOutput::UnnamedFileOutputImpl : public FileDataOutput {
+ public:
+  UnnamedFileOutputImpl(std::string name, int fd, size_t preallocated)
+      : name_(std::move(name)), fd_(fd), preallocated_(preallocated) {}
+  ~UnnamedFileOutputImpl() override {}
+  UnnamedFileOutputImpl(const UnnamedFileOutputImpl&) = delete;
+  UnnamedFileOutputImpl& operator=(const UnnamedFileOutputImpl&) = delete;
+
+  bool IsValid() const override { return fd_ >= 0; }
+  bool WriteAt(off_t offset, const std::string& content) override {
+    size_t written = 0;
+    while (written < content.size()) {
+      ssize_t n = pwrite(fd_, content.data() + written,
+                         content.size() - written, offset + written);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        PLOG(WARNING) << "write failed " << name_ << " offset=" << offset;
+        return false;
+      }
+      written += n;
+    }
+    end_ = std::max(end_, static_cast<size_t>(offset) + content.size());
+    return true;
+  }
+
+  bool Close() override {
+    // Preallocated blocks beyond the content must not be in the output.
+    if (end_ < preallocated_ && ftruncate(fd_, end_) < 0) {
+      PLOG(WARNING) << "ftruncate failed " << name_ << " size=" << end_;
+      return false;
+    }
+    return true;
+  }
+
+  std::string ToString() const override { return name_; }
+
+ private:
+  const std::string name_;
+  const int fd_;
+  const size_t preallocated_;
+  size_t end_ = 0;
+};
+#endif
+
 /* static */
 std::unique_ptr<FileDataOutput> FileDataOutput::NewFileOutput(
     const std::string& filename,
@@ -192,4 +267,141 @@ std::unique_ptr<FileDataOutput> FileDataOutput::NewStringOutput(
   return std::unique_ptr<FileDataOutput>(new StringOutputImpl(name, buf));
 }
 
+PendingFileOutput::PendingFileOutput(std::string filename,
+                                     std::string tmp_filename,
+                                     int mode,
+                                     size_t size)
+    : filename_(std::move(filename)),
+      tmp_filename_(std::move(tmp_filename)),
+      mode_(mode),
+      size_(size) {}
+
+PendingFileOutput::~PendingFileOutput() {
+  Discard();
+}
+
+bool PendingFileOutput::is_unnamed() const {
+#ifdef __linux__
+  return fd_.valid();
+#else
+  return false;
+#endif
+}
+
+std::string PendingFileOutput::path() const {
+#ifdef __linux__
+  if (fd_.valid()) {
+    return absl::StrCat("/proc/self/fd/", fd_.fd());
+  }
+#endif
+  return tmp_filename_;
+}
+
+#ifdef __linux__
+void PendingFileOutput::PrepareUnnamedFile() {
+  if (!CanLinkUnnamedFile()) {
+    return;
+  }
+  fd_.reset(OpenUnnamedFile(filename_, mode_));
+  if (!fd_.valid() && errno == ENOENT) {
+    if (!CreateDirectoryForFile(filename_)) {
+      PLOG(INFO) << "failed to create directory for " << filename_;
+    }
+    fd_.reset(OpenUnnamedFile(filename_, mode_));
+  }
+  if (!fd_.valid()) {
+    // EISDIR if kernel doesn't know O_TMPFILE, or EOPNOTSUPP if filesystem
+    // doesn't support it.
+    VLOG(1) << "unnamed file is not available for " << filename_
+            << " errno=" << errno << ", use " << tmp_filename_;
+    return;
+  }
+  // Preallocation is optimization. Some filesystems don't support it.
+  if (size_ > 0) {
+    if (fallocate(fd_.fd(), 0, 0, size_) == 0) {
+      preallocated_ = size_;
+    } else {
+      VLOG(1) << "fallocate failed " << filename_ << " size=" << size_
+              << " errno=" << errno;
+    }
+  }
+}
+#endif
+
+std::unique_ptr<FileDataOutput> PendingFileOutput::NewFileDataOutput() {
+#ifdef __linux__
+  // Opened here rather than in the constructor, so the fd is not held
+  // until the content is ready to be written.
+  PrepareUnnamedFile();
+  if (fd_.valid()) {
+    return std::unique_ptr<FileDataOutput>(
+        new UnnamedFileOutputImpl(filename_, fd_.fd(), preallocated_));
+  }
+#endif
+  remove(tmp_filename_.c_str());
+  return FileDataOutput::NewFileOutput(tmp_filename_, mode_);
+}
+
+bool PendingFileOutput::Commit() {
+  DCHECK(!done_) << filename_;
+#ifdef __linux__
+  if (fd_.valid()) {
+    const std::string path = this->path();
+    bool ok = linkat(AT_FDCWD, path.c_str(), AT_FDCWD, filename_.c_str(),
+                     AT_SYMLINK_FOLLOW) == 0;
+    if (!ok && errno == EEXIST) {
+      // linkat(2) doesn't replace the existing file, so link it at
+      // a temporary name, and rename it to filename atomically.
+      const std::string link_name =
+          absl::StrCat(filename_, ".tmp.", getpid(), ".", fd_.fd());
+      remove(link_name.c_str());
+      if (linkat(AT_FDCWD, path.c_str(), AT_FDCWD, link_name.c_str(),
+                 AT_SYMLINK_FOLLOW) != 0) {
+        return false;
+      }
+      // Once linked, the unnamed file can't be linked again after
+      // link_name is removed, so keep link_name as tmp_filename to
+      // retry Commit() or to Discard() it.
+      tmp_filename_ = link_name;
+      fd_.reset(-1);
+      if (rename(link_name.c_str(), filename_.c_str()) != 0) {
+        return false;
+      }
+      done_ = true;
+      return true;
+    }
+    if (!ok) {
+      // Keep the unnamed file, so Commit() can be retried.
+      return false;
+    }
+    done_ = true;
+    fd_.reset(-1);
+    return true;
+  }
+#endif
+  if (tmp_filename_ != filename_ &&
+      rename(tmp_filename_.c_str(), filename_.c_str()) != 0) {
+    return false;
+  }
+  done_ = true;
+  return true;
+}
+
+void PendingFileOutput::Discard() {
+  if (done_) {
+    return;
+  }
+  done_ = true;
+#ifdef __linux__
+  if (fd_.valid()) {
+    // Unnamed file is freed when closed.
+    fd_.reset(-1);
+    return;
+  }
+#endif
+  if (tmp_filename_ != filename_) {
+    remove(tmp_filename_.c_str());
+  }
+}
+
 }  // namespace devtools_goma
@@ -10,6 +10,8 @@
 #include <memory>
 #include <string>
 
+#include "lib/scoped_fd.h"
+
 namespace devtools_goma {
 
 // TODO: provide Input too.
@@ -49,6 +51,74 @@ class FileDataOutput {
       std::string* buf);
 };
 
+// PendingFileOutput is an output file that is not visible at filename
+// until Commit().
+// On Linux, it is written in an unnamed file created with O_TMPFILE in
+// the directory of filename, preallocated to the expected size, and
+// linked to filename with linkat(2) on Commit(). An uncommitted unnamed
+// file is freed by kernel, so no file is left behind.
+// The unnamed file is opened by NewFileDataOutput(), and its fd is held
+// until Commit() or Discard(), i.e. one fd per pending output.
+// If O_TMPFILE is not available (e.g. non-Linux, or the filesystem
+// doesn't support it), it is written in tmp_filename and renamed to
+// filename on Commit(). If tmp_filename == filename, it is written in
+// filename directly and Commit() does nothing.
+class PendingFileOutput {
+ public:
+  // |size| is the expected size of the output, used for preallocation.
+  PendingFileOutput(std::string filename, std::string tmp_filename,
+                    int mode, size_t size);
+  // Discards the output if it is not committed.
+  ~PendingFileOutput();
+
+  PendingFileOutput(const PendingFileOutput&) = delete;
+  PendingFileOutput& operator=(const PendingFileOutput&) = delete;
+
+  const std::string& filename() const { return filename_; }
+  // Returns true if the output is written in an unnamed file.
+  // Valid after NewFileDataOutput().
+  bool is_unnamed() const;
+  // Returns the path to read the written content before Commit().
+  // Valid after NewFileDataOutput().
+  std::string path() const;
+
+  // Returns FileDataOutput to write the content.
+  // It must not outlive this object, and should be called at most once.
+  std::unique_ptr<FileDataOutput> NewFileDataOutput();
+
+  // Publishes the written content at filename, replacing the existing file.
+  // Returns false on error, and errno is set. The written content is kept
+  // on error, so it can be retried (e.g. after the existing file is
+  // removed).
+  bool Commit();
+  // Discards the written content.
+  // Note that filename is not removed even if tmp_filename == filename,
+  // since it might be written by other (e.g. local compile).
+  void Discard();
+
+ private:
+  class UnnamedFileOutputImpl;
+
+#ifdef __linux__
+  // Opens fd_ if O_TMPFILE is available for filename.
+  void PrepareUnnamedFile();
+#endif
+
+  const std::string filename_;
+  // It may be replaced by a temporary link of the unnamed file, if Commit()
+  // failed to rename it to filename.
+  std::string tmp_filename_;
+  const int mode_;
+  const size_t size_;
+#ifdef __linux__
+  // fd of the unnamed file. invalid if O_TMPFILE is not used.
+  ScopedFd fd_;
+  // size allocated by fallocate(2).
+  size_t preallocated_ = 0;
+#endif
+  bool done_ = false;
+};
+
 }  // namespace devtools_goma
 
 #endif  // DEVTOOLS_GOMA_LIB_FILE_DATA_OUTPUT_H_
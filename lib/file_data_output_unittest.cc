@@ -4,9 +4,16 @@
 
 #include "lib/file_data_output.h"
 
+#ifndef _WIN32
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <memory>
 
 #include "gtest/gtest.h"
+#include "lib/file_helper.h"
 
 namespace devtools_goma {
 
@@ -21,4 +28,133 @@ TEST(StringOutput, EmptyContent) {
   EXPECT_EQ(buf, content);
 }
 
+#ifndef _WIN32
+class PendingFileOutputTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    const char* tmpdir = getenv("TEST_TMPDIR");
+    std::string tmpl = std::string(tmpdir ? tmpdir : "/tmp") +
+                       "/pending_file_output_unittest.XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(&tmpl[0]));
+    tmpdir_ = tmpl;
+  }
+  void TearDown() override {
+    for (const auto& name : {"out", "out.tmp", "sub/out"}) {
+      remove(Path(name).c_str());
+    }
+    rmdir(Path("sub").c_str());
+    EXPECT_EQ(0, rmdir(tmpdir_.c_str())) << "files left in " << tmpdir_;
+  }
+
+  std::string Path(const std::string& name) const {
+    return tmpdir_ + "/" + name;
+  }
+
+  static bool Exists(const std::string& path) {
+    return access(path.c_str(), F_OK) == 0;
+  }
+
+  std::string tmpdir_;
+};
+
+TEST_F(PendingFileOutputTest, Commit) {
+  const std::string content = "The quick brown fox jumps over the lazy dog.";
+  PendingFileOutput pending(Path("out"), Path("out.tmp"), 0644,
+                            content.size());
+  std::unique_ptr<FileDataOutput> output = pending.NewFileDataOutput();
+  ASSERT_TRUE(output->IsValid());
+  EXPECT_TRUE(output->WriteAt(10, content.substr(10)));
+  EXPECT_TRUE(output->WriteAt(0, content.substr(0, 10)));
+  EXPECT_TRUE(output->Close());
+  output.reset();
+  EXPECT_FALSE(Exists(Path("out")));
+
+  std::string written;
+  EXPECT_TRUE(ReadFileToString(pending.path(), &written));
+  EXPECT_EQ(content, written);
+
+  EXPECT_TRUE(pending.Commit());
+  EXPECT_TRUE(ReadFileToString(Path("out"), &written));
+  EXPECT_EQ(content, written);
+  EXPECT_FALSE(Exists(Path("out.tmp")));
+}
+
+TEST_F(PendingFileOutputTest, CommitReplace) {
+  ASSERT_TRUE(WriteStringToFile("old content", Path("out")));
+
+  const std::string content = "new";
+  // Larger expected size than actual content.
+  PendingFileOutput pending(Path("out"), Path("out.tmp"), 0644, 4096);
+  std::unique_ptr<FileDataOutput> output = pending.NewFileDataOutput();
+  ASSERT_TRUE(output->IsValid());
+  EXPECT_TRUE(output->WriteAt(0, content));
+  EXPECT_TRUE(output->Close());
+  output.reset();
+
+  std::string written;
+  EXPECT_TRUE(ReadFileToString(Path("out"), &written));
+  EXPECT_EQ("old content", written);
+
+  EXPECT_TRUE(pending.Commit());
+  EXPECT_TRUE(ReadFileToString(Path("out"), &written));
+  EXPECT_EQ(content, written);
+  EXPECT_FALSE(Exists(Path("out.tmp")));
+}
+
+TEST_F(PendingFileOutputTest, CommitInNewDirectory) {
+  PendingFileOutput pending(Path("sub/out"), Path("sub/out"), 0644, 4);
+  std::unique_ptr<FileDataOutput> output = pending.NewFileDataOutput();
+  ASSERT_TRUE(output->IsValid());
+  EXPECT_TRUE(output->WriteAt(0, "data"));
+  EXPECT_TRUE(output->Close());
+  output.reset();
+  EXPECT_TRUE(pending.Commit());
+
+  std::string written;
+  EXPECT_TRUE(ReadFileToString(Path("sub/out"), &written));
+  EXPECT_EQ("data", written);
+}
+
+TEST_F(PendingFileOutputTest, CommitRetry) {
+  // A non-empty directory can't be replaced by a file.
+  ASSERT_EQ(0, mkdir(Path("out").c_str(), 0755));
+  ASSERT_TRUE(WriteStringToFile("", Path("out/file")));
+
+  PendingFileOutput pending(Path("out"), Path("out.tmp"), 0644, 4);
+  std::unique_ptr<FileDataOutput> output = pending.NewFileDataOutput();
+  ASSERT_TRUE(output->IsValid());
+  EXPECT_TRUE(output->WriteAt(0, "data"));
+  EXPECT_TRUE(output->Close());
+  output.reset();
+  EXPECT_FALSE(pending.Commit());
+
+  // The written content is kept, so Commit() can be retried after
+  // the existing one is removed, as CompileTask::DoOutput does on Windows.
+  ASSERT_EQ(0, remove(Path("out/file").c_str()));
+  ASSERT_EQ(0, rmdir(Path("out").c_str()));
+  EXPECT_TRUE(pending.Commit());
+
+  std::string written;
+  EXPECT_TRUE(ReadFileToString(Path("out"), &written));
+  EXPECT_EQ("data", written);
+  EXPECT_FALSE(Exists(Path("out.tmp")));
+}
+
+TEST_F(PendingFileOutputTest, Discard) {
+  ASSERT_TRUE(WriteStringToFile("local output", Path("out")));
+  {
+    PendingFileOutput pending(Path("out"), Path("out.tmp"), 0644, 6);
+    std::unique_ptr<FileDataOutput> output = pending.NewFileDataOutput();
+    ASSERT_TRUE(output->IsValid());
+    EXPECT_TRUE(output->WriteAt(0, "remote"));
+    EXPECT_TRUE(output->Close());
+  }
+  EXPECT_FALSE(Exists(Path("out.tmp")));
+
+  std::string written;
+  EXPECT_TRUE(ReadFileToString(Path("out"), &written));
+  EXPECT_EQ("local output", written);
+}
+#endif
+
 }  // namespace devtools_goma
@@ -102,6 +102,9 @@ class FileReader {
  protected:
   explicit FileReader(const std::string& filename)
       : fd_(ScopedFd::OpenForRead(filename)) {}
+  // For subclasses that don't read from a file descriptor.
+  // They must override all virtual methods.
+  FileReader() {}
 
  private:
   // Returns an instance of FileReader.
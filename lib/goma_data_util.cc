@@ -9,6 +9,7 @@
 #include <string>
 #include <vector>
 
+#include "absl/container/flat_hash_set.h"
 #include "goma_hash.h"
 
 #include "lib/goma_data.pb.h"
@@ -92,4 +93,31 @@ std::string ComputeFileBlobHashKey(const FileBlob& blob) {
   return md_str;
 }
 
+bool ExpandInputManifest(const InputManifest& manifest, ExecReq* req) {
+  absl::flat_hash_set<std::string> skip(req->removed_input().begin(),
+                                        req->removed_input().end());
+  for (const auto& input : req->input()) {
+    skip.insert(input.filename());
+  }
+  for (const auto& entry : manifest.entry()) {
+    if (entry.filename().empty() || entry.hash_key().empty()) {
+      return false;
+    }
+    if (skip.contains(entry.filename())) {
+      continue;
+    }
+    ExecReq_Input* input = req->add_input();
+    input->set_filename(entry.filename());
+    input->set_hash_key(entry.hash_key());
+  }
+  std::sort(req->mutable_input()->begin(), req->mutable_input()->end(),
+            [](const ExecReq_Input& a, const ExecReq_Input& b) {
+              return a.filename() < b.filename();
+            });
+  req->clear_input_manifest_hash_key();
+  req->clear_removed_input();
+  req->clear_input_manifest();
+  return true;
+}
+
 }  // namespace devtools_goma
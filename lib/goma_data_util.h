@@ -13,6 +13,7 @@ namespace devtools_goma {
 class ExecReq;
 class ExecResp;
 class FileBlob;
+class InputManifest;
 
 // Returns true if subprograms in ExecReq and ExecResp are the same.
 bool IsSameSubprograms(const ExecReq& req, const ExecResp& resp);
@@ -24,6 +25,12 @@ bool IsValidFileBlob(const FileBlob& blob);
 // Compute a unique hash key of from the contents of |blob|.
 std::string ComputeFileBlobHashKey(const FileBlob& blob);
 
+// Replaces the input manifest reference in |req| with the inputs it stands
+// for, i.e. entries of |manifest| except req->removed_input() and those
+// overridden by req->input(). Resulting inputs are sorted by filename.
+// Returns false if |manifest| has an entry without filename or hash_key.
+bool ExpandInputManifest(const InputManifest& manifest, ExecReq* req);
+
 }  // namespace devtools_goma
 
 #endif  // DEVTOOLS_GOMA_LIB_GOMA_DATA_UTIL_H_
@@ -189,4 +189,45 @@ TEST(GomaProtoUtilTest, IsValidFileBlob) {
   }
 }
 
+TEST(GomaProtoUtilTest, ExpandInputManifest) {
+  InputManifest manifest;
+  for (const char* name : {"a.h", "b.h", "c.h", "d.h"}) {
+    InputManifest::Entry* entry = manifest.add_entry();
+    entry->set_filename(name);
+    entry->set_hash_key(std::string(name) + "_hash");
+  }
+
+  ExecReq req;
+  req.set_input_manifest_hash_key("manifest_hash");
+  req.add_removed_input("b.h");
+  ExecReq_Input* input = req.add_input();
+  input->set_filename("main.cc");
+  input->set_hash_key("main.cc_hash");
+  input = req.add_input();
+  input->set_filename("c.h");
+  input->set_hash_key("c.h_modified_hash");
+
+  ASSERT_TRUE(ExpandInputManifest(manifest, &req));
+  EXPECT_FALSE(req.has_input_manifest_hash_key());
+  EXPECT_EQ(0, req.removed_input_size());
+  ASSERT_EQ(4, req.input_size());
+  EXPECT_EQ("a.h", req.input(0).filename());
+  EXPECT_EQ("a.h_hash", req.input(0).hash_key());
+  EXPECT_EQ("c.h", req.input(1).filename());
+  EXPECT_EQ("c.h_modified_hash", req.input(1).hash_key());
+  EXPECT_EQ("d.h", req.input(2).filename());
+  EXPECT_EQ("d.h_hash", req.input(2).hash_key());
+  EXPECT_EQ("main.cc", req.input(3).filename());
+  EXPECT_EQ("main.cc_hash", req.input(3).hash_key());
+}
+
+TEST(GomaProtoUtilTest, ExpandInputManifestShouldFailOnBrokenEntry) {
+  InputManifest manifest;
+  manifest.add_entry()->set_filename("a.h");
+
+  ExecReq req;
+  req.set_input_manifest_hash_key("manifest_hash");
+  EXPECT_FALSE(ExpandInputManifest(manifest, &req));
+}
+
 }  // namespace devtools_goma
@@ -77,6 +77,24 @@ std::string SHA256HashValue::ToHexString() const {
   return md_str;
 }
 
+struct SHA256Hasher::Context {
+  SHA256_CTX sha256;
+};
+
+SHA256Hasher::SHA256Hasher() : ctx_(new Context) {
+  SHA256_Init(&ctx_->sha256);
+}
+
+SHA256Hasher::~SHA256Hasher() = default;
+
+void SHA256Hasher::Update(absl::string_view data) {
+  SHA256_Update(&ctx_->sha256, data.data(), data.size());
+}
+
+void SHA256Hasher::Finish(SHA256HashValue* hash_value) {
+  SHA256_Final(hash_value->mutable_data(), &ctx_->sha256);
+}
+
 void ComputeDataHashKeyForSHA256HashValue(absl::string_view data,
                                           SHA256HashValue* hash_value) {
   SHA256_CTX sha256;
@@ -6,6 +6,7 @@
 #ifndef DEVTOOLS_GOMA_LIB_GOMA_HASH_H_
 #define DEVTOOLS_GOMA_LIB_GOMA_HASH_H_
 
+#include <memory>
 #include <ostream>
 #include <string>
 // Needed for memcmp
@@ -57,6 +58,24 @@ class SHA256HashValue {
   unsigned char data_[32];
 };
 
+// SHA256Hasher computes SHA-256 of data given in pieces.
+class SHA256Hasher {
+ public:
+  SHA256Hasher();
+  ~SHA256Hasher();
+
+  SHA256Hasher(const SHA256Hasher&) = delete;
+  SHA256Hasher& operator=(const SHA256Hasher&) = delete;
+
+  void Update(absl::string_view data);
+  // Update must not be called after Finish.
+  void Finish(SHA256HashValue* hash_value);
+
+ private:
+  struct Context;
+  std::unique_ptr<Context> ctx_;
+};
+
 void ComputeDataHashKeyForSHA256HashValue(absl::string_view data,
                                           SHA256HashValue* hash_value);
 
@@ -47,3 +47,17 @@ TEST(GomaHashTest, SHA256HashValueNonHex) {
   EXPECT_FALSE(devtools_goma::SHA256HashValue::ConvertFromHexString(
                    hex_string, &hash_value));
 }
+
+TEST(GomaHashTest, SHA256Hasher) {
+  const std::string data = "hello, world. hello, world.";
+  std::string expected;
+  devtools_goma::ComputeDataHashKey(data, &expected);
+
+  devtools_goma::SHA256Hasher hasher;
+  hasher.Update(absl::string_view(data).substr(0, 5));
+  hasher.Update("");
+  hasher.Update(absl::string_view(data).substr(5));
+  devtools_goma::SHA256HashValue hash_value;
+  hasher.Finish(&hash_value);
+  EXPECT_EQ(expected, hash_value.ToHexString());
+}